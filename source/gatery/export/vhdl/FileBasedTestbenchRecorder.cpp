@@ -77,43 +77,20 @@ ARCHITECTURE tb OF )" << m_entityName << R"( IS
 
 	declareSignals(vhdlFile);
 
-	utils::StableMap<hlim::NodePort, bool> outputIsBool;
-	utils::StableSet<hlim::NodePort> outputIsDrivenByNetwork;
-
 	for (auto ioPin : m_allIOPins) {
 		const std::string &name = rootEntity->getNamespaceScope().get(ioPin).name;
-		auto conType = ioPin->getConnectionType();
 
-		if (ioPin->isOutputPin()) {
+		if (ioPin->isOutputPin())
 			m_outputToIoPinName[ioPin->getDriver(0)] = name;
-			outputIsBool[ioPin->getDriver(0)] = conType.isBool();
-			outputIsDrivenByNetwork.insert(ioPin->getDriver(0));
-		}
 
 		if (ioPin->isInputPin()) {
 			hlim::NodePort pinOutput{const_cast<hlim::Node_Pin*>(ioPin), 0};
 			m_outputToIoPinName[pinOutput] = name;
-			outputIsBool[pinOutput] = conType.isBool();
 		}
 
 	}
 
-	vhdlFile << R"(
-	function stringcompare(v_line : in string; str : in string) return boolean is
-	begin
-		if not (v_line'length = str'length) then
-			return false;
-		end if;
-		for i in v_line'range loop
-			if not (v_line(i) = str(i)) then
-				return false;
-			end if;
-		end loop;
-		return true;
-	 
-	end function stringcompare;
-	)";
-	
+	assignVectorIndices();
 
 	//const std::string assertionSeverity = "warning";
 	const std::string assertionSeverity = "error";
@@ -145,7 +122,9 @@ ARCHITECTURE tb OF )" << m_entityName << R"( IS
 	cf.indent(vhdlFile, 2);
 	vhdlFile << "VARIABLE v_line : line;" << std::endl;
 	cf.indent(vhdlFile, 2);
-	vhdlFile << "VARIABLE time_in_ps : integer;" << std::endl;
+	vhdlFile << "VARIABLE v_command : character;" << std::endl;
+	cf.indent(vhdlFile, 2);
+	vhdlFile << "VARIABLE v_index : integer;" << std::endl;
 	cf.indent(vhdlFile, 2);
 	vhdlFile << "VARIABLE v_clk : std_logic;" << std::endl;
 
@@ -173,169 +152,91 @@ ARCHITECTURE tb OF )" << m_entityName << R"( IS
 
 	cf.indent(vhdlFile, 3);
 	vhdlFile << "readline(test_vector_file, v_line);" << std::endl;
-	
 	cf.indent(vhdlFile, 3);
-	vhdlFile << "IF stringcompare(v_line(1 to v_line'length), \"SET\") THEN" << std::endl;
-
-		cf.indent(vhdlFile, 4);
-		vhdlFile << "readline(test_vector_file, v_line);" << std::endl;
-
-		cf.indent(vhdlFile, 4);
-		vhdlFile << "IF false THEN" << std::endl;
-		for (auto &p : m_outputToIoPinName) {
-			if (outputIsDrivenByNetwork.contains(p.first)) continue;
-
-			cf.indent(vhdlFile, 4);
-			vhdlFile << "ELSIF stringcompare(v_line(1 to v_line'length), \"" << p.second << "\") THEN" << std::endl;
+	vhdlFile << "read(v_line, v_command);" << std::endl;
+	cf.indent(vhdlFile, 3);
+	vhdlFile << "read(v_line, v_index);" << std::endl;
 
-			cf.indent(vhdlFile, 5);
-			vhdlFile << "readline(test_vector_file, v_line);" << std::endl;
+	cf.indent(vhdlFile, 3);
+	vhdlFile << "CASE v_command IS" << std::endl;
 
-			cf.indent(vhdlFile, 5);
-			if (outputIsBool[p.first])
-				vhdlFile << "read(v_line, v_" << p.second << ");" << std::endl;
-			else
-				vhdlFile << "bread(v_line, v_" << p.second << ");" << std::endl;
-			cf.indent(vhdlFile, 5);
-			vhdlFile << p.second << " <= v_" << p.second << ";" << std::endl;
-		}
+	auto writeIndexCases = [&](char command, auto &&writeBranch) {
 		cf.indent(vhdlFile, 4);
-		vhdlFile << "ELSE" << std::endl;
-		cf.indent(vhdlFile, 5);
-		vhdlFile << "REPORT \"An error occured while parsing the test vector file: unknown signal:\" & v_line(1 to v_line'length);" << std::endl;
+		vhdlFile << "WHEN '" << command << "' =>" << std::endl;
 		cf.indent(vhdlFile, 5);
+		vhdlFile << "CASE v_index IS" << std::endl;
+		writeBranch();
+		cf.indent(vhdlFile, 6);
+		vhdlFile << "WHEN OTHERS =>" << std::endl;
+		cf.indent(vhdlFile, 7);
+		vhdlFile << "REPORT \"An error occured while parsing the test vector file: unknown index:\" & integer'image(v_index);" << std::endl;
+		cf.indent(vhdlFile, 7);
 		vhdlFile << "ASSERT FALSE severity failure;" << std::endl;
-
-		cf.indent(vhdlFile, 4);
-		vhdlFile << "END IF;" << std::endl;
-
-
-	cf.indent(vhdlFile, 3);
-	vhdlFile << "ELSIF stringcompare(v_line(1 to v_line'length), \"CHECK\") THEN" << std::endl;
-
-		cf.indent(vhdlFile, 4);
-		vhdlFile << "readline(test_vector_file, v_line);" << std::endl;
-
-		cf.indent(vhdlFile, 4);
-		vhdlFile << "IF false THEN" << std::endl;
-		for (auto &p : m_outputToIoPinName) {
-
-			cf.indent(vhdlFile, 4);
-			vhdlFile << "ELSIF stringcompare(v_line(1 to v_line'length), \"" << p.second << "\") THEN" << std::endl;
-
-			cf.indent(vhdlFile, 5);
-			vhdlFile << "readline(test_vector_file, v_line);" << std::endl;
-
-			cf.indent(vhdlFile, 5);
-			if (outputIsBool[p.first])
-				vhdlFile << "read(v_line, v_" << p.second << ");" << std::endl;
+		cf.indent(vhdlFile, 5);
+		vhdlFile << "END CASE;" << std::endl;
+	};
+
+	// Bidirectional pins are both driven and checked, but have only one choice per command.
+	writeIndexCases(VECTOR_SET, [&]{
+		for (auto ioPin : m_allIOPins) {
+			if (!ioPin->isInputPin()) continue;
+			const std::string &name = rootEntity->getNamespaceScope().get(ioPin).name;
+
+			cf.indent(vhdlFile, 6);
+			vhdlFile << "WHEN " << m_signalIndices.at(name) << " =>" << std::endl;
+			cf.indent(vhdlFile, 7);
+			if (ioPin->getConnectionType().isBool())
+				vhdlFile << "read(v_line, v_" << name << ");" << std::endl;
 			else
-				vhdlFile << "bread(v_line, v_" << p.second << ");" << std::endl;
-			cf.indent(vhdlFile, 5);
-			vhdlFile << "ASSERT std_match(" << p.second << ", v_" << p.second << ") severity " << assertionSeverity<< ";" << std::endl;
+				vhdlFile << "bread(v_line, v_" << name << ");" << std::endl;
+			cf.indent(vhdlFile, 7);
+			vhdlFile << name << " <= v_" << name << ";" << std::endl;
 		}
-		cf.indent(vhdlFile, 4);
-		vhdlFile << "ELSE" << std::endl;
-		cf.indent(vhdlFile, 5);
-		vhdlFile << "REPORT \"An error occured while parsing the test vector file: unknown signal:\" & v_line(1 to v_line'length);" << std::endl;
-		cf.indent(vhdlFile, 5);
-		vhdlFile << "ASSERT FALSE severity failure;" << std::endl;
-
-		cf.indent(vhdlFile, 4);
-		vhdlFile << "END IF;" << std::endl;
-#if 0
-	cf.indent(vhdlFile, 3);
-	vhdlFile << "ELSIF stringcompare(v_line(1 to v_line'length), \"CLK\") THEN" << std::endl;
-
-		cf.indent(vhdlFile, 4);
-		vhdlFile << "readline(test_vector_file, v_line);" << std::endl;
-
-		cf.indent(vhdlFile, 4);
-		vhdlFile << "IF false THEN" << std::endl;
-		for (auto c : m_clocksOfInterest) {
+	});
 
-			auto *rootEntity = m_ast->getRootEntity();
-			std::string clockName =  rootEntity->getNamespaceScope().getClock((hlim::Clock *) c).name;
+	writeIndexCases(VECTOR_CHECK, [&]{
+		for (auto ioPin : m_allIOPins) {
+			const std::string &name = rootEntity->getNamespaceScope().get(ioPin).name;
 
-
-			cf.indent(vhdlFile, 4);
-			vhdlFile << "ELSIF stringcompare(v_line(1 to v_line'length), \"" << clockName << "\") THEN" << std::endl;
-
-			cf.indent(vhdlFile, 5);
-			vhdlFile << "readline(test_vector_file, v_line);" << std::endl;
-
-			cf.indent(vhdlFile, 5);
-			vhdlFile << "read(v_line, v_clk);" << std::endl;
-
-			cf.indent(vhdlFile, 5);
-			vhdlFile << clockName << " <= v_clk;" << std::endl;
+			cf.indent(vhdlFile, 6);
+			vhdlFile << "WHEN " << m_signalIndices.at(name) << " =>" << std::endl;
+			cf.indent(vhdlFile, 7);
+			if (ioPin->getConnectionType().isBool())
+				vhdlFile << "read(v_line, v_" << name << ");" << std::endl;
+			else
+				vhdlFile << "bread(v_line, v_" << name << ");" << std::endl;
+			cf.indent(vhdlFile, 7);
+			vhdlFile << "ASSERT std_match(" << name << ", v_" << name << ") severity " << assertionSeverity<< ";" << std::endl;
 		}
-		cf.indent(vhdlFile, 4);
-		vhdlFile << "ELSE" << std::endl;
-		cf.indent(vhdlFile, 5);
-		vhdlFile << "REPORT \"An error occured while parsing the test vector file: unknown clock:\" & v_line(1 to v_line'length);" << std::endl;
-		cf.indent(vhdlFile, 5);
-		vhdlFile << "ASSERT FALSE severity failure;" << std::endl;
+	});
 
-		cf.indent(vhdlFile, 4);
-		vhdlFile << "END IF;" << std::endl;
-#endif
-	cf.indent(vhdlFile, 3);
-	vhdlFile << "ELSIF stringcompare(v_line(1 to v_line'length), \"RST\") THEN" << std::endl;
-
-		cf.indent(vhdlFile, 4);
-		vhdlFile << "readline(test_vector_file, v_line);" << std::endl;
-
-		cf.indent(vhdlFile, 4);
-		vhdlFile << "IF false THEN" << std::endl;
+	writeIndexCases(VECTOR_RESET, [&]{
 		for (auto c : m_resetsOfInterest) {
+			std::string resetName = rootEntity->getNamespaceScope().getReset((hlim::Clock *) c).name;
 
-			auto *rootEntity = m_ast->getRootEntity();
-			std::string resetName =  rootEntity->getNamespaceScope().getReset((hlim::Clock *) c).name;
-
-
-			cf.indent(vhdlFile, 4);
-			vhdlFile << "ELSIF stringcompare(v_line(1 to v_line'length), \"" << resetName << "\") THEN" << std::endl;
-
-			cf.indent(vhdlFile, 5);
-			vhdlFile << "readline(test_vector_file, v_line);" << std::endl;
-
-			cf.indent(vhdlFile, 5);
+			cf.indent(vhdlFile, 6);
+			vhdlFile << "WHEN " << m_resetIndices[resetName] << " =>" << std::endl;
+			cf.indent(vhdlFile, 7);
 			vhdlFile << "read(v_line, v_clk);" << std::endl;
-
-			cf.indent(vhdlFile, 5);
+			cf.indent(vhdlFile, 7);
 			vhdlFile << resetName << " <= v_clk;" << std::endl;
 		}
-		cf.indent(vhdlFile, 4);
-		vhdlFile << "ELSE" << std::endl;
-		cf.indent(vhdlFile, 5);
-		vhdlFile << "REPORT \"An error occured while parsing the test vector file: unknown clock:\" & v_line(1 to v_line'length);" << std::endl;
-		cf.indent(vhdlFile, 5);
-		vhdlFile << "ASSERT FALSE severity failure;" << std::endl;
-
-		cf.indent(vhdlFile, 4);
-		vhdlFile << "END IF;" << std::endl;
-
-	cf.indent(vhdlFile, 3);
-	vhdlFile << "ELSIF stringcompare(v_line(1 to v_line'length), \"ADV\") THEN" << std::endl;
-
-		cf.indent(vhdlFile, 4);
-		vhdlFile << "readline(test_vector_file, v_line);" << std::endl;
-		cf.indent(vhdlFile, 4);
-		vhdlFile << "read(v_line, time_in_ps);" << std::endl;
-		cf.indent(vhdlFile, 4);
-		vhdlFile << "wait for time_in_ps * 1 ps;" << std::endl;
-
-	cf.indent(vhdlFile, 3);
-	vhdlFile << "ELSE" << std::endl;
+	});
 
 	cf.indent(vhdlFile, 4);
-	vhdlFile << "REPORT \"An error occured while parsing the test vector file: Can't parse line:\" & v_line(1 to v_line'length);" << std::endl;
+	vhdlFile << "WHEN '" << VECTOR_ADVANCE << "' =>" << std::endl;
+	cf.indent(vhdlFile, 5);
+	vhdlFile << "wait for v_index * 1 ps;" << std::endl;
+
 	cf.indent(vhdlFile, 4);
+	vhdlFile << "WHEN OTHERS =>" << std::endl;
+	cf.indent(vhdlFile, 5);
+	vhdlFile << "REPORT \"An error occured while parsing the test vector file: unknown command:\" & v_command;" << std::endl;
+	cf.indent(vhdlFile, 5);
 	vhdlFile << "ASSERT FALSE severity failure;" << std::endl;
 
 	cf.indent(vhdlFile, 3);
-	vhdlFile << "END IF;" << std::endl;
+	vhdlFile << "END CASE;" << std::endl;
 
 	cf.indent(vhdlFile, 2);
 	vhdlFile << "end loop;" << std::endl;
@@ -347,6 +248,20 @@ ARCHITECTURE tb OF )" << m_entityName << R"( IS
 	vhdlFile << "END;" << std::endl;
 }
 
+void FileBasedTestbenchRecorder::assignVectorIndices()
+{
+	auto *rootEntity = m_ast->getRootEntity();
+
+	// One index per pin, even if a bidirectional pin is known under both its input and its output.
+	m_signalIndices.clear();
+	for (auto ioPin : m_allIOPins)
+		m_signalIndices.try_emplace(rootEntity->getNamespaceScope().get(ioPin).name, m_signalIndices.size());
+
+	m_resetIndices.clear();
+	for (auto c : m_resetsOfInterest)
+		m_resetIndices.try_emplace(rootEntity->getNamespaceScope().getReset((hlim::Clock *) c).name, m_resetIndices.size());
+}
+
 void FileBasedTestbenchRecorder::onPowerOn()
 {
 	findClocksAndPorts();
@@ -394,7 +309,7 @@ void FileBasedTestbenchRecorder::advanceTimeTo(const hlim::ClockRational &simula
 	auto timeDiffInPS = (simulationTime - m_writtenSimulationTime) * 1'000'000'000'000ull;
 	std::uint64_t roundedTimeDiffInPS = timeDiffInPS.numerator() / timeDiffInPS.denominator();
 
-	m_testvectorFile->stream() << "ADV\n" << roundedTimeDiffInPS << std::endl;
+	m_testvectorFile->stream() << VECTOR_ADVANCE << ' ' << roundedTimeDiffInPS << '\n';
 	m_writtenSimulationTime += Seconds{roundedTimeDiffInPS, 1'000'000'000'000ull};
 }
 
@@ -405,18 +320,19 @@ void FileBasedTestbenchRecorder::flush(const hlim::ClockRational &flushIntervalE
 	for (auto phaseIdx : utils::Range(m_phases.size())) {
 		const auto &phase = m_phases[phaseIdx];
 
-		if (phase.assertStatements.str().empty() && phase.signalOverrides.empty() && phase.resetOverrides.empty())
+		if (phase.assertStatements.view().empty() && phase.signalOverrides.empty() && phase.resetOverrides.empty())
 			continue;
 
 		advanceTimeTo(m_flushIntervalStart + interval * (1 + phaseIdx));
 
-		m_testvectorFile->stream() << phase.assertStatements.str();
+		auto &stream = m_testvectorFile->stream();
+		stream << phase.assertStatements.view();
 		
 		for (const auto &p : phase.signalOverrides) 
-			m_testvectorFile->stream() << "SET\n" << p.first << '\n' << p.second << '\n';
+			stream << VECTOR_SET << ' ' << m_signalIndices.at(p.first) << ' ' << p.second << '\n';
 
 		for (const auto &p : phase.resetOverrides) 
-			m_testvectorFile->stream() << "RST\n" << p.first << '\n' << p.second << '\n';
+			stream << VECTOR_RESET << ' ' << m_resetIndices.at(p.first) << ' ' << p.second << '\n';
 	}
 
 	m_phases.clear();
@@ -510,7 +426,7 @@ void FileBasedTestbenchRecorder::onSimProcOutputRead(const hlim::NodePort &outpu
 	const auto& conType = hlim::getOutputConnectionType(drivingOutput);
 	if (conType.isBool()) {
 		if (state.get(sim::DefaultConfig::DEFINED, 0)) {
-			m_phases.back().assertStatements << "CHECK" << std::endl << name_it->second << std::endl << state << std::endl;
+			m_phases.back().assertStatements << VECTOR_CHECK << ' ' << m_signalIndices.at(name_it->second) << ' ' << state << '\n';
 		}
 	} else {
 		bool anyDefined = false;
@@ -520,7 +436,7 @@ void FileBasedTestbenchRecorder::onSimProcOutputRead(const hlim::NodePort &outpu
 		}
 
 		if (anyDefined) {
-			m_phases.back().assertStatements << "CHECK" << std::endl << name_it->second << std::endl;
+			m_phases.back().assertStatements << VECTOR_CHECK << ' ' << m_signalIndices.at(name_it->second) << ' ';
 			for (int i = (int)conType.width - 1; i >= 0; i--) {
 				bool d = state.get(sim::DefaultConfig::DEFINED, i);
 				bool v = state.get(sim::DefaultConfig::VALUE, i);
@@ -529,7 +445,7 @@ void FileBasedTestbenchRecorder::onSimProcOutputRead(const hlim::NodePort &outpu
 				else
 					m_phases.back().assertStatements << '-';
 			}
-			m_phases.back().assertStatements << std::endl;
+			m_phases.back().assertStatements << '\n';
 		}
 	}
 }
@@ -553,25 +469,15 @@ module )" << m_dependencySortedEntities.back() << "();" << std::endl;
 
 	declareSignalsVerilog(verilogFile);
 
-	utils::StableMap<hlim::NodePort, bool> outputIsBool;
-	utils::StableSet<hlim::NodePort> outputIsDrivenByNetwork;
-	utils::StableMap<hlim::NodePort, bool> isBidirectional;
-
 	for (auto ioPin : m_allIOPins) {
 		const std::string &name = rootEntity->getNamespaceScope().get(ioPin).name;
-		auto conType = ioPin->getConnectionType();
 
-		if (ioPin->isOutputPin()) {
+		if (ioPin->isOutputPin())
 			m_outputToIoPinName[ioPin->getDriver(0)] = name;
-			outputIsBool[ioPin->getDriver(0)] = conType.isBool();
-			outputIsDrivenByNetwork.insert(ioPin->getDriver(0));
-		}
 
 		if (ioPin->isInputPin()) {
 			hlim::NodePort pinOutput{const_cast<hlim::Node_Pin*>(ioPin), 0};
 			m_outputToIoPinName[pinOutput] = name;
-			outputIsBool[pinOutput] = conType.isBool();
-			isBidirectional[pinOutput] = ioPin->isBiDirectional();
 		}
 
 	}
@@ -596,7 +502,9 @@ module )" << m_dependencySortedEntities.back() << "();" << std::endl;
 	cf.indent(verilogFile, 2);
 	verilogFile << "reg [4095:0] line;" << std::endl;
 	cf.indent(verilogFile, 2);
-	verilogFile << "integer time_in_ps;" << std::endl;
+	verilogFile << "reg [7:0] command;" << std::endl;
+	cf.indent(verilogFile, 2);
+	verilogFile << "integer index;" << std::endl;
 
 	cf.indent(verilogFile, 2);
 	verilogFile << "integer test_vector_file;" << std::endl;
@@ -637,152 +545,88 @@ module )" << m_dependencySortedEntities.back() << "();" << std::endl;
 	verilogFile << "end" << std::endl;
 
 	cf.indent(verilogFile, 3);
-	verilogFile << "else if (line ==  \"SET\\n\") begin" << std::endl;
-
-		cf.indent(verilogFile, 4);
-		verilogFile << "$fgets(line, test_vector_file);" << std::endl;
-
-		cf.indent(verilogFile, 4);
-		verilogFile << "if (0) ;" << std::endl;
-		for (auto &p : m_outputToIoPinName) {
-			if (outputIsDrivenByNetwork.contains(p.first)) continue;
-
-			cf.indent(verilogFile, 4);
-			verilogFile << "else if (line == \"" << p.second << "\\n\") begin" << std::endl;
-
-			cf.indent(verilogFile, 5);
-			verilogFile << "$fgets(line, test_vector_file);" << std::endl;
-
-			cf.indent(verilogFile, 5);
-			verilogFile << "$sscanf(line, \"%b\", " << p.second << "_TB_helper);" << std::endl;
-
-			cf.indent(verilogFile, 5);
-
-#if 0
-			if (isBidirectional[p.first])
-				verilogFile << p.second << "_TB_driver <= " << p.second << "_TB_helper;" << std::endl;
-			else 
-#endif
-				verilogFile << p.second << " <= " << p.second << "_TB_helper;" << std::endl;
+	verilogFile << "else begin" << std::endl;
+	cf.indent(verilogFile, 4);
+	verilogFile << "$sscanf(line, \"%c %d\", command, index);" << std::endl;
+	cf.indent(verilogFile, 4);
+	verilogFile << "case (command)" << std::endl;
 
-			cf.indent(verilogFile, 4);
-			verilogFile << "end" << std::endl;
-		}
-		cf.indent(verilogFile, 4);
-		verilogFile << "else begin" << std::endl;
-		cf.indent(verilogFile, 5);
-		verilogFile << "$display(\"An error occured while parsing the test vector file: unknown signal: %s\", line);" << std::endl;
+	auto writeIndexCases = [&](char command, auto &&writeBranch) {
 		cf.indent(verilogFile, 5);
+		verilogFile << "\"" << command << "\": case (index)" << std::endl;
+		writeBranch();
+		cf.indent(verilogFile, 6);
+		verilogFile << "default: begin" << std::endl;
+		cf.indent(verilogFile, 7);
+		verilogFile << "$display(\"An error occured while parsing the test vector file: unknown index: %d\", index);" << std::endl;
+		cf.indent(verilogFile, 7);
 		verilogFile << "$finish;" << std::endl;
-
-		cf.indent(verilogFile, 4);
+		cf.indent(verilogFile, 6);
 		verilogFile << "end" << std::endl;
-
-	cf.indent(verilogFile, 3);
-	verilogFile << "end" << std::endl;
-
-	cf.indent(verilogFile, 3);
-	verilogFile << "else if (line == \"CHECK\\n\") begin" << std::endl;
-
-		cf.indent(verilogFile, 4);
-		verilogFile << "$fgets(line, test_vector_file);" << std::endl;
-
-		cf.indent(verilogFile, 4);
-		verilogFile << "if (0) ;" << std::endl;
-		for (auto &p : m_outputToIoPinName) {
-
-			cf.indent(verilogFile, 4);
-			verilogFile << "else if (line == \"" << p.second << "\\n\") begin" << std::endl;
-
-			cf.indent(verilogFile, 5);
-			verilogFile << "$fgets(line, test_vector_file);" << std::endl;
-
-			cf.indent(verilogFile, 5);
-			verilogFile << "$sscanf(line, \"%b\", " << p.second << "_TB_helper);" << std::endl;
-			cf.indent(verilogFile, 5);
-			verilogFile << "if (" << p.second << " !== " << p.second << "_TB_helper) $fatal(1, \"Check failed on " << p.second << "\");" << std::endl;
-
-			cf.indent(verilogFile, 4);
+		cf.indent(verilogFile, 5);
+		verilogFile << "endcase" << std::endl;
+	};
+
+	writeIndexCases(VECTOR_SET, [&]{
+		for (auto ioPin : m_allIOPins) {
+			if (!ioPin->isInputPin()) continue;
+			const std::string &name = rootEntity->getNamespaceScope().get(ioPin).name;
+
+			cf.indent(verilogFile, 6);
+			verilogFile << m_signalIndices.at(name) << ": begin" << std::endl;
+			cf.indent(verilogFile, 7);
+			verilogFile << "$sscanf(line, \"%c %d %b\", command, index, " << name << "_TB_helper);" << std::endl;
+			cf.indent(verilogFile, 7);
+			verilogFile << name << " <= " << name << "_TB_helper;" << std::endl;
+			cf.indent(verilogFile, 6);
 			verilogFile << "end" << std::endl;
 		}
-		cf.indent(verilogFile, 4);
-		verilogFile << "else begin" << std::endl;
-		cf.indent(verilogFile, 5);
-		verilogFile << "$display(\"An error occured while parsing the test vector file: unknown signal: %s\", line);" << std::endl;
-		cf.indent(verilogFile, 5);
-		verilogFile << "$finish;" << std::endl;
-
-		cf.indent(verilogFile, 4);
-		verilogFile << "end" << std::endl;
-
-	cf.indent(verilogFile, 3);
-	verilogFile << "end" << std::endl;
-
-	cf.indent(verilogFile, 3);
-	verilogFile << "else if (line == \"RST\\n\") begin" << std::endl;
-
-		cf.indent(verilogFile, 4);
-		verilogFile << "$fgets(line, test_vector_file);" << std::endl;
+	});
+
+	writeIndexCases(VECTOR_CHECK, [&]{
+		for (auto ioPin : m_allIOPins) {
+			const std::string &name = rootEntity->getNamespaceScope().get(ioPin).name;
+
+			cf.indent(verilogFile, 6);
+			verilogFile << m_signalIndices.at(name) << ": begin" << std::endl;
+			cf.indent(verilogFile, 7);
+			verilogFile << "$sscanf(line, \"%c %d %b\", command, index, " << name << "_TB_helper);" << std::endl;
+			cf.indent(verilogFile, 7);
+			verilogFile << "if (" << name << " !== " << name << "_TB_helper) $fatal(1, \"Check failed on " << name << "\");" << std::endl;
+			cf.indent(verilogFile, 6);
+			verilogFile << "end" << std::endl;
+		}
+	});
 
-		cf.indent(verilogFile, 4);
-		verilogFile << "if (0) ;" << std::endl;
+	writeIndexCases(VECTOR_RESET, [&]{
 		for (auto c : m_resetsOfInterest) {
+			std::string resetName = rootEntity->getNamespaceScope().getReset((hlim::Clock *) c).name;
 
-			auto *rootEntity = m_ast->getRootEntity();
-			std::string resetName =  rootEntity->getNamespaceScope().getReset((hlim::Clock *) c).name;
-
-
-			cf.indent(verilogFile, 4);
-			verilogFile << "else if (line == \"" << resetName << "\\n\") begin" << std::endl;
-
-			cf.indent(verilogFile, 5);
-			verilogFile << "$fgets(line, test_vector_file);" << std::endl;
-
-			cf.indent(verilogFile, 5);
-			verilogFile << "$sscanf(line, \"%b\", v_clk);" << std::endl;
-
-			cf.indent(verilogFile, 5);
+			cf.indent(verilogFile, 6);
+			verilogFile << m_resetIndices[resetName] << ": begin" << std::endl;
+			cf.indent(verilogFile, 7);
+			verilogFile << "$sscanf(line, \"%c %d %b\", command, index, v_clk);" << std::endl;
+			cf.indent(verilogFile, 7);
 			verilogFile << resetName << " <= v_clk;" << std::endl;
-
-			cf.indent(verilogFile, 4);
+			cf.indent(verilogFile, 6);
 			verilogFile << "end" << std::endl;
 		}
-		cf.indent(verilogFile, 4);
-		verilogFile << "else begin" << std::endl;
-
-		cf.indent(verilogFile, 5);
-		verilogFile << "$display(\"An error occured while parsing the test vector file: unknown clock: %s\", line);" << std::endl;
-		cf.indent(verilogFile, 5);
-		verilogFile << "$finish;" << std::endl;
-
-		cf.indent(verilogFile, 4);
-		verilogFile << "end" << std::endl;
-
-	cf.indent(verilogFile, 3);
-	verilogFile << "end" << std::endl;
-
-	cf.indent(verilogFile, 3);
-	verilogFile << "else if (line == \"ADV\\n\") begin" << std::endl;
+	});
 
-		cf.indent(verilogFile, 4);
-		verilogFile << "$fgets(line, test_vector_file);" << std::endl;
-		cf.indent(verilogFile, 4);
-		verilogFile << "$sscanf(line, \"%d\", time_in_ps);" << std::endl;
-		cf.indent(verilogFile, 4);
-		verilogFile << "#time_in_ps;" << std::endl;
+	cf.indent(verilogFile, 5);
+	verilogFile << "\"" << VECTOR_ADVANCE << "\": #index;" << std::endl;
 
-	cf.indent(verilogFile, 3);
-	verilogFile << "end" << std::endl;
-
-	cf.indent(verilogFile, 3);
-	verilogFile << "else begin" << std::endl;
-
-
-	cf.indent(verilogFile, 4);
+	cf.indent(verilogFile, 5);
+	verilogFile << "default: begin" << std::endl;
+	cf.indent(verilogFile, 6);
 	verilogFile << "$display(\"An error occured while parsing the test vector file: Can't parse line: %s\", line);" << std::endl;
-	cf.indent(verilogFile, 4);
+	cf.indent(verilogFile, 6);
 	verilogFile << "$finish;" << std::endl;
+	cf.indent(verilogFile, 5);
+	verilogFile << "end" << std::endl;
 
+	cf.indent(verilogFile, 4);
+	verilogFile << "endcase" << std::endl;
 	cf.indent(verilogFile, 3);
 	verilogFile << "end" << std::endl;
 
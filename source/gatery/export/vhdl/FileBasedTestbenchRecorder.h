@@ -42,6 +42,11 @@ namespace gtry::vhdl {
 class VHDLExport;
 class AST;
 
+/**
+ * @brief Records simulation processes into a test vector file and writes VHDL and Verilog testbenches that replay it.
+ * @details The test vector file holds one command per line: a command character, an index, and possibly a value, e.g. "S 3 0110" to set the
+ * signal with index 3. Signals and resets are referred to by index, so the testbenches can dispatch each line with a single case statement.
+ */
 class FileBasedTestbenchRecorder : public BaseTestbenchRecorder
 {
 	public:
@@ -75,6 +80,17 @@ class FileBasedTestbenchRecorder : public BaseTestbenchRecorder
 
 		std::string m_testVectorFilename;
 
+		/// Commands of the test vector file
+		static constexpr char VECTOR_SET = 'S';
+		static constexpr char VECTOR_CHECK = 'C';
+		static constexpr char VECTOR_RESET = 'R';
+		/// The index of the advance command is the time to wait in picoseconds.
+		static constexpr char VECTOR_ADVANCE = 'A';
+
+		std::map<std::string, size_t> m_signalIndices;
+		std::map<std::string, size_t> m_resetIndices;
+
+		void assignVectorIndices();
 		void writeVHDL();
 
 		void advanceTimeTo(const hlim::ClockRational &simulationTime);
@@ -20,6 +20,7 @@
 
 #include <gatery/simulation/Simulator.h>
 #include <gatery/simulation/waveformFormats/VCDSink.h>
+#include <gatery/simulation/waveformFormats/FSTSink.h>
 #include <gatery/export/vhdl/VHDLExport.h>
 #include <gatery/hlim/Circuit.h>
 #include <boost/test/unit_test.hpp>
@@ -95,6 +96,17 @@ void UnitTestSimulationFixture::recordVCD(const std::string& filename, bool incl
 		m_vcdSink->addAllMemories();
 }
 
+void UnitTestSimulationFixture::recordFST(const std::string& filename, bool includeMemories)
+{
+	m_fstSink.emplace(design.getCircuit(), *m_simulator, filename.c_str());
+	m_fstSink->addAllPins();
+	m_fstSink->addAllNamedSignals();
+	m_fstSink->addAllTaps();
+
+	if(includeMemories)
+		m_fstSink->addAllMemories();
+}
+
 void UnitTestSimulationFixture::outputVHDL(const std::string& filename, bool includeTest)
 {
 	m_vhdlExport.emplace(filename);
@@ -116,10 +128,7 @@ bool UnitTestSimulationFixture::runHitsTimeout(const hlim::ClockRational &timeou
 {
 	prepRun();
 	m_stopTestCalled = false;
-	m_simulator->compileProgram(design.getCircuit(), {}, { .perf = {
-					.samplePerformanceCounters = m_traceSimulationPerformance, 
-					.logPerformanceCounters = m_traceSimulationPerformance,
-	}});
+	m_simulator->compileProgram(design.getCircuit(), {}, getCompileOptions());
 	m_simulator->powerOn();
 	m_simulator->advance(timeoutSeconds);
 	m_simulator->commitState();
@@ -187,6 +196,8 @@ void BoostUnitTestSimulationFixture::prepRun()
 			recordVCD(filename + ".vcd");
 		else if(arg == "--vcdm")
 			recordVCD(filename + "_with_memories" ".vcd", true);
+		else if (arg == "--fst")
+			recordFST(filename + ".fst");
 		else if (arg == "--vhdl")
 			outputVHDL(filename + ".vhd");
 		else if (arg == "--csv")
@@ -22,6 +22,7 @@
 #include <gatery/simulation/UnitTestSimulationFixture.h>
 
 #include <gatery/simulation/waveformFormats/VCDSink.h>
+#include <gatery/simulation/waveformFormats/FSTSink.h>
 #include <gatery/export/vhdl/VHDLExport.h>
 #include <gatery/frontend/Clock.h>
 
@@ -48,6 +49,8 @@ namespace gtry {
 
 			/// Enables recording of a waveform for a subsequent simulation run
 			void recordVCD(const std::string& filename, bool includeMemories = false);
+			/// Enables recording of a compressed FST waveform for a subsequent simulation run
+			void recordFST(const std::string& filename, bool includeMemories = false);
 			/// Exports as VHDL and (optionally) writes a vhdl testbench of the subsequent simulation run
 			void outputVHDL(const std::string& filename, bool includeTest = true);
 
@@ -71,6 +74,7 @@ namespace gtry {
 
 			bool m_stopTestCalled = false;
 			std::optional<sim::VCDSink> m_vcdSink;
+			std::optional<sim::FSTSink> m_fstSink;
 			std::optional<vhdl::VHDLExport> m_vhdlExport;
 			std::optional<std::filesystem::path> m_statisticsCounterCsvFile;
 	};
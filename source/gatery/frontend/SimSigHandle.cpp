@@ -121,6 +121,22 @@ bool simulationIsShuttingDown()
 	return sim->simulationIsShuttingDown();
 }
 
+size_t simulationBatchIndex()
+{
+	auto *sim = sim::SimulationContext::current()->getSimulator();
+	HCL_DESIGNCHECK_HINT(sim, "Can only get the simulation batch index if running in a simulation!");
+
+	return sim->getCurrentBatchIndex();
+}
+
+bool simulationResumedFromCheckpoint()
+{
+	auto *sim = sim::SimulationContext::current()->getSimulator();
+	HCL_DESIGNCHECK_HINT(sim, "Can only check for checkpoints if running in a simulation!");
+
+	return sim->resumedFromCheckpoint();
+}
+
 bool simHasData(std::string_view key)
 {
 	return sim::SimulationContext::current()->hasAuxData(key);
@@ -363,6 +363,14 @@ namespace gtry {
 	///			 entire coroutine stack is being destructed.
 	bool simulationIsShuttingDown();
 
+	/// @brief Returns which instance of a batch simulated circuit the calling simulation process belongs to.
+	/// @see gtry::sim::CompileOptions::batchSize
+	size_t simulationBatchIndex();
+
+	/// @brief Returns true if the simulation continued from a checkpoint, in which case simulation processes start at the time of the checkpoint.
+	/// @see gtry::sim::Simulator::restoreCheckpoint
+	bool simulationResumedFromCheckpoint();
+
 	using BigInt = sim::BigInt;
 
 	sim::WaitClock AfterClk(const Clock& clk);
@@ -51,10 +51,12 @@
 #include "postprocessing/TechnologyMapping.h"
 #include "postprocessing/Retiming.h"
 #include "postprocessing/CDCDetection.h"
+#include "postprocessing/LocalRewriter.h"
 
 
 #include "../simulation/BitVectorState.h"
 #include "../simulation/ReferenceSimulator.h"
+#include "../simulation/WorkerPool.h"
 #include "../simulation/SimulationVisualization.h"
 #include "../simulation/simProc/SimulationProcess.h"
 #include "../utils/Range.h"
@@ -71,6 +73,7 @@
 #include <map>
 
 #include <iostream>
+#include <thread>
 
 template class std::unique_ptr<gtry::hlim::BaseNode>;
 template class std::unique_ptr<gtry::hlim::Clock>;
@@ -91,6 +94,45 @@ Circuit::~Circuit()
 {
 }
 
+template<typename Result>
+std::vector<Result> Circuit::analyzeByNodeGroup(const Subnet &subnet, const std::function<void(BaseNode*, std::vector<Result>&)> &analyze)
+{
+	// Partition the node indices by node group, in the order in which the groups first appear
+	std::vector<std::vector<size_t>> partitions;
+	utils::UnstableMap<const NodeGroup*, size_t> partitionOfGroup;
+	std::vector<BaseNode*> nodes(subnet.begin(), subnet.end());
+	for (auto i : utils::Range(nodes.size())) {
+		auto [it, inserted] = partitionOfGroup.try_emplace(nodes[i]->getGroup(), partitions.size());
+		if (inserted)
+			partitions.emplace_back();
+		partitions[it->second].push_back(i);
+	}
+
+	std::vector<std::vector<Result>> resultsOfNode(nodes.size());
+	auto analyzePartition = [&](size_t partition, size_t) {
+		for (auto i : partitions[partition])
+			analyze(nodes[i], resultsOfNode[i]);
+	};
+
+	size_t numThreads = m_numPostprocessingThreads;
+	if (numThreads == 0)
+		numThreads = std::max<size_t>(1, std::thread::hardware_concurrency());
+
+	if (numThreads > 1 && partitions.size() > 1) {
+		if (m_postprocessingWorkers == nullptr || m_postprocessingWorkers->getNumThreads() != numThreads)
+			m_postprocessingWorkers = std::make_unique<sim::WorkerPool>(numThreads);
+		m_postprocessingWorkers->run(partitions.size(), analyzePartition);
+	} else
+		for (auto partition : utils::Range(partitions.size()))
+			analyzePartition(partition, 0);
+
+	std::vector<Result> results;
+	for (auto &nodeResults : resultsOfNode)
+		for (auto &r : nodeResults)
+			results.push_back(std::move(r));
+	return results;
+}
+
 /**
  * @brief Copies a subnet of all nodes that are needed to drive the specified outputs up to the specified inputs
  * @note Do note that subnetInputs specified input ports, not output ports!
@@ -304,11 +346,12 @@ void Circuit::disconnectZeroBitOutputPins()
 	}
 }
 
-void Circuit::optimizeRewireNodes(Subnet &subnet)
+void Circuit::optimizeRewireNodes(Subnet &subnet, LocalRewriter *rewriter)
 {
 	for (auto &n : subnet)
 		if (Node_Rewire *rewireNode = dynamic_cast<Node_Rewire*>(n))
-			rewireNode->optimize();
+			if (rewireNode->optimize() && rewriter)
+				rewriter->enqueueRewired(rewireNode);
 }
 
 
@@ -507,89 +550,99 @@ void Circuit::mergeMuxes(Subnet &subnet)
 	do {
 		done = true;
 
-		for (size_t i = 0; i < m_nodes.size(); i++) {
-			if (Node_Multiplexer *muxNode = dynamic_cast<Node_Multiplexer*>(m_nodes[i].get())) {
-				if (muxNode->getNumInputPorts() != 3) continue;
+		for (size_t i = 0; i < m_nodes.size(); i++)
+			if (Node_Multiplexer *muxNode = dynamic_cast<Node_Multiplexer*>(m_nodes[i].get()))
+				if (mergeMuxInputs(subnet, muxNode))
+					done = false;
+	} while (!done);
+}
 
-				//std::cout << "Found 2-input mux" << std::endl;
+/**
+ * @brief Lets a binary mux directly fetch from the input of a binary mux driving it, if both are selected by the same (or the negated) condition.
+ * @return Whether any input was merged.
+ */
+bool Circuit::mergeMuxInputs(const Subnet &subnet, Node_Multiplexer *muxNode)
+{
+	if (muxNode->getNumInputPorts() != 3) return false;
 
-				Conjunction condition;
-				condition.parseInput({.node = muxNode, .port = 0});
+	//std::cout << "Found 2-input mux" << std::endl;
 
-				for (size_t muxInput : utils::Range(2)) {
+	bool merged = false;
+	Conjunction condition;
+	condition.parseInput({.node = muxNode, .port = 0});
 
-					auto input0 = muxNode->getNonSignalDriver(muxInput?2:1);
-					auto input1 = muxNode->getNonSignalDriver(muxInput?1:2);
+	for (size_t muxInput : utils::Range(2)) {
 
-					if (input1.node == nullptr)
-						continue;
+		auto input0 = muxNode->getNonSignalDriver(muxInput?2:1);
+		auto input1 = muxNode->getNonSignalDriver(muxInput?1:2);
 
-					if (Node_Multiplexer *prevMuxNode = dynamic_cast<Node_Multiplexer*>(input0.node)) {
-						if (prevMuxNode->getNumInputPorts() != 3) continue;
-						if (prevMuxNode == muxNode) continue; // sad thing
-						if (!subnet.contains(prevMuxNode)) continue; // todo: Optimize
+		if (input1.node == nullptr)
+			continue;
 
-						//std::cout << "Found 2 chained muxes" << std::endl;
+		if (Node_Multiplexer *prevMuxNode = dynamic_cast<Node_Multiplexer*>(input0.node)) {
+			if (prevMuxNode->getNumInputPorts() != 3) continue;
+			if (prevMuxNode == muxNode) continue; // sad thing
+			if (!subnet.contains(prevMuxNode)) continue; // todo: Optimize
 
-						Conjunction prevCondition;
-						prevCondition.parseInput({.node = prevMuxNode, .port = 0});
+			//std::cout << "Found 2 chained muxes" << std::endl;
 
-						bool conditionsMatch = false;
-						bool prevConditionNegated;
+			Conjunction prevCondition;
+			prevCondition.parseInput({.node = prevMuxNode, .port = 0});
 
-						if (prevCondition.isEqualTo(condition)) {
-							conditionsMatch = true;
-							prevConditionNegated = muxInput==1;
-						} else if (condition.isNegationOf(prevCondition)) {
-							conditionsMatch = true;
-							prevConditionNegated = muxInput==0;
-						} else {
-							/*
-							std::cout << "Condition 1 is :" << std::endl;
-							if (condition.m_undefined) std::cout << "   undefined" << std::endl;
-							if (condition.m_contradicting) std::cout << "   contradicting" << std::endl;
-							std::cout << "	";
-							for (auto p : condition.m_conditionsAndNegations) {
-								std::cout << " and ";
-								if (p.second)
-									std::cout << "not ";
-								std::cout << std::hex << p.first.node << ':' << p.first.port;
-							}
-							std::cout << std::endl;
-							std::cout << "Condition 2 is :" << std::endl;
-							if (prevCondition.m_undefined) std::cout << "   undefined" << std::endl;
-							if (prevCondition.m_contradicting) std::cout << "   contradicting" << std::endl;
-							std::cout << "	";
-							for (auto p : prevCondition.m_conditionsAndNegations) {
-								std::cout << " and ";
-								if (p.second)
-									std::cout << "not ";
-								std::cout << std::hex << p.first.node << ':' << p.first.port;
-							}
-							std::cout << std::endl;
-							*/
-						}
+			bool conditionsMatch = false;
+			bool prevConditionNegated;
 
-						if (conditionsMatch) {
-							if (prevMuxNode->getNonSignalDriver(prevConditionNegated?2:1) == muxNode->getNonSignalDriver(muxInput?2:1))
-								dbg::log(dbg::LogMessage(muxNode->getGroup()) << dbg::LogMessage::LOG_WARNING << dbg::LogMessage::LOG_POSTPROCESSING << "Not merging muxes " << prevMuxNode << " and " << muxNode << " because the former is driving itself.");
-							else {
-								//std::cout << "Conditions match!" << std::endl;
-								dbg::log(dbg::LogMessage(muxNode->getGroup()) << dbg::LogMessage::LOG_INFO << dbg::LogMessage::LOG_POSTPROCESSING << "Merging muxes " << prevMuxNode << " and " << muxNode << " because they form an if then else pair");
+			if (prevCondition.isEqualTo(condition)) {
+				conditionsMatch = true;
+				prevConditionNegated = muxInput==1;
+			} else if (condition.isNegationOf(prevCondition)) {
+				conditionsMatch = true;
+				prevConditionNegated = muxInput==0;
+			} else {
+				/*
+				std::cout << "Condition 1 is :" << std::endl;
+				if (condition.m_undefined) std::cout << "   undefined" << std::endl;
+				if (condition.m_contradicting) std::cout << "   contradicting" << std::endl;
+				std::cout << "	";
+				for (auto p : condition.m_conditionsAndNegations) {
+					std::cout << " and ";
+					if (p.second)
+						std::cout << "not ";
+					std::cout << std::hex << p.first.node << ':' << p.first.port;
+				}
+				std::cout << std::endl;
+				std::cout << "Condition 2 is :" << std::endl;
+				if (prevCondition.m_undefined) std::cout << "   undefined" << std::endl;
+				if (prevCondition.m_contradicting) std::cout << "   contradicting" << std::endl;
+				std::cout << "	";
+				for (auto p : prevCondition.m_conditionsAndNegations) {
+					std::cout << " and ";
+					if (p.second)
+						std::cout << "not ";
+					std::cout << std::hex << p.first.node << ':' << p.first.port;
+				}
+				std::cout << std::endl;
+				*/
+			}
 
-								auto bypass = prevMuxNode->getDriver(prevConditionNegated?2:1);
+			if (conditionsMatch) {
+				if (prevMuxNode->getNonSignalDriver(prevConditionNegated?2:1) == muxNode->getNonSignalDriver(muxInput?2:1))
+					dbg::log(dbg::LogMessage(muxNode->getGroup()) << dbg::LogMessage::LOG_WARNING << dbg::LogMessage::LOG_POSTPROCESSING << "Not merging muxes " << prevMuxNode << " and " << muxNode << " because the former is driving itself.");
+				else {
+					//std::cout << "Conditions match!" << std::endl;
+					dbg::log(dbg::LogMessage(muxNode->getGroup()) << dbg::LogMessage::LOG_INFO << dbg::LogMessage::LOG_POSTPROCESSING << "Merging muxes " << prevMuxNode << " and " << muxNode << " because they form an if then else pair");
 
-								// Connect second mux directly to bypass
-								muxNode->connectInput(muxInput, bypass);
+					auto bypass = prevMuxNode->getDriver(prevConditionNegated?2:1);
 
-								done = false;
-							}
-						}
-					}
+					// Connect second mux directly to bypass
+					muxNode->connectInput(muxInput, bypass);
+
+					merged = true;
 				}
 			}
 		}
-	} while (!done);
+	}
+	return merged;
 }
 
 
@@ -664,127 +717,156 @@ void Circuit::mergeRewires(Subnet &subnet)
 	do {
 		done = true;
 
-		for (size_t i = 0; i < m_nodes.size(); i++) {
-			if (Node_Rewire *rewireNode = dynamic_cast<Node_Rewire*>(m_nodes[i].get())) {
-
-				for (size_t inputIdx : utils::Range(rewireNode->getNumInputPorts())) {
+		for (size_t i = 0; i < m_nodes.size(); i++)
+			if (Node_Rewire *rewireNode = dynamic_cast<Node_Rewire*>(m_nodes[i].get()))
+				if (mergeRewireInputs(subnet, rewireNode))
+					done = false;
+	} while (!done);
+}
 
-					auto input = rewireNode->getNonSignalDriver(inputIdx);
+/**
+ * @brief Lets a rewire node directly fetch from the inputs of rewire nodes driving it, if those merely extract a single range.
+ * @return Whether any input was merged.
+ */
+bool Circuit::mergeRewireInputs(const Subnet &subnet, Node_Rewire *rewireNode)
+{
+	bool merged = false;
+	for (size_t inputIdx : utils::Range(rewireNode->getNumInputPorts())) {
 
-					if (input.node == nullptr)
-						continue;
+		auto input = rewireNode->getNonSignalDriver(inputIdx);
 
-					if (Node_Rewire *prevRewireNode = dynamic_cast<Node_Rewire*>(input.node)) {
-						if (prevRewireNode == rewireNode) continue; // sad thing
-						if (!subnet.contains(prevRewireNode)) continue; // todo: Optimize
+		if (input.node == nullptr)
+			continue;
 
-						if (prevRewireNode->getGroup() != rewireNode->getGroup()) continue;
+		if (Node_Rewire *prevRewireNode = dynamic_cast<Node_Rewire*>(input.node)) {
+			if (prevRewireNode == rewireNode) continue; // sad thing
+			if (!subnet.contains(prevRewireNode)) continue; // todo: Optimize
 
-						if (prevRewireNode->getOp().ranges.size() == 1) { // keep it simple for now
+			if (prevRewireNode->getGroup() != rewireNode->getGroup()) continue;
 
-							if (prevRewireNode->getOp().ranges[0].source == Node_Rewire::OutputRange::INPUT) {
-								auto prevInputIdx = prevRewireNode->getOp().ranges[0].inputIdx;
-								auto prevInputOffset = prevRewireNode->getOp().ranges[0].inputOffset;
+			if (prevRewireNode->getOp().ranges.size() == 1) { // keep it simple for now
 
-								if (prevRewireNode->getNonSignalDriver(prevInputIdx) == rewireNode->getNonSignalDriver(inputIdx))
-									dbg::log(dbg::LogMessage(rewireNode->getGroup()) << dbg::LogMessage::LOG_WARNING << dbg::LogMessage::LOG_POSTPROCESSING << "Not merging rewires " << prevRewireNode << " and " << rewireNode << " because the former is driving itself.");
-								else {
-									dbg::log(dbg::LogMessage(rewireNode->getGroup()) << dbg::LogMessage::LOG_INFO << dbg::LogMessage::LOG_POSTPROCESSING << "Merging rewires " << prevRewireNode << " and " << rewireNode << " by directly fetching from input " << prevInputIdx << " at bit offset " << prevInputOffset);
+				if (prevRewireNode->getOp().ranges[0].source == Node_Rewire::OutputRange::INPUT) {
+					auto prevInputIdx = prevRewireNode->getOp().ranges[0].inputIdx;
+					auto prevInputOffset = prevRewireNode->getOp().ranges[0].inputOffset;
 
-									auto op = rewireNode->getOp();
-									for (auto &r : op.ranges) {
-										if (r.source == Node_Rewire::OutputRange::INPUT && r.inputIdx == inputIdx)
-											r.inputOffset += prevInputOffset;
-									}
-									rewireNode->setOp(std::move(op));
+					if (prevRewireNode->getNonSignalDriver(prevInputIdx) == rewireNode->getNonSignalDriver(inputIdx))
+						dbg::log(dbg::LogMessage(rewireNode->getGroup()) << dbg::LogMessage::LOG_WARNING << dbg::LogMessage::LOG_POSTPROCESSING << "Not merging rewires " << prevRewireNode << " and " << rewireNode << " because the former is driving itself.");
+					else {
+						dbg::log(dbg::LogMessage(rewireNode->getGroup()) << dbg::LogMessage::LOG_INFO << dbg::LogMessage::LOG_POSTPROCESSING << "Merging rewires " << prevRewireNode << " and " << rewireNode << " by directly fetching from input " << prevInputIdx << " at bit offset " << prevInputOffset);
 
-									rewireNode->connectInput(inputIdx, prevRewireNode->getDriver(prevInputIdx));
-									done = false;
-								}
-							}
+						auto op = rewireNode->getOp();
+						for (auto &r : op.ranges) {
+							if (r.source == Node_Rewire::OutputRange::INPUT && r.inputIdx == inputIdx)
+								r.inputOffset += prevInputOffset;
 						}
+						rewireNode->setOp(std::move(op));
+
+						rewireNode->connectInput(inputIdx, prevRewireNode->getDriver(prevInputIdx));
+						merged = true;
 					}
 				}
-				
 			}
 		}
-	} while (!done);
+	}
+	return merged;
 }
 
-void Circuit::removeIrrelevantMuxes(Subnet &subnet)
+/**
+ * @brief Checks if everything that is driven by the output of a 2-input mux is muxed again by the same condition, such that only one of the mux inputs is relevant.
+ * @param muxNode The mux in question.
+ * @param condition The condition of the mux.
+ * @param muxInputPort The mux input that would be the only relevant one.
+ * @param muxOutput An input driven by the mux from where to check.
+ */
+static bool onlyMuxInputRelevant(Node_Multiplexer *muxNode, const Conjunction &condition, size_t muxInputPort, NodePort muxOutput)
 {
-	bool done;
-	do {
-		done = true;
+	std::vector<NodePort> openList = { muxOutput };
+	utils::UnstableSet<NodePort> closedList;
 
-		for (auto n : subnet) {
-			if (Node_Multiplexer *muxNode = dynamic_cast<Node_Multiplexer*>(n)) {
-				if (muxNode->getNumInputPorts() != 3) continue;
+	while (!openList.empty()) {
+		NodePort input = openList.back();
+		openList.pop_back();
+		if (closedList.contains(input)) continue;
+		closedList.insert(input);
 
-				//std::cout << "Found 2-input mux" << std::endl;
+		if (input.node->hasSideEffects() || input.node->hasRef() || !input.node->isCombinatorial(input.port)) {
+			//std::cout << "Internal node with sideeffects, skipping" << std::endl;
+			return false;
+		}
 
-				Conjunction condition;
-				condition.parseInput({.node = muxNode, .port = 0});
+		if (input.node->getGroup() != muxNode->getGroup()) {
+			//std::cout << "Internal node driving external, skipping" << std::endl;
+			return false;
+		}
 
-				for (size_t muxInputPort : utils::Range(1,3)) {
+		if (Node_Multiplexer *subnetOutputMuxNode = dynamic_cast<Node_Multiplexer*>(input.node)) {
+			if (subnetOutputMuxNode->getNumInputPorts() == 3) {
+				Conjunction subnetOutputMuxNodeCondition;
+				subnetOutputMuxNodeCondition.parseInput({.node = subnetOutputMuxNode, .port = 0});
 
-					auto directlyDriven = muxNode->getDirectlyDriven(0);
-					for (auto muxOutput : directlyDriven) {
-						std::vector<NodePort> openList = { muxOutput };
-						utils::UnstableSet<NodePort> closedList;
+				if (input.port == muxInputPort && condition.isEqualTo(subnetOutputMuxNodeCondition))
+					continue;
+				if (input.port != muxInputPort && condition.isNegationOf(subnetOutputMuxNodeCondition))
+					continue;
+			}
+		}
 
-						bool allSubnetOutputsMuxed = true;
+		for (auto j : utils::Range(input.node->getNumOutputPorts()))
+			for (auto driven : input.node->getDirectlyDriven(j))
+				openList.push_back(driven);
+	}
+	return true;
+}
 
-						while (!openList.empty()) {
-							NodePort input = openList.back();
-							openList.pop_back();
-							if (closedList.contains(input)) continue;
-							closedList.insert(input);
+void Circuit::removeIrrelevantMuxes(Subnet &subnet, LocalRewriter *rewriter)
+{
+	struct Bypass {
+		Node_Multiplexer *muxNode;
+		size_t muxInputPort;
+		NodePort muxOutput;
+	};
 
-							if (input.node->hasSideEffects() || input.node->hasRef() || !input.node->isCombinatorial(input.port)) {
-								allSubnetOutputsMuxed = false;
-								//std::cout << "Internal node with sideeffects, skipping" << std::endl;
-								break;
-							}
+	bool done;
+	do {
+		done = true;
 
-							if (input.node->getGroup() != muxNode->getGroup()) {
-								allSubnetOutputsMuxed = false;
-								//std::cout << "Internal node driving external, skipping" << std::endl;
-								break;
-							}
+		// Search all node groups concurrently for muxes that can be bypassed
+		auto bypasses = analyzeByNodeGroup<Bypass>(subnet, [](BaseNode *n, std::vector<Bypass> &bypasses) {
+			if (Node_Multiplexer *muxNode = dynamic_cast<Node_Multiplexer*>(n)) {
+				if (muxNode->getNumInputPorts() != 3) return;
 
-							if (Node_Multiplexer *subnetOutputMuxNode = dynamic_cast<Node_Multiplexer*>(input.node)) {
-								if (subnetOutputMuxNode->getNumInputPorts() == 3) {
-									Conjunction subnetOutputMuxNodeCondition;
-									subnetOutputMuxNodeCondition.parseInput({.node = subnetOutputMuxNode, .port = 0});
+				//std::cout << "Found 2-input mux" << std::endl;
 
-									if (input.port == muxInputPort && condition.isEqualTo(subnetOutputMuxNodeCondition))
-										continue;
-									if (input.port != muxInputPort && condition.isNegationOf(subnetOutputMuxNodeCondition))
-										continue;
-								}
-							}
+				Conjunction condition;
+				condition.parseInput({.node = muxNode, .port = 0});
 
-							for (auto j : utils::Range(input.node->getNumOutputPorts()))
-								for (auto driven : input.node->getDirectlyDriven(j))
-									openList.push_back(driven);
+				for (size_t muxInputPort : utils::Range(1,3))
+					for (auto muxOutput : muxNode->getDirectlyDriven(0))
+						if (onlyMuxInputRelevant(muxNode, condition, muxInputPort, muxOutput))
+							bypasses.push_back({ .muxNode = muxNode, .muxInputPort = muxInputPort, .muxOutput = muxOutput });
+			}
+		});
 
-						}
+		// Rewire in subnet order, rechecking each candidate since previous rewires may have changed its surroundings
+		for (const auto &bypass : bypasses) {
+			auto *muxNode = bypass.muxNode;
+			auto muxOutput = bypass.muxOutput;
+			if (muxOutput.node->getDriver(muxOutput.port) != NodePort{.node = muxNode, .port = 0}) continue;
 
-						if (allSubnetOutputsMuxed) {
-							if (muxNode->getNonSignalDriver(muxInputPort) == muxOutput.node->getNonSignalDriver(muxOutput.port))
-								dbg::log(dbg::LogMessage(muxNode->getGroup()) << dbg::LogMessage::LOG_WARNING << dbg::LogMessage::LOG_POSTPROCESSING << "Not removing mux " << muxNode << " because it is driving itself");
-							else {
-								dbg::log(dbg::LogMessage(muxNode->getGroup()) << dbg::LogMessage::LOG_INFO << dbg::LogMessage::LOG_POSTPROCESSING << "Removing mux " << muxNode << " because only input " << muxInputPort << " is relevant further on");
-								//std::cout << "Rewiring past mux" << std::endl;
-								muxOutput.node->connectInput(muxOutput.port, muxNode->getDriver(muxInputPort));
-								done = false;
-							}
-						} else {
-							//std::cout << "Not rewiring past mux" << std::endl;
-						}
-					}
-				}
+			Conjunction condition;
+			condition.parseInput({.node = muxNode, .port = 0});
+			if (!onlyMuxInputRelevant(muxNode, condition, bypass.muxInputPort, muxOutput)) continue;
+
+			if (muxNode->getNonSignalDriver(bypass.muxInputPort) == muxOutput.node->getNonSignalDriver(muxOutput.port))
+				dbg::log(dbg::LogMessage(muxNode->getGroup()) << dbg::LogMessage::LOG_WARNING << dbg::LogMessage::LOG_POSTPROCESSING << "Not removing mux " << muxNode << " because it is driving itself");
+			else {
+				dbg::log(dbg::LogMessage(muxNode->getGroup()) << dbg::LogMessage::LOG_INFO << dbg::LogMessage::LOG_POSTPROCESSING << "Removing mux " << muxNode << " because only input " << bypass.muxInputPort << " is relevant further on");
+				//std::cout << "Rewiring past mux" << std::endl;
+				muxOutput.node->connectInput(muxOutput.port, muxNode->getDriver(bypass.muxInputPort));
+				if (rewriter)
+					rewriter->enqueueRewired(muxOutput.node);
+				done = false;
 			}
 		}
 	} while (!done);
@@ -827,7 +909,7 @@ std::optional<std::pair<Node_Multiplexer*, Node_Constant*>> followedByCompatible
  * Yet quite often, the frontend constructs large chains of binary multiplexers, each being selected by a comparison between
  * an index and a constant. This code detects these chains and turns them back into a single multiplexer.
  */
-void Circuit::mergeBinaryMuxChain(Subnet& subnet)
+void Circuit::mergeBinaryMuxChain(Subnet& subnet, LocalRewriter *rewriter)
 {
 	std::vector<BaseNode*> newNodes;
 
@@ -916,8 +998,11 @@ void Circuit::mergeBinaryMuxChain(Subnet& subnet)
 					newMux->connectInput(i, inputs[i]);
 
 				auto allToRewire = chain.back().first->getDirectlyDriven(0);
-				for (auto np : allToRewire)
+				for (auto np : allToRewire) {
 					np.node->rewireInput(np.port, {.node = newMux, .port = 0ull} );
+					if (rewriter)
+						rewriter->enqueueRewired(np.node);
+				}
 
 				dbg::log(dbg::LogMessage(newMux->getGroup()) << dbg::LogMessage::LOG_INFO << dbg::LogMessage::LOG_POSTPROCESSING 
 						<< "Replacing chain of mux nodes starting at node " << chain.front().first 
@@ -928,11 +1013,14 @@ void Circuit::mergeBinaryMuxChain(Subnet& subnet)
 		}
 	}
 
-	for (auto n : newNodes)
+	for (auto n : newNodes) {
 		subnet.add(n);
+		if (rewriter)
+			rewriter->enqueue(n);
+	}
 }
 
-void Circuit::removeIrrelevantComparisons(Subnet &subnet)
+void Circuit::removeIrrelevantComparisons(Subnet &subnet, LocalRewriter *rewriter)
 {
 	for (auto n : subnet) {
 		if (auto *compNode = dynamic_cast<Node_Compare*>(n)) {
@@ -956,7 +1044,11 @@ void Circuit::removeIrrelevantComparisons(Subnet &subnet)
 					dbg::log(dbg::LogMessage(compNode->getGroup()) << dbg::LogMessage::LOG_INFO << dbg::LogMessage::LOG_POSTPROCESSING << "Compare node " << compNode 
 									<< " is comparing to an undefined signal coming from " << constInputs[i] << ". Hardwireing output to undefined source " << compNode->getDriver(i).node);
 					// replace with undefined
+					auto driven = compNode->getDirectlyDriven(0);
 					compNode->bypassOutputToInput(0, i);
+					if (rewriter)
+						for (auto &d : driven)
+							rewriter->enqueueRewired(d.node);
 					break;
 				}
 				bool invert = constInputs[i]->getValue().get(sim::DefaultConfig::VALUE, 0) ^ (compNode->getOp() == Node_Compare::EQ);
@@ -972,17 +1064,26 @@ void Circuit::removeIrrelevantComparisons(Subnet &subnet)
 					notNode->recordStackTrace();
 					notNode->connectInput(0, compNode->getDriver(i^1));
 					subnet.add(notNode);
+					if (rewriter)
+						rewriter->enqueue(notNode);
 
 					auto driven = compNode->getDirectlyDriven(0);
-					for (auto &d : driven)
+					for (auto &d : driven) {
 						d.node->rewireInput(d.port, {.node=notNode, .port=0ull});
+						if (rewriter)
+							rewriter->enqueueRewired(d.node);
+					}
 
 					break;
 				} else {
 					dbg::log(dbg::LogMessage(compNode->getGroup()) << dbg::LogMessage::LOG_INFO << dbg::LogMessage::LOG_POSTPROCESSING << "Compare node " << compNode 
 							<< " is comparing to a constant and actually an identity function. Removing by directly attaching outputs to " << compNode->getDriver(i^1).node);
 					// bypass
+					auto driven = compNode->getDirectlyDriven(0);
 					compNode->bypassOutputToInput(0, i^1);
+					if (rewriter)
+						for (auto &d : driven)
+							rewriter->enqueueRewired(d.node);
 					break;
 				}
 			}
@@ -991,7 +1092,7 @@ void Circuit::removeIrrelevantComparisons(Subnet &subnet)
 }
 
 
-void Circuit::cullMuxConditionNegations(Subnet &subnet)
+void Circuit::cullMuxConditionNegations(Subnet &subnet, LocalRewriter *rewriter)
 {
 	for (auto n : subnet) {
 		if (Node_Multiplexer *muxNode = dynamic_cast<Node_Multiplexer*>(n)) {
@@ -1014,6 +1115,8 @@ void Circuit::cullMuxConditionNegations(Subnet &subnet)
 
 							muxNode->connectInput(0, input1);
 							muxNode->connectInput(1, input0);
+							if (rewriter)
+								rewriter->enqueueRewired(muxNode);
 
 							dbg::log(dbg::LogMessage(muxNode->getGroup()) << dbg::LogMessage::LOG_INFO << dbg::LogMessage::LOG_POSTPROCESSING << "Removing/bypassing negation " << logicNode << " to mux " << muxNode << " selector by swapping mux inputs.");
 
@@ -1052,7 +1155,7 @@ void Circuit::removeNoOps(Subnet &subnet)
 }
 
 
-void Circuit::foldRegisterMuxEnableLoops(Subnet &subnet)
+void Circuit::foldRegisterMuxEnableLoops(Subnet &subnet, LocalRewriter *rewriter)
 {
 	std::vector<BaseNode*> newNodes;
 	for (auto n : subnet) {
@@ -1086,6 +1189,8 @@ void Circuit::foldRegisterMuxEnableLoops(Subnet &subnet)
 							dbg::log(dbg::LogMessage(regNode->getGroup()) << dbg::LogMessage::LOG_INFO << dbg::LogMessage::LOG_POSTPROCESSING << "Replacing mux loop through " << muxNode << " on register " << regNode << " by binding the condition to register enable");
 						}
 						regNode->connectInput(Node_Register::Input::DATA, muxNode->getDriver(2));
+						if (rewriter)
+							rewriter->enqueueRewired(regNode);
 					} else if (muxInput2.node == regNode) {
 						auto *notNode = createNode<Node_Logic>(Node_Logic::NOT);
 						newNodes.push_back(notNode);
@@ -1110,40 +1215,54 @@ void Circuit::foldRegisterMuxEnableLoops(Subnet &subnet)
 							dbg::log(dbg::LogMessage(regNode->getGroup()) << dbg::LogMessage::LOG_INFO << dbg::LogMessage::LOG_POSTPROCESSING << "Replacing mux loop through " << muxNode << " on register " << regNode << " by binding the condition to register enable");
 						}
 						regNode->connectInput(Node_Register::Input::DATA, muxNode->getDriver(1));
+						if (rewriter)
+							rewriter->enqueueRewired(regNode);
 					}
 				}
 			}
 		}
 	}
 
-	for (auto n : newNodes)
+	for (auto n : newNodes) {
 		subnet.add(n);
+		if (rewriter)
+			rewriter->enqueue(n);
+	}
 }
 
 void Circuit::removeConstSelectMuxes(Subnet &subnet)
 {
-	for (auto n : subnet) {
-		if (auto *muxNode = dynamic_cast<Node_Multiplexer*>(n)) {
-			auto sel = muxNode->getNonSignalDriver(0);
-			if (auto *constNode = dynamic_cast<Node_Constant*>(sel.node)) {
-				if (constNode->getValue().size() == 0)
-				{
-					dbg::log(dbg::LogMessage(muxNode->getGroup()) << dbg::LogMessage::LOG_INFO << dbg::LogMessage::LOG_POSTPROCESSING << "Removing mux " << muxNode << " because its selector is constant, empty, and defaults to zero.");
-					muxNode->bypassOutputToInput(0, 1);
-				}
-				else
-				{
-					HCL_ASSERT(constNode->getValue().size() < 64);
-					std::uint64_t selDefined = constNode->getValue().extractNonStraddling(sim::DefaultConfig::DEFINED, 0, constNode->getValue().size());
-					std::uint64_t selValue = constNode->getValue().extractNonStraddling(sim::DefaultConfig::VALUE, 0, constNode->getValue().size());
-					if ((selDefined ^ (~0ull >> (64 - constNode->getValue().size()))) == 0) {
-						dbg::log(dbg::LogMessage(muxNode->getGroup()) << dbg::LogMessage::LOG_INFO << dbg::LogMessage::LOG_POSTPROCESSING << "Removing mux " << muxNode << " because its selector is constant and defined.");
-						muxNode->bypassOutputToInput(0, 1+selValue);
-					}
-				}
-			}
-		}
+	for (auto n : subnet)
+		if (auto *muxNode = dynamic_cast<Node_Multiplexer*>(n))
+			bypassConstSelectMux(muxNode);
+}
+
+/**
+ * @brief Bypasses a mux whose selector is driven by a fully defined (or empty) constant.
+ * @return Whether the mux was bypassed.
+ */
+bool Circuit::bypassConstSelectMux(Node_Multiplexer *muxNode)
+{
+	auto sel = muxNode->getNonSignalDriver(0);
+	auto *constNode = dynamic_cast<Node_Constant*>(sel.node);
+	if (constNode == nullptr) return false;
+
+	if (constNode->getValue().size() == 0)
+	{
+		dbg::log(dbg::LogMessage(muxNode->getGroup()) << dbg::LogMessage::LOG_INFO << dbg::LogMessage::LOG_POSTPROCESSING << "Removing mux " << muxNode << " because its selector is constant, empty, and defaults to zero.");
+		muxNode->bypassOutputToInput(0, 1);
+		return true;
 	}
+
+	HCL_ASSERT(constNode->getValue().size() < 64);
+	std::uint64_t selDefined = constNode->getValue().extractNonStraddling(sim::DefaultConfig::DEFINED, 0, constNode->getValue().size());
+	std::uint64_t selValue = constNode->getValue().extractNonStraddling(sim::DefaultConfig::VALUE, 0, constNode->getValue().size());
+	if ((selDefined ^ (~0ull >> (64 - constNode->getValue().size()))) == 0) {
+		dbg::log(dbg::LogMessage(muxNode->getGroup()) << dbg::LogMessage::LOG_INFO << dbg::LogMessage::LOG_POSTPROCESSING << "Removing mux " << muxNode << " because its selector is constant and defined.");
+		muxNode->bypassOutputToInput(0, 1+selValue);
+		return true;
+	}
+	return false;
 }
 
 void Circuit::propagateConstants(Subnet &subnet)
@@ -1172,7 +1291,6 @@ void Circuit::propagateConstants(Subnet &subnet)
 
 
 	//std::cout << "propagateConstants()" << std::endl;
-	sim::SimulatorCallbacks ignoreCallbacks;
 
 	std::vector<NodePort> openList;
 	// std::set<NodePort> closedList;
@@ -1231,111 +1349,135 @@ void Circuit::propagateConstants(Subnet &subnet)
 			}
 
 			// Remove registers without reset or whose reset is compatible with the constant input
-			if (auto *regNode = dynamic_cast<Node_Register*>(successor.node)) {
-				bool bypassRegister = false;
-
-				auto dataDriver = regNode->getNonSignalDriver((unsigned)Node_Register::Input::DATA);
-				auto resetDriver = regNode->getNonSignalDriver((unsigned)Node_Register::Input::RESET_VALUE);
-				auto *constNode = dynamic_cast<Node_Constant*>(dataDriver.node);
-
-				// Only bypass if input driven by constant node
-				if (constNode != nullptr) {
-					if (resetDriver.node == nullptr)
-						bypassRegister = true;
-					else if (dataDriver.node != nullptr) {
-						// evaluate reset value. Note that it is ok to only evaluate the reset value (it need not be constant) because the register only evaluates it during the reset.
-						sim::ReferenceSimulator simulator(false);
-						simulator.compileProgram(*this, {resetDriver}, { .ignoreSimulationProcesses = true });
-						simulator.powerOn();
-
-						auto resetValue = simulator.getValueOfOutput(resetDriver);
-						if (sim::canBeReplacedWith(resetValue, constNode->getValue())) 
-							bypassRegister = true;
-					}
-				}
-
-				if (bypassRegister) {
-					regNode->bypassOutputToInput(0, (unsigned)Node_Register::Input::DATA);
+			if (auto *regNode = dynamic_cast<Node_Register*>(successor.node))
+				if (bypassConstantRegister(regNode))
 					continue;
-				} 
-			}
 
-			// Nodes with side-effects can't be removed/bypassed
-			if (successor.node->hasSideEffects()) continue;
-			// Nodes with references can't be removed/bypassed
-			if (successor.node->hasRef()) continue;
+			// Attempt to compute the outputs of this node and add the new const-node outputs to the openList to continue const-propagation from there.
+			foldConstantOutputs(subnet, successor.node, openList);
+		}
+	}
+}
 
-			if (!successor.node->getInternalStateSizes().empty()) continue; // can't be good for const propagation
+/**
+ * @brief Bypasses a register whose data input is driven by a constant if it has no reset or its reset value is compatible with the constant.
+ * @return Whether the register was bypassed.
+ */
+bool Circuit::bypassConstantRegister(Node_Register *regNode)
+{
+	bool bypassRegister = false;
+
+	auto dataDriver = regNode->getNonSignalDriver((unsigned)Node_Register::Input::DATA);
+	auto resetDriver = regNode->getNonSignalDriver((unsigned)Node_Register::Input::RESET_VALUE);
+	auto *constNode = dynamic_cast<Node_Constant*>(dataDriver.node);
+
+	// Only bypass if input driven by constant node
+	if (constNode != nullptr) {
+		if (resetDriver.node == nullptr)
+			bypassRegister = true;
+		else if (dataDriver.node != nullptr) {
+			// evaluate reset value. Note that it is ok to only evaluate the reset value (it need not be constant) because the register only evaluates it during the reset.
+			sim::ReferenceSimulator simulator(false);
+			simulator.compileProgram(*this, {resetDriver}, { .ignoreSimulationProcesses = true });
+			simulator.powerOn();
+
+			auto resetValue = simulator.getValueOfOutput(resetDriver);
+			if (sim::canBeReplacedWith(resetValue, constNode->getValue())) 
+				bypassRegister = true;
+		}
+	}
 
-			// Attempt to compute the output of this node.
-			// Build a state vector with all inputs. Set all non-const inputs to undefined.
-			sim::DefaultBitVectorState state;
-			std::vector<size_t> inputOffsets(successor.node->getNumInputPorts(), ~0ull);
-			for (size_t port : utils::Range(successor.node->getNumInputPorts())) {
-				auto driver = successor.node->getNonSignalDriver(port);
-				if (driver.node != nullptr) {
-					auto conType = hlim::getOutputConnectionType(driver);
-					size_t offset = state.size();
-					state.resize(offset + (conType.width + 63)/64 * 64);
-					inputOffsets[port] = offset;
-					if (Node_Constant *constNode = dynamic_cast<Node_Constant*>(driver.node)) {
-						size_t arr[] = {offset};
-						constNode->simulatePowerOn(ignoreCallbacks, state, nullptr, arr); // import const data
-					} else {
-						state.clearRange(sim::DefaultConfig::DEFINED, offset, conType.width);   // set non-const data to undefined
-					}
-				}
-			}
+	if (bypassRegister)
+		regNode->bypassOutputToInput(0, (unsigned)Node_Register::Input::DATA);
+
+	return bypassRegister;
+}
 
-			// Allocate Outputs
-			std::vector<size_t> outputOffsets(successor.node->getNumOutputPorts(), ~0ull);
-			for (size_t port : utils::Range(successor.node->getNumOutputPorts())) {
-				auto conType = successor.node->getOutputConnectionType(port);
-				size_t offset = state.size();
-				state.resize(offset + (conType.width + 63)/64 * 64);
-				outputOffsets[port] = offset;
+/**
+ * @brief Computes the outputs of a node from the constants driving its inputs and replaces all fully defined, combinatorial outputs by constants.
+ * @details If the node ends up without any other nodes connected to it, it will be culled by other optimization steps.
+ * @param newConstantOutputs The outputs of the created constant nodes are appended here.
+ * @return Whether any output was replaced.
+ */
+bool Circuit::foldConstantOutputs(Subnet &subnet, BaseNode *node, std::vector<NodePort> &newConstantOutputs)
+{
+	sim::SimulatorCallbacks ignoreCallbacks;
+
+	// Nodes with side-effects can't be removed/bypassed
+	if (node->hasSideEffects()) return false;
+	// Nodes with references can't be removed/bypassed
+	if (node->hasRef()) return false;
+
+	if (!node->getInternalStateSizes().empty()) return false; // can't be good for const propagation
+
+	// Attempt to compute the output of this node.
+	// Build a state vector with all inputs. Set all non-const inputs to undefined.
+	sim::DefaultBitVectorState state;
+	std::vector<size_t> inputOffsets(node->getNumInputPorts(), ~0ull);
+	for (size_t port : utils::Range(node->getNumInputPorts())) {
+		auto driver = node->getNonSignalDriver(port);
+		if (driver.node != nullptr) {
+			auto conType = hlim::getOutputConnectionType(driver);
+			size_t offset = state.size();
+			state.resize(offset + (conType.width + 63)/64 * 64);
+			inputOffsets[port] = offset;
+			if (Node_Constant *constNode = dynamic_cast<Node_Constant*>(driver.node)) {
+				size_t arr[] = {offset};
+				constNode->simulatePowerOn(ignoreCallbacks, state, nullptr, arr); // import const data
+			} else {
+				state.clearRange(sim::DefaultConfig::DEFINED, offset, conType.width);   // set non-const data to undefined
 			}
+		}
+	}
 
-			// Simulate node
-			successor.node->simulateEvaluate(ignoreCallbacks, state, nullptr, inputOffsets.data(), outputOffsets.data()); // compute outputs
+	// Allocate Outputs
+	std::vector<size_t> outputOffsets(node->getNumOutputPorts(), ~0ull);
+	for (size_t port : utils::Range(node->getNumOutputPorts())) {
+		auto conType = node->getOutputConnectionType(port);
+		size_t offset = state.size();
+		state.resize(offset + (conType.width + 63)/64 * 64);
+		outputOffsets[port] = offset;
+	}
 
-			// Check all outputs. If any are fully defined, all nodes connected to that output can instead be connected to a const-node with the result.
-			// If this nodes ends up without any other nodes connected to it, it will be culled by other optimization steps.
-			for (size_t port : utils::Range(successor.node->getNumOutputPorts())) {
+	// Simulate node
+	node->simulateEvaluate(ignoreCallbacks, state, nullptr, inputOffsets.data(), outputOffsets.data()); // compute outputs
 
-				// Only consider on combinatory outputs
-				if (!successor.node->isCombinatorial(port)) continue;
+	// Check all outputs. If any are fully defined, all nodes connected to that output can instead be connected to a const-node with the result.
+	bool folded = false;
+	for (size_t port : utils::Range(node->getNumOutputPorts())) {
 
-				auto conType = successor.node->getOutputConnectionType(port);
+		// Only consider on combinatory outputs
+		if (!node->isCombinatorial(port)) continue;
 
-				bool allDefined = true;
-				for (auto i : utils::Range(conType.width))
-					if (!state.get(sim::DefaultConfig::DEFINED, outputOffsets[port]+i)) {
-						allDefined = false;
-						break;
-					}
+		auto conType = node->getOutputConnectionType(port);
 
-				if (allDefined) {
-					//std::cout << "	Found all const output" << std::endl;
+		bool allDefined = true;
+		for (auto i : utils::Range(conType.width))
+			if (!state.get(sim::DefaultConfig::DEFINED, outputOffsets[port]+i)) {
+				allDefined = false;
+				break;
+			}
 
-					auto* constant = createNode<Node_Constant>(state.extract(outputOffsets[port], conType.width), conType.type);
-					constant->moveToGroup(successor.node->getGroup());
-					subnet.add(constant);
-					NodePort newConstOutputPort{.node = constant, .port = 0};
+		if (allDefined) {
+			//std::cout << "	Found all const output" << std::endl;
 
-					dbg::log(dbg::LogMessage(successor.node->getGroup()) << dbg::LogMessage::LOG_INFO << dbg::LogMessage::LOG_POSTPROCESSING << "Replacing " << successor.node << " port " << port << " with folded constant " << constant);
+			auto* constant = createNode<Node_Constant>(state.extract(outputOffsets[port], conType.width), conType.type);
+			constant->moveToGroup(node->getGroup());
+			subnet.add(constant);
+			NodePort newConstOutputPort{.node = constant, .port = 0};
 
-					while (!successor.node->getDirectlyDriven(port).empty()) {
-						NodePort input = successor.node->getDirectlyDriven(port).back();
-						input.node->connectInput(input.port, newConstOutputPort);
-					}
+			dbg::log(dbg::LogMessage(node->getGroup()) << dbg::LogMessage::LOG_INFO << dbg::LogMessage::LOG_POSTPROCESSING << "Replacing " << node << " port " << port << " with folded constant " << constant);
 
-					// Add the new const-node output to the openList to continue const-propagation from here.
-					openList.push_back(newConstOutputPort);
-				}
+			while (!node->getDirectlyDriven(port).empty()) {
+				NodePort input = node->getDirectlyDriven(port).back();
+				input.node->connectInput(input.port, newConstOutputPort);
 			}
+
+			newConstantOutputs.push_back(newConstOutputPort);
+			folded = true;
 		}
 	}
+	return folded;
 }
 
 void Circuit::removeFalseLoops()
@@ -1628,19 +1770,21 @@ void Circuit::optimizeSubnet(Subnet &subnet)
 	//defaultValueResolution(*this, subnet);
 	//cullUnusedNodes(subnet); // Dirty way of getting rid of default nodes
 	
-	propagateConstants(subnet);
-	mergeRewires(subnet);
-	optimizeRewireNodes(subnet);
-	cullMuxConditionNegations(subnet);
+	// Constant folding, rewire and mux merging, and no-op removal are applied locally until nothing changes anymore.
+	LocalRewriter rewriter(*this, subnet);
+	rewriter.addDefaultRules();
+	rewriter.enqueueAll();
+	rewriter.run();
+
+	// The remaining passes put whatever they change back onto the worklist of the rewriter.
+	optimizeRewireNodes(subnet, &rewriter);
+	cullMuxConditionNegations(subnet, &rewriter);
 	//breakMutuallyExclusiveMuxChains(subnet);
-	mergeMuxes(subnet);
-	removeIrrelevantComparisons(subnet);
-	removeIrrelevantMuxes(subnet);
-	mergeBinaryMuxChain(subnet);
-	removeNoOps(subnet);
-	foldRegisterMuxEnableLoops(subnet);
-	removeConstSelectMuxes(subnet);
-	propagateConstants(subnet); // do again after muxes are removed
+	removeIrrelevantComparisons(subnet, &rewriter);
+	removeIrrelevantMuxes(subnet, &rewriter);
+	mergeBinaryMuxChain(subnet, &rewriter);
+	foldRegisterMuxEnableLoops(subnet, &rewriter);
+	rewriter.run(); // do again after muxes are removed
 	cullUnusedNodes(subnet);
 }
 
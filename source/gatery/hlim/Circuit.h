@@ -24,6 +24,7 @@
 
 #include "../utils/CppTools.h"
 
+#include <algorithm>
 #include <vector>
 #include <memory>
 #include <map>
@@ -31,6 +32,7 @@
 
 namespace gtry::sim {
 	struct SimulationVisualization;
+	class WorkerPool;
 
 	template<typename ReturnValue>
 	class SimulationFunction;
@@ -50,6 +52,10 @@ namespace gtry::hlim {
 
 	class Node_Signal;
 	class Node_Attributes;
+	class Node_Register;
+	class Node_Rewire;
+	class Node_Multiplexer;
+	class LocalRewriter;
 
 	/*
 	class Circuit;
@@ -153,22 +159,28 @@ namespace gtry::hlim {
 		void insertConstUndefinedNodes();
 		void disconnectZeroBitConnections();
 		void disconnectZeroBitOutputPins();
-		void optimizeRewireNodes(Subnet& subnet);
+		void optimizeRewireNodes(Subnet& subnet, LocalRewriter* rewriter = nullptr);
 		void cullSequentiallyDuplicatedSignalNodes();
 		void cullUnnamedSignalNodes();
 		void cullOrphanedSignalNodes();
 		void cullUnusedNodes(Subnet& subnet);
 		void mergeMuxes(Subnet& subnet);
 		void breakMutuallyExclusiveMuxChains(Subnet& subnet);
-		void cullMuxConditionNegations(Subnet& subnet);
-		void removeIrrelevantMuxes(Subnet& subnet);
-		void mergeBinaryMuxChain(Subnet& subnet);
-		void removeIrrelevantComparisons(Subnet& subnet);
+		void cullMuxConditionNegations(Subnet& subnet, LocalRewriter* rewriter = nullptr);
+		void removeIrrelevantMuxes(Subnet& subnet, LocalRewriter* rewriter = nullptr);
+		void mergeBinaryMuxChain(Subnet& subnet, LocalRewriter* rewriter = nullptr);
+		void removeIrrelevantComparisons(Subnet& subnet, LocalRewriter* rewriter = nullptr);
 		void mergeRewires(Subnet& subnet);
 		void removeNoOps(Subnet& subnet);
-		void foldRegisterMuxEnableLoops(Subnet& subnet);
+		void foldRegisterMuxEnableLoops(Subnet& subnet, LocalRewriter* rewriter = nullptr);
 		void propagateConstants(Subnet& subnet);
 		void removeConstSelectMuxes(Subnet& subnet);
+
+		bool mergeRewireInputs(const Subnet& subnet, Node_Rewire* rewireNode);
+		bool mergeMuxInputs(const Subnet& subnet, Node_Multiplexer* muxNode);
+		bool bypassConstSelectMux(Node_Multiplexer* muxNode);
+		bool bypassConstantRegister(Node_Register* regNode);
+		bool foldConstantOutputs(Subnet& subnet, BaseNode* node, std::vector<NodePort>& newConstantOutputs);
 		void moveClockDriversToTop();
 		void ensureNoLiteralComparison();
 		void ensureChildNotReadingTristatePin();
@@ -185,6 +197,11 @@ namespace gtry::hlim {
 		void optimizeSubnet(Subnet& subnet);
 		void postprocess(const PostProcessor& postProcessor);
 
+		/// @brief Sets the number of threads with which postprocessing passes analyze node groups concurrently.
+		/// @details Zero (the default) uses as many threads as the hardware supports. The results of the postprocessing do not depend on the number of threads.
+		void setNumPostprocessingThreads(size_t numThreads) { m_numPostprocessingThreads = numThreads; }
+		inline size_t getNumPostprocessingThreads() const { return m_numPostprocessingThreads; }
+
 		void addSimulationProcess(std::function<sim::SimulationFunction<void>()> simProc) { m_simulationProcesses.push_back(std::move(simProc)); }
 		inline const std::vector<std::function<sim::SimulationFunction<void>()>>& getSimulationProcesses() const { return m_simulationProcesses; }
 
@@ -214,6 +231,14 @@ namespace gtry::hlim {
 
 		std::vector<size_t> m_debugNodeId;
 
+		size_t m_numPostprocessingThreads = 0;
+		std::unique_ptr<sim::WorkerPool> m_postprocessingWorkers;
+
+		/// @brief Runs a read-only analysis on each node of the subnet, concurrently for different node groups, and returns the results in the order of the subnet.
+		/// @details The analysis must not modify the circuit. Partitioning by node group keeps the nodes that most local analyses visit together in one task.
+		template<typename Result>
+		std::vector<Result> analyzeByNodeGroup(const Subnet& subnet, const std::function<void(BaseNode*, std::vector<Result>&)>& analyze);
+
 		void setNodeId(BaseNode* node);
 		void setClockId(Clock* clock);
 		void readDebugNodeIds();
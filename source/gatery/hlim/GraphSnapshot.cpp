@@ -0,0 +1,128 @@
+/*  This file is part of Gatery, a library for circuit design.
+	Copyright (C) 2021 Michael Offel, Andreas Ley
+
+	Gatery is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 3 of the License, or (at your option) any later version.
+
+	Gatery is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include "gatery/pch.h"
+
+#include "GraphSnapshot.h"
+
+#include "Subnet.h"
+#include "Node.h"
+
+#include <gatery/utils/Range.h>
+
+namespace gtry::hlim {
+
+void GraphSnapshot::build(const Subnet &subnet)
+{
+	m_nodes.clear();
+	m_nodeKind.clear();
+	m_indexOfId.clear();
+	m_firstId = 0;
+	m_indexOfScatteredId.clear();
+	m_inputOffset.clear();
+	m_inputNode.clear();
+	m_driver.clear();
+	m_outputOffset.clear();
+	m_outputNode.clear();
+	m_outputWidth.clear();
+	m_outputType.clear();
+	m_drivenOffset.clear();
+	m_driven.clear();
+
+	m_nodes.reserve(subnet.size());
+	m_nodeKind.reserve(subnet.size());
+	m_inputOffset.reserve(subnet.size()+1);
+	m_outputOffset.reserve(subnet.size()+1);
+
+	for (auto *node : subnet) {
+		m_inputOffset.push_back((std::uint32_t) m_inputNode.size());
+		m_outputOffset.push_back((std::uint32_t) m_outputNode.size());
+
+		for ([[maybe_unused]] auto i : utils::Range(node->getNumInputPorts()))
+			m_inputNode.push_back((std::uint32_t) m_nodes.size());
+
+		for (auto i : utils::Range(node->getNumOutputPorts())) {
+			m_outputNode.push_back((std::uint32_t) m_nodes.size());
+			m_outputWidth.push_back(node->getOutputConnectionType(i).width);
+			m_outputType.push_back((std::uint8_t) node->getOutputType(i));
+		}
+
+		m_nodes.push_back(node);
+		m_nodeKind.push_back(&typeid(*node));
+	}
+	m_inputOffset.push_back((std::uint32_t) m_inputNode.size());
+	m_outputOffset.push_back((std::uint32_t) m_outputNode.size());
+
+	// Subnets iterate in id order, so the table only needs to span from the first to the last id instead of all ids of the circuit.
+	if (!m_nodes.empty()) {
+		m_firstId = m_nodes.front()->getId();
+		size_t idSpan = m_nodes.back()->getId() - m_firstId + 1;
+		if (idSpan <= 4 * m_nodes.size()) {
+			m_indexOfId.resize(idSpan, INVALID);
+			for (auto nodeIdx : utils::Range<std::uint32_t>((std::uint32_t) m_nodes.size()))
+				m_indexOfId[m_nodes[nodeIdx]->getId() - m_firstId] = nodeIdx;
+		} else {
+			for (auto nodeIdx : utils::Range<std::uint32_t>((std::uint32_t) m_nodes.size()))
+				m_indexOfScatteredId[m_nodes[nodeIdx]->getId()] = nodeIdx;
+		}
+	}
+
+	m_driver.resize(m_inputNode.size());
+	m_drivenOffset.reserve(m_outputNode.size()+1);
+	for (auto nodeIdx : utils::Range<std::uint32_t>((std::uint32_t) m_nodes.size())) {
+		auto *node = m_nodes[nodeIdx];
+
+		for (auto i : utils::Range(node->getNumInputPorts()))
+			m_driver[getInput(nodeIdx, i)] = getOutput(node->getDriver(i));
+
+		for (auto i : utils::Range(node->getNumOutputPorts())) {
+			m_drivenOffset.push_back((std::uint32_t) m_driven.size());
+			for (const auto &np : node->getDirectlyDriven(i)) {
+				auto drivenIdx = getNodeIndex(np.node);
+				if (drivenIdx != INVALID)
+					m_driven.push_back(getInput(drivenIdx, np.port));
+			}
+		}
+	}
+	m_drivenOffset.push_back((std::uint32_t) m_driven.size());
+}
+
+std::uint32_t GraphSnapshot::getNodeIndex(const BaseNode *node) const
+{
+	if (node == nullptr)
+		return INVALID;
+
+	std::uint64_t id = node->getId();
+	if (!m_indexOfScatteredId.empty()) {
+		auto it = m_indexOfScatteredId.find(id);
+		return it == m_indexOfScatteredId.end() ? INVALID : it->second;
+	}
+
+	if (id < m_firstId || id - m_firstId >= m_indexOfId.size())
+		return INVALID;
+	return m_indexOfId[id - m_firstId];
+}
+
+std::uint32_t GraphSnapshot::getOutput(const NodePort &np) const
+{
+	auto nodeIdx = getNodeIndex(np.node);
+	if (nodeIdx == INVALID)
+		return INVALID;
+	return getOutput(nodeIdx, np.port);
+}
+
+}
@@ -0,0 +1,104 @@
+/*  This file is part of Gatery, a library for circuit design.
+	Copyright (C) 2021 Michael Offel, Andreas Ley
+
+	Gatery is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 3 of the License, or (at your option) any later version.
+
+	Gatery is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#pragma once
+
+#include "NodeIO.h"
+#include "NodePort.h"
+
+#include <gatery/utils/StableContainers.h>
+
+#include <cstdint>
+#include <span>
+#include <typeinfo>
+#include <vector>
+
+namespace gtry::hlim {
+
+class BaseNode;
+class Subnet;
+
+/**
+ * @brief Read-only snapshot of the connectivity of a subnet in compressed sparse row form.
+ * @details Nodes are numbered densely in id order, their inputs and outputs are numbered consecutively per node, and all drivers,
+ * fan-outs, output widths, output types, and node kinds are stored in flat arrays. Analysis passes can thus walk the graph
+ * without chasing the per node and per port vectors of the NodeIO.
+ * Connections from or to nodes outside of the subnet are treated as unconnected.
+ * The snapshot does not observe the circuit, it must be rebuilt once the subnet or any of its connections are modified.
+ */
+class GraphSnapshot {
+	public:
+		static constexpr std::uint32_t INVALID = ~0u;
+
+		GraphSnapshot() = default;
+		GraphSnapshot(const Subnet &subnet) { build(subnet); }
+
+		void build(const Subnet &subnet);
+
+		inline size_t numNodes() const { return m_nodes.size(); }
+		inline size_t numInputs() const { return m_inputNode.size(); }
+		inline size_t numOutputs() const { return m_outputNode.size(); }
+
+		inline BaseNode *getNode(std::uint32_t node) const { return m_nodes[node]; }
+		/// Returns the dense index of a node or INVALID if the node is not part of the snapshot.
+		std::uint32_t getNodeIndex(const BaseNode *node) const;
+		inline const std::type_info &getNodeKind(std::uint32_t node) const { return *m_nodeKind[node]; }
+
+		inline size_t getNumInputPorts(std::uint32_t node) const { return m_inputOffset[node+1] - m_inputOffset[node]; }
+		inline size_t getNumOutputPorts(std::uint32_t node) const { return m_outputOffset[node+1] - m_outputOffset[node]; }
+		inline std::uint32_t getInput(std::uint32_t node, size_t port) const { return m_inputOffset[node] + (std::uint32_t) port; }
+		inline std::uint32_t getOutput(std::uint32_t node, size_t port) const { return m_outputOffset[node] + (std::uint32_t) port; }
+		/// Returns the dense index of an output or INVALID if it is not part of the snapshot.
+		std::uint32_t getOutput(const NodePort &np) const;
+
+		inline std::uint32_t getInputNode(std::uint32_t input) const { return m_inputNode[input]; }
+		inline size_t getInputPort(std::uint32_t input) const { return input - m_inputOffset[m_inputNode[input]]; }
+		inline std::uint32_t getOutputNode(std::uint32_t output) const { return m_outputNode[output]; }
+		inline size_t getOutputPort(std::uint32_t output) const { return output - m_outputOffset[m_outputNode[output]]; }
+		inline NodePort getNodePort(std::uint32_t output) const { return { .node = m_nodes[m_outputNode[output]], .port = getOutputPort(output) }; }
+
+		/// Returns the output driving an input, or INVALID if the input is unconnected or driven from outside of the snapshot.
+		inline std::uint32_t getDriver(std::uint32_t input) const { return m_driver[input]; }
+		/// Returns all inputs (inside of the snapshot) driven by an output in the same order as NodeIO::getDirectlyDriven.
+		inline std::span<const std::uint32_t> getDriven(std::uint32_t output) const {
+			return std::span<const std::uint32_t>(m_driven.data() + m_drivenOffset[output], m_drivenOffset[output+1] - m_drivenOffset[output]);
+		}
+
+		inline size_t getOutputWidth(std::uint32_t output) const { return m_outputWidth[output]; }
+		inline NodeIO::OutputType getOutputType(std::uint32_t output) const { return (NodeIO::OutputType) m_outputType[output]; }
+	protected:
+		std::vector<BaseNode*> m_nodes;
+		std::vector<const std::type_info*> m_nodeKind;
+		/// Dense node index for each node id from m_firstId on (INVALID for nodes not in the snapshot), if the ids of the subnet are not too scattered.
+		std::vector<std::uint32_t> m_indexOfId;
+		std::uint64_t m_firstId = 0;
+		/// Dense node index for each node id, if the ids of the subnet are too scattered for a table.
+		utils::UnstableMap<std::uint64_t, std::uint32_t> m_indexOfScatteredId;
+
+		std::vector<std::uint32_t> m_inputOffset;
+		std::vector<std::uint32_t> m_inputNode;
+		std::vector<std::uint32_t> m_driver;
+
+		std::vector<std::uint32_t> m_outputOffset;
+		std::vector<std::uint32_t> m_outputNode;
+		std::vector<std::size_t> m_outputWidth;
+		std::vector<std::uint8_t> m_outputType;
+		std::vector<std::uint32_t> m_drivenOffset;
+		std::vector<std::uint32_t> m_driven;
+};
+
+}
@@ -245,7 +245,7 @@ namespace {
 		portCondition.removeTerms(retimingEnableCondition);
 
 		// Ensure that the contribution to regEnable are (or become part of) the retiming area
-		for (const auto pair : portCondition.getTerms().anyOrder())
+		for (const auto &pair : portCondition.getTerms().anyOrder())
 			retimingArea.add(pair.second.conjunctionDriver.node);
 
 
@@ -808,6 +808,10 @@ bool retimeForwardToOutput(Circuit &circuit, Subnet &area, NodePort output, cons
 		for (auto r : regs) {
 			newNodes.add(r);
 			registersToCheckForBypass.insert(r);
+			// The spawner rewired its readers to the new register
+			if (settings.rewiredNodes)
+				for (auto driven : r->getDirectlyDriven(0))
+					settings.rewiredNodes->add(driven.node);
 		}
 	}
 
@@ -871,14 +875,19 @@ bool retimeForwardToOutput(Circuit &circuit, Subnet &area, NodePort output, cons
 				if (!retimingPlan->areaToBeRetimed.contains(inputNP.node))
 					inputsToRewire.push_back(inputNP);
 
-		for (auto inputNP : inputsToRewire)
+		for (auto inputNP : inputsToRewire) {
 			inputNP.node->rewireInput(inputNP.port, {.node = reg, .port = 0ull});
+			if (settings.rewiredNodes)
+				settings.rewiredNodes->add(inputNP.node);
+		}
 	}
 	
 
 	// Replace enables of anchored registers and memory write ports
 	for (const auto &repl : retimingPlan->enableReplacements) {
 		repl.input.node->rewireInput(repl.input.port, repl.newEnable);
+		if (settings.rewiredNodes)
+			settings.rewiredNodes->add(repl.input.node);
 		for (auto &n : repl.newNodes)
 			newNodes.add(n);
 	}
@@ -932,8 +941,11 @@ bool retimeForwardToOutput(Circuit &circuit, Subnet &area, NodePort output, cons
 	}
 
 	// After everything has been prepared, actually apply the bypasses.
-	for (const auto &driven_newDriver : bypasses)
+	for (const auto &driven_newDriver : bypasses) {
 		driven_newDriver.first.node->rewireInput(driven_newDriver.first.port, driven_newDriver.second);
+		if (settings.rewiredNodes)
+			settings.rewiredNodes->add(driven_newDriver.first.node);
+	}
 	
 	
 
@@ -950,29 +962,18 @@ bool retimeForwardToOutput(Circuit &circuit, Subnet &area, NodePort output, cons
 
 void retimeForward(Circuit &circuit, Subnet &subnet)
 {
+	// estimate signal delays once, then only update the cones affected by each retiming step
+	hlim::SignalDelay delays;
+	delays.compute(subnet);
+
 	bool done = false;
 	while (!done) {
 
-		// estimate signal delays
-		hlim::SignalDelay delays;
-		delays.compute(subnet);
-
 		// Find critical output
-		hlim::NodePort criticalOutput;
-		size_t criticalBit = ~0u;
-		float criticalTime = 0.0f;
-		for (auto &n : subnet)
-			for (auto i : utils::Range(n->getNumOutputPorts())) {
-				hlim::NodePort np = {.node = n, .port = i};
-				auto d = delays.getDelay(np);
-				for (auto i : utils::Range(d.size())) {   
-					if (d[i] > criticalTime) {
-						criticalTime = d[i];
-						criticalOutput = np;
-						criticalBit = i;
-					}
-				}
-			}
+		auto critical = delays.getCriticalBit();
+		hlim::NodePort criticalOutput = critical.output;
+		size_t criticalBit = critical.bit;
+		float criticalTime = critical.delay;
 /*
 		{
 			DotExport exp("signalDelays.dot");
@@ -1039,7 +1040,14 @@ void retimeForward(Circuit &circuit, Subnet &subnet)
 		}
 
 		if (retimingTarget.node != nullptr && dynamic_cast<Node_Register*>(retimingTarget.node) == nullptr) {
-			done = !retimeForwardToOutput(circuit, subnet, retimingTarget, {.failureIsError=false});
+			Subnet newNodes;
+			Subnet rewiredNodes;
+			done = !retimeForwardToOutput(circuit, subnet, retimingTarget, {.failureIsError=false, .newNodes=&newNodes, .rewiredNodes=&rewiredNodes});
+			if (!done) {
+				for (auto *n : rewiredNodes)
+					newNodes.add(n);
+				delays.update(subnet, newNodes);
+			}
 		} else
 			done = true;
 	
@@ -1184,7 +1192,7 @@ namespace {
 		portCondition.removeTerms(retimingEnableCondition);
 
 		// Ensure that the contribution to regEnable are (or become part of) the retiming area
-		for (const auto pair : portCondition.getTerms().anyOrder())
+		for (const auto &pair : portCondition.getTerms().anyOrder())
 			retimingArea.add(pair.second.conjunctionDriver.node);
 
 
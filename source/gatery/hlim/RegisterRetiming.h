@@ -46,6 +46,8 @@ struct RetimingSetting {
 	bool failureIsError = true;
 	/// Subnet to add all new nodes into
 	Subnet *newNodes = nullptr;
+	/// Subnet to add all existing nodes into whose inputs were rewired
+	Subnet *rewiredNodes = nullptr;
 
 	/// Whether to disable forward retiming for all registers that are placed downstream (combinatorically driven) of the retiming target output.
 	bool downstreamDisableForwardRT = false;
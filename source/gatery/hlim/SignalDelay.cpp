@@ -26,54 +26,183 @@
 
 #include "TopologicalSort.h"
 
+#include <algorithm>
+
 
 namespace gtry::hlim {
 
 void SignalDelay::compute(const Subnet &subnet)
 {
-	allocate(subnet);
-	zero();
+	m_outputToBitDelays.clear();
+	m_outputsByDelay.clear();
+	m_maxDelayOfOutput.clear();
+	m_delays.clear();
+	m_topologicalPosition.clear();
+
+	for (auto n : subnet.getNodes())
+		for (auto i : utils::Range(n->getNumOutputPorts()))
+			allocate({.node=n, .port=i});
 
 	TopologicalSort sorter;
 	const auto &sorted = sorter.sort(subnet);
 
-	for (auto n : sorted)
-		n->estimateSignalDelay(*this);
+	for (auto i : utils::Range(sorted.size())) {
+		m_topologicalPosition[sorted[i]] = i;
+		evaluate(sorted[i]);
+	}
 }
 
-void SignalDelay::allocate(const Subnet &subnet)
+void SignalDelay::update(const Subnet &subnet, const Subnet &changedNodes)
 {
-	m_outputToBitDelays.clear();
-
-	utils::StableMap<NodePort, std::pair<size_t, size_t>> allocations;
+	// Min-heap of nodes by their topological position and id. Entries whose position was raised after they were queued are stale and skipped.
+	std::vector<std::pair<size_t, BaseNode*>> worklist;
+	auto later = [](const std::pair<size_t, BaseNode*> &lhs, const std::pair<size_t, BaseNode*> &rhs) {
+		if (lhs.first != rhs.first)
+			return lhs.first > rhs.first;
+		return lhs.second->getId() > rhs.second->getId();
+	};
+	auto push = [&](BaseNode *n, size_t position) {
+		worklist.push_back({position, n});
+		std::push_heap(worklist.begin(), worklist.end(), later);
+	};
+
+	utils::UnstableSet<BaseNode*> queued;
+	for (auto n : changedNodes) {
+		if (!subnet.contains(n)) continue;
 
-	size_t totalSize = 0;
-	for (auto n : subnet.getNodes())
 		for (auto i : utils::Range(n->getNumOutputPorts())) {
 			NodePort np{.node=n, .port=i};
-
 			if (outputIsDependency(np)) continue;
+			auto allocIt = m_outputToBitDelays.find(np);
+			if (allocIt == m_outputToBitDelays.end() || allocIt->second.width != getOutputWidth(np))
+				allocate(np);
+		}
+
+		// Added and rewired nodes must come after their (combinatorial) drivers.
+		size_t position = 0;
+		for (auto i : utils::Range(n->getNumInputPorts())) {
+			auto driver = n->getDriver(i);
+			if (driver.node == nullptr || !subnet.contains(driver.node) || driver.node->getOutputType(driver.port) == NodeIO::OUTPUT_LATCHED) continue;
+			auto it = m_topologicalPosition.find(driver.node);
+			if (it != m_topologicalPosition.end())
+				position = std::max(position, it->second + 1);
+		}
+		auto [it, inserted] = m_topologicalPosition.try_emplace(n, position);
+		it->second = std::max(it->second, position);
+
+		push(n, it->second);
+		queued.insert(n);
+	}
+
+	// Propagate changed delays to the readers
+	while (!worklist.empty()) {
+		std::pop_heap(worklist.begin(), worklist.end(), later);
+		auto [position, n] = worklist.back();
+		worklist.pop_back();
+		if (m_topologicalPosition[n] != position) continue;
+
+		queued.erase(n);
+		if (!evaluate(n)) continue;
+
+		for (auto port : utils::Range(n->getNumOutputPorts())) {
+			bool latched = n->getOutputType(port) == NodeIO::OUTPUT_LATCHED;
+			for (auto driven : n->getDirectlyDriven(port)) {
+				if (!subnet.contains(driven.node)) continue;
+
+				auto &readerPosition = m_topologicalPosition[driven.node];
+				if (!latched && readerPosition <= position) {
+					readerPosition = position + 1;
+					push(driven.node, readerPosition);
+					queued.insert(driven.node);
+				} else if (!queued.contains(driven.node)) {
+					push(driven.node, readerPosition);
+					queued.insert(driven.node);
+				}
+			}
+		}
+	}
+}
+
+SignalDelay::CriticalBit SignalDelay::getCriticalBit() const
+{
+	CriticalBit result;
+	if (m_outputsByDelay.empty() || m_outputsByDelay.rbegin()->first <= 0.0f)
+		return result;
+
+	result.output = m_outputsByDelay.rbegin()->second;
+	auto delays = getDelay(result.output);
+	for (auto i : utils::Range(delays.size()))
+		if (delays[i] > result.delay) {
+			result.delay = delays[i];
+			result.bit = i;
+		}
+	return result;
+}
+
+void SignalDelay::allocate(const NodePort &np)
+{
+	if (outputIsDependency(np)) return;
+
+	size_t width = getOutputWidth(np);
+	m_outputToBitDelays[np] = { .offset = m_delays.size(), .width = width };
+	m_delays.resize(m_delays.size() + width, 0.0f);
+}
 
-			size_t width = getOutputWidth(np);
-			allocations[np] = {totalSize, width};
-			totalSize += width;
+bool SignalDelay::evaluate(BaseNode *node)
+{
+	m_previousDelays.clear();
+	for (auto i : utils::Range(node->getNumOutputPorts())) {
+		auto delays = getDelay({.node=node, .port=i});
+		m_previousDelays.insert(m_previousDelays.end(), delays.begin(), delays.end());
+		std::fill(delays.begin(), delays.end(), 0.0f);
+	}
+
+	node->estimateSignalDelay(*this);
+
+	bool changed = false;
+	size_t previousIdx = 0;
+	for (auto i : utils::Range(node->getNumOutputPorts())) {
+		NodePort np{.node=node, .port=i};
+		auto delays = getDelay(np);
+		if (!std::equal(delays.begin(), delays.end(), m_previousDelays.begin() + previousIdx) || !m_maxDelayOfOutput.contains(np)) {
+			changed = true;
+			updateMaxDelay(np);
 		}
+		previousIdx += delays.size();
+	}
+	return changed;
+}
 
-	m_delays.resize(totalSize);
-	for (auto &alloc : allocations)
-		m_outputToBitDelays[alloc.first] = std::span<float>(m_delays.data() + alloc.second.first, alloc.second.second);
+void SignalDelay::updateMaxDelay(const NodePort &np)
+{
+	if (!contains(np)) return;
+
+	auto delays = getDelay(np);
+	float maxDelay = 0.0f;
+	for (auto d : delays)
+		maxDelay = std::max(maxDelay, d);
+
+	auto it = m_maxDelayOfOutput.find(np);
+	if (it != m_maxDelayOfOutput.end()) {
+		m_outputsByDelay.erase({it->second, np});
+		it->second = maxDelay;
+	} else
+		m_maxDelayOfOutput[np] = maxDelay;
+	m_outputsByDelay.insert({maxDelay, np});
 }
 
-void SignalDelay::zero()
+bool SignalDelay::OutputByDelayCompare::operator()(const std::pair<float, NodePort> &lhs, const std::pair<float, NodePort> &rhs) const
 {
-	memset(m_delays.data(), 0, m_delays.size() * sizeof(float));
+	if (lhs.first != rhs.first)
+		return lhs.first < rhs.first;
+	return utils::StableCompare<NodePort>{}(rhs.second, lhs.second);
 }
 
 std::span<float> SignalDelay::getDelay(const NodePort &np)
 {
 	auto it = m_outputToBitDelays.find(np);
 	if (it != m_outputToBitDelays.end())
-		return it->second; 
+		return std::span<float>(m_delays.data() + it->second.offset, it->second.width);
 
 	size_t width = 0;
 	if (np.node != nullptr)
@@ -87,7 +216,7 @@ std::span<const float> SignalDelay::getDelay(const NodePort &np) const
 {
 	auto it = m_outputToBitDelays.find(np);
 	if (it != m_outputToBitDelays.end())
-		return it->second; 
+		return std::span<const float>(m_delays.data() + it->second.offset, it->second.width);
 
 	size_t width = 0;
 	if (np.node != nullptr)
@@ -20,33 +20,71 @@
 #include <gatery/utils/StableContainers.h>
 
 #include <map>
+#include <set>
 #include <span>
 #include <vector>
 
+#include "NodePort.h"
 #include "../utils/Exceptions.h"
 #include "../utils/Preprocessor.h"
 
 namespace gtry::hlim {
 
-struct NodePort;
+class BaseNode;
 class Circuit;
 class Subnet;
 
+/**
+ * @brief Estimated arrival times of all bits of all outputs of a subnet.
+ * @details After a full computation, the delays can be updated incrementally when the subnet is modified (e.g. by retiming),
+ * which only reevaluates the given changed nodes and, transitively, those readers whose input delays changed as a result.
+ */
 class SignalDelay {
 	public:
+		struct CriticalBit {
+			NodePort output;
+			size_t bit = ~0ull;
+			float delay = 0.0f;
+		};
+
+		/// Computes the delays of all nodes of the subnet from scratch.
 		void compute(const Subnet &subnet);
+		/// @brief Updates the delays after nodes were added to the subnet or inputs of its nodes were rewired.
+		/// @details Only the fan-out cone of changedNodes is reevaluated, so it must hold all added nodes and all nodes with rewired inputs.
+		/// Nodes must not have been removed from the subnet since the last computation. The cone is evaluated in topological order,
+		/// so each node is only evaluated once, after all of its changed drivers.
+		void update(const Subnet &subnet, const Subnet &changedNodes);
+
+		/// Returns the output bit with the largest delay.
+		CriticalBit getCriticalBit() const;
 
 		inline bool contains(const NodePort &np) const { return m_outputToBitDelays.contains(np); }
 		std::span<float> getDelay(const NodePort &np);
 		std::span<const float> getDelay(const NodePort &np) const;
 	protected:
+		struct Allocation {
+			size_t offset;
+			size_t width;
+		};
+
 		mutable std::vector<float> m_zeros;
 		std::vector<float> m_delays;
-		utils::UnstableMap<NodePort, std::span<float>> m_outputToBitDelays;
-
+		utils::UnstableMap<NodePort, Allocation> m_outputToBitDelays;
+		/// Orders by delay and, among equal delays, puts the lowest node id and port last.
+		struct OutputByDelayCompare {
+			bool operator()(const std::pair<float, NodePort> &lhs, const std::pair<float, NodePort> &rhs) const;
+		};
+		/// Largest delay of each output, ordered to quickly find the critical path.
+		std::set<std::pair<float, NodePort>, OutputByDelayCompare> m_outputsByDelay;
+		utils::UnstableMap<NodePort, float> m_maxDelayOfOutput;
+		std::vector<float> m_previousDelays;
+		/// Position of each node in a topological order of the subnet. Updates raise the positions of nodes that end up reading from later nodes.
+		utils::UnstableMap<BaseNode*, size_t> m_topologicalPosition;
 
-		void allocate(const Subnet &subnet);
-		void zero();
+		void allocate(const NodePort &np);
+		/// Evaluates a node and returns whether any of its output delays changed.
+		bool evaluate(BaseNode *node);
+		void updateMaxDelay(const NodePort &np);
 };
 
 }
@@ -481,13 +481,13 @@ void SubnetTemplate<makeConst, FinalType>::dilateIf(std::function<DilateDir(cons
 			if (dir == DilateDir::input || dir == DilateDir::both)
 				for (auto i : utils::Range(n->getNumInputPorts())) 
 					if(auto np = n->getDriver(i); np.node)
-						if (auto [it, inserted] = m_nodes.insert(np.node); inserted)
+						if (m_nodes.insert(np.node))
 							newNodes.push_back(np.node);
 
 			if (dir == DilateDir::output || dir == DilateDir::both)
 				for (auto i : utils::Range(n->getNumOutputPorts())) 
 					for (auto np : n->getDirectlyDriven(i))
-						if (auto [it, inserted] = m_nodes.insert(np.node); inserted)
+						if (m_nodes.insert(np.node))
 							newNodes.push_back(np.node);
 		}
 		lastStepNodes.swap(newNodes);
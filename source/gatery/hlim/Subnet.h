@@ -18,6 +18,9 @@
 #pragma once
 
 #include <gatery/utils/StableContainers.h>
+#include <gatery/utils/IdSet.h>
+
+#include "Node.h"
 
 #include <set>
 #include <span>
@@ -116,25 +119,31 @@ namespace gtry::hlim {
 		void dilateIf(std::function<DilateDir(const NodeType&)> filter, size_t stepLimit = 0, std::optional<NodeType*> startNode = {});
 		template<class... FilterNodeType> void dilateIf(DilateDir match, DilateDir notMatch = DilateDir::none, size_t stepLimit = 0, std::optional<NodeType*> startNode = {});
 
-		inline const utils::StableSet<NodeType*>& getNodes() const { return m_nodes; }
+		inline const utils::IdSet<NodeType*>& getNodes() const { return m_nodes; }
 
 		inline bool contains(NodeType* node) const { return m_nodes.contains(node); }
 		inline bool empty() const { return m_nodes.empty(); }
+		inline size_t size() const { return m_nodes.size(); }
 
 		FinalType filterLoopNodesOnly() const;
 
 		auto begin() const { return m_nodes.begin(); }
 		auto end() const { return m_nodes.end(); }
-		operator utils::StableSet<NodeType*>() const { return m_nodes; }
+		operator utils::StableSet<NodeType*>() const { return utils::StableSet<NodeType*>(m_nodes.begin(), m_nodes.end()); }
 		operator utils::UnstableSet<NodeType*>() const { return utils::UnstableSet<NodeType*>(m_nodes.begin(), m_nodes.end()); }
 
 		template<typename Iterator>
 		void insert(Iterator begin, Iterator end) { m_nodes.insert(begin, end); }
 
 		/// Join two subnets
-		FinalType& add(const FinalType& other) { insert(other.begin(), other.end()); return (FinalType&)*this; }
+		FinalType& add(const FinalType& other) { m_nodes.insert(other.getNodes()); return (FinalType&)*this; }
+		/// Removes all nodes of the other subnet
+		FinalType& remove(const FinalType& other) { m_nodes.erase(other.getNodes()); return (FinalType&)*this; }
+		/// Removes all nodes that are not also part of the other subnet
+		FinalType& intersect(const FinalType& other) { m_nodes.intersect(other.getNodes()); return (FinalType&)*this; }
 	protected:
-		utils::StableSet<NodeType*> m_nodes;
+		/// Nodes indexed by their id, which keeps membership tests O(1) and iteration in the same deterministic id order as a StableSet.
+		utils::IdSet<NodeType*> m_nodes;
 	};
 
 	class Subnet : public SubnetTemplate<false, Subnet> { };
@@ -21,6 +21,7 @@
 #include "TopologicalSort.h"
 
 #include "Subnet.h"
+#include "GraphSnapshot.h"
 
 #include "Circuit.h"
 #include "Node.h"
@@ -34,55 +35,59 @@ namespace gtry::hlim {
 const std::vector<BaseNode*> &TopologicalSort::sort(const Subnet &subnet, LoopHandling loopHandling)
 {
 	m_sortedNodes.clear();
-	m_unsortedNodes = subnet;
+	m_unsortedNodes.clear();
 
-	utils::UnstableSet<NodePort> outputsReady;
+	GraphSnapshot graph(subnet);
 
-	// Checks if all inputs of a node are ready (either because they are bound to a registered output, unconnected, bound to a node outside of the subset, or their input simply is ready)
-	auto allInputsReady = [&outputsReady, &subnet](BaseNode *node)->bool {
-		for (auto i : utils::Range(node->getNumInputPorts())) {
-			auto driver = node->getDriver(i);
-			if (driver.node == nullptr) continue; // ready
-			if (!subnet.contains(driver.node)) continue; // ready
-
-			auto outType = driver.node->getOutputType(driver.port);
-			if (outType == NodeIO::OUTPUT_LATCHED) continue; // ready
+	// Count for each node the inputs that are not ready yet, i.e. that are not unconnected, not bound to a node outside of the subset, and not bound to a registered output.
+	std::vector<size_t> inputsPending(graph.numNodes(), 0);
+	for (auto input : utils::Range<std::uint32_t>((std::uint32_t) graph.numInputs())) {
+		auto driver = graph.getDriver(input);
+		if (driver != GraphSnapshot::INVALID && graph.getOutputType(driver) != NodeIO::OUTPUT_LATCHED)
+			inputsPending[graph.getInputNode(input)]++;
+	}
 
-			if (outputsReady.contains(driver)) continue; // ready
+	std::vector<bool> sorted(graph.numNodes(), false);
+	size_t numSorted = 0;
 
-			// not ready
-			return false;
-		}
-		return true;
-	};
-	
 	// Add all initially ready nodes to stack
-	std::vector<hlim::BaseNode*> nodesReady;
-	for (auto &node : subnet) {
-		if (allInputsReady(node))
-			nodesReady.push_back(node);
-	}
+	std::vector<std::uint32_t> nodesReady;
+	for (auto nodeIdx : utils::Range<std::uint32_t>((std::uint32_t) graph.numNodes()))
+		if (inputsPending[nodeIdx] == 0)
+			nodesReady.push_back(nodeIdx);
 
 	while (true) {
 
 		// Add ready nodes to list, then explore their outputs if any of the driven nodes are now also ready.
 		while (!nodesReady.empty()) {
-			auto *node = nodesReady.back();
+			auto nodeIdx = nodesReady.back();
 			nodesReady.pop_back();
-			if (!m_unsortedNodes.contains(node)) continue; // already handled
-			m_unsortedNodes.erase(node);
-			m_sortedNodes.push_back(node);
+			if (sorted[nodeIdx]) continue; // already handled
+			sorted[nodeIdx] = true;
+			numSorted++;
+			m_sortedNodes.push_back(graph.getNode(nodeIdx));
+
+			// All outputs become ready at once, before any of the driven nodes are checked.
+			for (auto port : utils::Range(graph.getNumOutputPorts(nodeIdx))) {
+				auto output = graph.getOutput(nodeIdx, port);
+				if (graph.getOutputType(output) != NodeIO::OUTPUT_LATCHED)
+					for (auto input : graph.getDriven(output))
+						inputsPending[graph.getInputNode(input)]--;
+			}
+
+			for (auto port : utils::Range(graph.getNumOutputPorts(nodeIdx)))
+				for (auto input : graph.getDriven(graph.getOutput(nodeIdx, port)))
+					if (inputsPending[graph.getInputNode(input)] == 0)
+						nodesReady.push_back(graph.getInputNode(input));
+		}
 
-			for (auto i : utils::Range(node->getNumOutputPorts()))
-				outputsReady.insert({.node=node, .port=i});
+		if (numSorted == graph.numNodes()) break;
 
-			for (auto i : utils::Range(node->getNumOutputPorts()))
-				for (auto np : node->getDirectlyDriven(i))
-					if (allInputsReady(np.node))
-						nodesReady.push_back(np.node);
-		}
+		for (auto nodeIdx : utils::Range<std::uint32_t>((std::uint32_t) graph.numNodes()))
+			if (!sorted[nodeIdx])
+				m_unsortedNodes.insert(graph.getNode(nodeIdx));
 
-		if (m_unsortedNodes.empty() || (loopHandling == SET_LOOPS_ASIDE)) break;
+		if (loopHandling == SET_LOOPS_ASIDE) break;
 
 		HCL_ASSERT_HINT(loopHandling != LOOPS_ARE_ERRORS, "Can't sort topologically, subnet contains loops, " + std::to_string(m_unsortedNodes.size()) + " nodes remaining");
 
@@ -94,7 +99,8 @@ const std::vector<BaseNode*> &TopologicalSort::sort(const Subnet &subnet, LoopHa
 			if (n->getId() < nodeToSplit->getId())
 				nodeToSplit = n;
 
-		nodesReady.push_back(nodeToSplit);
+		m_unsortedNodes.clear();
+		nodesReady.push_back(graph.getNodeIndex(nodeToSplit));
 	}	
 
 
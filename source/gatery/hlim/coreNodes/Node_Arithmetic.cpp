@@ -19,6 +19,7 @@
 #include "Node_Arithmetic.h"
 
 #include <gatery/simulation/BitVectorState.h>
+#include <gatery/simulation/BitVectorKernels.h>
 
 #include "../../utils/BitManipulation.h"
 #include "../../utils/Exceptions.h"
@@ -30,6 +31,49 @@
 
 namespace gtry::hlim {
 
+namespace {
+	/**
+	 * @brief Adds or subtracts wide operands with carry chains over their 64-bit words instead of converting them to BigInt.
+	 * @details Only handles word aligned operands of the same width as the output, returns false for everything else.
+	 */
+	bool evaluateWideAddSub(const Node_Arithmetic &node, sim::DefaultBitVectorState &state, const size_t *inputOffsets, size_t outputOffset)
+	{
+		auto op = node.getOp();
+		if (op != Node_Arithmetic::ADD && op != Node_Arithmetic::SUB)
+			return false;
+
+		size_t width = node.getOutputConnectionType(0).width;
+		if (outputOffset % 64 != 0)
+			return false;
+		for (size_t i = 0; i < node.getNumInputPorts(); i++)
+			if (inputOffsets[i] % 64 != 0 || hlim::getOutputConnectionType(node.getDriver(i)).width != width)
+				return false;
+
+		size_t numFullWords = width / 64;
+		size_t tailWidth = width % 64;
+		std::uint64_t *values = state.data(sim::DefaultConfig::VALUE);
+		std::uint64_t *result = values + outputOffset / 64;
+
+		sim::kernels::copy(result, values + inputOffsets[0] / 64, numFullWords);
+		std::uint64_t resultTail = state.extractNonStraddling(sim::DefaultConfig::VALUE, inputOffsets[0] + numFullWords * 64, tailWidth);
+
+		for (size_t i = 1; i < node.getNumInputPorts(); i++) {
+			const std::uint64_t *operand = values + inputOffsets[i] / 64;
+			std::uint64_t operandTail = state.extractNonStraddling(sim::DefaultConfig::VALUE, inputOffsets[i] + numFullWords * 64, tailWidth);
+			if (op == Node_Arithmetic::ADD) {
+				bool carry = sim::kernels::add(result, result, operand, numFullWords);
+				resultTail = resultTail + operandTail + (carry ? 1 : 0);
+			} else {
+				bool borrow = sim::kernels::sub(result, result, operand, numFullWords);
+				resultTail = resultTail - operandTail - (borrow ? 1 : 0);
+			}
+		}
+
+		state.insertNonStraddling(sim::DefaultConfig::VALUE, outputOffset + numFullWords * 64, tailWidth, resultTail);
+		return true;
+	}
+}
+
 Node_Arithmetic::Node_Arithmetic(Op op, size_t operands) : Node(operands, 1), m_op(op)
 {
 
@@ -139,7 +183,7 @@ void Node_Arithmetic::simulateEvaluate(sim::SimulatorCallbacks &simCallbacks, si
 		}
 
 		state.insertNonStraddling(sim::DefaultConfig::VALUE, outputOffsets[0], getOutputConnectionType(0).width, result);
-	} else {
+	} else if (!evaluateWideAddSub(*this, state, inputOffsets, outputOffsets[0])) {
 		sim::BigInt value, result;
 
 		for (size_t i = 0; i < getNumInputPorts(); i++) {
@@ -191,6 +235,58 @@ void Node_Arithmetic::simulateEvaluate(sim::SimulatorCallbacks &simCallbacks, si
 	}
 }
 
+bool Node_Arithmetic::hasSimulateEvaluateDefined() const
+{
+	// Division by zero turns fully defined inputs into undefined outputs.
+	if (m_op != ADD && m_op != SUB && m_op != MUL)
+		return false;
+
+	if (!getOutputConnectionType(0).isBitVec())
+		return false;
+
+	// Wide additions and subtractions run on the carry chain kernels if all operands are as wide as the output.
+	size_t width = getOutputConnectionType(0).width;
+	bool wideAddSub = width > 64 && m_op != MUL;
+	if (width > 64 && !wideAddSub)
+		return false;
+
+	for (size_t i = 0; i < getNumInputPorts(); i++) {
+		auto driver = getDriver(i);
+		if (driver.node == nullptr)
+			return false;
+		size_t inputWidth = hlim::getOutputConnectionType(driver).width;
+		if (wideAddSub ? inputWidth != width : inputWidth > 64)
+			return false;
+	}
+	return true;
+}
+
+void Node_Arithmetic::simulateEvaluateDefined(sim::SimulatorCallbacks &simCallbacks, sim::DefaultBitVectorState &state, const size_t *internalOffsets, const size_t *inputOffsets, const size_t *outputOffsets) const
+{
+	if (getOutputConnectionType(0).width > 64) {
+		if (!evaluateWideAddSub(*this, state, inputOffsets, outputOffsets[0]))
+			simulateEvaluate(simCallbacks, state, internalOffsets, inputOffsets, outputOffsets);
+		return;
+	}
+
+	std::uint64_t result = 0;
+	for (size_t i = 0; i < getNumInputPorts(); i++) {
+		const auto &type = hlim::getOutputConnectionType(getDriver(i));
+		std::uint64_t value = state.extractNonStraddling(sim::DefaultConfig::VALUE, inputOffsets[i], type.width);
+
+		if (i == 0)
+			result = value;
+		else
+			switch (m_op) {
+				case ADD: result += value; break;
+				case SUB: result -= value; break;
+				case MUL: result *= value; break;
+				default: HCL_ASSERT_HINT(false, "Unhandled case!");
+			}
+	}
+	state.insertNonStraddling(sim::DefaultConfig::VALUE, outputOffsets[0], getOutputConnectionType(0).width, result);
+}
+
 
 std::string Node_Arithmetic::getTypeName() const
 {
@@ -19,12 +19,46 @@
 #include "Node_Compare.h"
 
 #include <gatery/simulation/BitVectorState.h>
+#include <gatery/simulation/BitVectorKernels.h>
 
 #include "../SignalDelay.h"
 
 
 namespace gtry::hlim {
 
+namespace {
+	/**
+	 * @brief Compares wide unsigned operands from the most significant word downwards instead of converting them to BigInt.
+	 * @return Negative, zero, or positive if left is less, equal, or greater than right. Empty if the operands are not word aligned.
+	 */
+	std::optional<int> compareWide(const sim::DefaultBitVectorState &state, size_t leftOffset, size_t leftWidth, size_t rightOffset, size_t rightWidth)
+	{
+		if (leftOffset % 64 != 0 || rightOffset % 64 != 0)
+			return {};
+
+		auto word = [&](size_t offset, size_t width, size_t idx) -> std::uint64_t {
+			if (idx * 64 >= width) return 0;
+			return state.extractNonStraddling(sim::DefaultConfig::VALUE, offset + idx * 64, std::min<size_t>(64, width - idx * 64));
+		};
+
+		// Partial words and the words that only one of the operands has.
+		size_t commonFullWords = std::min(leftWidth, rightWidth) / 64;
+		for (size_t idx = (std::max(leftWidth, rightWidth) + 63) / 64; idx > commonFullWords; idx--) {
+			std::uint64_t left = word(leftOffset, leftWidth, idx-1);
+			std::uint64_t right = word(rightOffset, rightWidth, idx-1);
+			if (left != right)
+				return left < right ? -1 : 1;
+		}
+
+		const std::uint64_t *left = state.data(sim::DefaultConfig::VALUE) + leftOffset / 64;
+		const std::uint64_t *right = state.data(sim::DefaultConfig::VALUE) + rightOffset / 64;
+		size_t idx = sim::kernels::findLastDifference(left, right, commonFullWords);
+		if (idx == ~0ull)
+			return 0;
+		return left[idx] < right[idx] ? -1 : 1;
+	}
+}
+
 Node_Compare::Node_Compare(Op op) : Node(2, 1), m_op(op)
 {
 	ConnectionType conType;
@@ -145,6 +179,30 @@ void Node_Compare::simulateEvaluate(sim::SimulatorCallbacks &simCallbacks, sim::
 			default:
 				HCL_ASSERT_HINT(false, "Unhandled case!");
 		}
+	} else if (auto order = compareWide(state, inputOffsets[0], leftType.width, inputOffsets[1], rightType.width)) {
+		HCL_ASSERT(leftType.isBitVec());
+		switch (m_op) {
+			case EQ:
+				result = *order == 0;
+			break;
+			case NEQ:
+				result = *order != 0;
+			break;
+			case LT:
+				result = *order < 0;
+			break;
+			case GT:
+				result = *order > 0;
+			break;
+			case LEQ:
+				result = *order <= 0;
+			break;
+			case GEQ:
+				result = *order >= 0;
+			break;
+			default:
+				HCL_ASSERT_HINT(false, "Unhandled case!");
+		}
 	} else {
 		sim::BigInt left, right;
 
@@ -179,6 +237,44 @@ void Node_Compare::simulateEvaluate(sim::SimulatorCallbacks &simCallbacks, sim::
 	state.insertNonStraddling(sim::DefaultConfig::DEFINED, outputOffsets[0], 1, 1);
 }
 
+bool Node_Compare::hasSimulateEvaluateDefined() const
+{
+	auto leftDriver = getDriver(0);
+	auto rightDriver = getDriver(1);
+	if (leftDriver.node == nullptr || rightDriver.node == nullptr)
+		return false;
+
+	const auto &leftType = hlim::getOutputConnectionType(leftDriver);
+	const auto &rightType = hlim::getOutputConnectionType(rightDriver);
+	if (leftType.type != rightType.type)
+		return false;
+	if (leftType.width == 0 || rightType.width == 0 || leftType.width > 64 || rightType.width > 64)
+		return false;
+	if (leftType.isBool() && m_op != EQ && m_op != NEQ)
+		return false;
+	return true;
+}
+
+void Node_Compare::simulateEvaluateDefined(sim::SimulatorCallbacks &simCallbacks, sim::DefaultBitVectorState &state, const size_t *internalOffsets, const size_t *inputOffsets, const size_t *outputOffsets) const
+{
+	std::uint64_t left = state.extractNonStraddling(sim::DefaultConfig::VALUE, inputOffsets[0], hlim::getOutputConnectionType(getDriver(0)).width);
+	std::uint64_t right = state.extractNonStraddling(sim::DefaultConfig::VALUE, inputOffsets[1], hlim::getOutputConnectionType(getDriver(1)).width);
+
+	bool result;
+	switch (m_op) {
+		case EQ: result = left == right; break;
+		case NEQ: result = left != right; break;
+		case LT: result = left < right; break;
+		case GT: result = left > right; break;
+		case LEQ: result = left <= right; break;
+		case GEQ: result = left >= right; break;
+		default:
+			HCL_ASSERT_HINT(false, "Unhandled case!");
+			result = false;
+	}
+	state.insertNonStraddling(sim::DefaultConfig::VALUE, outputOffsets[0], 1, result?1:0);
+}
+
 
 std::string Node_Compare::getTypeName() const
 {
@@ -39,6 +39,8 @@ class Node_Compare : public Node<Node_Compare>
 		inline void disconnectInput(size_t operand) { NodeIO::disconnectInput(operand); }
 
 		virtual void simulateEvaluate(sim::SimulatorCallbacks &simCallbacks, sim::DefaultBitVectorState &state, const size_t *internalOffsets, const size_t *inputOffsets, const size_t *outputOffsets) const override;
+		virtual bool hasSimulateEvaluateDefined() const override;
+		virtual void simulateEvaluateDefined(sim::SimulatorCallbacks &simCallbacks, sim::DefaultBitVectorState &state, const size_t *internalOffsets, const size_t *inputOffsets, const size_t *outputOffsets) const override;
 
 		virtual std::string getTypeName() const override;
 		virtual void assertValidity() const override;
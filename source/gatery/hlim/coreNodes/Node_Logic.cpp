@@ -21,9 +21,100 @@
 
 #include "../SignalDelay.h"
 
+#include <gatery/simulation/BitVectorKernels.h>
+
 
 namespace gtry::hlim {
 
+namespace {
+	/// Evaluates the full 64-bit words of word aligned operands with the vectorized kernels and returns the number of bits processed.
+	size_t evaluateFullWords(Node_Logic::Op op, sim::DefaultBitVectorState &state, size_t leftOffset, size_t rightOffset, size_t outputOffset, size_t width)
+	{
+		if (leftOffset % 64 != 0 || rightOffset % 64 != 0 || outputOffset % 64 != 0)
+			return 0;
+
+		size_t numWords = width / 64;
+		const std::uint64_t *left = state.data(sim::DefaultConfig::VALUE) + leftOffset / 64;
+		const std::uint64_t *leftDefined = state.data(sim::DefaultConfig::DEFINED) + leftOffset / 64;
+		const std::uint64_t *right = state.data(sim::DefaultConfig::VALUE) + rightOffset / 64;
+		const std::uint64_t *rightDefined = state.data(sim::DefaultConfig::DEFINED) + rightOffset / 64;
+		std::uint64_t *result = state.data(sim::DefaultConfig::VALUE) + outputOffset / 64;
+		std::uint64_t *resultDefined = state.data(sim::DefaultConfig::DEFINED) + outputOffset / 64;
+
+		switch (op) {
+			case Node_Logic::AND:
+				sim::kernels::transform(result, resultDefined, left, leftDefined, right, rightDefined, numWords, [](auto l, auto lD, auto r, auto rD, auto &res, auto &resD) {
+					res = l & r;
+					resD = (lD & ~l) | (rD & ~r) | (lD & rD);
+				});
+			break;
+			case Node_Logic::NAND:
+				sim::kernels::transform(result, resultDefined, left, leftDefined, right, rightDefined, numWords, [](auto l, auto lD, auto r, auto rD, auto &res, auto &resD) {
+					res = ~(l & r);
+					resD = (lD & ~l) | (rD & ~r) | (lD & rD);
+				});
+			break;
+			case Node_Logic::OR:
+				sim::kernels::transform(result, resultDefined, left, leftDefined, right, rightDefined, numWords, [](auto l, auto lD, auto r, auto rD, auto &res, auto &resD) {
+					res = l | r;
+					resD = (lD & l) | (rD & r) | (lD & rD);
+				});
+			break;
+			case Node_Logic::NOR:
+				sim::kernels::transform(result, resultDefined, left, leftDefined, right, rightDefined, numWords, [](auto l, auto lD, auto r, auto rD, auto &res, auto &resD) {
+					res = ~(l | r);
+					resD = (lD & l) | (rD & r) | (lD & rD);
+				});
+			break;
+			case Node_Logic::XOR:
+				sim::kernels::transform(result, resultDefined, left, leftDefined, right, rightDefined, numWords, [](auto l, auto lD, auto r, auto rD, auto &res, auto &resD) {
+					res = l ^ r;
+					resD = lD & rD;
+				});
+			break;
+			case Node_Logic::EQ:
+				sim::kernels::transform(result, resultDefined, left, leftDefined, right, rightDefined, numWords, [](auto l, auto lD, auto r, auto rD, auto &res, auto &resD) {
+					res = ~(l ^ r);
+					resD = lD & rD;
+				});
+			break;
+			case Node_Logic::NOT:
+				sim::kernels::transform(result, resultDefined, left, leftDefined, left, leftDefined, numWords, [](auto l, auto lD, auto, auto, auto &res, auto &resD) {
+					res = ~l;
+					resD = lD;
+				});
+			break;
+			default:
+				return 0;
+		}
+		return numWords * 64;
+	}
+
+	/// Value-only counterpart of evaluateFullWords for fully defined operands.
+	size_t evaluateFullWordsDefined(Node_Logic::Op op, sim::DefaultBitVectorState &state, size_t leftOffset, size_t rightOffset, size_t outputOffset, size_t width)
+	{
+		if (leftOffset % 64 != 0 || rightOffset % 64 != 0 || outputOffset % 64 != 0)
+			return 0;
+
+		size_t numWords = width / 64;
+		const std::uint64_t *left = state.data(sim::DefaultConfig::VALUE) + leftOffset / 64;
+		const std::uint64_t *right = state.data(sim::DefaultConfig::VALUE) + rightOffset / 64;
+		std::uint64_t *result = state.data(sim::DefaultConfig::VALUE) + outputOffset / 64;
+
+		switch (op) {
+			case Node_Logic::AND: sim::kernels::transform(result, left, right, numWords, [](auto l, auto r) { return l & r; }); break;
+			case Node_Logic::NAND: sim::kernels::transform(result, left, right, numWords, [](auto l, auto r) { return ~(l & r); }); break;
+			case Node_Logic::OR: sim::kernels::transform(result, left, right, numWords, [](auto l, auto r) { return l | r; }); break;
+			case Node_Logic::NOR: sim::kernels::transform(result, left, right, numWords, [](auto l, auto r) { return ~(l | r); }); break;
+			case Node_Logic::XOR: sim::kernels::transform(result, left, right, numWords, [](auto l, auto r) { return l ^ r; }); break;
+			case Node_Logic::EQ: sim::kernels::transform(result, left, right, numWords, [](auto l, auto r) { return ~(l ^ r); }); break;
+			case Node_Logic::NOT: sim::kernels::transform(result, left, left, numWords, [](auto l, auto) { return ~l; }); break;
+			default: return 0;
+		}
+		return numWords * 64;
+	}
+}
+
 Node_Logic::Node_Logic(Op op) : Node(op==NOT?1:2, 1), m_op(op)
 {
 
@@ -62,6 +153,13 @@ void Node_Logic::simulateEvaluate(sim::SimulatorCallbacks &simCallbacks, sim::De
 
 	size_t offset = 0;
 
+	if (width >= 64 && !leftAllUndefined && inputOffsets[0] != ~0ull) {
+		if (m_op == NOT)
+			offset = evaluateFullWords(m_op, state, inputOffsets[0], inputOffsets[0], outputOffsets[0], width);
+		else if (!rightAllUndefined && inputOffsets[1] != ~0ull)
+			offset = evaluateFullWords(m_op, state, inputOffsets[0], inputOffsets[1], outputOffsets[0], width);
+	}
+
 	while (offset < width) {
 		size_t chunkSize = std::min<size_t>(64, width-offset);
 
@@ -121,6 +219,44 @@ void Node_Logic::simulateEvaluate(sim::SimulatorCallbacks &simCallbacks, sim::De
 	}
 }
 
+bool Node_Logic::hasSimulateEvaluateDefined() const
+{
+	return true;
+}
+
+void Node_Logic::simulateEvaluateDefined(sim::SimulatorCallbacks &simCallbacks, sim::DefaultBitVectorState &state, const size_t *internalOffsets, const size_t *inputOffsets, const size_t *outputOffsets) const
+{
+	size_t width = getOutputConnectionType(0).width;
+
+	size_t offset = 0;
+	if (width >= 64)
+		offset = evaluateFullWordsDefined(m_op, state, inputOffsets[0], m_op == NOT ? inputOffsets[0] : inputOffsets[1], outputOffsets[0], width);
+
+	while (offset < width) {
+		size_t chunkSize = std::min<size_t>(64, width-offset);
+
+		std::uint64_t left = state.extractNonStraddling(sim::DefaultConfig::VALUE, inputOffsets[0]+offset, chunkSize);
+		std::uint64_t right = 0;
+		if (m_op != NOT)
+			right = state.extractNonStraddling(sim::DefaultConfig::VALUE, inputOffsets[1]+offset, chunkSize);
+
+		std::uint64_t result;
+		switch (m_op) {
+			case AND: result = left & right; break;
+			case NAND: result = ~(left & right); break;
+			case OR: result = left | right; break;
+			case NOR: result = ~(left | right); break;
+			case XOR: result = left ^ right; break;
+			case EQ: result = ~(left ^ right); break;
+			case NOT: result = ~left; break;
+			default: HCL_ASSERT_HINT(false, "Unhandled case!"); result = 0;
+		};
+
+		state.insertNonStraddling(sim::DefaultConfig::VALUE, outputOffsets[0] + offset, chunkSize, result);
+		offset += chunkSize;
+	}
+}
+
 bool Node_Logic::checkIsNoOp(size_t &inputToForward) const
 {
 	if (m_op == NOT) {
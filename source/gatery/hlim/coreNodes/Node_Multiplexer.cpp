@@ -47,43 +47,22 @@ void Node_Multiplexer::simulateEvaluate(sim::SimulatorCallbacks &simCallbacks, s
 
 	if (!allDefinedNonStraddling(state, inputOffsets[0], selectorType.width)) {
 
-#if 0
-		// Check if all inputs equal (should be more fine grained based on the individual bits!)
-		bool allInputsEqual = true;
-
-		// All must be equal to first in which bits are defined and in the defined bits
-		for (unsigned i = 2; i < getNumInputPorts(); i++)
-			allInputsEqual &= equalOnDefinedValues(state, inputOffsets[1], state, inputOffsets[i], getOutputConnectionType(0).width);
-
-		if (allInputsEqual && getNumInputPorts() > 1) {
-			// arbitrarily copy first
-			state.copyRange(outputOffsets[0], state, inputOffsets[1], getOutputConnectionType(0).width);
-		} else
-			state.clearRange(sim::DefaultConfig::DEFINED, outputOffsets[0], getOutputConnectionType(0).width);
-#else
-		///@todo: This is probably slow
-
-		for (auto b : utils::Range(getOutputConnectionType(0).width)) {
-			bool value = inputOffsets[1] == ~0ull ? false : state.get(sim::DefaultConfig::VALUE, inputOffsets[1]+b);
-			bool defined = inputOffsets[1] == ~0ull ? false : state.get(sim::DefaultConfig::DEFINED, inputOffsets[1]+b);
-
-			// while still defined, check all corresponding bits in other inputs
-			// if defined and same value, remain defined
-			if (defined)
-				for (unsigned i = 2; i < getNumInputPorts(); i++) {
-					bool v = inputOffsets[i] == ~0ull ? false : state.get(sim::DefaultConfig::VALUE, inputOffsets[i]+b);
-					bool d = inputOffsets[i] == ~0ull ? false : state.get(sim::DefaultConfig::DEFINED, inputOffsets[i]+b);
-
-					if (!d || value != v) {
-						defined = false;
-						break;
-					}
-				}
-
-			state.set(sim::DefaultConfig::VALUE, outputOffsets[0]+b, value);
-			state.set(sim::DefaultConfig::DEFINED, outputOffsets[0]+b, defined);
+		// Only bits that are defined and equal in all inputs remain defined.
+		size_t width = getOutputConnectionType(0).width;
+		if (inputOffsets[1] == ~0ull) {
+			state.clearRange(sim::DefaultConfig::VALUE, outputOffsets[0], width);
+			state.clearRange(sim::DefaultConfig::DEFINED, outputOffsets[0], width);
+			return;
+		}
+
+		state.copyRange(outputOffsets[0], state, inputOffsets[1], width);
+		for (unsigned i = 2; i < getNumInputPorts(); i++) {
+			if (inputOffsets[i] == ~0ull) {
+				state.clearRange(sim::DefaultConfig::DEFINED, outputOffsets[0], width);
+				break;
+			}
+			sim::mergeUndefinedSelection(state, outputOffsets[0], state, inputOffsets[i], width);
 		}
-#endif
 
 		return;
 	}
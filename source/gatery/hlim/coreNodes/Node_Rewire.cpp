@@ -404,7 +404,7 @@ void Node_Rewire::estimateSignalDelayCriticalInput(SignalDelay &sigDelay, size_t
 	HCL_ASSERT(false);
 }
 
-void Node_Rewire::optimize()
+bool Node_Rewire::optimize()
 {
 	bool zeroWidthSubrangesRemoved = false;
 	bool mergedSubranges = false;
@@ -496,6 +496,8 @@ void Node_Rewire::optimize()
 
 	if (inputsWereRemoved)
 		dbg::log(dbg::LogMessage(getGroup()) << dbg::LogMessage::LOG_INFO << dbg::LogMessage::LOG_POSTPROCESSING << "In rewire node " << this << " removed unused or redundant inputs." );
+
+	return zeroWidthSubrangesRemoved || constantsWereMerged || mergedSubranges || inputsWereMerged || inputsWereRemoved;
 }
 
 bool Node_Rewire::outputIsConstant(size_t port) const
@@ -0,0 +1,216 @@
+/*  This file is part of Gatery, a library for circuit design.
+	Copyright (C) 2021 Michael Offel, Andreas Ley
+
+	Gatery is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 3 of the License, or (at your option) any later version.
+
+	Gatery is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include "gatery/pch.h"
+
+#include "LocalRewriter.h"
+
+#include "../Circuit.h"
+#include "../Subnet.h"
+#include "../GraphTools.h"
+#include "../coreNodes/Node_Signal.h"
+#include "../coreNodes/Node_Constant.h"
+#include "../coreNodes/Node_Register.h"
+#include "../coreNodes/Node_Rewire.h"
+#include "../coreNodes/Node_Multiplexer.h"
+#include "../supportNodes/Node_ExportOverride.h"
+#include "../../debug/DebugInterface.h"
+#include <gatery/utils/Range.h>
+
+namespace gtry::hlim {
+
+LocalRewriter::LocalRewriter(Circuit &circuit, Subnet &subnet) : m_circuit(circuit), m_subnet(subnet)
+{
+}
+
+void LocalRewriter::addDefaultRules()
+{
+	addRule([this](BaseNode *node) { return replaceConstantOutputs(node); });
+
+	addRule([this](BaseNode *node) {
+		if (isOverridable(node) || !hasConstantInput(node)) return false;
+
+		// Remove registers without reset or whose reset is compatible with the constant input
+		if (auto *regNode = dynamic_cast<Node_Register*>(node))
+			return !regNode->getDirectlyDriven(0).empty() && m_circuit.bypassConstantRegister(regNode);
+
+		bool anyConsumed = false;
+		for (auto port : utils::Range(node->getNumOutputPorts()))
+			if (node->isCombinatorial(port) && !node->getDirectlyDriven(port).empty())
+				anyConsumed = true;
+		if (!anyConsumed) return false;
+
+		// The consumers of the new constants were readers of the node and thus end up on the worklist again.
+		std::vector<NodePort> newConstantOutputs;
+		return m_circuit.foldConstantOutputs(m_subnet, node, newConstantOutputs);
+	});
+
+	addRule<Node_Rewire>([this](Node_Rewire *rewireNode) { return m_circuit.mergeRewireInputs(m_subnet, rewireNode); });
+
+	addRule<Node_Multiplexer>([this](Node_Multiplexer *muxNode) { return m_circuit.mergeMuxInputs(m_subnet, muxNode); });
+	addRule<Node_Multiplexer>([this](Node_Multiplexer *muxNode) {
+		return !muxNode->getDirectlyDriven(0).empty() && m_circuit.bypassConstSelectMux(muxNode);
+	});
+
+	addRule([this](BaseNode *node) { return bypassNoOp(node); });
+}
+
+void LocalRewriter::enqueue(BaseNode *node)
+{
+	m_worklist.insert(node);
+	m_worklistCursor = std::min(m_worklistCursor, node->getId());
+}
+
+void LocalRewriter::enqueueAll()
+{
+	for (auto *node : m_subnet)
+		enqueue(node);
+}
+
+size_t LocalRewriter::run()
+{
+	size_t numApplied = 0;
+	while (!m_worklist.empty()) {
+		BaseNode *node = *m_worklist.lowerBound(m_worklistCursor);
+		m_worklistCursor = node->getId();
+		m_worklist.erase(node);
+
+		if (!m_subnet.contains(node)) continue;
+
+		// Rules may rewire the readers of the node, which can't be found anymore once they are rewired.
+		m_previousReaders.clear();
+		for (auto port : utils::Range(node->getNumOutputPorts()))
+			for (const auto &np : node->getDirectlyDriven(port))
+				m_previousReaders.push_back(np);
+
+		for (auto &rule : m_rules) {
+			if (rule(node)) {
+				numApplied++;
+				// Give the other rules (and this one) another shot at whatever is left of the node.
+				enqueueRewired(node);
+				for (const auto &np : m_previousReaders)
+					if (np.node->getDriver(np.port).node != node)
+						enqueueRewired(np.node);
+				break;
+			}
+		}
+	}
+	return numApplied;
+}
+
+void LocalRewriter::rewireInput(const NodePort &input, const NodePort &driver)
+{
+	input.node->rewireInput(input.port, driver);
+	enqueueRewired(input.node);
+}
+
+void LocalRewriter::enqueueRewired(BaseNode *node)
+{
+	enqueue(node);
+
+	if (!dynamic_cast<Node_Signal*>(node)) return;
+
+	// Rules look through signal nodes, so everything reading from this signal (directly or through further signals) is affected as well.
+	std::vector<BaseNode*> openList = { node };
+	utils::UnstableSet<BaseNode*> closedList;
+	closedList.insert(node);
+	while (!openList.empty()) {
+		auto *signal = openList.back();
+		openList.pop_back();
+		for (const auto &np : signal->getDirectlyDriven(0)) {
+			enqueue(np.node);
+			if (dynamic_cast<Node_Signal*>(np.node) && !closedList.contains(np.node)) {
+				closedList.insert(np.node);
+				openList.push_back(np.node);
+			}
+		}
+	}
+}
+
+/// Replaces outputs that are known to be constant (but are not driven by constant nodes) by constant nodes.
+bool LocalRewriter::replaceConstantOutputs(BaseNode *node)
+{
+	if (dynamic_cast<Node_Constant*>(node)) return false;
+
+	bool replaced = false;
+	for (auto port : utils::Range(node->getNumOutputPorts())) {
+		if (!node->outputIsConstant(port) || node->getDirectlyDriven(port).empty()) continue;
+
+		auto value = evaluateStatically(m_circuit, {.node = node, .port = port});
+		auto *newConstant = m_circuit.createNode<Node_Constant>(value, node->getOutputConnectionType(port));
+		newConstant->moveToGroup(node->getGroup());
+		m_subnet.add(newConstant);
+
+		auto driven = node->getDirectlyDriven(port);
+		for (auto &d : driven)
+			rewireInput(d, {.node = newConstant, .port = 0});
+		replaced = true;
+	}
+	return replaced;
+}
+
+/// Bypasses no-op nodes, the nodes themselves are left for cullUnusedNodes to remove.
+bool LocalRewriter::bypassNoOp(BaseNode *node)
+{
+	if (node->getNumOutputPorts() == 0 || node->getDirectlyDriven(0).empty()) return false;
+
+	if (!node->bypassIfNoOp()) return false;
+
+	dbg::log(dbg::LogMessage(node->getGroup()) << dbg::LogMessage::LOG_INFO << dbg::LogMessage::LOG_POSTPROCESSING << "Removing " << node << " because it is a no-op.");
+	return true;
+}
+
+/// Nodes to which handles exist, registers that can be overriden through those, and export overrides must not be folded.
+bool LocalRewriter::isOverridable(BaseNode *node) const
+{
+	if (node->hasRef()) return true;
+	if (dynamic_cast<Node_ExportOverride*>(node)) return true;
+
+	if (dynamic_cast<Node_Register*>(node)) {
+		std::vector<NodePort> openList = { {.node = node, .port = 0} };
+		utils::UnstableSet<BaseNode*> closedList;
+		while (!openList.empty()) {
+			auto output = openList.back();
+			openList.pop_back();
+			for (const auto &np : output.node->getDirectlyDriven(output.port)) {
+				if (np.node->hasRef()) return true;
+				if (dynamic_cast<Node_Signal*>(np.node) && !closedList.contains(np.node)) {
+					closedList.insert(np.node);
+					openList.push_back({.node = np.node, .port = 0});
+				}
+			}
+		}
+	}
+	return false;
+}
+
+/// Checks whether any input is driven by a constant node of the subnet, looking only through non-overridable signal nodes of the subnet.
+bool LocalRewriter::hasConstantInput(BaseNode *node) const
+{
+	for (auto port : utils::Range(node->getNumInputPorts())) {
+		auto driver = node->getDriver(port);
+		// Bounded by the size of the subnet in case of loops of signal nodes.
+		for (size_t steps = 0; steps < m_subnet.size() && dynamic_cast<Node_Signal*>(driver.node) && m_subnet.contains(driver.node) && !isOverridable(driver.node); steps++)
+			driver = driver.node->getDriver(0);
+
+		if (dynamic_cast<Node_Constant*>(driver.node) && m_subnet.contains(driver.node) && !isOverridable(driver.node))
+			return true;
+	}
+	return false;
+}
+
+}
@@ -0,0 +1,96 @@
+/*  This file is part of Gatery, a library for circuit design.
+	Copyright (C) 2021 Michael Offel, Andreas Ley
+
+	Gatery is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 3 of the License, or (at your option) any later version.
+
+	Gatery is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#pragma once
+
+#include "../NodeIO.h"
+#include "../Node.h"
+
+#include <gatery/utils/IdSet.h>
+
+#include <functional>
+#include <vector>
+
+namespace gtry::hlim {
+
+class Circuit;
+class Subnet;
+
+/**
+ * @brief Applies local rewrite rules to the nodes of a subnet until a fixed point is reached.
+ * @details Instead of sweeping the entire subnet with each optimization pass until nothing changes anymore, the rewriter keeps a worklist of nodes.
+ * Rules may only change the connections around the node they are applied to: the inputs of the node and the inputs of its readers.
+ * Whenever a rule succeeds, the rewriter puts the node and all its previous readers back onto the worklist, and rules can rewire other inputs
+ * through rewireInput. Nodes reading through signal nodes are treated as if they had been rewired themselves.
+ * Nodes are processed in id order, which keeps the result deterministic. Nodes must not be deleted while they are on the worklist.
+ */
+class LocalRewriter
+{
+	public:
+		/// A rule inspects a node and returns true if it modified the circuit around it.
+		using Rule = std::function<bool(BaseNode*)>;
+
+		LocalRewriter(Circuit &circuit, Subnet &subnet);
+
+		LocalRewriter(const LocalRewriter&) = delete;
+		LocalRewriter &operator=(const LocalRewriter&) = delete;
+
+		void addRule(Rule rule) { m_rules.push_back(std::move(rule)); }
+		template<class NodeType>
+		void addRule(std::function<bool(NodeType*)> rule);
+
+		/// Adds constant folding, register bypassing, rewire and mux merging, and the removal of no-ops and muxes with constant selectors.
+		void addDefaultRules();
+
+		void enqueue(BaseNode *node);
+		void enqueueAll();
+
+		/// Processes the worklist until it is empty and returns the number of successful rule applications.
+		size_t run();
+
+		/// Rewires an input on behalf of a rule and puts the affected nodes back onto the worklist.
+		void rewireInput(const NodePort &input, const NodePort &driver);
+		/// Enqueues a node whose inputs changed along with everything reading from it through signal nodes.
+		/// @details Allows passes that run outside of the rewriter to record their changes for the next run.
+		void enqueueRewired(BaseNode *node);
+	protected:
+		Circuit &m_circuit;
+		Subnet &m_subnet;
+
+		std::vector<Rule> m_rules;
+		utils::IdSet<BaseNode*> m_worklist;
+		/// No node with a smaller id is on the worklist, so that popping doesn't rescan the bitmap from the start.
+		std::uint64_t m_worklistCursor = 0;
+		std::vector<NodePort> m_previousReaders;
+
+		bool replaceConstantOutputs(BaseNode *node);
+		bool bypassNoOp(BaseNode *node);
+		bool isOverridable(BaseNode *node) const;
+		bool hasConstantInput(BaseNode *node) const;
+};
+
+template<class NodeType>
+void LocalRewriter::addRule(std::function<bool(NodeType*)> rule)
+{
+	addRule([rule = std::move(rule)](BaseNode *node) {
+		if (auto *n = dynamic_cast<NodeType*>(node))
+			return rule(n);
+		return false;
+	});
+}
+
+}
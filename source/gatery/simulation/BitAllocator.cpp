@@ -26,7 +26,18 @@ size_t BitAllocator::allocate(size_t size) {
 	if (size == 0)
 		return 0ull;
 	
-	if (size <= 32) {
+	if (size <= 32 && m_strategy == Strategy::SEQUENTIAL) {
+		size_t alignment = utils::nextPow2(size);
+		size_t used = 64 - m_currentWord.remaining;
+		size_t start = (used + alignment - 1) & ~(alignment - 1);
+		if (m_currentWord.remaining == 0 || start + size > 64) {
+			m_currentWord.offset = m_totalSize;
+			m_totalSize += 64;
+			start = 0;
+		}
+		m_currentWord.remaining = 64 - (start + size);
+		return m_currentWord.offset + start;
+	} else if (size <= 32) {
 		size = utils::nextPow2(size);
 		
 		unsigned bucket;
@@ -60,6 +71,7 @@ void BitAllocator::flushBuckets() {
 	for (auto i : utils::Range<unsigned>(NUM_BUCKETS)) {
 		m_buckets[i].remaining = 0;
 	}
+	m_currentWord.remaining = 0;
 }
 
 }
@@ -23,8 +23,22 @@
 
 namespace gtry::sim {
 	
+/**
+ * @brief Assigns bit offsets such that allocations of up to 64 bits never straddle 64-bit words.
+ * @details Allocations of up to 32 bits are aligned to their size rounded up to the next power of two,
+ * larger ones start at 64-bit word boundaries and occupy whole words.
+ */
 class BitAllocator {
 	public:
+		enum class Strategy {
+			/// Small allocations of each power-of-two size class are packed into a separate word.
+			SIZE_BUCKETS,
+			/// Small allocations are packed into a single word in the order in which they are allocated, keeping allocations that are made together close together.
+			SEQUENTIAL
+		};
+
+		BitAllocator(Strategy strategy = Strategy::SIZE_BUCKETS) : m_strategy(strategy) { }
+
 		enum {
 			BUCKET_1,
 			BUCKET_2,
@@ -36,6 +50,7 @@ class BitAllocator {
 		};
 
 		size_t allocate(size_t size);
+		/// Ensures that subsequent allocations do not share 64-bit words with previous ones.
 		void flushBuckets();
 		inline size_t getTotalSize() const { return m_totalSize; }
 	protected:
@@ -43,7 +58,10 @@ class BitAllocator {
 			size_t offset = 0;
 			size_t remaining = 0;
 		};
+		Strategy m_strategy;
 		std::array<Bucket, NUM_BUCKETS> m_buckets;
+		/// For the sequential strategy, the word currently being filled.
+		Bucket m_currentWord;
 		size_t m_totalSize = 0;
 };
 
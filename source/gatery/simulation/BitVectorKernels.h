@@ -0,0 +1,243 @@
+/*  This file is part of Gatery, a library for circuit design.
+	Copyright (C) 2021 Michael Offel, Andreas Ley
+
+	Gatery is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 3 of the License, or (at your option) any later version.
+
+	Gatery is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+#if defined(_M_AMD64) || defined(__amd64__)
+#include <immintrin.h>
+#define GTRY_KERNELS_ADDCARRY 1
+#endif
+
+/**
+ * @brief Kernels operating on whole 64-bit words of the planes of a BitVectorState.
+ * @details The kernels process as many words as possible with AVX-512 or AVX2 registers, depending on the instruction sets
+ * the library is compiled for, and handle the remaining words (or all words, if neither is available) with scalar code.
+ * The instruction set is chosen at compile time (the Op functors are inlined into the vector loops), so the default build only
+ * uses scalar code. Enable GATERY_NATIVE_ARCH (cmake) or --native-arch (premake) to build the vector path for the build machine.
+ * All pointers refer to word aligned starts of signals, partial words at the end of a signal must be handled by the caller.
+ */
+namespace gtry::sim::kernels {
+
+/// Scalar stand in for a SIMD register, used for the remaining words and if no SIMD instruction set is available.
+struct ScalarWords {
+	enum { NUM_WORDS = 1 };
+	std::uint64_t v;
+
+	static ScalarWords load(const std::uint64_t *src) { return { *src }; }
+	static ScalarWords broadcast(std::uint64_t value) { return { value }; }
+	void store(std::uint64_t *dst) const { *dst = v; }
+	bool isZero() const { return v == 0; }
+
+	friend ScalarWords operator&(ScalarWords a, ScalarWords b) { return { a.v & b.v }; }
+	friend ScalarWords operator|(ScalarWords a, ScalarWords b) { return { a.v | b.v }; }
+	friend ScalarWords operator^(ScalarWords a, ScalarWords b) { return { a.v ^ b.v }; }
+	friend ScalarWords operator~(ScalarWords a) { return { ~a.v }; }
+};
+
+#if defined(__AVX512F__)
+struct SimdWords {
+	enum { NUM_WORDS = 8 };
+	__m512i v;
+
+	static SimdWords load(const std::uint64_t *src) { return { _mm512_loadu_si512(src) }; }
+	static SimdWords broadcast(std::uint64_t value) { return { _mm512_set1_epi64((long long) value) }; }
+	void store(std::uint64_t *dst) const { _mm512_storeu_si512(dst, v); }
+	bool isZero() const { return _mm512_test_epi64_mask(v, v) == 0; }
+
+	friend SimdWords operator&(SimdWords a, SimdWords b) { return { _mm512_and_si512(a.v, b.v) }; }
+	friend SimdWords operator|(SimdWords a, SimdWords b) { return { _mm512_or_si512(a.v, b.v) }; }
+	friend SimdWords operator^(SimdWords a, SimdWords b) { return { _mm512_xor_si512(a.v, b.v) }; }
+	friend SimdWords operator~(SimdWords a) { return { _mm512_ternarylogic_epi64(a.v, a.v, a.v, 0x55) }; }
+};
+#elif defined(__AVX2__)
+struct SimdWords {
+	enum { NUM_WORDS = 4 };
+	__m256i v;
+
+	static SimdWords load(const std::uint64_t *src) { return { _mm256_loadu_si256((const __m256i*) src) }; }
+	static SimdWords broadcast(std::uint64_t value) { return { _mm256_set1_epi64x((long long) value) }; }
+	void store(std::uint64_t *dst) const { _mm256_storeu_si256((__m256i*) dst, v); }
+	bool isZero() const { return _mm256_testz_si256(v, v); }
+
+	friend SimdWords operator&(SimdWords a, SimdWords b) { return { _mm256_and_si256(a.v, b.v) }; }
+	friend SimdWords operator|(SimdWords a, SimdWords b) { return { _mm256_or_si256(a.v, b.v) }; }
+	friend SimdWords operator^(SimdWords a, SimdWords b) { return { _mm256_xor_si256(a.v, b.v) }; }
+	friend SimdWords operator~(SimdWords a) { return { _mm256_xor_si256(a.v, _mm256_set1_epi64x(-1)) }; }
+};
+#else
+using SimdWords = ScalarWords;
+#endif
+
+/**
+ * @brief Computes two output words from four input words for each word index, e.g. the value and defined plane of a logic operation.
+ * @details The operation is invoked with either SimdWords or ScalarWords and must only use the bitwise operators.
+ */
+template<typename Op>
+void transform(std::uint64_t *dstA, std::uint64_t *dstB, const std::uint64_t *srcA, const std::uint64_t *srcB, const std::uint64_t *srcC, const std::uint64_t *srcD, size_t numWords, Op op)
+{
+	size_t i = 0;
+	for (; i + SimdWords::NUM_WORDS <= numWords; i += SimdWords::NUM_WORDS) {
+		SimdWords a, b;
+		op(SimdWords::load(srcA + i), SimdWords::load(srcB + i), SimdWords::load(srcC + i), SimdWords::load(srcD + i), a, b);
+		a.store(dstA + i);
+		b.store(dstB + i);
+	}
+	for (; i < numWords; i++) {
+		ScalarWords a, b;
+		op(ScalarWords::load(srcA + i), ScalarWords::load(srcB + i), ScalarWords::load(srcC + i), ScalarWords::load(srcD + i), a, b);
+		a.store(dstA + i);
+		b.store(dstB + i);
+	}
+}
+
+/// Computes one output word from two input words for each word index, e.g. the value plane of a logic operation on fully defined signals.
+template<typename Op>
+void transform(std::uint64_t *dst, const std::uint64_t *srcA, const std::uint64_t *srcB, size_t numWords, Op op)
+{
+	size_t i = 0;
+	for (; i + SimdWords::NUM_WORDS <= numWords; i += SimdWords::NUM_WORDS)
+		op(SimdWords::load(srcA + i), SimdWords::load(srcB + i)).store(dst + i);
+	for (; i < numWords; i++)
+		op(ScalarWords::load(srcA + i), ScalarWords::load(srcB + i)).store(dst + i);
+}
+
+inline void copy(std::uint64_t *dst, const std::uint64_t *src, size_t numWords)
+{
+	size_t i = 0;
+	for (; i + SimdWords::NUM_WORDS <= numWords; i += SimdWords::NUM_WORDS)
+		SimdWords::load(src + i).store(dst + i);
+	for (; i < numWords; i++)
+		dst[i] = src[i];
+}
+
+inline void fill(std::uint64_t *dst, std::uint64_t content, size_t numWords)
+{
+	size_t i = 0;
+	SimdWords c = SimdWords::broadcast(content);
+	for (; i + SimdWords::NUM_WORDS <= numWords; i += SimdWords::NUM_WORDS)
+		c.store(dst + i);
+	for (; i < numWords; i++)
+		dst[i] = content;
+}
+
+inline bool equal(const std::uint64_t *a, const std::uint64_t *b, size_t numWords)
+{
+	size_t i = 0;
+	for (; i + SimdWords::NUM_WORDS <= numWords; i += SimdWords::NUM_WORDS)
+		if (!(SimdWords::load(a + i) ^ SimdWords::load(b + i)).isZero())
+			return false;
+	for (; i < numWords; i++)
+		if (a[i] != b[i])
+			return false;
+	return true;
+}
+
+/// Returns true if the defined planes are equal and the value planes are equal wherever they are defined.
+inline bool equalOnDefined(const std::uint64_t *aValue, const std::uint64_t *aDefined, const std::uint64_t *bValue, const std::uint64_t *bDefined, size_t numWords)
+{
+	size_t i = 0;
+	for (; i + SimdWords::NUM_WORDS <= numWords; i += SimdWords::NUM_WORDS) {
+		SimdWords aD = SimdWords::load(aDefined + i);
+		SimdWords differences = (aD ^ SimdWords::load(bDefined + i)) | ((SimdWords::load(aValue + i) ^ SimdWords::load(bValue + i)) & aD);
+		if (!differences.isZero())
+			return false;
+	}
+	for (; i < numWords; i++)
+		if ((aDefined[i] ^ bDefined[i]) | ((aValue[i] ^ bValue[i]) & aDefined[i]))
+			return false;
+	return true;
+}
+
+/// Returns the index of the most significant word in which a and b differ or ~0ull if they are equal.
+inline size_t findLastDifference(const std::uint64_t *a, const std::uint64_t *b, size_t numWords)
+{
+	size_t i = numWords;
+	for (; i >= SimdWords::NUM_WORDS; i -= SimdWords::NUM_WORDS)
+		if (!(SimdWords::load(a + i - SimdWords::NUM_WORDS) ^ SimdWords::load(b + i - SimdWords::NUM_WORDS)).isZero())
+			break;
+	while (i > 0) {
+		i--;
+		if (a[i] != b[i])
+			return i;
+	}
+	return ~0ull;
+}
+
+/// Accumulates src into dst as undefined selections do: Bits only stay defined if they are defined in both and their values agree.
+inline void mergeUndefinedSelection(std::uint64_t *dstValue, std::uint64_t *dstDefined, const std::uint64_t *srcValue, const std::uint64_t *srcDefined, size_t numWords)
+{
+	size_t i = 0;
+	for (; i + SimdWords::NUM_WORDS <= numWords; i += SimdWords::NUM_WORDS) {
+		SimdWords d = SimdWords::load(dstDefined + i) & SimdWords::load(srcDefined + i) & ~(SimdWords::load(dstValue + i) ^ SimdWords::load(srcValue + i));
+		d.store(dstDefined + i);
+	}
+	for (; i < numWords; i++)
+		dstDefined[i] &= srcDefined[i] & ~(dstValue[i] ^ srcValue[i]);
+}
+
+/// Computes dst = a + b + carry over numWords words and returns the outgoing carry. dst may alias a or b.
+inline bool add(std::uint64_t *dst, const std::uint64_t *a, const std::uint64_t *b, size_t numWords, bool carry = false)
+{
+#ifdef GTRY_KERNELS_ADDCARRY
+	unsigned char c = carry ? 1 : 0;
+	for (size_t i = 0; i < numWords; i++) {
+		unsigned long long sum;
+		c = _addcarry_u64(c, a[i], b[i], &sum);
+		dst[i] = sum;
+	}
+	return c != 0;
+#else
+	for (size_t i = 0; i < numWords; i++) {
+		std::uint64_t sum = a[i] + b[i];
+		bool nextCarry = sum < a[i];
+		sum += carry ? 1 : 0;
+		nextCarry |= carry && sum == 0;
+		dst[i] = sum;
+		carry = nextCarry;
+	}
+	return carry;
+#endif
+}
+
+/// Computes dst = a - b - borrow over numWords words and returns the outgoing borrow. dst may alias a or b.
+inline bool sub(std::uint64_t *dst, const std::uint64_t *a, const std::uint64_t *b, size_t numWords, bool borrow = false)
+{
+#ifdef GTRY_KERNELS_ADDCARRY
+	unsigned char c = borrow ? 1 : 0;
+	for (size_t i = 0; i < numWords; i++) {
+		unsigned long long diff;
+		c = _subborrow_u64(c, a[i], b[i], &diff);
+		dst[i] = diff;
+	}
+	return c != 0;
+#else
+	for (size_t i = 0; i < numWords; i++) {
+		std::uint64_t diff = a[i] - b[i];
+		bool nextBorrow = a[i] < b[i];
+		nextBorrow |= borrow && diff == 0;
+		diff -= borrow ? 1 : 0;
+		dst[i] = diff;
+		borrow = nextBorrow;
+	}
+	return borrow;
+#endif
+}
+
+}
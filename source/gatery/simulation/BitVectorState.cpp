@@ -79,6 +79,19 @@ ExtendedBitVectorState createExtendedBitVectorState(std::size_t bitWidth, const
 	return state;
 }
 
+ExtendedBitVectorState createExtendedBitVectorState(std::size_t bitWidth, std::uint64_t value, std::uint64_t defined)
+{
+	HCL_ASSERT(bitWidth <= 64);
+
+	BitVectorState<ExtendedConfig> state;
+	state.resize(bitWidth);
+	state.clearRange(ExtendedConfig::DONT_CARE, 0, bitWidth);
+	state.clearRange(ExtendedConfig::HIGH_IMPEDANCE, 0, bitWidth);
+	state.insert(ExtendedConfig::VALUE, 0, bitWidth, value);
+	state.insert(ExtendedConfig::DEFINED, 0, bitWidth, defined);
+	return state;
+}
+
 bool operator==(const DefaultBitVectorState &lhs, std::span<const std::byte> rhs)
 {
 	if (lhs.size() != rhs.size() * 8)
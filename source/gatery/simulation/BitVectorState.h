@@ -22,6 +22,8 @@
 #include "../utils/BitManipulation.h"
 #include "../utils/Range.h"
 
+#include "BitVectorKernels.h"
+
 #include <boost/multiprecision/cpp_int.hpp>
 
 #include <vector>
@@ -333,17 +335,31 @@ bool canBeReplacedWith(const BitVectorState<Config> &vecA, const BitVectorState<
 template<typename Config>
 void mergeUndefinedSelection(BitVectorState<Config> &dst, size_t startDst, const BitVectorState<Config> &src, size_t startSrc, size_t size) {
 
-	/// @todo: optimize
+	if (startDst % Config::NUM_BITS_PER_BLOCK == 0 && startSrc % Config::NUM_BITS_PER_BLOCK == 0 && size >= Config::NUM_BITS_PER_BLOCK) {
+		size_t words = size / Config::NUM_BITS_PER_BLOCK;
+		kernels::mergeUndefinedSelection(
+			dst.data(Config::VALUE) + startDst / Config::NUM_BITS_PER_BLOCK, dst.data(Config::DEFINED) + startDst / Config::NUM_BITS_PER_BLOCK,
+			src.data(Config::VALUE) + startSrc / Config::NUM_BITS_PER_BLOCK, src.data(Config::DEFINED) + startSrc / Config::NUM_BITS_PER_BLOCK,
+			words);
 
-	for (size_t i = 0; i < size; i++) {
-		bool aDef = dst.get(Config::DEFINED, startDst+i);
-		// If the destination is undefined it stays undefined
-		if (aDef) {
-			bool bDef = src.get(Config::DEFINED, startSrc+i);
-			// Otherwise the destination becomes undefined if the src is undefined or the values differ.
-			if (!bDef || dst.get(Config::VALUE, startDst+i) != src.get(Config::VALUE, startSrc+i))
-				dst.set(Config::DEFINED, startDst+i, false);
-		}
+		startDst += words * Config::NUM_BITS_PER_BLOCK;
+		startSrc += words * Config::NUM_BITS_PER_BLOCK;
+		size -= words * Config::NUM_BITS_PER_BLOCK;
+	}
+
+	size_t offset = 0;
+	while (offset < size) {
+		size_t chunkSize = std::min<size_t>(Config::NUM_BITS_PER_BLOCK, size-offset);
+
+		auto dstValue = dst.extract(Config::VALUE, startDst + offset, chunkSize);
+		auto dstDefined = dst.extract(Config::DEFINED, startDst + offset, chunkSize);
+		auto srcValue = src.extract(Config::VALUE, startSrc + offset, chunkSize);
+		auto srcDefined = src.extract(Config::DEFINED, startSrc + offset, chunkSize);
+
+		// Bits become undefined if the src is undefined or the values differ.
+		dst.insert(Config::DEFINED, startDst + offset, chunkSize, dstDefined & srcDefined & ~(dstValue ^ srcValue));
+
+		offset += chunkSize;
 	}
 }
 
@@ -588,6 +604,8 @@ DefaultBitVectorState createDefinedRandomDefaultBitVectorState(std::size_t bitWi
 
 ExtendedBitVectorState createExtendedBitVectorState(std::size_t bitWidth, const void *data);
 inline ExtendedBitVectorState createExtendedBitVectorState(std::span<const std::byte> data) { return createExtendedBitVectorState(data.size() * 8, data.data()); }
+/// Creates a state of up to 64 bits from a value and a defined mask, without don't care or high impedance bits.
+ExtendedBitVectorState createExtendedBitVectorState(std::size_t bitWidth, std::uint64_t value, std::uint64_t defined);
 
 bool operator==(const DefaultBitVectorState &lhs, std::span<const std::byte> rhs);
 inline bool operator!=(const DefaultBitVectorState &lhs, std::span<const std::byte> rhs) { return !(lhs == rhs); }
@@ -670,8 +688,7 @@ void BitVectorState<Config>::setRange(typename Config::Plane plane, size_t offse
 	}
 
 	size_t numFullWords = (size - firstWordSize) / Config::NUM_BITS_PER_BLOCK;
-	for (auto i : utils::Range(numFullWords))
-		m_values[plane][wordOffset + i] = content;
+	kernels::fill(m_values[plane].data() + wordOffset, content, numFullWords);
 
 
 	size_t trailingWordSize = (size - firstWordSize) % Config::NUM_BITS_PER_BLOCK;
@@ -694,7 +711,15 @@ void BitVectorState<Config>::clearRange(typename Config::Plane plane, size_t off
 template<class Config>
 void BitVectorState<Config>::copyRange(size_t dstOffset, const BitVectorState<Config> &src, size_t srcOffset, size_t size)
 {
-	if (srcOffset % 8 == 0 && dstOffset % 8 == 0 && size >= 8) {
+	if (srcOffset % Config::NUM_BITS_PER_BLOCK == 0 && dstOffset % Config::NUM_BITS_PER_BLOCK == 0 && size >= Config::NUM_BITS_PER_BLOCK) {
+		size_t words = size / Config::NUM_BITS_PER_BLOCK;
+		for (auto i : utils::Range<size_t>(Config::NUM_PLANES))
+			kernels::copy(data((typename Config::Plane) i) + dstOffset / Config::NUM_BITS_PER_BLOCK, src.data((typename Config::Plane) i) + srcOffset / Config::NUM_BITS_PER_BLOCK, words);
+
+		dstOffset += words * Config::NUM_BITS_PER_BLOCK;
+		srcOffset += words * Config::NUM_BITS_PER_BLOCK;
+		size -= words * Config::NUM_BITS_PER_BLOCK;
+	} else if (srcOffset % 8 == 0 && dstOffset % 8 == 0 && size >= 8) {
 		size_t bytes = size / 8;
 		for (auto i : utils::Range<size_t>(Config::NUM_PLANES))
 			memcpy((char*) data((typename Config::Plane) i) + dstOffset/8, (const char*) src.data((typename Config::Plane) i) + srcOffset/8, bytes);
@@ -752,6 +777,19 @@ bool BitVectorState<Config>::compareRange(size_t dstOffset, const BitVectorState
 template<>
 inline bool BitVectorState<DefaultConfig>::compareRange(size_t dstOffset, const BitVectorState<DefaultConfig> &src, size_t srcOffset, size_t size) const
 {
+	if (srcOffset % DefaultConfig::NUM_BITS_PER_BLOCK == 0 && dstOffset % DefaultConfig::NUM_BITS_PER_BLOCK == 0 && size >= DefaultConfig::NUM_BITS_PER_BLOCK) {
+		size_t words = size / DefaultConfig::NUM_BITS_PER_BLOCK;
+		if (!kernels::equalOnDefined(
+				src.data(DefaultConfig::VALUE) + srcOffset / DefaultConfig::NUM_BITS_PER_BLOCK, src.data(DefaultConfig::DEFINED) + srcOffset / DefaultConfig::NUM_BITS_PER_BLOCK,
+				data(DefaultConfig::VALUE) + dstOffset / DefaultConfig::NUM_BITS_PER_BLOCK, data(DefaultConfig::DEFINED) + dstOffset / DefaultConfig::NUM_BITS_PER_BLOCK,
+				words))
+			return false;
+
+		dstOffset += words * DefaultConfig::NUM_BITS_PER_BLOCK;
+		srcOffset += words * DefaultConfig::NUM_BITS_PER_BLOCK;
+		size -= words * DefaultConfig::NUM_BITS_PER_BLOCK;
+	}
+
 	size_t width = size;
 	size_t offset = 0;
 	while (offset < width) {
@@ -0,0 +1,536 @@
+/*  This file is part of Gatery, a library for circuit design.
+	Copyright (C) 2021 Michael Offel, Andreas Ley
+
+	Gatery is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 3 of the License, or (at your option) any later version.
+
+	Gatery is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include "gatery/pch.h"
+#include "CompiledSimulator.h"
+
+#include "../debug/DebugInterface.h"
+#include "../utils/Range.h"
+#include "../utils/BitManipulation.h"
+#include "../hlim/coreNodes/Node_Arithmetic.h"
+#include "../hlim/coreNodes/Node_Compare.h"
+#include "../hlim/coreNodes/Node_Logic.h"
+#include "../hlim/coreNodes/Node_Multiplexer.h"
+#include "../hlim/coreNodes/Node_Register.h"
+
+#include <boost/process.hpp>
+
+#include <atomic>
+#include <sstream>
+
+#ifndef _WIN32
+#include <dlfcn.h>
+#endif
+
+namespace gtry::sim {
+
+namespace bp = boost::process;
+
+namespace {
+
+const char *generatedPrelude = R"(
+#include <cstdint>
+#include <cstddef>
+
+#ifdef _WIN32
+#define GTRY_EXPORT extern "C" __declspec(dllexport)
+#else
+#define GTRY_EXPORT extern "C" __attribute__((visibility("default")))
+#endif
+
+typedef std::uint64_t u64;
+typedef void (*gtry_Fallback)(void *context, std::size_t step);
+typedef void (*gtry_Block)(u64 *V, u64 *D, gtry_Fallback fallback, void *context);
+
+static inline u64 gtry_get(const u64 *plane, std::size_t word, unsigned shift, u64 mask) { return (plane[word] >> shift) & mask; }
+static inline void gtry_put(u64 *plane, std::size_t word, unsigned shift, u64 mask, u64 value) { plane[word] = (plane[word] & ~(mask << shift)) | ((value & mask) << shift); }
+
+)";
+
+/// Mask of the lower width bits as a C++ literal.
+std::string maskLiteral(size_t width)
+{
+	return (boost::format("0x%xull") % utils::bitMaskRange<std::uint64_t>(0, width)).str();
+}
+
+/// Expression reading width bits at the given offset of a plane ("V" or "D").
+std::string read(const char *plane, size_t offset, size_t width)
+{
+	return (boost::format("gtry_get(%s, %d, %d, %s)") % plane % (offset / 64) % (offset % 64) % maskLiteral(width)).str();
+}
+
+/// Statement writing width bits at the given offset of a plane ("V" or "D").
+std::string write(const char *plane, size_t offset, size_t width, std::string_view value)
+{
+	return (boost::format("gtry_put(%s, %d, %d, %s, %s);") % plane % (offset / 64) % (offset % 64) % maskLiteral(width) % value).str();
+}
+
+/// Statements copying both planes from one offset to another.
+std::string copy(size_t dstOffset, size_t srcOffset, size_t width)
+{
+	return write("V", dstOffset, width, read("V", srcOffset, width)) + " " + write("D", dstOffset, width, read("D", srcOffset, width));
+}
+
+bool emitLogic(std::ostream &out, const hlim::Node_Logic *node, const MappedNode &step)
+{
+	size_t width = node->getOutputConnectionType(0).width;
+	if (step.outputs[0] == ~0ull)
+		return false;
+
+	auto operand = [&](size_t input, const char *plane, size_t offset, size_t chunkSize) -> std::string {
+		if (input >= node->getNumInputPorts() || node->getDriver(input).node == nullptr || step.inputs[input] == ~0ull)
+			return "0";
+		return read(plane, step.inputs[input] + offset, chunkSize);
+	};
+
+	// Same chunking as Node_Logic::simulateEvaluate
+	for (size_t offset = 0; offset < width; offset += 64) {
+		size_t chunkSize = std::min<size_t>(64, width - offset);
+
+		out << "\t{\n";
+		out << "\t\tu64 l = " << operand(0, "V", offset, chunkSize) << ", ld = " << operand(0, "D", offset, chunkSize) << ";\n";
+		if (node->getOp() != hlim::Node_Logic::NOT)
+			out << "\t\tu64 r = " << operand(1, "V", offset, chunkSize) << ", rd = " << operand(1, "D", offset, chunkSize) << ";\n";
+
+		const char *value;
+		const char *defined;
+		switch (node->getOp()) {
+			case hlim::Node_Logic::AND:
+				value = "l & r";
+				defined = "(ld & ~l) | (rd & ~r) | (ld & rd)";
+			break;
+			case hlim::Node_Logic::NAND:
+				value = "~(l & r)";
+				defined = "(ld & ~l) | (rd & ~r) | (ld & rd)";
+			break;
+			case hlim::Node_Logic::OR:
+				value = "l | r";
+				defined = "(ld & l) | (rd & r) | (ld & rd)";
+			break;
+			case hlim::Node_Logic::NOR:
+				value = "~(l | r)";
+				defined = "(ld & l) | (rd & r) | (ld & rd)";
+			break;
+			case hlim::Node_Logic::XOR:
+				value = "l ^ r";
+				defined = "ld & rd";
+			break;
+			case hlim::Node_Logic::EQ:
+				value = "~(l ^ r)";
+				defined = "ld & rd";
+			break;
+			case hlim::Node_Logic::NOT:
+				value = "~l";
+				defined = "ld";
+			break;
+			default:
+				return false;
+		}
+
+		out << "\t\t" << write("V", step.outputs[0] + offset, chunkSize, value) << '\n';
+		out << "\t\t" << write("D", step.outputs[0] + offset, chunkSize, defined) << '\n';
+		out << "\t}\n";
+	}
+	return true;
+}
+
+bool emitArithmetic(std::ostream &out, const hlim::Node_Arithmetic *node, const MappedNode &step)
+{
+	const auto &outputType = node->getOutputConnectionType(0);
+	if (step.outputs[0] == ~0ull || !outputType.isBitVec() || outputType.width == 0 || outputType.width > 64)
+		return false;
+
+	const char *op;
+	switch (node->getOp()) {
+		case hlim::Node_Arithmetic::ADD: op = "+="; break;
+		case hlim::Node_Arithmetic::SUB: op = "-="; break;
+		case hlim::Node_Arithmetic::MUL: op = "*="; break;
+		default:
+			return false;
+	}
+
+	std::vector<size_t> inputWidths;
+	for (auto i : utils::Range(node->getNumInputPorts())) {
+		auto driver = node->getDriver(i);
+		if (driver.node == nullptr || step.inputs[i] == ~0ull) {
+			out << '\t' << write("D", step.outputs[0], outputType.width, "0") << '\n';
+			return true;
+		}
+		size_t width = hlim::getOutputConnectionType(driver).width;
+		if (width == 0 || width > 64)
+			return false;
+		inputWidths.push_back(width);
+	}
+	if (inputWidths.empty())
+		return false;
+
+	out << "\tif (";
+	for (auto i : utils::Range(inputWidths.size())) {
+		if (i > 0) out << " && ";
+		out << read("D", step.inputs[i], inputWidths[i]) << " == " << maskLiteral(inputWidths[i]);
+	}
+	out << ") {\n";
+	out << "\t\tu64 result = " << read("V", step.inputs[0], inputWidths[0]) << ";\n";
+	for (auto i : utils::Range<size_t>(1, inputWidths.size()))
+		out << "\t\tresult " << op << ' ' << read("V", step.inputs[i], inputWidths[i]) << ";\n";
+	out << "\t\t" << write("V", step.outputs[0], outputType.width, "result") << '\n';
+	out << "\t\t" << write("D", step.outputs[0], outputType.width, "~0ull") << '\n';
+	out << "\t} else\n";
+	out << "\t\t" << write("D", step.outputs[0], outputType.width, "0") << '\n';
+	return true;
+}
+
+bool emitCompare(std::ostream &out, const hlim::Node_Compare *node, const MappedNode &step)
+{
+	const auto &outputType = node->getOutputConnectionType(0);
+	if (step.outputs[0] == ~0ull || outputType.width != 1)
+		return false;
+
+	auto leftDriver = node->getDriver(0);
+	auto rightDriver = node->getDriver(1);
+	if (leftDriver.node == nullptr || rightDriver.node == nullptr) {
+		out << '\t' << write("D", step.outputs[0], 1, "0") << '\n';
+		return true;
+	}
+
+	const auto &leftType = hlim::getOutputConnectionType(leftDriver);
+	const auto &rightType = hlim::getOutputConnectionType(rightDriver);
+	if (leftType.type != rightType.type)
+		return false;
+	if (leftType.width == 0 || leftType.width > 64 || rightType.width == 0 || rightType.width > 64)
+		return false;
+
+	if (step.inputs[0] == ~0ull || step.inputs[1] == ~0ull) {
+		out << '\t' << write("D", step.outputs[0], 1, "0") << '\n';
+		return true;
+	}
+
+	const char *op;
+	switch (node->getOp()) {
+		case hlim::Node_Compare::EQ: op = "=="; break;
+		case hlim::Node_Compare::NEQ: op = "!="; break;
+		case hlim::Node_Compare::LT: op = "<"; break;
+		case hlim::Node_Compare::GT: op = ">"; break;
+		case hlim::Node_Compare::LEQ: op = "<="; break;
+		case hlim::Node_Compare::GEQ: op = ">="; break;
+		default:
+			return false;
+	}
+	if (!leftType.isBitVec() && node->getOp() != hlim::Node_Compare::EQ && node->getOp() != hlim::Node_Compare::NEQ)
+		return false;
+
+	out << "\tif (" << read("D", step.inputs[0], leftType.width) << " == " << maskLiteral(leftType.width)
+		<< " && " << read("D", step.inputs[1], rightType.width) << " == " << maskLiteral(rightType.width) << ") {\n";
+	out << "\t\t" << write("V", step.outputs[0], 1, (boost::format("%s %s %s") % read("V", step.inputs[0], leftType.width) % op % read("V", step.inputs[1], rightType.width)).str()) << '\n';
+	out << "\t\t" << write("D", step.outputs[0], 1, "1") << '\n';
+	out << "\t} else\n";
+	out << "\t\t" << write("D", step.outputs[0], 1, "0") << '\n';
+	return true;
+}
+
+bool emitMultiplexer(std::ostream &out, const hlim::Node_Multiplexer *node, const MappedNode &step, size_t stepIdx)
+{
+	size_t width = node->getOutputConnectionType(0).width;
+	if (step.outputs[0] == ~0ull || width == 0 || width > 64)
+		return false;
+
+	if (step.inputs[0] == ~0ull) {
+		out << '\t' << write("D", step.outputs[0], width, "0") << '\n';
+		return true;
+	}
+
+	size_t selectorWidth = hlim::getOutputConnectionType(node->getDriver(0)).width;
+	if (selectorWidth == 0 || selectorWidth >= 64)
+		return false;
+
+	// Fully defined selectors copy the chosen input, all others are handled by the interpreter.
+	out << "\tif (" << read("D", step.inputs[0], selectorWidth) << " == " << maskLiteral(selectorWidth) << ") {\n";
+	out << "\t\tswitch (" << read("V", step.inputs[0], selectorWidth) << ") {\n";
+	for (auto i : utils::Range<size_t>(1, node->getNumInputPorts())) {
+		out << "\t\t\tcase " << i-1 << ": ";
+		if (step.inputs[i] == ~0ull)
+			out << write("D", step.outputs[0], width, "0");
+		else
+			out << copy(step.outputs[0], step.inputs[i], width);
+		out << " break;\n";
+	}
+	out << "\t\t\tdefault: " << write("D", step.outputs[0], width, "0") << '\n';
+	out << "\t\t}\n";
+	out << "\t} else\n";
+	out << "\t\tfallback(context, " << stepIdx << ");\n";
+	return true;
+}
+
+bool emitRegister(std::ostream &out, const hlim::Node_Register *node, const MappedNode &step)
+{
+	size_t width = node->getOutputConnectionType(0).width;
+	if (width == 0 || width > 64)
+		return false;
+
+	size_t dataOffset = step.internal[hlim::Node_Register::INT_DATA];
+	size_t enableOffset = step.internal[hlim::Node_Register::INT_ENABLE];
+	if (dataOffset == ~0ull || enableOffset == ~0ull)
+		return false;
+
+	if (step.inputs[hlim::Node_Register::DATA] == ~0ull)
+		out << '\t' << write("D", dataOffset, width, "0") << '\n';
+	else
+		out << '\t' << copy(dataOffset, step.inputs[hlim::Node_Register::DATA], width) << '\n';
+
+	if (step.inputs[hlim::Node_Register::ENABLE] == ~0ull)
+		out << '\t' << write("V", enableOffset, 1, "1") << ' ' << write("D", enableOffset, 1, "1") << '\n';
+	else
+		out << '\t' << copy(enableOffset, step.inputs[hlim::Node_Register::ENABLE], 1) << '\n';
+	return true;
+}
+
+/// Emits the code evaluating a step and returns true, or returns false if the step has to be evaluated by the interpreter.
+bool emitStep(std::ostream &out, const MappedNode &step, size_t stepIdx)
+{
+	if (auto *logic = dynamic_cast<const hlim::Node_Logic*>(step.node))
+		return emitLogic(out, logic, step);
+	if (auto *arithmetic = dynamic_cast<const hlim::Node_Arithmetic*>(step.node))
+		return emitArithmetic(out, arithmetic, step);
+	if (auto *compare = dynamic_cast<const hlim::Node_Compare*>(step.node))
+		return emitCompare(out, compare, step);
+	if (auto *mux = dynamic_cast<const hlim::Node_Multiplexer*>(step.node))
+		return emitMultiplexer(out, mux, step, stepIdx);
+	if (auto *reg = dynamic_cast<const hlim::Node_Register*>(step.node))
+		return emitRegister(out, reg, step);
+	return false;
+}
+
+}
+
+CompiledSimulator::CompiledSimulator(bool enableConsoleOutput) : CompiledSimulator(enableConsoleOutput, Config{})
+{
+}
+
+CompiledSimulator::CompiledSimulator(bool enableConsoleOutput, Config config) : ReferenceSimulator(enableConsoleOutput), m_config(std::move(config))
+{
+}
+
+CompiledSimulator::~CompiledSimulator()
+{
+	unloadLibrary();
+}
+
+void CompiledSimulator::compileProgram(const hlim::Circuit &circuit, const utils::StableSet<hlim::NodePort> &outputs, const CompileOptions &options)
+{
+	unloadLibrary();
+	ReferenceSimulator::compileProgram(circuit, outputs, options);
+
+	// Activity driven evaluation skips individual steps and batched instances need their own state pointers, neither of which the generated code supports.
+	if (options.activityDrivenEvaluation || options.batchSize > 1)
+		return;
+
+	if (!compileAndLoad(generateSource()))
+		m_numCompiledNodes = 0;
+}
+
+void CompiledSimulator::evaluateExecutionBlock(size_t blockIdx, size_t thread, bool concurrent)
+{
+	if (m_blockFunctions == nullptr) {
+		ReferenceSimulator::evaluateExecutionBlock(blockIdx, thread, concurrent);
+		return;
+	}
+
+	FallbackContext context{ this, &m_program->m_executionBlocks[blockIdx] };
+	m_blockFunctions[blockIdx](
+		m_dataState.signalState.data(DefaultConfig::VALUE),
+		m_dataState.signalState.data(DefaultConfig::DEFINED),
+		&CompiledSimulator::evaluateFallback,
+		&context
+	);
+	m_numNodeEvaluations.fetch_add(m_program->m_executionBlocks[blockIdx].getNumSteps(), std::memory_order_relaxed);
+}
+
+void CompiledSimulator::evaluateFallback(void *context, size_t step)
+{
+	auto &fallbackContext = *static_cast<FallbackContext*>(context);
+	auto &simulator = *fallbackContext.simulator;
+	const auto &mappedNode = fallbackContext.block->getStep(step);
+
+	auto perfHandle = simulator.m_performanceCounters.processNode(mappedNode.node);
+	mappedNode.node->simulateEvaluate(simulator.m_callbackDispatcher, simulator.m_dataState.signalState, mappedNode.internal.data(), mappedNode.inputs.data(), mappedNode.outputs.data());
+}
+
+std::string CompiledSimulator::generateSource()
+{
+	m_numCompiledNodes = 0;
+
+	std::stringstream source;
+	source << "// Generated by gatery, do not edit.\n" << generatedPrelude;
+
+	for (const auto &block : m_program->m_executionBlocks) {
+		source << "static void gtry_block_" << block.getIndex() << "(u64 *V, u64 *D, gtry_Fallback fallback, void *context)\n{\n";
+		for (auto i : utils::Range(block.getNumSteps())) {
+			const auto &step = block.getStep(i);
+			source << "\t// " << step.node->getTypeName() << " (id " << step.node->getId() << ")\n";
+			if (emitStep(source, step, i))
+				m_numCompiledNodes++;
+			else
+				source << "\tfallback(context, " << i << ");\n";
+		}
+		source << "}\n\n";
+	}
+
+	source << "GTRY_EXPORT const gtry_Block gtry_blocks[] = {\n";
+	for (const auto &block : m_program->m_executionBlocks)
+		source << "\t&gtry_block_" << block.getIndex() << ",\n";
+	source << "\tnullptr\n};\n";
+
+	return source.str();
+}
+
+bool CompiledSimulator::compileAndLoad(const std::string &source)
+{
+	std::string toolchain = '"' + m_config.compiler + '"';
+	for (const auto &arg : m_config.compilerArguments)
+		toolchain += " \"" + arg + '"';
+	toolchain += " \"" + m_config.outputOption + '"';
+
+	size_t hash = std::hash<std::string>{}(toolchain + '\n' + source);
+	std::string name = (boost::format("gtry_sim_%016x") % hash).str();
+
+#ifdef _WIN32
+	const char *libraryExtension = ".dll";
+#else
+	const char *libraryExtension = ".so";
+#endif
+
+	// The toolchain is stored with the source so that a cached library is only reused for the exact same input.
+	std::string cacheKey = "// " + toolchain + "\n" + source;
+
+	auto sourcePath = m_config.cacheDirectory / (name + ".cpp");
+	auto libraryPath = m_config.cacheDirectory / (name + libraryExtension);
+
+	auto logWarning = [](const std::string &msg) {
+		dbg::log(dbg::LogMessage{} << dbg::LogMessage::LOG_WARNING << dbg::LogMessage::LOG_POSTPROCESSING << msg);
+	};
+
+	std::error_code error;
+
+	bool cached = false;
+	if (std::filesystem::exists(libraryPath, error)) {
+		std::ifstream file(sourcePath.string().c_str(), std::fstream::binary);
+		std::string cachedSource((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		cached = file && cachedSource == cacheKey;
+	}
+
+	if (cached)
+		return loadLibrary(libraryPath);
+
+	std::filesystem::create_directories(m_config.cacheDirectory, error);
+
+	// Compile into files of this process and simulator first, so that concurrently running simulations (in this or other processes)
+	// never overwrite each other's files or load a partially written library.
+	static std::atomic<size_t> nextUniqueId = 0;
+	std::string uniqueName = (boost::format("%s.%d.%d") % name % boost::this_process::get_id() % nextUniqueId++).str();
+	auto temporarySourcePath = m_config.cacheDirectory / (uniqueName + ".cpp");
+	auto temporaryLibraryPath = m_config.cacheDirectory / (uniqueName + libraryExtension);
+
+	{
+		std::ofstream file(temporarySourcePath.string().c_str(), std::fstream::binary);
+		file << cacheKey;
+		if (!file) {
+			logWarning("Could not write generated simulation code to " + temporarySourcePath.string() + ", falling back to interpreted simulation.");
+			return false;
+		}
+	}
+
+	int exitCode = -1;
+	try {
+		boost::filesystem::path compiler = m_config.compiler;
+		if (!compiler.has_parent_path())
+			compiler = bp::search_path(m_config.compiler);
+		if (!compiler.empty())
+			exitCode = bp::system(compiler, bp::args(m_config.compilerArguments), temporarySourcePath.string(), m_config.outputOption, temporaryLibraryPath.string());
+	} catch (const bp::process_error &e) {
+		logWarning(std::string("Could not run the compiler for the generated simulation code: ") + e.what());
+	}
+
+	if (exitCode != 0) {
+		logWarning("Compiling the generated simulation code " + temporarySourcePath.string() + " with " + m_config.compiler + " failed, falling back to interpreted simulation.");
+		std::filesystem::remove(temporarySourcePath, error);
+		std::filesystem::remove(temporaryLibraryPath, error);
+		return false;
+	}
+
+	// Load the library that was just compiled, before publishing it, so that it can not be exchanged by other processes in between.
+	bool loaded = loadLibrary(temporaryLibraryPath);
+
+	// Publish the source before the library, a library with a mismatching source is simply recompiled.
+	std::filesystem::rename(temporarySourcePath, sourcePath, error);
+	if (!error)
+		std::filesystem::rename(temporaryLibraryPath, libraryPath, error);
+	if (error) {
+		std::filesystem::remove(temporarySourcePath, error);
+#ifndef _WIN32
+		// Windows does not allow removing loaded libraries, they stay behind in the cache directory.
+		std::filesystem::remove(temporaryLibraryPath, error);
+#endif
+	}
+
+	return loaded;
+}
+
+bool CompiledSimulator::loadLibrary(const std::filesystem::path &libraryPath)
+{
+	auto logWarning = [](const std::string &msg) {
+		dbg::log(dbg::LogMessage{} << dbg::LogMessage::LOG_WARNING << dbg::LogMessage::LOG_POSTPROCESSING << msg);
+	};
+
+#ifdef _WIN32
+	HMODULE library = LoadLibraryA(libraryPath.string().c_str());
+	if (library == nullptr) {
+		logWarning("Could not load the compiled simulation code from " + libraryPath.string() + ", falling back to interpreted simulation.");
+		return false;
+	}
+	m_library = library;
+	m_blockFunctions = reinterpret_cast<const BlockFunction*>(GetProcAddress(library, "gtry_blocks"));
+#else
+	m_library = dlopen(libraryPath.string().c_str(), RTLD_NOW | RTLD_LOCAL);
+	if (m_library == nullptr) {
+		logWarning("Could not load the compiled simulation code from " + libraryPath.string() + " (" + dlerror() + "), falling back to interpreted simulation.");
+		return false;
+	}
+	m_blockFunctions = reinterpret_cast<const BlockFunction*>(dlsym(m_library, "gtry_blocks"));
+#endif
+
+	if (m_blockFunctions == nullptr) {
+		logWarning("The compiled simulation code in " + libraryPath.string() + " lacks the execution blocks, falling back to interpreted simulation.");
+		unloadLibrary();
+		return false;
+	}
+	return true;
+}
+
+void CompiledSimulator::unloadLibrary()
+{
+	m_blockFunctions = nullptr;
+	if (m_library == nullptr)
+		return;
+#ifdef _WIN32
+	FreeLibrary(static_cast<HMODULE>(m_library));
+#else
+	dlclose(m_library);
+#endif
+	m_library = nullptr;
+}
+
+}
@@ -0,0 +1,104 @@
+/*  This file is part of Gatery, a library for circuit design.
+	Copyright (C) 2021 Michael Offel, Andreas Ley
+
+	Gatery is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 3 of the License, or (at your option) any later version.
+
+	Gatery is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#pragma once
+
+#include "ReferenceSimulator.h"
+
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace gtry::sim {
+
+/**
+ * @brief Simulator that translates the execution blocks of the circuit into C++, compiles them with the system compiler, and loads the result as a shared library.
+ * @details The generated code accesses the signal state at fixed offsets and evaluates the common nodes (logic, arithmetic, comparisons, multiplexers, registers)
+ * of up to 64 bits without virtual dispatch. All other nodes as well as all clocked events, simulation processes, and the activity driven evaluation mode are
+ * handled by the ReferenceSimulator this is derived from.
+ * Compiled libraries are cached by the hash of the generated code next to the code itself, so rerunning the same circuit skips the compilation.
+ * If the compilation fails, a warning is logged and the circuit is interpreted as in the ReferenceSimulator.
+ */
+class CompiledSimulator : public ReferenceSimulator
+{
+	public:
+		struct Config {
+			/// Compiler executable, searched for in the PATH unless it is given with a path.
+			std::string compiler =
+#ifdef _WIN32
+				"cl";
+#else
+				"c++";
+#endif
+			/// Arguments to compile a C++ source file into a shared library. The source file is appended, followed by the output option and the output file.
+			std::vector<std::string> compilerArguments = {
+#ifdef _WIN32
+				"/nologo", "/O2", "/LD"
+#else
+				"-O2", "-shared", "-fPIC"
+#endif
+			};
+			/// Option of the compiler that directly precedes the name of the output file.
+			std::string outputOption =
+#ifdef _WIN32
+				"/Fe:";
+#else
+				"-o";
+#endif
+			/// Directory in which the generated sources and compiled libraries are kept for reuse.
+			std::filesystem::path cacheDirectory = std::filesystem::temp_directory_path() / "gatery_compiled_sim";
+		};
+
+		CompiledSimulator(bool enableConsoleOutput = true);
+		CompiledSimulator(bool enableConsoleOutput, Config config);
+		virtual ~CompiledSimulator();
+
+		virtual void compileProgram(const hlim::Circuit &circuit, const utils::StableSet<hlim::NodePort> &outputs = {}, const CompileOptions &options = {}) override;
+
+		/// Whether the last compileProgram resulted in compiled code being used for evaluation.
+		inline bool isCompiled() const { return m_blockFunctions != nullptr; }
+		/// Number of nodes that are evaluated by the generated code (as opposed to calling back into the interpreter).
+		inline size_t getNumCompiledNodes() const { return m_numCompiledNodes; }
+	protected:
+		/// Signature of the callback through which the generated code evaluates steps it can not handle itself.
+		using FallbackFunction = void(*)(void *context, size_t step);
+		/// Signature of the generated function evaluating one execution block.
+		using BlockFunction = void(*)(std::uint64_t *value, std::uint64_t *defined, FallbackFunction fallback, void *context);
+
+		Config m_config;
+		void *m_library = nullptr;
+		const BlockFunction *m_blockFunctions = nullptr;
+		size_t m_numCompiledNodes = 0;
+
+		virtual void evaluateExecutionBlock(size_t blockIdx, size_t thread, bool concurrent) override;
+
+		/// Generates the C++ source for all execution blocks of m_program.
+		std::string generateSource();
+		/// Compiles the source (or reuses a previously compiled library) and loads it. Returns false on failure.
+		bool compileAndLoad(const std::string &source);
+		bool loadLibrary(const std::filesystem::path &libraryPath);
+		void unloadLibrary();
+
+		struct FallbackContext {
+			CompiledSimulator *simulator;
+			const ExecutionBlock *block;
+		};
+		static void evaluateFallback(void *context, size_t step);
+};
+
+}
@@ -0,0 +1,181 @@
+/*  This file is part of Gatery, a library for circuit design.
+	Copyright (C) 2021 Michael Offel, Andreas Ley
+
+	Gatery is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 3 of the License, or (at your option) any later version.
+
+	Gatery is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include "gatery/pch.h"
+#include "EventQueue.h"
+#include "../utils/Exceptions.h"
+#include "../utils/Preprocessor.h"
+
+#include <bit>
+
+namespace gtry::sim {
+
+void EventQueue::setTickDuration(const hlim::ClockRational &tickDuration)
+{
+	std::vector<Event> events;
+	while (!empty()) {
+		events.push_back(top());
+		pop();
+	}
+	clear();
+
+	m_tickDuration = tickDuration;
+
+	for (auto &e : events) {
+		e.tick = ~0ull;
+		push(std::move(e));
+	}
+}
+
+std::uint64_t EventQueue::toTicks(const hlim::ClockRational &time) const
+{
+	if (m_tickDuration.numerator() == 0)
+		return ~0ull;
+
+	auto ticks = time / m_tickDuration;
+	if (ticks.denominator() != 1)
+		return ~0ull;
+
+	return ticks.numerator();
+}
+
+void EventQueue::push(Event event)
+{
+	if (!m_current.empty()) {
+		if (event.timeOfEvent == m_currentTime) {
+			m_current.push(std::move(event));
+			return;
+		}
+		if (hlim::clockLess(event.timeOfEvent, m_currentTime)) {
+			// The queue already moved on to a later time, which can only happen if nothing was left for the current simulation time.
+			// Hand the events of that later time back so that they get picked up again after the new event.
+			while (!m_current.empty()) {
+				m_far.push(m_current.top());
+				m_current.pop();
+			}
+		}
+	}
+
+	if (event.tick == ~0ull)
+		event.tick = toTicks(event.timeOfEvent);
+
+	if (!insertIntoWheel(event))
+		m_far.push(std::move(event));
+}
+
+void EventQueue::clear()
+{
+	for (auto &level : m_levels) {
+		for (auto &slot : level.slots)
+			slot.clear();
+		level.occupied = 0;
+	}
+	m_numWheelEvents = 0;
+	m_now = 0;
+
+	while (!m_far.empty())
+		m_far.pop();
+	while (!m_current.empty())
+		m_current.pop();
+}
+
+bool EventQueue::insertIntoWheel(Event &event)
+{
+	if (event.tick == ~0ull || event.tick < m_now)
+		return false;
+
+	std::uint64_t differingBits = event.tick ^ m_now;
+	size_t level = differingBits == 0 ? 0 : (std::bit_width(differingBits) - 1) / SLOT_BITS;
+	if (level >= NUM_LEVELS)
+		return false;
+
+	size_t slot = (event.tick >> (level * SLOT_BITS)) & (NUM_SLOTS-1);
+	m_levels[level].slots[slot].push_back(std::move(event));
+	m_levels[level].occupied |= 1ull << slot;
+	m_numWheelEvents++;
+	return true;
+}
+
+std::optional<std::uint64_t> EventQueue::findEarliestTick()
+{
+	if (m_numWheelEvents == 0)
+		return {};
+
+	while (true) {
+		std::uint64_t occupied = m_levels[0].occupied & (~0ull << (m_now & (NUM_SLOTS-1)));
+		if (occupied)
+			return (m_now & ~std::uint64_t(NUM_SLOTS-1)) | std::countr_zero(occupied);
+
+		bool cascaded = false;
+		for (size_t level = 1; level < NUM_LEVELS && !cascaded; level++) {
+			size_t shift = level * SLOT_BITS;
+			size_t currentSlot = (m_now >> shift) & (NUM_SLOTS-1);
+			if (currentSlot+1 == NUM_SLOTS) continue;
+
+			// Events of this level always lie in later slots than m_now.
+			occupied = m_levels[level].occupied & (~0ull << (currentSlot+1));
+			if (!occupied) continue;
+
+			// Advance to the start of the earliest slot and redistribute its events among the lower levels.
+			size_t slot = std::countr_zero(occupied);
+			m_now = ((m_now >> (shift + SLOT_BITS)) << (shift + SLOT_BITS)) | (std::uint64_t(slot) << shift);
+
+			m_cascadeScratch.swap(m_levels[level].slots[slot]);
+			m_levels[level].occupied &= ~(1ull << slot);
+			m_numWheelEvents -= m_cascadeScratch.size();
+			for (auto &e : m_cascadeScratch) {
+				bool inserted = insertIntoWheel(e);
+				HCL_ASSERT(inserted);
+			}
+			m_cascadeScratch.clear();
+			cascaded = true;
+		}
+		HCL_ASSERT(cascaded);
+	}
+}
+
+void EventQueue::refill()
+{
+	if (!m_current.empty()) return;
+
+	if (auto tick = findEarliestTick()) {
+		size_t slotIdx = *tick & (NUM_SLOTS-1);
+		auto &slot = m_levels[0].slots[slotIdx];
+		const auto &time = slot.front().timeOfEvent;
+		if (m_far.empty() || !hlim::clockMore(time, m_far.top().timeOfEvent)) {
+			m_now = *tick;
+			m_currentTime = time;
+			for (auto &e : slot)
+				m_current.push(std::move(e));
+			m_numWheelEvents -= slot.size();
+			slot.clear();
+			m_levels[0].occupied &= ~(1ull << slotIdx);
+		}
+	}
+
+	if (m_current.empty()) {
+		if (m_far.empty()) return;
+		m_currentTime = m_far.top().timeOfEvent;
+	}
+
+	while (!m_far.empty() && m_far.top().timeOfEvent == m_currentTime) {
+		m_current.push(m_far.top());
+		m_far.pop();
+	}
+}
+
+}
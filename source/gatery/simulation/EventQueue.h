@@ -0,0 +1,137 @@
+/*  This file is part of Gatery, a library for circuit design.
+	Copyright (C) 2021 Michael Offel, Andreas Ley
+
+	Gatery is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 3 of the License, or (at your option) any later version.
+
+	Gatery is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#pragma once
+
+#include "simProc/WaitClock.h"
+#include "../hlim/ClockRational.h"
+
+#include <array>
+#include <vector>
+#include <queue>
+#include <variant>
+#include <optional>
+#include <coroutine>
+#include <cstdint>
+
+namespace gtry::sim {
+
+struct Event {
+	enum class Type {
+		clockPinTrigger,
+		simProcResume,
+		clockValueChange,
+		resetValueChange,
+	};
+	Type type = Type::clockPinTrigger;
+	hlim::ClockRational timeOfEvent = {0};
+	/// timeOfEvent in multiples of the tick duration of the EventQueue, or ~0ull to let the EventQueue determine it.
+	std::uint64_t tick = ~0ull;
+	size_t microTick = 0;
+	WaitClock::TimingPhase timingPhase = WaitClock::DURING;
+
+	struct ClockValueChangeEvt {
+		size_t clockPinIdx = ~0ull;
+		bool risingEdge = false;
+	};
+	struct ResetValueChangeEvt {
+		size_t resetPinIdx = ~0ull;
+		bool newResetHigh = false;
+	};
+	struct SimProcResumeEvt {
+		std::coroutine_handle<> handle;
+		std::uint64_t insertionId = ~0ull;
+		size_t batchIndex = 0;
+	};
+
+	std::variant<ClockValueChangeEvt, ResetValueChangeEvt, SimProcResumeEvt> data = ClockValueChangeEvt{};
+
+	template<typename T>
+	T &evt() { return std::get<T>(data); }
+	template<typename T>
+	const T &evt() const { return std::get<T>(data); }
+
+	bool operator<(const Event &rhs) const {
+		if (hlim::clockMore(timeOfEvent, rhs.timeOfEvent)) return true;
+		if (hlim::clockLess(timeOfEvent, rhs.timeOfEvent)) return false;
+		if (timingPhase > rhs.timingPhase) return true;
+		if (timingPhase < rhs.timingPhase) return false;
+		if (microTick > rhs.microTick) return true;
+		if (microTick < rhs.microTick) return false;
+		if ((unsigned)type > (unsigned) rhs.type) return true; // fibers before clocks
+		if ((unsigned)type < (unsigned)rhs.type) return false; // fibers before clocks
+		if (type == Type::simProcResume)
+			return evt<SimProcResumeEvt>().insertionId > rhs.evt<SimProcResumeEvt>().insertionId;
+		return false;
+	}
+};
+
+/**
+ * @brief Queue of pending simulation events, ordered like a priority queue of Events.
+ * @details Time is counted in integer ticks whose duration evenly divides the half periods of all simulated clocks. Events
+ * on ticks within 2^24 ticks of the current tick are bucketed in a hierarchical timing wheel, which makes pushing them
+ * constant time and avoids rational number comparisons. All events of the earliest time are then moved to a small priority
+ * queue which establishes the order within the time step (timing phase, micro tick, insertion order).
+ * Events that do not fall on a tick (e.g. WaitFor with an odd duration) or lie too far in the future go to a regular priority queue.
+ */
+class EventQueue
+{
+	public:
+		/// Sets the duration of one tick. Zero disables the timing wheel. Events already in the queue are redistributed.
+		void setTickDuration(const hlim::ClockRational &tickDuration);
+		inline const hlim::ClockRational &getTickDuration() const { return m_tickDuration; }
+		/// Returns the given time in ticks or ~0ull if it is not a multiple of the tick duration.
+		std::uint64_t toTicks(const hlim::ClockRational &time) const;
+
+		void push(Event event);
+		inline bool empty() { refill(); return m_current.empty(); }
+		inline const Event &top() { refill(); return m_current.top(); }
+		inline void pop() { refill(); m_current.pop(); }
+		void clear();
+	protected:
+		enum {
+			SLOT_BITS = 6,
+			NUM_SLOTS = 1 << SLOT_BITS,
+			NUM_LEVELS = 4,
+		};
+		struct Level {
+			/// Bit mask of all non empty slots.
+			std::uint64_t occupied = 0;
+			std::array<std::vector<Event>, NUM_SLOTS> slots;
+		};
+
+		hlim::ClockRational m_tickDuration = {0};
+		/// All events in the wheel are at or after this tick. Level l holds events whose tick first differs from m_now in the l-th group of SLOT_BITS bits.
+		std::uint64_t m_now = 0;
+		std::array<Level, NUM_LEVELS> m_levels;
+		size_t m_numWheelEvents = 0;
+		std::vector<Event> m_cascadeScratch;
+
+		/// Events not on a tick or beyond the range of the wheel.
+		std::priority_queue<Event> m_far;
+		/// All events of m_currentTime, the earliest time in the queue.
+		std::priority_queue<Event> m_current;
+		hlim::ClockRational m_currentTime = {0};
+
+		bool insertIntoWheel(Event &event);
+		/// Returns the earliest tick in the wheel, cascading events from the higher levels down to the first level as needed.
+		std::optional<std::uint64_t> findEarliestTick();
+		/// Moves all events of the earliest time to m_current if it is empty.
+		void refill();
+};
+
+}
@@ -36,7 +36,9 @@
 #include "../hlim/supportNodes/Node_External.h"
 #include "../hlim/NodeVisitor.h"
 #include "../hlim/supportNodes/Node_ExportOverride.h"
+#include "../hlim/supportNodes/Node_SignalTap.h"
 #include "../hlim/Subnet.h"
+#include "../hlim/GraphSnapshot.h"
 
 #include <gatery/export/DotExport.h>
 
@@ -48,17 +50,39 @@
 
 #include <chrono>
 #include <iostream>
+#include <numeric>
+#include <queue>
+#include <cstring>
 
 #include <immintrin.h>
 
 namespace gtry::sim {
 
 
+void ExecutionBlock::evaluateBatch(SimulatorCallbacks &simCallbacks, std::span<DataState* const> instances, SimulatorPerformanceCounters &performanceCounters) const
+{
+	SimulatorPerformanceCounters::Scope perf(performanceCounters);
+	for (const auto &step : m_steps) {
+		perf.enter(step.node);
+		for (auto *state : instances)
+			step.node->simulateEvaluate(simCallbacks, state->signalState, step.internal.data(), step.inputs.data(), step.outputs.data());
+	}
+}
+
 void ExecutionBlock::evaluate(SimulatorCallbacks &simCallbacks, DataState &state, SimulatorPerformanceCounters &performanceCounters) const
 {
+	SimulatorPerformanceCounters::Scope perf(performanceCounters);
+	if (!state.fullyDefinedSteps.empty()) {
+		for (auto i : utils::Range(m_steps.size())) {
+			perf.enter(m_steps[i].node);
+			evaluateStep(i, simCallbacks, state);
+		}
+		return;
+	}
+
 #if 1
 	for (const auto &step : m_steps) {
-		auto perfHandle = performanceCounters.processNode(step.node);
+		perf.enter(step.node);
 		step.node->simulateEvaluate(simCallbacks, state.signalState, step.internal.data(), step.inputs.data(), step.outputs.data());
 	}
 #else
@@ -75,17 +99,274 @@ void ExecutionBlock::evaluate(SimulatorCallbacks &simCallbacks, DataState &state
 #endif
 }
 
+namespace {
+
+/// Returns the index of the first set bit at or after start, or ~0ull if there is none.
+size_t findNextActiveStep(const std::vector<std::uint64_t> &activeSteps, size_t start)
+{
+	size_t word = start / 64;
+	if (word >= activeSteps.size())
+		return ~0ull;
+
+	std::uint64_t bits = activeSteps[word] & (~0ull << (start % 64));
+	while (bits == 0) {
+		if (++word >= activeSteps.size())
+			return ~0ull;
+		bits = activeSteps[word];
+	}
+	return word * 64 + std::countr_zero(bits);
+}
+
+/// Marks a step for reevaluation, atomically if other threads may be marking steps in the same words.
+void markStepActive(DataState &state, StepLocation location, bool concurrent)
+{
+	std::uint64_t &word = state.activeSteps[location.executionBlock][location.step / 64];
+	std::uint64_t mask = 1ull << (location.step % 64);
+	if (concurrent)
+		std::atomic_ref<std::uint64_t>(word).fetch_or(mask, std::memory_order_relaxed);
+	else
+		word |= mask;
+}
+
+}
+
+size_t ExecutionBlock::evaluateActive(SimulatorCallbacks &simCallbacks, DataState &state, DefaultBitVectorState &scratch, bool concurrent, SimulatorPerformanceCounters &performanceCounters) const
+{
+	// Other execution blocks only mark steps of this block before it starts (they are dependencies of this block), so the own bits need no synchronization.
+	auto &activeSteps = state.activeSteps[m_index];
+
+	SimulatorPerformanceCounters::Scope perf(performanceCounters);
+	size_t numEvaluated = 0;
+	// Steps are topologically sorted, so readers of changed outputs are always further down the list and get picked up in the same pass.
+	for (size_t i = findNextActiveStep(activeSteps, 0); i < m_steps.size(); i = findNextActiveStep(activeSteps, i+1)) {
+		utils::bitClear(activeSteps.data(), i);
+
+		const auto &step = m_steps[i];
+		captureOutputs(i, state, scratch);
+		perf.enter(step.node);
+		evaluateStep(i, simCallbacks, state);
+		markChangedOutputs(i, state, scratch, concurrent);
+		numEvaluated++;
+	}
+	return numEvaluated;
+}
+
 void ExecutionBlock::commitState(SimulatorCallbacks &simCallbacks, DataState &state, SimulatorPerformanceCounters &performanceCounters) const
 {
+	SimulatorPerformanceCounters::Scope perf(performanceCounters);
 	for (const auto &step : m_steps) {
-		auto perfHandle = performanceCounters.processNode(step.node);
+		perf.enter(step.node);
 		step.node->simulateCommit(simCallbacks, state.signalState, step.internal.data(), step.inputs.data());
 	}
 }
 
 void ExecutionBlock::addStep(MappedNode mappedNode)
 {
+	if (m_steps.size() % 64 == 0)
+		m_definedEvaluationSteps.push_back(0);
+	if (mappedNode.node->hasSimulateEvaluateDefined())
+		utils::bitSet(m_definedEvaluationSteps.data(), m_steps.size());
+
 	m_steps.push_back(mappedNode);
+	m_definedness.emplace_back();
+}
+
+void ExecutionBlock::resolveInputDefinedness(size_t stepIdx, const std::vector<hlim::NodePort> &drivers, const utils::UnstableMap<hlim::NodePort, StepLocation> &producerOfOutput)
+{
+	const auto &step = m_steps[stepIdx];
+	auto &definedness = m_definedness[stepIdx];
+	definedness = {};
+
+	for (auto i : utils::Range(drivers.size())) {
+		// Unconnected inputs are undefined, so the step can never be evaluated value-only.
+		if (drivers[i].node == nullptr || step.inputs[i] == ~0ull) {
+			utils::bitClear(m_definedEvaluationSteps.data(), stepIdx);
+			continue;
+		}
+
+		auto it = producerOfOutput.find(drivers[i]);
+		if (it != producerOfOutput.end()) {
+			if (std::find(definedness.producers.begin(), definedness.producers.end(), it->second) == definedness.producers.end())
+				definedness.producers.push_back(it->second);
+		} else
+			definedness.otherInputs.push_back({ step.inputs[i], hlim::getOutputConnectionType(drivers[i]).width });
+	}
+
+	for (auto i : utils::Range(step.outputs.size()))
+		definedness.outputWidths.push_back(step.node->getOutputConnectionType(i).width);
+}
+
+void ExecutionBlock::evaluateStep(size_t stepIdx, SimulatorCallbacks &simCallbacks, DataState &state) const
+{
+	const auto &step = m_steps[stepIdx];
+	if (state.fullyDefinedSteps.empty()) {
+		step.node->simulateEvaluate(simCallbacks, state.signalState, step.internal.data(), step.inputs.data(), step.outputs.data());
+		return;
+	}
+
+	// Only the thread evaluating this block accesses its bits.
+	auto &fullyDefinedSteps = state.fullyDefinedSteps[m_index];
+	auto &definedOutputSteps = state.definedOutputSteps[m_index];
+	if (utils::bitExtract(fullyDefinedSteps.data(), stepIdx)) {
+		// The outputs are only written by this step and are still fully defined, but undefined values can reach the inputs at any time,
+		// e.g. from uninitialized registers, conflicting drivers, or nodes without a value-only kernel.
+		if (inputsFullyDefined(stepIdx, state)) {
+			// The outputs stay fully defined, so the bit in definedOutputSteps remains valid.
+			step.node->simulateEvaluateDefined(simCallbacks, state.signalState, step.internal.data(), step.inputs.data(), step.outputs.data());
+			return;
+		}
+		utils::bitClear(fullyDefinedSteps.data(), stepIdx);
+	}
+
+	step.node->simulateEvaluate(simCallbacks, state.signalState, step.internal.data(), step.inputs.data(), step.outputs.data());
+
+	// Only the regular evaluation can write undefined bits, so this is the only place where the definedness of the outputs needs to be updated.
+	if (!outputsFullyDefined(stepIdx, state)) {
+		utils::bitClear(definedOutputSteps.data(), stepIdx);
+		return;
+	}
+	utils::bitSet(definedOutputSteps.data(), stepIdx);
+
+	if (hasDefinedEvaluation(stepIdx) && inputsFullyDefined(stepIdx, state))
+		utils::bitSet(fullyDefinedSteps.data(), stepIdx);
+}
+
+bool ExecutionBlock::inputsFullyDefined(size_t stepIdx, const DataState &state) const
+{
+	const auto &definedness = m_definedness[stepIdx];
+	// Producers are in this block before this step or in blocks this one depends on, so their bits are final.
+	for (const auto &producer : definedness.producers)
+		if (!utils::bitExtract(state.definedOutputSteps[producer.executionBlock].data(), producer.step))
+			return false;
+
+	for (const auto &[offset, width] : definedness.otherInputs)
+		if (!allDefined(state.signalState, offset, width))
+			return false;
+	return true;
+}
+
+bool ExecutionBlock::outputsFullyDefined(size_t stepIdx, const DataState &state) const
+{
+	const auto &step = m_steps[stepIdx];
+	const auto &definedness = m_definedness[stepIdx];
+	for (auto i : utils::Range(step.outputs.size()))
+		if (!allDefined(state.signalState, step.outputs[i], definedness.outputWidths[i]))
+			return false;
+	return true;
+}
+
+void ExecutionBlock::collectAccesses(AccessMap &readersOfOffset, AccessMap &accessorsOfInternal) const
+{
+	for (auto i : utils::Range(m_steps.size())) {
+		const auto &step = m_steps[i];
+		StepLocation location = { .executionBlock = m_index, .step = i };
+
+		for (auto offset : step.inputs)
+			if (offset != ~0ull) {
+				auto &readers = readersOfOffset[offset];
+				if (readers.empty() || readers.back() != location)
+					readers.push_back(location);
+			}
+
+		// Only non-empty internal state can be shared, empty ones may alias arbitrary offsets.
+		auto internalSizes = step.node->getInternalStateSizes();
+		auto referencedInternals = step.node->getReferencedInternalStateSizes();
+		for (auto j : utils::Range(step.internal.size())) {
+			if (step.internal[j] == ~0ull) continue;
+
+			size_t size;
+			if (j < internalSizes.size())
+				size = internalSizes[j];
+			else {
+				const auto &ref = referencedInternals[j - internalSizes.size()];
+				size = ref.first->getInternalStateSizes()[ref.second];
+			}
+
+			if (size > 0)
+				accessorsOfInternal[step.internal[j]].push_back(location);
+		}
+	}
+}
+
+void ExecutionBlock::buildFanOut(const AccessMap &readersOfOffset, const AccessMap &accessorsOfInternal)
+{
+	m_fanOut.clear();
+	m_fanOut.resize(m_steps.size());
+	m_outputScratchSize = 0;
+
+	for (auto i : utils::Range(m_steps.size())) {
+		const auto &step = m_steps[i];
+		auto &fanOut = m_fanOut[i];
+		StepLocation location = { .executionBlock = m_index, .step = i };
+
+		size_t scratchSize = 0;
+		for (auto j : utils::Range(step.node->getNumOutputPorts())) {
+			size_t width = step.node->getOutputConnectionType(j).width;
+			fanOut.outputWidths.push_back(width);
+			scratchSize += (width + 63) / 64 * 64;
+		}
+		m_outputScratchSize = std::max(m_outputScratchSize, scratchSize);
+
+		for (auto j : utils::Range(step.outputs.size())) {
+			if (fanOut.outputWidths[j] == 0) continue;
+			auto it = readersOfOffset.find(step.outputs[j]);
+			if (it != readersOfOffset.end())
+				for (auto reader : it->second)
+					if (reader != location) // Feedback loops on external nodes
+						fanOut.outputReaders.push_back(reader);
+		}
+
+		for (auto offset : step.internal) {
+			auto it = accessorsOfInternal.find(offset);
+			if (it != accessorsOfInternal.end() && it->second.size() > 1)
+				fanOut.internalSharers.insert(fanOut.internalSharers.end(), it->second.begin(), it->second.end());
+		}
+
+		for (auto *list : { &fanOut.outputReaders, &fanOut.internalSharers }) {
+			std::sort(list->begin(), list->end());
+			list->erase(std::unique(list->begin(), list->end()), list->end());
+		}
+	}
+}
+
+void ExecutionBlock::captureOutputs(size_t step, const DataState &state, DefaultBitVectorState &scratch) const
+{
+	const auto &outputs = m_steps[step].outputs;
+	const auto &widths = m_fanOut[step].outputWidths;
+
+	size_t scratchOffset = 0;
+	for (auto i : utils::Range(outputs.size())) {
+		scratch.copyRange(scratchOffset, state.signalState, outputs[i], widths[i]);
+		scratchOffset += (widths[i] + 63) / 64 * 64;
+	}
+}
+
+bool ExecutionBlock::markChangedOutputs(size_t step, DataState &state, const DefaultBitVectorState &scratch, bool concurrent) const
+{
+	const auto &outputs = m_steps[step].outputs;
+	const auto &widths = m_fanOut[step].outputWidths;
+
+	size_t scratchOffset = 0;
+	for (auto i : utils::Range(outputs.size())) {
+		if (!scratch.compareRange(scratchOffset, state.signalState, outputs[i], widths[i])) {
+			markOutputReaders(step, state, concurrent);
+			return true;
+		}
+		scratchOffset += (widths[i] + 63) / 64 * 64;
+	}
+	return false;
+}
+
+void ExecutionBlock::markOutputReaders(size_t step, DataState &state, bool concurrent) const
+{
+	for (auto reader : m_fanOut[step].outputReaders)
+		markStepActive(state, reader, concurrent);
+}
+
+void ExecutionBlock::markInternalSharers(size_t step, DataState &state, bool concurrent) const
+{
+	for (auto sharer : m_fanOut[step].internalSharers)
+		markStepActive(state, sharer, concurrent);
 }
 
 ClockedNode::ClockedNode(MappedNode mappedNode, size_t clockPort) : m_mappedNode(std::move(mappedNode)), m_clockPort(clockPort)
@@ -123,6 +404,21 @@ void Program::allocateClocks(const hlim::Circuit &circuit, const hlim::Subnet &n
 		HCL_ASSERT_HINT(m_clockSources[i].pin->isSelfDriven(true, true), "Simulating logic driven clocks is not yet implemented!");
 	}
 
+	// Choose the tick of the event queue such that all clock edges fall on ticks.
+	m_tickDuration = 0;
+	for (auto &clkSource : m_clockSources) {
+		clkSource.halfPeriod = hlim::ClockRational(1,2) / clkSource.pin->absoluteFrequency();
+		if (m_tickDuration.numerator() == 0)
+			m_tickDuration = clkSource.halfPeriod;
+		else
+			m_tickDuration = hlim::ClockRational(
+				std::gcd(m_tickDuration.numerator(), clkSource.halfPeriod.numerator()),
+				std::lcm(m_tickDuration.denominator(), clkSource.halfPeriod.denominator())
+			);
+	}
+	for (auto &clkSource : m_clockSources)
+		clkSource.halfPeriodTicks = hlim::floor(clkSource.halfPeriod / m_tickDuration);
+
 	for (auto i : utils::Range(m_resetSources.size())) {
 		m_resetSources[i].pin = m_stateMapping.clockPinAllocation.resetPins[i].source;
 		HCL_ASSERT_HINT(m_resetSources[i].pin->isSelfDriven(true, false), "Simulating logic driven clock resets is not yet implemented!");
@@ -132,6 +428,7 @@ void Program::allocateClocks(const hlim::Circuit &circuit, const hlim::Subnet &n
 		auto clk = p.first;
 		auto clkSrcIdx = p.second;
 		auto &clkDom = m_clockDomains[clk];
+		clkDom.index = m_clockDomains.size()-1;
 		clkDom.clock = clk;
 		clkDom.clockSourceIdx = clkSrcIdx;
 		m_clockSources[clkSrcIdx].domains.push_back(&clkDom);
@@ -144,120 +441,223 @@ void Program::allocateClocks(const hlim::Circuit &circuit, const hlim::Subnet &n
 	}
 }
 
-void Program::compileProgram(const hlim::Circuit &circuit, const hlim::Subnet &nodes, SimulatorPerformanceCounters &performanceCounters)
+namespace {
+
+/// Accumulates the inputs of Program::compileProgram to recognize identical compilations.
+struct ProgramHasher
 {
-	auto perfHandle = performanceCounters.processOther(SimulatorPerformanceCounters::Other::COMPILATION);
+	std::uint64_t hash = 0;
 
-	allocateSignals(circuit, nodes);
-	allocateClocks(circuit, nodes);
+	void add(std::uint64_t value) { hash ^= std::hash<std::uint64_t>{}(value) + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2); }
+	void add(const hlim::ClockRational &value) { add(value.numerator()); add(value.denominator()); }
+};
 
-	utils::UnstableSet<hlim::BaseNode*> subnetToConsider(nodes.begin(), nodes.end());
+}
 
-	utils::UnstableSet<hlim::NodePort> outputsReady;
-	   
-	utils::StableSet<hlim::BaseNode*> nodesRemaining;
+Program::CompilationKey Program::compilationKey(const hlim::Subnet &nodes, bool buildFanOut, size_t numThreads, StateLayout stateLayout)
+{
+	std::vector<hlim::BaseNode*> sortedNodes(nodes.begin(), nodes.end());
+	std::sort(sortedNodes.begin(), sortedNodes.end(), [](hlim::BaseNode *lhs, hlim::BaseNode *rhs) { return lhs->getId() < rhs->getId(); });
 
-	for (auto node : nodes) {
-		if (node->allOutputsForwarded() && !node->hasSideEffects()) continue;
-		if (dynamic_cast<hlim::Node_ExportOverride*>(node) != nullptr) continue;
-		nodesRemaining.insert(node);
+	CompilationKey key;
+	key.add(buildFanOut);
+	key.add(numThreads);
+	key.add((std::uint64_t) stateLayout);
 
+	std::vector<hlim::Clock*> clocks;
+	for (auto *node : sortedNodes) {
+		// The program refers to the nodes themselves, so it can only be shared for the very same nodes.
+		key.add((std::uintptr_t) node);
+		key.add(node->getId());
+		key.add(std::type_index(typeid(*node)).hash_code());
 
-		MappedNode mappedNode;
-		mappedNode.node = node;
-		mappedNode.internal = m_stateMapping.nodeToInternalOffset[node];
 		for (auto i : utils::Range(node->getNumInputPorts())) {
-			auto driver = node->getNonForwardingDriver(i);
-			auto it = m_stateMapping.outputToOffset.find(driver);
-			if (it != m_stateMapping.outputToOffset.end())
-				mappedNode.inputs.push_back(it->second);
-			else
-				mappedNode.inputs.push_back(~0ull);
+			auto driver = node->getDriver(i);
+			key.add((std::uintptr_t) driver.node);
+			key.add(driver.port);
 		}
 		for (auto i : utils::Range(node->getNumOutputPorts())) {
-			auto it = m_stateMapping.outputToOffset.find({.node = node, .port = i});
-			HCL_ASSERT(it != m_stateMapping.outputToOffset.end());
-			mappedNode.outputs.push_back(it->second);
+			const auto &type = node->getOutputConnectionType(i);
+			key.add((std::uint64_t) type.type);
+			key.add(type.width);
+		}
+		for (auto size : node->getInternalStateSizes())
+			key.add(size);
+		for (auto *clock : node->getClocks()) {
+			key.add((std::uintptr_t) clock);
+			if (clock != nullptr)
+				clocks.push_back(clock);
 		}
+	}
 
-		for (auto i : utils::Range(node->getNumOutputPorts())) {
+	// Clock and reset timings end up in the program as well
+	std::sort(clocks.begin(), clocks.end());
+	clocks.erase(std::unique(clocks.begin(), clocks.end()), clocks.end());
+	for (auto *clock : clocks) {
+		key.add((std::uintptr_t) clock);
+		key.add(clock->absoluteFrequency());
+		key.add((std::uint64_t) clock->getTriggerEvent());
+		key.add((std::uint64_t) clock->getRegAttribs().resetType);
+		key.add((std::uint64_t) clock->getRegAttribs().resetActive);
+		key.add(clock->getMinResetTime());
+		key.add(clock->getMinResetCycles());
+	}
 
-			switch (node->getOutputType(i)) {
-				case hlim::NodeIO::OUTPUT_IMMEDIATE:
-					// nothing
-				break;
-				case hlim::NodeIO::OUTPUT_CONSTANT: {
-					hlim::NodePort driver;
-					driver.node = node;
-					driver.port = i;
-					outputsReady.insert(driver);
-
-//					m_powerOnNodes.push_back(mappedNode);
-				} break;
-				case hlim::NodeIO::OUTPUT_LATCHED: {
-					hlim::NodePort driver;
-					driver.node = node;
-					driver.port = i;
-					outputsReady.insert(driver);
-
-//					m_powerOnNodes.push_back(mappedNode);
-				} break;
-			}
-		}
-		m_powerOnNodes.push_back(mappedNode); /// @todo now we do this to all nodes, needs to be found out by some other means
+	ProgramHasher hasher;
+	for (auto value : key.data)
+		hasher.add(value);
+	key.hash = hasher.hash;
+	return key;
+}
 
-		for (auto clockPort : utils::Range(node->getClocks().size())) {
-			if (node->getClocks()[clockPort] != nullptr) {
-				auto it = m_clockDomains.find(node->getClocks()[clockPort]);
-				HCL_ASSERT(it != m_clockDomains.end());
-				auto &clockDomain = it->second;
-				clockDomain.clockedNodes.push_back(ClockedNode(mappedNode, clockPort));
-				if (clockDomain.dependentExecutionBlocks.empty()) /// @todo only attach those that actually need to be recomputed
-					clockDomain.dependentExecutionBlocks.push_back(0ull);
-			}
-		}
+void Program::hashLayout()
+{
+	// The maps are unordered, so the offsets are hashed sorted by node id and port.
+	std::vector<std::array<std::uint64_t, 3>> offsets;
+	for (const auto &[output, offset] : m_stateMapping.outputToOffset.anyOrder())
+		if (output.node != nullptr)
+			offsets.push_back({ output.node->getId(), output.port, offset });
+	for (const auto &[node, internalOffsets] : m_stateMapping.nodeToInternalOffset.anyOrder())
+		for (auto i : utils::Range(internalOffsets.size()))
+			offsets.push_back({ node->getId(), ~0ull - i, internalOffsets[i] });
+	std::sort(offsets.begin(), offsets.end());
+
+	ProgramHasher hasher;
+	hasher.add(m_fullStateWidth);
+	for (const auto &offset : offsets)
+		for (auto value : offset)
+			hasher.add(value);
+	m_layoutHash = hasher.hash;
+}
+
+std::shared_ptr<const Program> Program::compileShared(const hlim::Circuit &circuit, const hlim::Subnet &nodes, SimulatorPerformanceCounters &performanceCounters, bool buildFanOut, size_t numThreads, StateLayout stateLayout)
+{
+	return findOrCompileShared(compilationKey(nodes, buildFanOut, numThreads, stateLayout), [&] {
+		auto program = std::make_shared<Program>();
+		program->compileProgram(circuit, nodes, performanceCounters, buildFanOut, numThreads, stateLayout);
+		return program;
+	});
+}
+
+std::shared_ptr<const Program> Program::findOrCompileShared(const CompilationKey &key, const std::function<std::shared_ptr<Program>()> &compile)
+{
+	static std::mutex mutex;
+	static std::map<std::uint64_t, std::vector<std::pair<CompilationKey, std::weak_ptr<const Program>>>> programs;
+
+	std::lock_guard lock(mutex);
+	for (auto it = programs.begin(); it != programs.end(); ) {
+		std::erase_if(it->second, [](const auto &p) { return p.second.expired(); });
+		if (it->second.empty())
+			it = programs.erase(it);
+		else
+			++it;
 	}
 
+	auto &bucket = programs[key.hash];
+	for (const auto &p : bucket)
+		if (p.first.data == key.data)
+			if (auto program = p.second.lock())
+				return program;
 
-	m_executionBlocks.push_back({});
-	ExecutionBlock &execBlock = m_executionBlocks.back();
+	auto program = compile();
+	bucket.emplace_back(key, program);
+	return program;
+}
 
-	std::vector<hlim::NodePort> readyNodeInputs;
-	while (!nodesRemaining.empty()) {
-		hlim::BaseNode *readyNode = nullptr;
-		for (auto node : nodesRemaining) {
-			bool allInputsReady = true;
-			readyNodeInputs.clear();
-			readyNodeInputs.resize(node->getNumInputPorts());
-			for (auto i : utils::Range(node->getNumInputPorts())) {
-				auto driver = node->getNonForwardingDriver(i);
-				{
-					utils::UnstableSet<hlim::NodePort> alreadyVisited;
-					while (dynamic_cast<hlim::Node_ExportOverride*>(driver.node)) { // Skip all export override nodes
-						alreadyVisited.insert(driver);
-						driver = driver.node->getNonForwardingDriver(hlim::Node_ExportOverride::SIM_INPUT);
-						if (alreadyVisited.contains(driver))
-							driver = {};
-					}
-				}
-				readyNodeInputs[i] = driver;
-				if (driver.node != nullptr && !outputsReady.contains(driver) && subnetToConsider.contains(driver.node)) {
+void Program::compileProgram(const hlim::Circuit &circuit, const hlim::Subnet &nodes, SimulatorPerformanceCounters &performanceCounters, bool buildFanOut, size_t numThreads, StateLayout stateLayout)
+{
+	auto perfHandle = performanceCounters.processOther(SimulatorPerformanceCounters::Other::COMPILATION);
 
-					// Allow feedback loops on external nodes
-					if (!dynamic_cast<hlim::Node_External*>(node) || driver.node != node) {
-						allInputsReady = false;
-						break;
-					}
+	// Unique across all programs, so that cached state offsets can not be mistaken for those of another program.
+	static std::atomic<size_t> nextProgramId = 1;
+	m_id = nextProgramId++;
+
+	hlim::GraphSnapshot graph(nodes);
+
+	std::vector<bool> isCandidate(graph.numNodes(), false);
+	std::vector<bool> isScheduled(graph.numNodes(), false);
+	size_t numRemaining = 0;
+
+	// All nodes with state, to be mapped once the signals are allocated.
+	std::vector<ScheduledNode> stateNodes;
+
+	for (auto node : nodes) {
+		if (node->allOutputsForwarded() && !node->hasSideEffects()) continue;
+		if (dynamic_cast<hlim::Node_ExportOverride*>(node) != nullptr) continue;
+		isCandidate[graph.getNodeIndex(node)] = true;
+		numRemaining++;
+
+		auto &stateNode = stateNodes.emplace_back(ScheduledNode{ .node = node });
+		for (auto i : utils::Range(node->getNumInputPorts()))
+			stateNode.inputs.push_back(node->getNonForwardingDriver(i));
+	}
+
+	// Latched and constant outputs are ready from the start, all others once their node is scheduled.
+	auto outputReady = [&](const hlim::NodePort &driver) {
+		auto nodeIdx = graph.getNodeIndex(driver.node);
+		if (nodeIdx == hlim::GraphSnapshot::INVALID || !isCandidate[nodeIdx]) return false;
+		return isScheduled[nodeIdx] || graph.getOutputType(graph.getOutput(nodeIdx, driver.port)) != hlim::NodeIO::OUTPUT_IMMEDIATE;
+	};
+
+	// Resolve the inputs of all nodes past export overrides and record on which other nodes they have to wait.
+	std::vector<std::vector<hlim::NodePort>> resolvedInputs(graph.numNodes());
+	std::vector<size_t> inputsPending(graph.numNodes(), 0);
+	std::vector<std::pair<std::uint32_t, std::uint32_t>> dependencies;
+	for (auto nodeIdx : utils::Range<std::uint32_t>((std::uint32_t) graph.numNodes())) {
+		if (!isCandidate[nodeIdx]) continue;
+		auto *node = graph.getNode(nodeIdx);
+
+		auto &inputs = resolvedInputs[nodeIdx];
+		inputs.resize(node->getNumInputPorts());
+		for (auto i : utils::Range(node->getNumInputPorts())) {
+			auto driver = node->getNonForwardingDriver(i);
+			{
+				utils::UnstableSet<hlim::NodePort> alreadyVisited;
+				while (dynamic_cast<hlim::Node_ExportOverride*>(driver.node)) { // Skip all export override nodes
+					alreadyVisited.insert(driver);
+					driver = driver.node->getNonForwardingDriver(hlim::Node_ExportOverride::SIM_INPUT);
+					if (alreadyVisited.contains(driver))
+						driver = {};
 				}
 			}
+			inputs[i] = driver;
+			if (driver.node != nullptr && !outputReady(driver) && graph.getNodeIndex(driver.node) != hlim::GraphSnapshot::INVALID) {
 
-			if (allInputsReady) {
-				readyNode = node;
-				break;
+				// Allow feedback loops on external nodes
+				if (!dynamic_cast<hlim::Node_External*>(node) || driver.node != node) {
+					inputsPending[nodeIdx]++;
+					dependencies.push_back({ graph.getNodeIndex(driver.node), nodeIdx });
+				}
 			}
 		}
+	}
+
+	std::vector<std::uint32_t> dependentsOffset(graph.numNodes()+1, 0);
+	for (auto [driver, dependent] : dependencies)
+		dependentsOffset[driver+1]++;
+	std::partial_sum(dependentsOffset.begin(), dependentsOffset.end(), dependentsOffset.begin());
+	std::vector<std::uint32_t> dependents(dependencies.size());
+	{
+		auto nextDependent = dependentsOffset;
+		for (auto [driver, dependent] : dependencies)
+			dependents[nextDependent[driver]++] = dependent;
+	}
+
+	// Topologically sort all nodes for evaluation, always picking the ready node with the lowest id
+	std::vector<ScheduledNode> schedule;
+
+	std::priority_queue<std::uint32_t, std::vector<std::uint32_t>, std::greater<>> nodesReady;
+	for (auto nodeIdx : utils::Range<std::uint32_t>((std::uint32_t) graph.numNodes()))
+		if (isCandidate[nodeIdx] && inputsPending[nodeIdx] == 0)
+			nodesReady.push(nodeIdx);
+
+	while (numRemaining > 0) {
+		if (nodesReady.empty()) {
+			utils::StableSet<hlim::BaseNode*> nodesRemaining;
+			for (auto nodeIdx : utils::Range<std::uint32_t>((std::uint32_t) graph.numNodes()))
+				if (isCandidate[nodeIdx] && !isScheduled[nodeIdx])
+					nodesRemaining.insert(graph.getNode(nodeIdx));
 
-		if (readyNode == nullptr) {
 			std::cout << "nodesRemaining : " << nodesRemaining.size() << std::endl;
 
 			
@@ -306,7 +706,7 @@ void Program::compileProgram(const hlim::Circuit &circuit, const hlim::Subnet &n
 					auto driver = node->getNonForwardingDriver(i);
 					while (dynamic_cast<hlim::Node_ExportOverride*>(driver.node)) // Skip all export override nodes
 						driver = driver.node->getNonForwardingDriver(hlim::Node_ExportOverride::SIM_INPUT);
-					if (driver.node != nullptr && !outputsReady.contains(driver)) {
+					if (driver.node != nullptr && !outputReady(driver)) {
 						std::cout << "	Input " << i << " not ready." << std::endl;
 						std::cout << "		" << driver.node->getName() << "  " << driver.node->getTypeName() << "  " << std::hex << (size_t)driver.node << std::endl;
 					}
@@ -354,45 +754,313 @@ void Program::compileProgram(const hlim::Circuit &circuit, const hlim::Subnet &n
 			//}
 		}
 
-		HCL_DESIGNCHECK_HINT(readyNode != nullptr, "Cyclic dependency!");
+		HCL_DESIGNCHECK_HINT(!nodesReady.empty(), "Cyclic dependency!");
+
+		auto nodeIdx = nodesReady.top();
+		nodesReady.pop();
+		isScheduled[nodeIdx] = true;
+		numRemaining--;
+
+		schedule.push_back({ .node = graph.getNode(nodeIdx), .inputs = std::move(resolvedInputs[nodeIdx]) });
+
+		for (auto i : utils::Range(dependentsOffset[nodeIdx], dependentsOffset[nodeIdx+1]))
+			if (--inputsPending[dependents[i]] == 0)
+				nodesReady.push(dependents[i]);
+	}
+
+	std::vector<size_t> blockOfStep(schedule.size(), 0);
+	utils::UnstableMap<hlim::BaseNode*, AllocationGroup> allocationGroups;
+	m_executionBlockGraph = {};
+	if (numThreads > 1)
+		partitionExecutionBlocks(schedule, numThreads, blockOfStep, allocationGroups);
+
+	allocateSignals(circuit, nodes, schedule, allocationGroups, stateLayout);
+	hashLayout();
+	allocateClocks(circuit, nodes);
 
-		nodesRemaining.erase(readyNode);
+	for (const auto &stateNode : stateNodes) {
+		MappedNode mappedNode = mapNode(stateNode.node, stateNode.inputs);
+
+		m_powerOnNodes.push_back(mappedNode); /// @todo now we do this to all nodes, needs to be found out by some other means
+
+		for (auto clockPort : utils::Range(stateNode.node->getClocks().size())) {
+			if (stateNode.node->getClocks()[clockPort] != nullptr) {
+				auto it = m_clockDomains.find(stateNode.node->getClocks()[clockPort]);
+				HCL_ASSERT(it != m_clockDomains.end());
+				auto &clockDomain = it->second;
+				clockDomain.clockedNodes.push_back(ClockedNode(mappedNode, clockPort));
+				if (clockDomain.dependentExecutionBlocks.empty()) /// @todo only attach those that actually need to be recomputed
+					clockDomain.dependentExecutionBlocks.push_back(0ull);
+			}
+		}
+	}
+
+	size_t numExecutionBlocks = 1;
+	for (auto block : blockOfStep)
+		numExecutionBlocks = std::max(numExecutionBlocks, block+1);
+	for (auto i : utils::Range(numExecutionBlocks))
+		m_executionBlocks.emplace_back(i);
+
+	std::vector<StepLocation> locationOfStep(schedule.size());
+	for (auto i : utils::Range(schedule.size())) {
+		auto &block = m_executionBlocks[blockOfStep[i]];
+		locationOfStep[i] = { .executionBlock = blockOfStep[i], .step = block.getNumSteps() };
+		block.addStep(mapNode(schedule[i].node, schedule[i].inputs));
+	}
 
-		MappedNode mappedNode;
-		mappedNode.node = readyNode;
-		mappedNode.internal = m_stateMapping.nodeToInternalOffset[readyNode];
-		for (auto i : utils::Range(readyNode->getNumInputPorts())) {
-			auto driver = readyNodeInputs[i];
-			auto it = m_stateMapping.outputToOffset.find(driver);
-			if (it != m_stateMapping.outputToOffset.end())
-				mappedNode.inputs.push_back(it->second);
+	// For two-state evaluation, inputs written by the evaluation of combinatorial steps inherit the definedness tracked for those steps.
+	utils::UnstableMap<hlim::NodePort, StepLocation> producerOfOutput;
+	for (auto i : utils::Range(schedule.size()))
+		for (auto port : utils::Range(schedule[i].node->getNumOutputPorts()))
+			if (schedule[i].node->isCombinatorial(port))
+				producerOfOutput[{.node = schedule[i].node, .port = port}] = locationOfStep[i];
+	for (auto i : utils::Range(schedule.size()))
+		m_executionBlocks[locationOfStep[i].executionBlock].resolveInputDefinedness(locationOfStep[i].step, schedule[i].inputs, producerOfOutput);
+
+	if (numThreads > 1) {
+		for (auto &clkDom : m_clockDomains.anyOrder()) {
+			std::vector<std::vector<size_t>> advanceGroups(numThreads);
+			for (auto i : utils::Range(clkDom.second.clockedNodes.size()))
+				advanceGroups[allocationGroups[clkDom.second.clockedNodes[i].getMappedNode().node].advanceGroup].push_back(i);
+
+			std::erase_if(advanceGroups, [](const auto &group) { return group.empty(); });
+			if (advanceGroups.size() > 1)
+				clkDom.second.advanceGroups = std::move(advanceGroups);
+		}
+	}
+
+	if (buildFanOut) {
+		this->buildFanOut();
+
+		m_nodeToStep.clear();
+		for (auto blockIdx : utils::Range(m_executionBlocks.size())) {
+			auto &block = m_executionBlocks[blockIdx];
+			for (auto stepIdx : utils::Range(block.getNumSteps()))
+				m_nodeToStep[block.getStep(stepIdx).node] = { .executionBlock = blockIdx, .step = stepIdx };
+		}
+
+		for (auto &clkDom : m_clockDomains.anyOrder())
+			for (auto &cn : clkDom.second.clockedNodes) {
+				auto it = m_nodeToStep.find(cn.getMappedNode().node);
+				HCL_ASSERT(it != m_nodeToStep.end());
+				cn.setStep(it->second.executionBlock, it->second.step);
+			}
+	}
+}
+
+void Program::partitionExecutionBlocks(const std::vector<ScheduledNode> &schedule, size_t numThreads, std::vector<size_t> &blockOfStep, utils::UnstableMap<hlim::BaseNode*, AllocationGroup> &allocationGroups)
+{
+	// Execution blocks need to be reasonably large to amortize the synchronization between threads.
+	constexpr size_t minStepsPerBlock = 64;
+
+	utils::UnstableMap<hlim::BaseNode*, size_t> stepOfNode;
+	for (auto i : utils::Range(schedule.size()))
+		stepOfNode[schedule[i].node] = i;
+
+	auto findRoot = [](std::vector<size_t> &parent, size_t i) {
+		while (parent[i] != i) {
+			parent[i] = parent[parent[i]];
+			i = parent[i];
+		}
+		return i;
+	};
+	auto unite = [&](std::vector<size_t> &parent, size_t a, size_t b) {
+		a = findRoot(parent, a);
+		b = findRoot(parent, b);
+		if (a > b) std::swap(a, b);
+		parent[b] = a;
+	};
+
+	// Nodes that report to the simulator (asserts, debug messages, ...) are evaluated afterwards by the simulation thread.
+	// They have no outputs, so nothing depends on them.
+	std::vector<bool> serial(schedule.size(), false);
+	for (auto i : utils::Range(schedule.size()))
+		serial[i] = dynamic_cast<hlim::Node_SignalTap*>(schedule[i].node) != nullptr;
+
+	// A step has to wait for the steps producing its (immediate) inputs and for the steps whose internal state it references.
+	// Referenced internal state (e.g. of memory write ports) is written by its owner during evaluation and read by the referring nodes,
+	// so the order of the schedule is kept for those.
+	std::vector<std::vector<size_t>> predecessors(schedule.size());
+	for (auto i : utils::Range(schedule.size())) {
+		for (const auto &driver : schedule[i].inputs) {
+			if (driver.node == nullptr || driver.node->getOutputType(driver.port) != hlim::NodeIO::OUTPUT_IMMEDIATE) continue;
+			auto it = stepOfNode.find(driver.node);
+			if (it != stepOfNode.end() && it->second != i) // Feedback loops on external nodes
+				predecessors[i].push_back(it->second);
+		}
+		for (const auto &ref : schedule[i].node->getReferencedInternalStateSizes()) {
+			if (ref.first == nullptr) continue;
+			auto it = stepOfNode.find(ref.first);
+			if (it == stepOfNode.end() || it->second == i) continue;
+			if (it->second < i)
+				predecessors[i].push_back(it->second);
 			else
-				mappedNode.inputs.push_back(~0ull);
+				predecessors[it->second].push_back(i);
 		}
+	}
 
-		for (auto i : utils::Range(readyNode->getNumOutputPorts())) {
-			auto it = m_stateMapping.outputToOffset.find({.node = readyNode, .port = i});
-			HCL_ASSERT(it != m_stateMapping.outputToOffset.end());
-			mappedNode.outputs.push_back(it->second);
+	// Longest path from any step without predecessors. All steps of the same depth are independent of each other.
+	std::vector<size_t> depth(schedule.size(), 0);
+	size_t maxDepth = 0;
+	for (auto i : utils::Range(schedule.size())) {
+		for (auto p : predecessors[i])
+			depth[i] = std::max(depth[i], depth[p]+1);
+		maxDepth = std::max(maxDepth, depth[i]);
+	}
+
+	// Group consecutive depths into bands that are large enough to be split among all threads.
+	// Within a band, steps connected by dependencies form components that end up in the same execution block.
+	// Dependencies between bands only point forward, so the execution blocks never depend on each other cyclically.
+	std::vector<size_t> stepsOfDepth(maxDepth+1, 0);
+	for (auto i : utils::Range(schedule.size()))
+		if (!serial[i])
+			stepsOfDepth[depth[i]]++;
+
+	std::vector<size_t> bandOfDepth(maxDepth+1);
+	size_t numBands = 0;
+	size_t bandSize = 0;
+	for (auto d : utils::Range(maxDepth+1)) {
+		bandOfDepth[d] = numBands;
+		bandSize += stepsOfDepth[d];
+		if (bandSize >= minStepsPerBlock * numThreads) {
+			numBands++;
+			bandSize = 0;
 		}
+	}
+	if (bandSize > 0)
+		numBands++;
+
+	std::vector<size_t> component(schedule.size());
+	std::iota(component.begin(), component.end(), 0);
+	for (auto i : utils::Range(schedule.size())) {
+		if (serial[i]) continue;
+		for (auto p : predecessors[i])
+			if (bandOfDepth[depth[p]] == bandOfDepth[depth[i]])
+				unite(component, p, i);
+	}
 
-		execBlock.addStep(std::move(mappedNode));
+	std::vector<size_t> componentSize(schedule.size(), 0);
+	std::vector<std::vector<size_t>> componentsOfBand(numBands);
+	for (auto i : utils::Range(schedule.size())) {
+		if (serial[i]) continue;
+		size_t root = findRoot(component, i);
+		if (componentSize[root]++ == 0)
+			componentsOfBand[bandOfDepth[depth[i]]].push_back(root);
+	}
 
-		for (auto i : utils::Range(readyNode->getNumOutputPorts())) {
-			hlim::NodePort driver;
-			driver.node = readyNode;
-			driver.port = i;
-			outputsReady.insert(driver);
+	// Distribute the components of each band among (at most) as many execution blocks as there are threads.
+	std::vector<size_t> blockOfComponent(schedule.size(), ~0ull);
+	size_t numBlocks = 0;
+	for (auto &components : componentsOfBand) {
+		size_t totalSize = 0;
+		for (auto root : components)
+			totalSize += componentSize[root];
+
+		std::stable_sort(components.begin(), components.end(), [&](size_t lhs, size_t rhs) { return componentSize[lhs] > componentSize[rhs]; });
+
+		size_t numBins = std::clamp<size_t>(totalSize / minStepsPerBlock, 1, numThreads);
+		std::vector<size_t> binSize(numBins, 0);
+		std::vector<size_t> binBlock(numBins, ~0ull);
+		for (auto root : components) {
+			size_t bin = std::min_element(binSize.begin(), binSize.end()) - binSize.begin();
+			binSize[bin] += componentSize[root];
+			if (binBlock[bin] == ~0ull)
+				binBlock[bin] = numBlocks++;
+			blockOfComponent[root] = binBlock[bin];
 		}
 	}
 
+	m_executionBlockGraph.resize(numBlocks);
+	for (auto i : utils::Range(schedule.size())) {
+		if (serial[i])
+			blockOfStep[i] = numBlocks;
+		else {
+			blockOfStep[i] = blockOfComponent[findRoot(component, i)];
+			for (auto p : predecessors[i])
+				if (blockOfStep[p] != blockOfStep[i])
+					m_executionBlockGraph.addDependency(blockOfStep[i], blockOfStep[p]);
+		}
+	}
+
+	// Group the clocked nodes for advancing them concurrently. Nodes sharing internal state (e.g. the ports of a memory)
+	// need to be in the same group to keep the order of their writes.
+	std::vector<size_t> sharing(schedule.size());
+	std::iota(sharing.begin(), sharing.end(), 0);
+	std::vector<bool> clocked(schedule.size(), false);
+	for (auto i : utils::Range(schedule.size())) {
+		const auto &clocks = schedule[i].node->getClocks();
+		clocked[i] = std::any_of(clocks.begin(), clocks.end(), [](hlim::Clock *clk) { return clk != nullptr; });
+		if (!clocked[i]) continue;
+
+		for (const auto &ref : schedule[i].node->getReferencedInternalStateSizes()) {
+			if (ref.first == nullptr) continue;
+			auto it = stepOfNode.find(ref.first);
+			if (it != stepOfNode.end())
+				unite(sharing, i, it->second);
+		}
+	}
+
+	std::vector<size_t> clockedInSet(schedule.size(), 0);
+	for (auto i : utils::Range(schedule.size()))
+		if (clocked[i])
+			clockedInSet[findRoot(sharing, i)]++;
+
+	std::vector<size_t> groupOfSet(schedule.size(), ~0ull);
+	std::vector<size_t> groupSize(numThreads, 0);
+	for (auto i : utils::Range(schedule.size())) {
+		size_t root = findRoot(sharing, i);
+		if (clockedInSet[root] == 0 || groupOfSet[root] != ~0ull) continue;
+
+		size_t group = std::min_element(groupSize.begin(), groupSize.end()) - groupSize.begin();
+		groupSize[group] += clockedInSet[root];
+		groupOfSet[root] = group;
+	}
+
+	for (auto i : utils::Range(schedule.size()))
+		allocationGroups[schedule[i].node] = {
+			.executionBlock = blockOfStep[i],
+			.advanceGroup = groupOfSet[findRoot(sharing, i)],
+		};
 }
 
-void Program::allocateSignals(const hlim::Circuit &circuit, const hlim::Subnet &nodes)
+MappedNode Program::mapNode(hlim::BaseNode *node, const std::vector<hlim::NodePort> &inputs)
+{
+	MappedNode mappedNode;
+	mappedNode.node = node;
+	mappedNode.internal = m_stateMapping.nodeToInternalOffset[node];
+	for (const auto &driver : inputs) {
+		auto it = m_stateMapping.outputToOffset.find(driver);
+		if (it != m_stateMapping.outputToOffset.end())
+			mappedNode.inputs.push_back(it->second);
+		else
+			mappedNode.inputs.push_back(~0ull);
+	}
+
+	for (auto i : utils::Range(node->getNumOutputPorts())) {
+		auto it = m_stateMapping.outputToOffset.find({.node = node, .port = i});
+		HCL_ASSERT(it != m_stateMapping.outputToOffset.end());
+		mappedNode.outputs.push_back(it->second);
+	}
+	return mappedNode;
+}
+
+void Program::buildFanOut()
+{
+	ExecutionBlock::AccessMap readersOfOffset;
+	ExecutionBlock::AccessMap accessorsOfInternal;
+	for (const auto &block : m_executionBlocks)
+		block.collectAccesses(readersOfOffset, accessorsOfInternal);
+
+	for (auto &block : m_executionBlocks)
+		block.buildFanOut(readersOfOffset, accessorsOfInternal);
+}
+
+void Program::allocateSignals(const hlim::Circuit &circuit, const hlim::Subnet &nodes, const std::vector<ScheduledNode> &schedule, const utils::UnstableMap<hlim::BaseNode*, AllocationGroup> &allocationGroups, StateLayout stateLayout)
 {
 	m_stateMapping.clear();
 
-	BitAllocator allocator;
+	const bool evaluationOrder = stateLayout == StateLayout::EVALUATION_ORDER;
+	BitAllocator allocator(evaluationOrder ? BitAllocator::Strategy::SEQUENTIAL : BitAllocator::Strategy::SIZE_BUCKETS);
 
 	struct ReferringNode {
 		hlim::BaseNode* node;
@@ -402,67 +1070,145 @@ void Program::allocateSignals(const hlim::Circuit &circuit, const hlim::Subnet &
 
 	std::vector<ReferringNode> referringNodes;
 
+	// State of different allocation groups must not share 64-bit words. So first gather all state by group and then
+	// allocate group by group with the allocator's buckets flushed in between.
+	struct Allocation {
+		size_t size;
+		size_t *offset;
+	};
+	std::map<AllocationGroup, std::vector<Allocation>> allocationsByGroup;
 
-	// First, loop through all nodes and allocate state and output state space.
-	// Keep a list of nodes that refer to other node's internal state to fill in once all internal state has been allocated.
-	for (auto node : nodes) {
+	std::vector<hlim::BaseNode*> forwardingNodes;
+
+	auto isForwarding = [](hlim::BaseNode *node) {
 		// Signals simply point to the actual producer's output, as do export overrides
-		if (node->allOutputsForwarded() || dynamic_cast<hlim::Node_ExportOverride*>(node)) {
-			for (auto i : utils::Range(node->getNumOutputPorts())) {
+		return node->allOutputsForwarded() || dynamic_cast<hlim::Node_ExportOverride*>(node);
+	};
+	auto getGroup = [&](hlim::BaseNode *node) {
+		auto groupIt = allocationGroups.find(node);
+		if (groupIt != allocationGroups.end())
+			return groupIt->second;
+		return AllocationGroup{};
+	};
 
-				hlim::NodePort driver;
-				if (dynamic_cast<hlim::Node_ExportOverride*>(node))
-					driver = node->getNonForwardingDriver(hlim::Node_ExportOverride::SIM_INPUT);
-				else
-					driver = node->getNonForwardingDriver(*node->forwardsInputToOutput(i));
+	// For the evaluation order layout, visit the nodes in the order in which they are evaluated, so that consecutively evaluated nodes access neighboring state.
+	std::vector<hlim::BaseNode*> orderedNodes;
+	if (evaluationOrder) {
+		utils::UnstableSet<hlim::BaseNode*> scheduledNodes;
+		for (const auto &scheduledNode : schedule) {
+			orderedNodes.push_back(scheduledNode.node);
+			scheduledNodes.insert(scheduledNode.node);
+		}
+		for (auto node : nodes)
+			if (!scheduledNodes.contains(node))
+				orderedNodes.push_back(node);
+	} else
+		orderedNodes.assign(nodes.begin(), nodes.end());
+
+	// Latched and constant outputs are produced outside of the evaluation order. For the evaluation order layout,
+	// they are placed next to their first reader instead of next to the node producing them.
+	utils::UnstableMap<hlim::NodePort, std::pair<AllocationGroup, Allocation>> deferredOutputs;
+	auto allocateDeferred = [&](const hlim::NodePort &output) {
+		auto it = deferredOutputs.find(output);
+		if (it != deferredOutputs.end()) {
+			allocationsByGroup[it->second.first].push_back(it->second.second);
+			deferredOutputs.erase(it);
+		}
+	};
 
-				{
-					utils::UnstableSet<hlim::NodePort> alreadyVisited;
-					while (dynamic_cast<hlim::Node_ExportOverride*>(driver.node)) { // Skip all export override nodes
-						alreadyVisited.insert(driver);
-						driver = driver.node->getNonForwardingDriver(hlim::Node_ExportOverride::SIM_INPUT);
-						if (alreadyVisited.contains(driver))
-							driver = {};
-					}
+	if (evaluationOrder)
+		for (auto node : orderedNodes) {
+			if (isForwarding(node)) continue;
+			AllocationGroup latchedGroup = { .advanceGroup = getGroup(node).advanceGroup };
+			for (auto i : utils::Range(node->getNumOutputPorts()))
+				if (node->getOutputType(i) != hlim::NodeIO::OUTPUT_IMMEDIATE) {
+					hlim::NodePort output = {.node = node, .port = i};
+					deferredOutputs[output] = { latchedGroup, Allocation{ .size = node->getOutputConnectionType(i).width, .offset = &m_stateMapping.outputToOffset[output] } };
 				}
+		}
 
-				size_t width = node->getOutputConnectionType(0).width;
-
-				if (driver.node != nullptr) {
-					auto it = m_stateMapping.outputToOffset.find(driver);
-					if (it == m_stateMapping.outputToOffset.end()) {
-						auto offset = allocator.allocate(width);
-						m_stateMapping.outputToOffset[driver] = offset;
-						m_stateMapping.outputToOffset[{.node = node, .port = 0ull}] = offset;
-					} else {
-						// point to same output port
-						m_stateMapping.outputToOffset[{.node = node, .port = 0ull}] = it->second;
-					}
+	// First, loop through all nodes and gather state and output state space.
+	// Keep a list of nodes that refer to other node's internal state to fill in once all internal state has been allocated.
+	for (auto nodeIdx : utils::Range(orderedNodes.size())) {
+		auto *node = orderedNodes[nodeIdx];
+		if (isForwarding(node)) {
+			forwardingNodes.push_back(node);
+			continue;
+		}
+
+		if (evaluationOrder && nodeIdx < schedule.size())
+			for (const auto &driver : schedule[nodeIdx].inputs)
+				allocateDeferred(driver);
+
+		AllocationGroup group = getGroup(node);
+		// Latched and constant outputs are not written during evaluation.
+		AllocationGroup latchedGroup = { .advanceGroup = group.advanceGroup };
+
+		std::vector<size_t> internalSizes = node->getInternalStateSizes();
+		ReferringNode refNode;
+		refNode.node = node;
+		refNode.refs = node->getReferencedInternalStateSizes();
+		refNode.internalSizeOffset = internalSizes.size();
+
+		auto &internalOffsets = m_stateMapping.nodeToInternalOffset[node];
+		internalOffsets.resize(internalSizes.size() + refNode.refs.size());
+		for (auto i : utils::Range(internalSizes.size()))
+			allocationsByGroup[group].push_back({ .size = internalSizes[i], .offset = &internalOffsets[i] });
+
+		for (auto i : utils::Range(node->getNumOutputPorts())) {
+			auto &offset = m_stateMapping.outputToOffset[{.node = node, .port = i}];
+			size_t width = node->getOutputConnectionType(i).width;
+			if (node->getOutputType(i) == hlim::NodeIO::OUTPUT_IMMEDIATE)
+				allocationsByGroup[group].push_back({ .size = width, .offset = &offset });
+			else if (evaluationOrder)
+				allocateDeferred({.node = node, .port = i}); // Not read by any node evaluated before
+			else
+				allocationsByGroup[latchedGroup].push_back({ .size = width, .offset = &offset });
+		}
+
+		if (!refNode.refs.empty())
+			referringNodes.push_back(refNode);
+	}
+
+	for (auto &[group, allocations] : allocationsByGroup) {
+		for (auto &allocation : allocations)
+			*allocation.offset = allocator.allocate(allocation.size);
+		allocator.flushBuckets();
+	}
+
+	for (auto node : forwardingNodes) {
+		for (auto i : utils::Range(node->getNumOutputPorts())) {
+
+			hlim::NodePort driver;
+			if (dynamic_cast<hlim::Node_ExportOverride*>(node))
+				driver = node->getNonForwardingDriver(hlim::Node_ExportOverride::SIM_INPUT);
+			else
+				driver = node->getNonForwardingDriver(*node->forwardsInputToOutput(i));
+
+			{
+				utils::UnstableSet<hlim::NodePort> alreadyVisited;
+				while (dynamic_cast<hlim::Node_ExportOverride*>(driver.node)) { // Skip all export override nodes
+					alreadyVisited.insert(driver);
+					driver = driver.node->getNonForwardingDriver(hlim::Node_ExportOverride::SIM_INPUT);
+					if (alreadyVisited.contains(driver))
+						driver = {};
 				}
 			}
-		} else {
-			std::vector<size_t> internalSizes = node->getInternalStateSizes();
-			ReferringNode refNode;
-			refNode.node = node;
-			refNode.refs = node->getReferencedInternalStateSizes();
-			refNode.internalSizeOffset = internalSizes.size();
-
-			std::vector<size_t> internalOffsets(internalSizes.size() + refNode.refs.size());
-			for (auto i : utils::Range(internalSizes.size()))
-				internalOffsets[i] = allocator.allocate(internalSizes[i]);
-			m_stateMapping.nodeToInternalOffset[node] = std::move(internalOffsets);
-
-			for (auto i : utils::Range(node->getNumOutputPorts())) {
-				hlim::NodePort driver = {.node = node, .port = i};
+
+			size_t width = node->getOutputConnectionType(0).width;
+
+			if (driver.node != nullptr) {
 				auto it = m_stateMapping.outputToOffset.find(driver);
 				if (it == m_stateMapping.outputToOffset.end()) {
-					size_t width = node->getOutputConnectionType(i).width;
-					m_stateMapping.outputToOffset[driver] = allocator.allocate(width);
+					// Driver is not part of the simulated subnet
+					auto offset = allocator.allocate(width);
+					m_stateMapping.outputToOffset[driver] = offset;
+					m_stateMapping.outputToOffset[{.node = node, .port = 0ull}] = offset;
+				} else {
+					// point to same output port
+					m_stateMapping.outputToOffset[{.node = node, .port = 0ull}] = it->second;
 				}
 			}
-
-			if (!refNode.refs.empty())
-				referringNodes.push_back(refNode);
 		}
 	}
 
@@ -485,45 +1231,9 @@ void Program::allocateSignals(const hlim::Circuit &circuit, const hlim::Subnet &
 }
 
 
-SignalWatch::SignalWatch(std::coroutine_handle<> handle, const SensitivityList &list, const StateMapping &stateMapping, const sim::DefaultBitVectorState &state, std::uint64_t insertionId)
-	: handle(handle), insertionId(insertionId)
-{
-	signals.reserve(list.getSignals().size());
-	size_t offset = 0;
-	for (auto i : utils::Range(list.getSignals().size())) {
-		size_t size = hlim::getOutputWidth(list.getSignals()[i]);
-		size_t paddedSize = (size+63)/64*64; ///@todo do something less wasteful
-
-		auto it = stateMapping.outputToOffset.find(list.getSignals()[i]);
-		// if it isn't mapped, it never changes, so we never need to check for a change of it.
-		if (it == stateMapping.outputToOffset.end()) continue;
-
-		signals.push_back({
-			.refStateIdx = offset,
-			.stateIdx = it->second,
-			.size = size
-		});
-		offset += paddedSize;
-	}
-
-	refState.resize(offset);
-	for (const auto &s : signals)
-		refState.copyRange(s.refStateIdx, state, s.stateIdx, s.size);
-}
-
-bool SignalWatch::anySignalChanged(const sim::DefaultBitVectorState &state) const
-{
-	for (const auto &s : signals)
-		if (!refState.compareRange(s.refStateIdx, state, s.stateIdx, s.size))
-			return true;
-	return false;
-}
-
-
-
-
 ReferenceSimulator::ReferenceSimulator(bool enableConsoleOutput)
 {
+	m_batchStates = { &m_dataState };
 	if (enableConsoleOutput) {
 		m_simulatorConsoleOutput.emplace();
 		addCallbacks(&m_simulatorConsoleOutput.value());
@@ -539,11 +1249,14 @@ ReferenceSimulator::~ReferenceSimulator()
 void ReferenceSimulator::destroyPendingEvents()
 {
 	m_simulationIsShuttingDown = true;
-	while (!m_nextEvents.empty())
-		m_nextEvents.pop();
+	m_nextEvents.clear();
+	for (auto &watches : m_signalWatches)
+		watches.clear();
 
 	m_coroutineHandler.stopAll();
 	m_processesAwaitingCommit.clear();
+	for (auto &awaiting : m_clockAwaitingSimProcs)
+		awaiting.clear();
 	m_simFibers.clear();
 	m_simulationIsShuttingDown = false;
 }
@@ -555,6 +1268,10 @@ void ReferenceSimulator::compileProgram(const hlim::Circuit &circuit, const util
 	startPerformanceCounterThread(options.perf);
 	m_options = options;
 
+	HCL_DESIGNCHECK_HINT(options.batchSize >= 1, "The batch must contain at least one instance!");
+	HCL_DESIGNCHECK_HINT(options.batchSize == 1 || (!options.activityDrivenEvaluation && !options.twoStateEvaluation),
+		"Simulating a batch of multiple instances is not supported together with activity driven or two-state evaluation!");
+
 	if (!options.ignoreSimulationProcesses) {
 		for (const auto &simProc : circuit.getSimulationProcesses())
 			addSimulationProcess(simProc);
@@ -565,7 +1282,22 @@ void ReferenceSimulator::compileProgram(const hlim::Circuit &circuit, const util
 
 	auto nodes = hlim::Subnet::allForSimulation(const_cast<hlim::Circuit&>(circuit), outputs);
 
-	m_program.compileProgram(circuit, nodes, m_performanceCounters);
+	size_t numThreads = options.numThreads;
+	if (numThreads == 0)
+		numThreads = std::max<size_t>(1, std::thread::hardware_concurrency());
+
+	if (numThreads == 1)
+		m_workerPool.reset();
+	else if (!m_workerPool || m_workerPool->getNumThreads() != numThreads)
+		m_workerPool = std::make_unique<WorkerPool>(numThreads);
+
+	if (options.shareProgram)
+		m_program = Program::compileShared(circuit, nodes, m_performanceCounters, options.activityDrivenEvaluation, numThreads, options.stateLayout);
+	else {
+		auto program = std::make_shared<Program>();
+		program->compileProgram(circuit, nodes, m_performanceCounters, options.activityDrivenEvaluation, numThreads, options.stateLayout);
+		m_program = std::move(program);
+	}
 }
 
 
@@ -599,21 +1331,112 @@ void ReferenceSimulator::compileStaticEvaluation(const hlim::Circuit& circuit, c
 			}
 		}
 	}
-	m_program.compileProgram(circuit, nodeSet, m_performanceCounters);
+	auto program = std::make_shared<Program>();
+	program->compileProgram(circuit, nodeSet, m_performanceCounters);
+	m_program = std::move(program);
 }
 
 
-void ReferenceSimulator::powerOn()
+template<typename Functor>
+void ReferenceSimulator::trackClockedNodeActivity(const ClockedNode &clockedNode, Functor functor, size_t thread, bool concurrent)
+{
+	if (!m_options.activityDrivenEvaluation) {
+		for (auto *state : m_batchStates)
+			functor(*state);
+		return;
+	}
+
+	const auto &block = m_program->m_executionBlocks[clockedNode.getExecutionBlock()];
+	auto &scratch = m_dataState.activityScratch[thread];
+
+	block.captureOutputs(clockedNode.getStep(), m_dataState, scratch);
+	functor(m_dataState);
+	block.markChangedOutputs(clockedNode.getStep(), m_dataState, scratch, concurrent);
+	// Changes to internal state (e.g. memory writes) can not be detected cheaply, so conservatively reevaluate everyone accessing it.
+	block.markInternalSharers(clockedNode.getStep(), m_dataState, concurrent);
+}
+
+void ReferenceSimulator::markNodeActive(hlim::BaseNode *node)
+{
+	if (!m_options.activityDrivenEvaluation) return;
+
+	auto it = m_program->m_nodeToStep.find(node);
+	if (it != m_program->m_nodeToStep.end())
+		utils::bitSet(m_dataState.activeSteps[it->second.executionBlock].data(), it->second.step);
+}
+
+void ReferenceSimulator::markNodeOutputsChanged(hlim::BaseNode *node)
+{
+	if (!m_options.activityDrivenEvaluation) return;
+
+	auto it = m_program->m_nodeToStep.find(node);
+	if (it != m_program->m_nodeToStep.end())
+		m_program->m_executionBlocks[it->second.executionBlock].markOutputReaders(it->second.step, m_dataState, false);
+}
+
+void ReferenceSimulator::resetFullyDefinedSteps()
+{
+	for (auto i : utils::Range(m_dataState.fullyDefinedSteps.size())) {
+		m_dataState.fullyDefinedSteps[i].assign((m_program->m_executionBlocks[i].getNumSteps() + 63) / 64, 0);
+		m_dataState.definedOutputSteps[i].assign((m_program->m_executionBlocks[i].getNumSteps() + 63) / 64, 0);
+	}
+}
+
+void ReferenceSimulator::initializeBatchStates()
 {
 	m_simulationTime = 0;
+	m_performanceStats = {};
+	m_numNodeEvaluations = 0;
 	m_microTick = 0;
 	m_timingPhase = WaitClock::AFTER;
-	m_dataState.signalState.resize(m_program.m_fullStateWidth);
+	m_currentBatchIndex = 0;
+
+	m_additionalBatchStates.resize(m_options.batchSize - 1);
+	m_batchStates = { &m_dataState };
+	for (auto &state : m_additionalBatchStates)
+		m_batchStates.push_back(&state);
+	m_signalWatches.resize(m_batchStates.size());
+
+	for (auto *state : m_batchStates) {
+		state->signalState.resize(m_program->m_fullStateWidth);
+		state->signalState.clearRange(DefaultConfig::VALUE, 0, m_program->m_fullStateWidth);
+		state->signalState.clearRange(DefaultConfig::DEFINED, 0, m_program->m_fullStateWidth);
+	}
 
-	m_dataState.signalState.clearRange(DefaultConfig::VALUE, 0, m_program.m_fullStateWidth);
-	m_dataState.signalState.clearRange(DefaultConfig::DEFINED, 0, m_program.m_fullStateWidth);
+	if (m_options.activityDrivenEvaluation) {
+		// Everything needs to be evaluated once after power on.
+		m_dataState.activeSteps.resize(m_program->m_executionBlocks.size());
+		size_t scratchSize = 0;
+		for (auto i : utils::Range(m_program->m_executionBlocks.size())) {
+			const auto &block = m_program->m_executionBlocks[i];
+			auto &activeSteps = m_dataState.activeSteps[i];
+			activeSteps.assign((block.getNumSteps() + 63) / 64, ~0ull);
+			if (block.getNumSteps() % 64 != 0)
+				activeSteps.back() = utils::bitMaskRange<std::uint64_t>(0, block.getNumSteps() % 64);
+			scratchSize = std::max(scratchSize, block.getOutputScratchSize());
+		}
+		m_dataState.activityScratch.resize(m_workerPool ? m_workerPool->getNumThreads() : 1);
+		for (auto &scratch : m_dataState.activityScratch)
+			scratch.resize(scratchSize);
+	}
+
+	m_dataState.fullyDefinedSteps.clear();
+	m_dataState.definedOutputSteps.clear();
+	if (m_options.twoStateEvaluation) {
+		m_dataState.fullyDefinedSteps.resize(m_program->m_executionBlocks.size());
+		m_dataState.definedOutputSteps.resize(m_program->m_executionBlocks.size());
+		resetFullyDefinedSteps();
+	}
 
 	destroyPendingEvents();
+	m_clockAwaitingSimProcs.resize(m_program->m_clockDomains.size());
+	m_nextEvents.setTickDuration(m_program->m_tickDuration);
+}
+
+void ReferenceSimulator::powerOn()
+{
+	initializeBatchStates();
+	m_resumedFromCheckpoint = false;
 
 	{
 		auto perfHandle = m_performanceCounters.processOther(SimulatorPerformanceCounters::Other::EVENT_CALLBACKS);
@@ -621,15 +1444,16 @@ void ReferenceSimulator::powerOn()
 		m_callbackDispatcher.onNewTick(m_simulationTime);
 	}
 
-	for (const auto &mappedNode : m_program.m_powerOnNodes) {
+	for (const auto &mappedNode : m_program->m_powerOnNodes) {
 		auto perfHandle = m_performanceCounters.processNode(mappedNode.node);
-		mappedNode.node->simulatePowerOn(m_callbackDispatcher, m_dataState.signalState, mappedNode.internal.data(), mappedNode.outputs.data());
+		for (auto *state : m_batchStates)
+			mappedNode.node->simulatePowerOn(m_callbackDispatcher, state->signalState, mappedNode.internal.data(), mappedNode.outputs.data());
 	}
 
-	m_dataState.clockState.resize(m_program.m_clockSources.size());
+	m_dataState.clockState.resize(m_program->m_clockSources.size());
 	for (auto i : utils::Range(m_dataState.clockState.size())) {
-		auto &clkSource = m_program.m_clockSources[i];
-		auto clock = m_program.m_clockSources[i].pin;
+		auto &clkSource = m_program->m_clockSources[i];
+		auto clock = m_program->m_clockSources[i].pin;
 		auto &cs = m_dataState.clockState[i];
 		// The pin defines the starting state of the clock signal
 		auto trigType = clock->getTriggerEvent();
@@ -637,7 +1461,7 @@ void ReferenceSimulator::powerOn()
 
 		for (auto &dom : clkSource.domains)
 			for (auto &cn : dom->clockedNodes)
-				cn.clockValueChanged(m_callbackDispatcher, m_dataState, cs.high, true, m_performanceCounters);
+				trackClockedNodeActivity(cn, [&](DataState &state){ cn.clockValueChanged(m_callbackDispatcher, state, cs.high, true, m_performanceCounters); });
 
 		Event e;
 		e.type = Event::Type::clockPinTrigger;
@@ -645,23 +1469,23 @@ void ReferenceSimulator::powerOn()
 			.clockPinIdx = i,
 			.risingEdge = !cs.high,
 		};
-		e.timeOfEvent = m_simulationTime + hlim::ClockRational(1,2) / clock->absoluteFrequency();
+		e.timeOfEvent = m_simulationTime + clkSource.halfPeriod;
 
 		m_nextEvents.push(e);
 	}
 
-	m_dataState.resetState.resize(m_program.m_resetSources.size());
+	m_dataState.resetState.resize(m_program->m_resetSources.size());
 	for (auto i : utils::Range(m_dataState.resetState.size())) {
-		auto clock = m_program.m_resetSources[i].pin;
+		auto clock = m_program->m_resetSources[i].pin;
 
 		auto &rs = m_dataState.resetState[i];
 		// The pin defines the starting state
-		auto &rstSource = m_program.m_resetSources[i];
+		auto &rstSource = m_program->m_resetSources[i];
 		rs.resetHigh = clock->getRegAttribs().resetActive == hlim::RegisterAttributes::Active::HIGH;
 
 		for (auto &dom : rstSource.domains)
 			for (auto &cn : dom->clockedNodes)
-				cn.changeReset(m_callbackDispatcher, m_dataState, rs.resetHigh, m_performanceCounters);
+				trackClockedNodeActivity(cn, [&](DataState &state){ cn.changeReset(m_callbackDispatcher, state, rs.resetHigh, m_performanceCounters); });
 		
 		{
 			auto perfHandle = m_performanceCounters.processOther(SimulatorPerformanceCounters::Other::EVENT_CALLBACKS);
@@ -670,8 +1494,8 @@ void ReferenceSimulator::powerOn()
 
 
 		// Deactivate reset
-		auto minTime = m_program.m_stateMapping.clockPinAllocation.resetPins[i].minResetTime;
-		auto minCycles = m_program.m_stateMapping.clockPinAllocation.resetPins[i].minResetCycles;
+		auto minTime = m_program->m_stateMapping.clockPinAllocation.resetPins[i].minResetTime;
+		auto minCycles = m_program->m_stateMapping.clockPinAllocation.resetPins[i].minResetCycles;
 		auto minCyclesTime = hlim::ClockRational(minCycles, 1) / clock->absoluteFrequency();
 		
 		minTime = std::max(minTime, minCyclesTime);
@@ -680,7 +1504,7 @@ void ReferenceSimulator::powerOn()
 			rs.resetHigh = !rs.resetHigh;
 			for (auto &dom : rstSource.domains)
 				for (auto &cn : dom->clockedNodes)
-					cn.changeReset(m_callbackDispatcher, m_dataState, !rs.resetHigh, m_performanceCounters);
+					trackClockedNodeActivity(cn, [&](DataState &state){ cn.changeReset(m_callbackDispatcher, state, !rs.resetHigh, m_performanceCounters); });
 
 			{
 				auto perfHandle = m_performanceCounters.processOther(SimulatorPerformanceCounters::Other::EVENT_CALLBACKS);
@@ -700,6 +1524,11 @@ void ReferenceSimulator::powerOn()
 		}
 	}	
 
+	startSimulationProcesses();
+}
+
+void ReferenceSimulator::startSimulationProcesses()
+{
 	// reevaluate, to provide fibers with power-on state
 	reevaluate();
 
@@ -716,10 +1545,13 @@ void ReferenceSimulator::powerOn()
 		m_simFibers.clear();
 		m_coroutineHandler.stopAll();
 
-		// start all sim procs
-		for (auto &f : m_simProcs) {
-			startCoroutine(f());
+		// start all sim procs, once for each instance of the batch
+		for (auto batchIndex : utils::Range(m_batchStates.size())) {
+			m_currentBatchIndex = batchIndex;
+			for (auto &f : m_simProcs)
+				startCoroutine(f());
 		}
+		m_currentBatchIndex = 0;
 
 		// start all fibers
 		for (auto &f : m_simFiberBodies) {
@@ -744,30 +1576,266 @@ void ReferenceSimulator::powerOn()
 	}
 }
 
+namespace {
+
+const char checkpointMagic[8] = {'G', 'T', 'R', 'Y', 'C', 'K', 'P', 'T'};
+const std::uint64_t checkpointVersion = 2;
+
+void writeCheckpointWord(std::ostream &stream, std::uint64_t word)
+{
+	stream.write((const char *) &word, sizeof(word));
+}
+
+std::uint64_t readCheckpointWord(std::istream &stream)
+{
+	std::uint64_t word = 0;
+	stream.read((char *) &word, sizeof(word));
+	HCL_DESIGNCHECK_HINT(stream, "Unexpected end of the checkpoint file!");
+	return word;
+}
+
+}
+
+void ReferenceSimulatorCheckpoint::save(std::ostream &stream) const
+{
+	stream.write(checkpointMagic, sizeof(checkpointMagic));
+	writeCheckpointWord(stream, checkpointVersion);
+
+	writeCheckpointWord(stream, simulationTime.numerator());
+	writeCheckpointWord(stream, simulationTime.denominator());
+	writeCheckpointWord(stream, fullStateWidth);
+	writeCheckpointWord(stream, layoutHash);
+
+	writeCheckpointWord(stream, signalStates.size());
+	for (const auto &state : signalStates)
+		for (auto plane : utils::Range<size_t>(DefaultConfig::NUM_PLANES)) {
+			writeCheckpointWord(stream, state.getNumBlocks());
+			stream.write((const char *) state.data((DefaultConfig::Plane) plane), state.getNumBlocks() * sizeof(DefaultConfig::BaseType));
+		}
+
+	writeCheckpointWord(stream, clockState.size());
+	for (const auto &cs : clockState)
+		writeCheckpointWord(stream, cs.high);
+	writeCheckpointWord(stream, resetState.size());
+	for (const auto &rs : resetState)
+		writeCheckpointWord(stream, rs.resetHigh);
+
+	writeCheckpointWord(stream, pendingEvents.size());
+	for (const auto &e : pendingEvents) {
+		writeCheckpointWord(stream, (std::uint64_t) e.type);
+		writeCheckpointWord(stream, e.timeOfEvent.numerator());
+		writeCheckpointWord(stream, e.timeOfEvent.denominator());
+		writeCheckpointWord(stream, e.microTick);
+		writeCheckpointWord(stream, e.timingPhase);
+		if (e.type == Event::Type::resetValueChange) {
+			writeCheckpointWord(stream, e.evt<Event::ResetValueChangeEvt>().resetPinIdx);
+			writeCheckpointWord(stream, e.evt<Event::ResetValueChangeEvt>().newResetHigh);
+		} else {
+			writeCheckpointWord(stream, e.evt<Event::ClockValueChangeEvt>().clockPinIdx);
+			writeCheckpointWord(stream, e.evt<Event::ClockValueChangeEvt>().risingEdge);
+		}
+	}
+}
+
+void ReferenceSimulatorCheckpoint::load(std::istream &stream)
+{
+	char magic[sizeof(checkpointMagic)];
+	stream.read(magic, sizeof(magic));
+	HCL_DESIGNCHECK_HINT(stream && std::memcmp(magic, checkpointMagic, sizeof(magic)) == 0, "Not a checkpoint file!");
+	HCL_DESIGNCHECK_HINT(readCheckpointWord(stream) == checkpointVersion, "The checkpoint file was written by an incompatible version!");
+
+	auto numerator = readCheckpointWord(stream);
+	simulationTime = hlim::ClockRational(numerator, readCheckpointWord(stream));
+	fullStateWidth = readCheckpointWord(stream);
+	layoutHash = readCheckpointWord(stream);
+
+	signalStates.resize(readCheckpointWord(stream));
+	for (auto &state : signalStates) {
+		state.resize(fullStateWidth);
+		for (auto plane : utils::Range<size_t>(DefaultConfig::NUM_PLANES)) {
+			HCL_DESIGNCHECK_HINT(readCheckpointWord(stream) == state.getNumBlocks(), "The checkpoint file is corrupt!");
+			stream.read((char *) state.data((DefaultConfig::Plane) plane), state.getNumBlocks() * sizeof(DefaultConfig::BaseType));
+		}
+	}
+	// Data of simulation processes can hold anything and is not written to files.
+	auxData.clear();
+
+	clockState.resize(readCheckpointWord(stream));
+	for (auto &cs : clockState)
+		cs.high = readCheckpointWord(stream);
+	resetState.resize(readCheckpointWord(stream));
+	for (auto &rs : resetState)
+		rs.resetHigh = readCheckpointWord(stream);
+
+	pendingEvents.resize(readCheckpointWord(stream));
+	for (auto &e : pendingEvents) {
+		e.type = (Event::Type) readCheckpointWord(stream);
+		numerator = readCheckpointWord(stream);
+		e.timeOfEvent = hlim::ClockRational(numerator, readCheckpointWord(stream));
+		e.microTick = readCheckpointWord(stream);
+		e.timingPhase = (WaitClock::TimingPhase) readCheckpointWord(stream);
+		HCL_DESIGNCHECK_HINT(e.type != Event::Type::simProcResume, "The checkpoint file is corrupt!");
+		if (e.type == Event::Type::resetValueChange) {
+			auto resetPinIdx = readCheckpointWord(stream);
+			e.data = Event::ResetValueChangeEvt{ .resetPinIdx = resetPinIdx, .newResetHigh = readCheckpointWord(stream) != 0 };
+		} else {
+			auto clockPinIdx = readCheckpointWord(stream);
+			e.data = Event::ClockValueChangeEvt{ .clockPinIdx = clockPinIdx, .risingEdge = readCheckpointWord(stream) != 0 };
+		}
+	}
+}
+
+std::unique_ptr<ReferenceSimulator> ReferenceSimulator::fork() const
+{
+	auto child = std::make_unique<ReferenceSimulator>(false);
+	child->m_options = m_options;
+	child->m_options.numThreads = 1;
+	child->m_program = m_program;
+	return child;
+}
+
+void ReferenceSimulator::forkVariants(size_t numVariants, const VariantFunction &setupVariant, const VariantFunction &runVariant)
+{
+	auto checkpoint = saveCheckpoint();
+
+	WorkerPool pool(std::min<size_t>(numVariants, std::max(1u, std::thread::hardware_concurrency())));
+	pool.run(numVariants, [&](size_t variant, size_t thread) {
+		auto child = fork();
+		setupVariant(variant, *child);
+		child->restoreCheckpoint(*checkpoint);
+		runVariant(variant, *child);
+	});
+}
+
+std::unique_ptr<SimulatorCheckpoint> ReferenceSimulator::saveCheckpoint()
+{
+	HCL_DESIGNCHECK_HINT(m_processesAwaitingCommit.empty() && !m_stateNeedsReevaluating, "Checkpoints can only be taken between time steps, not from within simulation processes!");
+
+	auto checkpoint = std::make_unique<ReferenceSimulatorCheckpoint>();
+	checkpoint->simulationTime = m_simulationTime;
+	checkpoint->fullStateWidth = m_program->m_fullStateWidth;
+	checkpoint->layoutHash = m_program->m_layoutHash;
+	for (auto *state : m_batchStates) {
+		checkpoint->signalStates.push_back(state->signalState);
+		checkpoint->auxData.push_back(state->auxData);
+	}
+	checkpoint->clockState = m_dataState.clockState;
+	checkpoint->resetState = m_dataState.resetState;
+
+	// Clock and reset events are replayed, simulation processes are restarted on restore.
+	EventQueue pendingEvents = m_nextEvents;
+	for (; !pendingEvents.empty(); pendingEvents.pop())
+		if (pendingEvents.top().type != Event::Type::simProcResume)
+			checkpoint->pendingEvents.push_back(pendingEvents.top());
+
+	return checkpoint;
+}
+
+std::unique_ptr<SimulatorCheckpoint> ReferenceSimulator::loadCheckpoint(std::istream &stream)
+{
+	auto checkpoint = std::make_unique<ReferenceSimulatorCheckpoint>();
+	checkpoint->load(stream);
+	return checkpoint;
+}
+
+void ReferenceSimulator::restoreCheckpoint(const SimulatorCheckpoint &checkpoint)
+{
+	const auto *cp = dynamic_cast<const ReferenceSimulatorCheckpoint*>(&checkpoint);
+	HCL_DESIGNCHECK_HINT(cp, "The checkpoint was not taken by a ReferenceSimulator!");
+	HCL_DESIGNCHECK_HINT(cp->fullStateWidth == m_program->m_fullStateWidth && cp->signalStates.size() == m_options.batchSize &&
+		cp->clockState.size() == m_program->m_clockSources.size() && cp->resetState.size() == m_program->m_resetSources.size(),
+		"The checkpoint was taken from a different circuit or with different compile options!");
+	HCL_DESIGNCHECK_HINT(cp->layoutHash == m_program->m_layoutHash, "The checkpoint was taken from a program with a different state layout!");
+
+	initializeBatchStates();
+	m_simulationTime = cp->simulationTime;
+	m_resumedFromCheckpoint = true;
+
+	for (auto batchIndex : utils::Range(m_batchStates.size())) {
+		m_batchStates[batchIndex]->signalState = cp->signalStates[batchIndex];
+		if (batchIndex < cp->auxData.size())
+			m_batchStates[batchIndex]->auxData = cp->auxData[batchIndex];
+		else
+			m_batchStates[batchIndex]->auxData.clear();
+	}
+	m_dataState.clockState = cp->clockState;
+	m_dataState.resetState = cp->resetState;
+
+	for (auto e : cp->pendingEvents) {
+		e.tick = ~0ull;
+		m_nextEvents.push(e);
+	}
+
+	{
+		auto perfHandle = m_performanceCounters.processOther(SimulatorPerformanceCounters::Other::EVENT_CALLBACKS);
+		m_callbackDispatcher.onPowerOn();
+		m_callbackDispatcher.onNewTick(m_simulationTime);
+		for (auto i : utils::Range(m_dataState.resetState.size()))
+			m_callbackDispatcher.onReset(m_program->m_resetSources[i].pin, m_dataState.resetState[i].resetHigh);
+	}
+
+	startSimulationProcesses();
+}
+
 void ReferenceSimulator::reevaluate()
 {
 	m_performanceStats.thisEventNumReEvals++;
-	/// @todo respect dependencies between blocks (once they are being expressed and made use of)
-	for (auto &block : m_program.m_executionBlocks)
-		block.evaluate(m_callbackDispatcher, m_dataState, m_performanceCounters);
+
+	size_t numParallelBlocks = 0;
+	if (m_workerPool) {
+		numParallelBlocks = m_program->m_executionBlockGraph.size();
+		m_workerPool->run(m_program->m_executionBlockGraph, [&](size_t blockIdx, size_t thread) {
+			evaluateExecutionBlock(blockIdx, thread, true);
+		});
+	}
+
+	for (auto i : utils::Range(numParallelBlocks, m_program->m_executionBlocks.size()))
+		evaluateExecutionBlock(i, 0, false);
 
 	m_stateNeedsReevaluating = false;
 }
 
+void ReferenceSimulator::evaluateExecutionBlock(size_t blockIdx, size_t thread, bool concurrent)
+{
+	const auto &block = m_program->m_executionBlocks[blockIdx];
+	size_t numEvaluated;
+	if (m_options.activityDrivenEvaluation) {
+		numEvaluated = block.evaluateActive(m_callbackDispatcher, m_dataState, m_dataState.activityScratch[thread], concurrent, m_performanceCounters);
+	} else if (m_batchStates.size() > 1) {
+		block.evaluateBatch(m_callbackDispatcher, m_batchStates, m_performanceCounters);
+		numEvaluated = block.getNumSteps() * m_batchStates.size();
+	} else {
+		block.evaluate(m_callbackDispatcher, m_dataState, m_performanceCounters);
+		numEvaluated = block.getNumSteps();
+	}
+	m_numNodeEvaluations.fetch_add(numEvaluated, std::memory_order_relaxed);
+}
+
+SimulatorStatistics ReferenceSimulator::getStatistics() const
+{
+	return {
+		.numEvents = m_performanceStats.totalRuntimeNumEvents,
+		.numReevaluations = m_performanceStats.numReEvals,
+		.numNodeEvaluations = m_numNodeEvaluations.load(std::memory_order_relaxed),
+	};
+}
+
 void ReferenceSimulator::commitState()
 {
 	m_readOnlyMode = true;
 
-	for (auto &block : m_program.m_executionBlocks)
-		block.commitState(m_callbackDispatcher, m_dataState, m_performanceCounters);
+	for (auto &block : m_program->m_executionBlocks)
+		for (auto *state : m_batchStates)
+			block.commitState(m_callbackDispatcher, *state, m_performanceCounters);
 
 	{
 		RunTimeSimulationContext context(this);
 		auto perfHandle = m_performanceCounters.processOther(SimulatorPerformanceCounters::Other::SIMULATION_PROCESS);
 
-		std::vector<std::coroutine_handle<>> processesAwaitingCommit;
+		std::vector<std::pair<std::coroutine_handle<>, size_t>> processesAwaitingCommit;
 		std::swap(m_processesAwaitingCommit, processesAwaitingCommit);
-		for (auto &h : processesAwaitingCommit) {
+		for (auto &[h, batchIndex] : processesAwaitingCommit) {
+			m_currentBatchIndex = batchIndex;
 			m_coroutineHandler.readyToResume(h);
 			m_coroutineHandler.run();
 		}
@@ -795,7 +1863,7 @@ void ReferenceSimulator::advanceMicroTick()
 		switch (event.type) {
 			case Event::Type::clockPinTrigger: {
 				auto &clkEvent = event.evt<Event::ClockValueChangeEvt>();
-				auto &clkPin = m_program.m_clockSources[clkEvent.clockPinIdx];
+				auto &clkPin = m_program->m_clockSources[clkEvent.clockPinIdx];
 				// Check if any clock domain driven by this clk pin has an activation
 				for (auto domain : clkPin.domains) {
 					auto trigType = domain->clock->getTriggerEvent();
@@ -817,13 +1885,15 @@ void ReferenceSimulator::advanceMicroTick()
 							Event e = event;
 							e.type = Event::Type::simProcResume;
 							e.data = Event::SimProcResumeEvt{};
-							for (auto &simProc : domain->awaitingSimProcs) {
+							auto &awaitingSimProcs = m_clockAwaitingSimProcs[domain->index];
+							for (auto &simProc : awaitingSimProcs) {
 								e.evt<Event::SimProcResumeEvt>().handle = simProc.handle;
 								e.evt<Event::SimProcResumeEvt>().insertionId = simProc.sortId;
+								e.evt<Event::SimProcResumeEvt>().batchIndex = simProc.batchIndex;
 								e.timingPhase = simProc.timingPhase;
 								m_nextEvents.push(e);
 							}
-							domain->awaitingSimProcs.clear();
+							awaitingSimProcs.clear();
 						}
 					}
 				}
@@ -836,7 +1906,9 @@ void ReferenceSimulator::advanceMicroTick()
 
 				// Re-issue next clock flank
 				clkEvent.risingEdge = !clkEvent.risingEdge;
-				event.timeOfEvent += hlim::ClockRational(1,2) / clkPin.pin->absoluteFrequency();
+				event.timeOfEvent += clkPin.halfPeriod;
+				if (event.tick != ~0ull)
+					event.tick += clkPin.halfPeriodTicks;
 				event.microTick = 0;
 				m_nextEvents.push(event);
 			} break;
@@ -848,11 +1920,11 @@ void ReferenceSimulator::advanceMicroTick()
 				cs.high = clkEvent.risingEdge;
 
 				// Trigger all clocked nodes of all driven clock domains
-				auto &clkPin = m_program.m_clockSources[clkEvent.clockPinIdx];
+				auto &clkPin = m_program->m_clockSources[clkEvent.clockPinIdx];
 				for (auto domain : clkPin.domains) {
 
 					for (auto &cn : domain->clockedNodes)
-						cn.clockValueChanged(m_callbackDispatcher, m_dataState, clkEvent.risingEdge, true, m_performanceCounters);
+						trackClockedNodeActivity(cn, [&](DataState &state){ cn.clockValueChanged(m_callbackDispatcher, state, clkEvent.risingEdge, true, m_performanceCounters); });
 
 					auto trigType = domain->clock->getTriggerEvent();
 
@@ -863,8 +1935,7 @@ void ReferenceSimulator::advanceMicroTick()
 						//for (auto id : domain->dependentExecutionBlocks)
 							//triggeredExecutionBlocks.insert(id);
 
-						for (auto &cn : domain->clockedNodes)
-							cn.advance(m_callbackDispatcher, m_dataState, m_performanceCounters);
+						advanceClockDomain(*domain);
 					}
 				}
 
@@ -878,14 +1949,14 @@ void ReferenceSimulator::advanceMicroTick()
 				const auto &rstEvent = event.evt<Event::ResetValueChangeEvt>();
 				m_dataState.resetState[rstEvent.resetPinIdx].resetHigh = rstEvent.newResetHigh;
 
-				auto &rstSrc = m_program.m_resetSources[rstEvent.resetPinIdx];
+				auto &rstSrc = m_program->m_resetSources[rstEvent.resetPinIdx];
 
 				for (auto dom : rstSrc.domains) {
 					//for (auto id : dom->dependentExecutionBlocks)
 					//	triggeredExecutionBlocks.insert(id);
 
 					for (auto &cn : dom->clockedNodes)
-						cn.changeReset(m_callbackDispatcher, m_dataState, rstEvent.newResetHigh, m_performanceCounters);
+						trackClockedNodeActivity(cn, [&](DataState &state){ cn.changeReset(m_callbackDispatcher, state, rstEvent.newResetHigh, m_performanceCounters); });
 				}
 
 				{
@@ -897,6 +1968,7 @@ void ReferenceSimulator::advanceMicroTick()
 				RunTimeSimulationContext context(this);
 				auto perfHandle = m_performanceCounters.processOther(SimulatorPerformanceCounters::Other::SIMULATION_PROCESS);
 
+				m_currentBatchIndex = event.evt<Event::SimProcResumeEvt>().batchIndex;
 				m_coroutineHandler.readyToResume(event.evt<Event::SimProcResumeEvt>().handle);
 				m_coroutineHandler.run();
 			} break;
@@ -904,13 +1976,33 @@ void ReferenceSimulator::advanceMicroTick()
 	}
 }
 
+void ReferenceSimulator::advanceClockDomain(const ClockDomain &domain)
+{
+	if (!m_workerPool || domain.advanceGroups.empty()) {
+		for (auto &cn : domain.clockedNodes)
+			trackClockedNodeActivity(cn, [&](DataState &state){ cn.advance(m_callbackDispatcher, state, m_performanceCounters); });
+		return;
+	}
+
+	m_workerPool->run(domain.advanceGroups.size(), [&](size_t group, size_t thread) {
+		for (auto idx : domain.advanceGroups[group]) {
+			auto &cn = domain.clockedNodes[idx];
+			trackClockedNodeActivity(cn, [&](DataState &state){ cn.advance(m_callbackDispatcher, state, m_performanceCounters); }, thread, true);
+		}
+	});
+}
+
 void ReferenceSimulator::checkSignalWatches()
 {
 	// check if any signal watches triggered and if so schedule resumption of the corresponding fibers in insertion order
-	for (auto it = m_signalWatches.begin(); it != m_signalWatches.end(); ) {
-		if (it->anySignalChanged(m_dataState.signalState)) {
-			auto it2 = it; it++;
+	for (auto batchIndex : utils::Range(m_signalWatches.size())) {
+		auto &watches = m_signalWatches[batchIndex];
+		if (watches.empty()) continue;
 
+		m_triggeredSignalWatches.clear();
+		watches.collectTriggered(m_batchStates[batchIndex]->signalState, m_triggeredSignalWatches);
+
+		for (const auto &triggered : m_triggeredSignalWatches) {
 			Event e;
 			e.type = Event::Type::simProcResume;
 			e.timeOfEvent = m_simulationTime;
@@ -920,13 +2012,12 @@ void ReferenceSimulator::checkSignalWatches()
 				e.microTick = 0;
 			e.timingPhase = WaitClock::AFTER;
 			e.data = Event::SimProcResumeEvt {
-				.handle = it2->handle,
-				.insertionId = it2->insertionId,
+				.handle = triggered.handle,
+				.insertionId = triggered.insertionId,
+				.batchIndex = batchIndex,
 			};
 			m_nextEvents.push(e);
-
-			m_signalWatches.erase(it2);
-		} else ++it;
+		}
 	}
 }
 
@@ -1056,23 +2147,52 @@ void ReferenceSimulator::simProcSetInputPin(hlim::Node_Pin *pin, const ExtendedB
 {
 	HCL_DESIGNCHECK_HINT(!m_readOnlyMode, "Can not change simulation states after waiting for WaitStable");
 
-	auto it = m_program.m_stateMapping.nodeToInternalOffset.find(pin);
-	HCL_ASSERT(it != m_program.m_stateMapping.nodeToInternalOffset.end());
-	if (pin->setState(m_dataState.signalState, it->second.data(), state)) {
+	auto it = m_program->m_stateMapping.nodeToInternalOffset.find(pin);
+	HCL_ASSERT(it != m_program->m_stateMapping.nodeToInternalOffset.end());
+	if (pin->setState(currentBatchState().signalState, it->second.data(), state)) {
 		m_stateNeedsReevaluating = true; // Only mark state as dirty if the value of the pin was actually changed.
+		markNodeActive(pin);
 		auto perfHandle = m_performanceCounters.processOther(SimulatorPerformanceCounters::Other::EVENT_CALLBACKS);
 		m_callbackDispatcher.onSimProcOutputOverridden({.node=pin, .port=0}, state);
 	}
 }
 
+void ReferenceSimulator::simProcSetInputPinWord(hlim::Node_Pin *pin, size_t stateOffset, std::uint64_t value, std::uint64_t defined)
+{
+	HCL_DESIGNCHECK_HINT(!m_readOnlyMode, "Can not change simulation states after waiting for WaitStable");
+
+	size_t width = pin->getOutputConnectionType(0).width;
+	HCL_ASSERT(width <= 64);
+	auto mask = utils::bitMaskRange<std::uint64_t>(0, width);
+	value &= mask;
+	defined &= mask;
+
+	auto &state = currentBatchState().signalState;
+	auto oldValue = state.extract(DefaultConfig::VALUE, stateOffset, width);
+	auto oldDefined = state.extract(DefaultConfig::DEFINED, stateOffset, width);
+	state.insert(DefaultConfig::VALUE, stateOffset, width, value);
+	state.insert(DefaultConfig::DEFINED, stateOffset, width, defined);
+
+	// Same as Node_Pin::setState: Only defined bits can change their value.
+	if (((oldValue ^ value) & oldDefined) | (oldDefined ^ defined)) {
+		m_stateNeedsReevaluating = true; // Only mark state as dirty if the value of the pin was actually changed.
+		markNodeActive(pin);
+		if (m_simProcIOObserved) {
+			auto perfHandle = m_performanceCounters.processOther(SimulatorPerformanceCounters::Other::EVENT_CALLBACKS);
+			m_callbackDispatcher.onSimProcOutputOverridden({.node=pin, .port=0}, createExtendedBitVectorState(width, value, defined));
+		}
+	}
+}
+
 void ReferenceSimulator::simProcOverrideRegisterOutput(hlim::Node_Register *reg, const DefaultBitVectorState &state)
 {
 	HCL_DESIGNCHECK_HINT(!m_readOnlyMode, "Can not change simulation states after waiting for WaitStable");
 
-	auto it = m_program.m_stateMapping.outputToOffset.find({.node = reg, .port = 0ull});
-	HCL_ASSERT(it != m_program.m_stateMapping.outputToOffset.end());
-	if (reg->overrideOutput(m_dataState.signalState, it->second, state)) {
+	auto it = m_program->m_stateMapping.outputToOffset.find({.node = reg, .port = 0ull});
+	HCL_ASSERT(it != m_program->m_stateMapping.outputToOffset.end());
+	if (reg->overrideOutput(currentBatchState().signalState, it->second, state)) {
 		m_stateNeedsReevaluating = true; // Only mark state as dirty if the value of the pin was actually changed.
+		markNodeOutputsChanged(reg);
 		auto perfHandle = m_performanceCounters.processOther(SimulatorPerformanceCounters::Other::EVENT_CALLBACKS);
 		m_callbackDispatcher.onSimProcOutputOverridden({.node=reg, .port=0}, convertToExtended(state));
 	}
@@ -1083,22 +2203,22 @@ void ReferenceSimulator::simProcOverrideRegisterOutput(hlim::Node_Register *reg,
 
 bool ReferenceSimulator::outputOptimizedAway(const hlim::NodePort &nodePort)
 {
-	return !m_program.m_stateMapping.nodeToInternalOffset.contains(nodePort.node);
+	return !m_program->m_stateMapping.nodeToInternalOffset.contains(nodePort.node);
 }
 
 
 DefaultBitVectorState ReferenceSimulator::getValueOfInternalState(const hlim::BaseNode *node, size_t idx, size_t offset, size_t size)
 {
 	DefaultBitVectorState value;
-	auto it = m_program.m_stateMapping.nodeToInternalOffset.find((hlim::BaseNode *) node);
-	if (it == m_program.m_stateMapping.nodeToInternalOffset.end()) {
+	auto it = m_program->m_stateMapping.nodeToInternalOffset.find((hlim::BaseNode *) node);
+	if (it == m_program->m_stateMapping.nodeToInternalOffset.end()) {
 		value.resize(0);
 	} else {
 		size_t width = node->getInternalStateSizes()[idx];
 		HCL_ASSERT(offset < width);
 		width = std::min(width - offset, size);
 		offset += it->second[idx];
-		value = m_dataState.signalState.extract(offset, width);
+		value = currentBatchState().signalState.extract(offset, width);
 	}
 	return value;
 }
@@ -1107,23 +2227,39 @@ DefaultBitVectorState ReferenceSimulator::getValueOfOutput(const hlim::NodePort
 {
 	size_t width = nodePort.node->getOutputConnectionType(nodePort.port).width;
 
-	auto it = m_program.m_stateMapping.outputToOffset.find(nodePort);
-	if (it == m_program.m_stateMapping.outputToOffset.end()) {
+	auto it = m_program->m_stateMapping.outputToOffset.find(nodePort);
+	if (it == m_program->m_stateMapping.outputToOffset.end()) {
 		DefaultBitVectorState value;
 		value.resize(width);
 		value.clearRange(DefaultConfig::DEFINED, 0, width);
 		return value;
 	} else {
-		return m_dataState.signalState.extract(it->second, width);
+		return currentBatchState().signalState.extract(it->second, width);
 	}
 }
 
+size_t ReferenceSimulator::getOutputStateOffset(const hlim::NodePort &nodePort) const
+{
+	auto it = m_program->m_stateMapping.outputToOffset.find(nodePort);
+	if (it == m_program->m_stateMapping.outputToOffset.end())
+		return ~0ull;
+	return it->second;
+}
+
+size_t ReferenceSimulator::getInternalStateOffset(const hlim::BaseNode *node, size_t idx) const
+{
+	auto it = m_program->m_stateMapping.nodeToInternalOffset.find((hlim::BaseNode *) node);
+	if (it == m_program->m_stateMapping.nodeToInternalOffset.end())
+		return ~0ull;
+	return it->second[idx];
+}
+
 std::array<bool, DefaultConfig::NUM_PLANES> ReferenceSimulator::getValueOfClock(const hlim::Clock *clk)
 {
 	std::array<bool, DefaultConfig::NUM_PLANES> res;
 
-	auto it = m_program.m_stateMapping.clockPinAllocation.clock2ClockPinIdx.find((hlim::Clock *)clk);
-	if (it == m_program.m_stateMapping.clockPinAllocation.clock2ClockPinIdx.end()) {
+	auto it = m_program->m_stateMapping.clockPinAllocation.clock2ClockPinIdx.find((hlim::Clock *)clk);
+	if (it == m_program->m_stateMapping.clockPinAllocation.clock2ClockPinIdx.end()) {
 		res[DefaultConfig::DEFINED] = false;
 		return res;
 	}
@@ -1137,8 +2273,8 @@ std::array<bool, DefaultConfig::NUM_PLANES> ReferenceSimulator::getValueOfReset(
 {
 	std::array<bool, DefaultConfig::NUM_PLANES> res;
 
-	auto it = m_program.m_stateMapping.clockPinAllocation.clock2ResetPinIdx.find((hlim::Clock *)clk);
-	if (it == m_program.m_stateMapping.clockPinAllocation.clock2ResetPinIdx.end()) {
+	auto it = m_program->m_stateMapping.clockPinAllocation.clock2ResetPinIdx.find((hlim::Clock *)clk);
+	if (it == m_program->m_stateMapping.clockPinAllocation.clock2ResetPinIdx.end()) {
 		res[DefaultConfig::DEFINED] = false;
 		return res;
 	}
@@ -1180,6 +2316,7 @@ void ReferenceSimulator::simulationProcessSuspending(std::coroutine_handle<> han
 	e.data = Event::SimProcResumeEvt{
 		.handle = handle,
 		.insertionId = m_nextSimProcInsertionId++,
+		.batchIndex = m_currentBatchIndex,
 	};
 	m_nextEvents.push(e);
 }
@@ -1192,9 +2329,9 @@ void ReferenceSimulator::simulationProcessSuspending(std::coroutine_handle<> han
 
 void ReferenceSimulator::simulationProcessSuspending(std::coroutine_handle<> handle, WaitClock &waitClock, utils::RestrictTo<RunTimeSimulationContext>)
 {
-	auto it = m_program.m_clockDomains.find(const_cast<hlim::Clock*>(waitClock.getClock()));
+	auto it = m_program->m_clockDomains.find(const_cast<hlim::Clock*>(waitClock.getClock()));
 
-	if (it == m_program.m_clockDomains.end()) {
+	if (it == m_program->m_clockDomains.end()) {
 		// This clock is not part of the simulation, so just wait for as long as it would take for the next tick to arrive if it was there.
 		// Note that this ignores any resets of that clock
 
@@ -1210,14 +2347,16 @@ void ReferenceSimulator::simulationProcessSuspending(std::coroutine_handle<> han
 		e.data = Event::SimProcResumeEvt {
 			.handle = handle,
 			.insertionId = m_nextSimProcInsertionId++,
+			.batchIndex = m_currentBatchIndex,
 		};
 
 		m_nextEvents.push(e);
 	} else {
-		it->second.awaitingSimProcs.push_back({
+		m_clockAwaitingSimProcs[it->second.index].push_back({
 			.sortId = m_nextSimProcInsertionId++,
 			.timingPhase = waitClock.getTimingPhase(),
 			.handle = handle,
+			.batchIndex = m_currentBatchIndex,
 		});
 	}
 }
@@ -1225,18 +2364,20 @@ void ReferenceSimulator::simulationProcessSuspending(std::coroutine_handle<> han
 
 void ReferenceSimulator::simulationProcessSuspending(std::coroutine_handle<> handle, WaitChange &waitChange, utils::RestrictTo<RunTimeSimulationContext>)
 {
-	m_signalWatches.push_back(SignalWatch(
-		handle,
-		waitChange.getSensitivityList(),
-		m_program.m_stateMapping,
-		m_dataState.signalState,
-		m_nextSimProcInsertionId++
-	));
+	std::vector<SignalWatchIndex::Range> ranges;
+	for (const auto &np : waitChange.getSensitivityList().getSignals()) {
+		auto it = m_program->m_stateMapping.outputToOffset.find(np);
+		// if it isn't mapped, it never changes, so we never need to check for a change of it.
+		if (it == m_program->m_stateMapping.outputToOffset.end()) continue;
+		ranges.push_back({ .offset = it->second, .size = hlim::getOutputWidth(np) });
+	}
+
+	m_signalWatches[m_currentBatchIndex].add(handle, m_nextSimProcInsertionId++, ranges, currentBatchState().signalState);
 }
 
 void ReferenceSimulator::simulationProcessSuspending(std::coroutine_handle<> handle, WaitStable &waitStable, utils::RestrictTo<RunTimeSimulationContext>)
 {
-	m_processesAwaitingCommit.push_back(handle);
+	m_processesAwaitingCommit.push_back({ handle, m_currentBatchIndex });
 }
 
 /*
@@ -1266,12 +2407,12 @@ void ReferenceSimulator::startCoroutine(SimulationFunction<void> coroutine)
 
 bool ReferenceSimulator::hasAuxData(std::string_view key) const
 {
-	return m_dataState.auxData.contains(key);
+	return currentBatchState().auxData.contains(key);
 }
 
 std::any& ReferenceSimulator::registerAuxData(std::string_view key, std::any data)
 {
-	auto [it, success] = m_dataState.auxData.emplace(key, std::move(data));
+	auto [it, success] = currentBatchState().auxData.emplace(key, std::move(data));
 	if (!success)
 		throw std::runtime_error("Aux data with that key already registered");
 	return it->second;
@@ -1279,8 +2420,8 @@ std::any& ReferenceSimulator::registerAuxData(std::string_view key, std::any dat
 
 std::any& ReferenceSimulator::getAuxData(std::string_view key)
 {
-	auto it = m_dataState.auxData.find(key);
-	if (it == m_dataState.auxData.end())
+	auto it = currentBatchState().auxData.find(key);
+	if (it == currentBatchState().auxData.end())
 		throw std::runtime_error("Aux data not found!");
 	return it->second;
 }
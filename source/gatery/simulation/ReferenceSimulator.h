@@ -28,12 +28,17 @@
 #include "../hlim/postprocessing/ClockPinAllocation.h"
 #include "../hlim/Subnet.h"
 #include "simProc/SensitivityList.h"
+#include "WorkerPool.h"
+#include "EventQueue.h"
+#include "SignalWatchIndex.h"
 
 #include <vector>
 #include <functional>
 #include <map>
 #include <queue>
 #include <list>
+#include <atomic>
+#include <memory>
 
 namespace gtry::hlim {
 	class Node_Register;
@@ -56,6 +61,17 @@ struct DataState
 	std::vector<ClockState> clockState;
 	std::vector<ResetState> resetState;
 	std::map<std::string, std::any, std::less<>> auxData;
+
+	/// For activity driven evaluation, a bitmask per execution block of all steps that need reevaluation.
+	std::vector<std::vector<std::uint64_t>> activeSteps;
+	/// For activity driven evaluation, scratch space (one per thread) to detect whether a node changed its outputs.
+	std::vector<DefaultBitVectorState> activityScratch;
+	/// For two-state evaluation, a bitmask per execution block of all steps whose outputs were found to be fully defined.
+	/// Those steps are evaluated with simulateEvaluateDefined as long as their inputs are fully defined. Empty if two-state evaluation is disabled.
+	std::vector<std::vector<std::uint64_t>> fullyDefinedSteps;
+	/// For two-state evaluation, a bitmask per execution block of all steps whose outputs were fully defined after their last evaluation.
+	/// Readers consult these bits instead of scanning the defined plane of inputs that are written by other steps.
+	std::vector<std::vector<std::uint64_t>> definedOutputSteps;
 };
 
 struct StateMapping
@@ -78,17 +94,88 @@ struct MappedNode {
 	std::vector<size_t> outputs;
 };
 
+struct StepLocation
+{
+	size_t executionBlock = ~0ull;
+	size_t step = ~0ull;
+
+	auto operator<=>(const StepLocation&) const = default;
+};
+
 class ExecutionBlock
 {
 	public:
+		ExecutionBlock(size_t index) : m_index(index) { }
+
 		void evaluate(SimulatorCallbacks &simCallbacks, DataState &state, SimulatorPerformanceCounters &performanceCounters) const;
+		/// Evaluates each step for all instances of the batch before moving on to the next step.
+		/// @details Calls simulateEvaluate once per instance, the instances are not interleaved into a shared kernel.
+		void evaluateBatch(SimulatorCallbacks &simCallbacks, std::span<DataState* const> instances, SimulatorPerformanceCounters &performanceCounters) const;
+		/// Only evaluates the steps marked in DataState::activeSteps and, transitively, all steps whose inputs changed in the process.
+		/// @param scratch The calling thread's scratch space for detecting changes.
+		/// @param concurrent Whether other execution blocks may be marking steps at the same time.
+		/// Returns the number of evaluated steps.
+		size_t evaluateActive(SimulatorCallbacks &simCallbacks, DataState &state, DefaultBitVectorState &scratch, bool concurrent, SimulatorPerformanceCounters &performanceCounters) const;
 		void commitState(SimulatorCallbacks &simCallbacks, DataState &state, SimulatorPerformanceCounters &performanceCounters) const;
 
 		void addStep(MappedNode mappedNode);
+		/// @brief Determines for a step how two-state evaluation finds out whether its inputs are fully defined.
+		/// @param drivers The drivers of the inputs of the step.
+		/// @param producerOfOutput The steps whose evaluation writes (and thus tracks the definedness of) each output.
+		void resolveInputDefinedness(size_t step, const std::vector<hlim::NodePort> &drivers, const utils::UnstableMap<hlim::NodePort, StepLocation> &producerOfOutput);
+		/// Whether the step supports value-only evaluation in two-state mode.
+		inline bool hasDefinedEvaluation(size_t step) const { return utils::bitExtract(m_definedEvaluationSteps.data(), step); }
+
+		using AccessMap = utils::UnstableMap<size_t, std::vector<StepLocation>>;
+		/// Registers which offsets the steps of this block read as inputs and which (non-empty) internal state they access.
+		void collectAccesses(AccessMap &readersOfOffset, AccessMap &accessorsOfInternal) const;
+		/// Determines for each step which other steps (of any block) read its outputs or share its internal state. Required for evaluateActive.
+		void buildFanOut(const AccessMap &readersOfOffset, const AccessMap &accessorsOfInternal);
+
+		inline size_t getIndex() const { return m_index; }
+		inline size_t getNumSteps() const { return m_steps.size(); }
+		inline const MappedNode &getStep(size_t step) const { return m_steps[step]; }
+		/// Size of the scratch space (in bits) needed to capture the outputs of any step.
+		inline size_t getOutputScratchSize() const { return m_outputScratchSize; }
+
+		/// Copies the outputs of a step to the scratch space for a subsequent call to markChangedOutputs.
+		void captureOutputs(size_t step, const DataState &state, DefaultBitVectorState &scratch) const;
+		/// Compares the outputs of a step against those captured before and, if they differ, marks all steps reading them as active.
+		bool markChangedOutputs(size_t step, DataState &state, const DefaultBitVectorState &scratch, bool concurrent) const;
+		/// Marks all steps reading the outputs of the given step as active.
+		void markOutputReaders(size_t step, DataState &state, bool concurrent) const;
+		/// Marks all steps sharing internal state with the given step (e.g. the ports of a memory) as active.
+		void markInternalSharers(size_t step, DataState &state, bool concurrent) const;
 	protected:
-		//std::vector<size_t> m_dependsOnExecutionBlocks;
-		//std::vector<size_t> m_dependentExecutionBlocks;
+		size_t m_index;
 		std::vector<MappedNode> m_steps;
+		/// Bitmask of all steps whose nodes implement simulateEvaluateDefined and whose inputs are all connected.
+		std::vector<std::uint64_t> m_definedEvaluationSteps;
+
+		struct StepDefinedness {
+			/// Steps whose outputs are read by this step, their definedness is tracked in DataState::definedOutputSteps.
+			std::vector<StepLocation> producers;
+			/// Offsets and widths of all inputs that are not written by the evaluation of any step (e.g. register outputs).
+			std::vector<std::pair<size_t, size_t>> otherInputs;
+			std::vector<size_t> outputWidths;
+		};
+		std::vector<StepDefinedness> m_definedness;
+
+		/// Evaluates a step and, for two-state evaluation, switches it to value-only evaluation while its inputs and outputs are fully defined.
+		void evaluateStep(size_t step, SimulatorCallbacks &simCallbacks, DataState &state) const;
+		bool inputsFullyDefined(size_t step, const DataState &state) const;
+		bool outputsFullyDefined(size_t step, const DataState &state) const;
+
+		struct StepFanOut {
+			/// Steps that read any of the outputs of this step.
+			std::vector<StepLocation> outputReaders;
+			/// Steps (possibly including this one) that access internal state which is also accessed by this step.
+			std::vector<StepLocation> internalSharers;
+			/// Widths of the outputs of this step.
+			std::vector<size_t> outputWidths;
+		};
+		std::vector<StepFanOut> m_fanOut;
+		size_t m_outputScratchSize = 0;
 };
 
 class ClockedNode
@@ -99,9 +186,18 @@ class ClockedNode
 		void clockValueChanged(SimulatorCallbacks &simCallbacks, DataState &state, bool clockValue, bool clockDefined, SimulatorPerformanceCounters &performanceCounters) const;
 		void advance(SimulatorCallbacks &simCallbacks, DataState &state, SimulatorPerformanceCounters &performanceCounters) const;
 		void changeReset(SimulatorCallbacks &simCallbacks, DataState &state, bool resetHigh, SimulatorPerformanceCounters &performanceCounters) const;
+
+		inline const MappedNode &getMappedNode() const { return m_mappedNode; }
+
+		/// Links this clocked node to the step of the same node in the execution blocks for activity driven evaluation.
+		void setStep(size_t executionBlock, size_t step) { m_executionBlock = executionBlock; m_step = step; }
+		inline size_t getExecutionBlock() const { return m_executionBlock; }
+		inline size_t getStep() const { return m_step; }
 	protected:
 		MappedNode m_mappedNode;
 		size_t m_clockPort;
+		size_t m_executionBlock = ~0ull;
+		size_t m_step = ~0ull;
 };
 
 
@@ -109,6 +205,7 @@ struct ClockAwaitingSimProc {
 	std::uint64_t sortId;
 	WaitClock::TimingPhase timingPhase;
 	std::coroutine_handle<> handle;
+	size_t batchIndex = 0;
 };
 
 /**
@@ -116,13 +213,16 @@ struct ClockAwaitingSimProc {
  */
 struct ClockDomain
 {
+	/// Index of the clock domain in the program.
+	size_t index = ~0ull;
 	hlim::Clock *clock = nullptr;
 	size_t clockSourceIdx = ~0ull;
 	size_t resetSourceIdx = ~0ull;
 	std::vector<ClockedNode> clockedNodes;
 	std::vector<size_t> dependentExecutionBlocks;
-
-	std::vector<ClockAwaitingSimProc> awaitingSimProcs;
+	/// For multi threaded simulation, the indices of the clocked nodes split into groups that can be advanced concurrently.
+	/// Empty if the clock domain is to be advanced by a single thread.
+	std::vector<std::vector<size_t>> advanceGroups;
 };
 
 /**
@@ -137,92 +237,105 @@ struct ClockPin
 	size_t srcSignalIdx = ~0ull; 
 	/// All the domains affected by this source.
 	std::vector<ClockDomain*> domains;
+	/// For clocks, the time between two clock edges.
+	hlim::ClockRational halfPeriod = {0};
+	/// For clocks, halfPeriod in ticks of the event queue.
+	std::uint64_t halfPeriodTicks = ~0ull;
 };
 
+/**
+ * @brief The circuit compiled for simulation, which is not modified by simulating it and can thus be shared among simulators.
+ */
 struct Program
 {
-	void compileProgram(const hlim::Circuit &circuit, const hlim::Subnet &nodes, SimulatorPerformanceCounters &performanceCounters);
+	/// The inputs of a compilation: the nodes, their connections and state sizes, the clocks, and the compile options.
+	struct CompilationKey {
+		std::vector<std::uint64_t> data;
+		/// Hash of the data, which only selects the bucket in which cached programs are compared by their whole key.
+		std::uint64_t hash = 0;
+
+		void add(std::uint64_t value) { data.push_back(value); }
+		void add(const hlim::ClockRational &value) { add(value.numerator()); add(value.denominator()); }
+	};
+
+	/**
+	 * @brief Returns a program that was compiled with the same inputs by any other simulator that still uses it, or compiles a new one.
+	 * @details Compilations are identified by their @ref CompilationKey.
+	 */
+	static std::shared_ptr<const Program> compileShared(const hlim::Circuit &circuit, const hlim::Subnet &nodes, SimulatorPerformanceCounters &performanceCounters, bool buildFanOut = false, size_t numThreads = 1, StateLayout stateLayout = StateLayout::EVALUATION_ORDER);
+	static CompilationKey compilationKey(const hlim::Subnet &nodes, bool buildFanOut, size_t numThreads, StateLayout stateLayout);
+	/// Returns the program that is cached under the key, or caches and returns the one built by compile. Programs with equal hashes but different keys are cached side by side.
+	static std::shared_ptr<const Program> findOrCompileShared(const CompilationKey &key, const std::function<std::shared_ptr<Program>()> &compile);
 
+	/// @param numThreads If larger than one, splits the execution blocks and clocked nodes such that they can be processed by this many threads concurrently.
+	void compileProgram(const hlim::Circuit &circuit, const hlim::Subnet &nodes, SimulatorPerformanceCounters &performanceCounters, bool buildFanOut = false, size_t numThreads = 1, StateLayout stateLayout = StateLayout::EVALUATION_ORDER);
+
+	/// Unique id of this compilation, see Simulator::getProgramId.
+	size_t m_id = 0;
 	size_t m_fullStateWidth = 0;
+	/// Hash of the state offsets of all outputs and internal states by node id, to tell whether a checkpoint fits this program's state.
+	std::uint64_t m_layoutHash = 0;
 
 	StateMapping m_stateMapping;
 
 	std::vector<MappedNode> m_powerOnNodes;
 	std::vector<ClockPin> m_clockSources;
 	std::vector<ClockPin> m_resetSources;
+	/// Largest duration that evenly divides the half periods of all clocks, used as the tick of the event queue.
+	hlim::ClockRational m_tickDuration = {0};
 	utils::UnstableMap<hlim::Clock*, ClockDomain> m_clockDomains;
 	std::vector<ExecutionBlock> m_executionBlocks;
+	/// Dependencies between the execution blocks that can be evaluated concurrently, which are the first m_executionBlockGraph.size() ones.
+	/// All remaining execution blocks must be evaluated afterwards by the simulation thread.
+	TaskGraph m_executionBlockGraph;
+	/// Location of each node's step in the execution blocks. Only filled if the fan-out was built for activity driven evaluation.
+	utils::UnstableMap<hlim::BaseNode*, StepLocation> m_nodeToStep;
 
 	protected:
-		void allocateSignals(const hlim::Circuit &circuit, const hlim::Subnet &nodes);
-		void allocateClocks(const hlim::Circuit &circuit, const hlim::Subnet &nodes);
-};
-
-struct Event {
-	enum class Type {
-		clockPinTrigger,
-		simProcResume,
-		clockValueChange,
-		resetValueChange,
-	};
-	Type type = Type::clockPinTrigger;
-	hlim::ClockRational timeOfEvent = {0};
-	size_t microTick = 0;
-	WaitClock::TimingPhase timingPhase = WaitClock::DURING;
-
-	struct ClockValueChangeEvt {
-		size_t clockPinIdx = ~0ull;
-		bool risingEdge = false;
-	};
-	struct ResetValueChangeEvt {
-		size_t resetPinIdx = ~0ull;
-		bool newResetHigh = false;
-	};
-	struct SimProcResumeEvt {
-		std::coroutine_handle<> handle;
-		std::uint64_t insertionId = ~0ull;
-	};
+		/// A node to be evaluated together with the (non-forwarding) drivers of its inputs.
+		struct ScheduledNode {
+			hlim::BaseNode *node;
+			std::vector<hlim::NodePort> inputs;
+		};
 
-	std::variant<ClockValueChangeEvt, ResetValueChangeEvt, SimProcResumeEvt> data = ClockValueChangeEvt{};
-
-	template<typename T>
-	T &evt() { return std::get<T>(data); }
-	template<typename T>
-	const T &evt() const { return std::get<T>(data); }
-
-	bool operator<(const Event &rhs) const {
-		if (hlim::clockMore(timeOfEvent, rhs.timeOfEvent)) return true;
-		if (hlim::clockLess(timeOfEvent, rhs.timeOfEvent)) return false;
-		if (timingPhase > rhs.timingPhase) return true;
-		if (timingPhase < rhs.timingPhase) return false;
-		if (microTick > rhs.microTick) return true;
-		if (microTick < rhs.microTick) return false;
-		if ((unsigned)type > (unsigned) rhs.type) return true; // fibers before clocks
-		if ((unsigned)type < (unsigned)rhs.type) return false; // fibers before clocks
-		if (type == Type::simProcResume)
-			return evt<SimProcResumeEvt>().insertionId > rhs.evt<SimProcResumeEvt>().insertionId;
-		return false;
-	}
-};
+		/// Identifies state that is written concurrently to other state and thus must not share 64-bit words with it.
+		struct AllocationGroup {
+			/// The execution block in which the node is evaluated.
+			size_t executionBlock = ~0ull;
+			/// The group of clocked nodes with which the node is advanced.
+			size_t advanceGroup = ~0ull;
 
-struct SignalWatch {
-	struct Signal {
-		size_t refStateIdx = ~0ull;
-		size_t stateIdx = ~0ull;
-		size_t size = ~0ull;
-	};
-	std::vector<Signal> signals;
-	sim::DefaultBitVectorState refState;
-	std::coroutine_handle<> handle;
-	std::uint64_t insertionId;
+			auto operator<=>(const AllocationGroup&) const = default;
+		};
 
-	SignalWatch(std::coroutine_handle<> handle, const SensitivityList &list, const StateMapping &stateMapping, const sim::DefaultBitVectorState &state, std::uint64_t insertionId);
+		void allocateSignals(const hlim::Circuit &circuit, const hlim::Subnet &nodes, const std::vector<ScheduledNode> &schedule, const utils::UnstableMap<hlim::BaseNode*, AllocationGroup> &allocationGroups, StateLayout stateLayout);
+		void allocateClocks(const hlim::Circuit &circuit, const hlim::Subnet &nodes);
+		/// Splits the topologically sorted nodes into execution blocks with dependencies among them and groups the clocked nodes for concurrent advancing.
+		void partitionExecutionBlocks(const std::vector<ScheduledNode> &schedule, size_t numThreads, std::vector<size_t> &blockOfStep, utils::UnstableMap<hlim::BaseNode*, AllocationGroup> &allocationGroups);
+		MappedNode mapNode(hlim::BaseNode *node, const std::vector<hlim::NodePort> &inputs);
+		void buildFanOut();
+		void hashLayout();
+};
 
-	bool anySignalChanged(const sim::DefaultBitVectorState &state) const;
+/**
+ * @brief State of a ReferenceSimulator between two time steps, see @ref Simulator::saveCheckpoint.
+ */
+struct ReferenceSimulatorCheckpoint : public SimulatorCheckpoint
+{
+	size_t fullStateWidth = 0;
+	/// See @ref Program::m_layoutHash, a checkpoint can only be restored into a program with the same layout.
+	std::uint64_t layoutHash = 0;
+	/// The signal state of each instance of the batch.
+	std::vector<DefaultBitVectorState> signalStates;
+	std::vector<ClockState> clockState;
+	std::vector<ResetState> resetState;
+	/// The data of simulation processes of each instance of the batch. Only kept in memory, not saved to files.
+	std::vector<std::map<std::string, std::any, std::less<>>> auxData;
+	/// All pending clock and reset events.
+	std::vector<Event> pendingEvents;
 
-	bool operator<(const SignalWatch &rhs) const {
-		return insertionId > rhs.insertionId;
-	}
+	virtual void save(std::ostream &stream) const override;
+	void load(std::istream &stream);
 };
 
 class ReferenceSimulator : public Simulator
@@ -235,6 +348,26 @@ class ReferenceSimulator : public Simulator
 
 
 		virtual void powerOn() override;
+		virtual std::unique_ptr<SimulatorCheckpoint> saveCheckpoint() override;
+		virtual std::unique_ptr<SimulatorCheckpoint> loadCheckpoint(std::istream &stream) override;
+		virtual void restoreCheckpoint(const SimulatorCheckpoint &checkpoint) override;
+
+		/**
+		 * @brief Creates a simulator for the same circuit and compile options without compiling it again.
+		 * @details The fork shares the compiled program with this simulator. It has no simulation processes, callbacks, or console output
+		 * and always runs single threaded.
+		 * Continue it from a checkpoint of this simulator with restoreCheckpoint.
+		 */
+		std::unique_ptr<ReferenceSimulator> fork() const;
+
+		using VariantFunction = std::function<void(size_t variant, ReferenceSimulator &simulator)>;
+		/**
+		 * @brief Continues the simulation from the current state in numVariants forks that are simulated concurrently.
+		 * @details For each variant, setupVariant adds the simulation processes (and possibly callbacks) of that variant to its fork.
+		 * The fork then continues from the current state and runVariant drives its simulation, e.g. by calling advance.
+		 * Both are called on the thread that simulates the variant. Returns once all variants are done, this simulator is not changed.
+		 */
+		void forkVariants(size_t numVariants, const VariantFunction &setupVariant, const VariantFunction &runVariant);
 		virtual void reevaluate() override;
 		virtual void commitState() override;
 		virtual void advanceEvent() override;
@@ -243,8 +376,11 @@ class ReferenceSimulator : public Simulator
 		virtual bool abortCalled() const override { return m_abortCalled; }
 
 		virtual bool simulationIsShuttingDown() const override { return m_simulationIsShuttingDown; }
+		virtual size_t getCurrentBatchIndex() const override { return m_currentBatchIndex; }
+		virtual SimulatorStatistics getStatistics() const override;
 
 		virtual void simProcSetInputPin(hlim::Node_Pin *pin, const ExtendedBitVectorState &state) override;
+		virtual void simProcSetInputPinWord(hlim::Node_Pin *pin, size_t stateOffset, std::uint64_t value, std::uint64_t defined) override;
 		virtual void simProcOverrideRegisterOutput(hlim::Node_Register *reg, const DefaultBitVectorState &state) override;
 
 		virtual bool outputOptimizedAway(const hlim::NodePort &nodePort) override;
@@ -252,6 +388,13 @@ class ReferenceSimulator : public Simulator
 		virtual DefaultBitVectorState getValueOfOutput(const hlim::NodePort &nodePort) override;
 		virtual std::array<bool, DefaultConfig::NUM_PLANES> getValueOfClock(const hlim::Clock *clk) override;
 		virtual std::array<bool, DefaultConfig::NUM_PLANES> getValueOfReset(const hlim::Clock *clk) override;
+		virtual const DefaultBitVectorState *getSignalState() const override { return &currentBatchState().signalState; }
+		virtual size_t getOutputStateOffset(const hlim::NodePort &nodePort) const override;
+		virtual size_t getInternalStateOffset(const hlim::BaseNode *node, size_t idx) const override;
+		virtual size_t getProgramId() const override { return m_program ? m_program->m_id : 0; }
+
+		/// The compiled circuit, which may be shared with other simulators.
+		inline const std::shared_ptr<const Program> &getProgram() const { return m_program; }
 
 		virtual void addSimulationProcess(std::function<SimulationFunction<void>()> simProc) override;
 		virtual void addSimulationFiber(std::function<void()> simFiber) override;
@@ -268,24 +411,42 @@ class ReferenceSimulator : public Simulator
 		virtual std::any& getAuxData(std::string_view key) override;
 	protected:
 		CompileOptions m_options;
-		Program m_program;
+		std::shared_ptr<const Program> m_program;
+		/// Simulation processes waiting for the next activation of each clock domain of the program.
+		std::vector<std::vector<ClockAwaitingSimProc>> m_clockAwaitingSimProcs;
+		/// State of instance 0, which also holds the clock and reset states shared by the whole batch.
 		DataState m_dataState;
+		/// States of instances 1 and up if a batch of multiple instances of the circuit is simulated.
+		std::vector<DataState> m_additionalBatchStates;
+		/// Pointers to the states of all instances of the batch, starting with m_dataState.
+		std::vector<DataState*> m_batchStates;
+		/// Instance of the batch that the currently running simulation process belongs to.
+		size_t m_currentBatchIndex = 0;
 		std::vector<std::uint64_t> m_simVizStates;
 		std::vector<size_t> m_simVizStateOffsets;
 
-		std::priority_queue<Event> m_nextEvents;
+		EventQueue m_nextEvents;
+
+		/// Worker threads for multi threaded simulation, null if the simulation runs single threaded.
+		std::unique_ptr<WorkerPool> m_workerPool;
 
 		void destroyPendingEvents();
+		/// Sets up the states of all instances of the batch for a new simulation at time zero, shared by powerOn and restoreCheckpoint.
+		void initializeBatchStates();
+		/// Starts all simulation processes, fibers, and visualizations after the state was powered on or restored.
+		void startSimulationProcesses();
 
 
 		SimulationCoroutineHandler m_coroutineHandler;
 
-		std::vector<std::coroutine_handle<>> m_processesAwaitingCommit;
+		std::vector<std::pair<std::coroutine_handle<>, size_t>> m_processesAwaitingCommit;
 		std::vector<std::function<SimulationFunction<>()>> m_simProcs;
 		std::vector<std::function<void()>> m_simFiberBodies;
 		std::list<SimulationFiber> m_simFibers;
 		std::vector<sim::SimulationVisualization> m_simViz;
-		std::list<SignalWatch> m_signalWatches;
+		/// Simulation processes waiting for signals to change, for each instance of the batch.
+		std::vector<SignalWatchIndex> m_signalWatches;
+		std::vector<SignalWatchIndex::TriggeredWatch> m_triggeredSignalWatches;
 		bool m_stateNeedsReevaluating = false;
 		std::uint64_t m_nextSimProcInsertionId = 0;
 
@@ -302,13 +463,34 @@ class ReferenceSimulator : public Simulator
 		};
 
 		PerformanceStats m_performanceStats;
+		/// Summed up by the threads evaluating execution blocks.
+		std::atomic<std::uint64_t> m_numNodeEvaluations = 0;
 
 		std::optional<SimulatorConsoleOutput> m_simulatorConsoleOutput;
 
 		void advanceMicroTick();
+		void advanceClockDomain(const ClockDomain &domain);
+		/// Evaluates the execution block with the given index during reevaluate().
+		/// @param thread Index of the calling thread.
+		/// @param concurrent Whether other execution blocks are being evaluated at the same time.
+		virtual void evaluateExecutionBlock(size_t blockIdx, size_t thread, bool concurrent);
 		void checkSignalWatches();
 		void handleCurrentTimeStep();
 
+		/// Runs a state change of a clocked node and, for activity driven evaluation, marks everything affected by it for reevaluation.
+		/// @param thread Index of the calling thread, if called from a worker thread.
+		/// @param concurrent Whether other threads are processing clocked nodes at the same time.
+		template<typename Functor>
+		void trackClockedNodeActivity(const ClockedNode &clockedNode, Functor functor, size_t thread = 0, bool concurrent = false);
+		/// For activity driven evaluation, marks the step of the given node for reevaluation.
+		void markNodeActive(hlim::BaseNode *node);
+		/// For activity driven evaluation, marks all readers of the outputs of the given node for reevaluation.
+		void markNodeOutputsChanged(hlim::BaseNode *node);
+		/// For two-state evaluation, returns all nodes to regular evaluation because undefined values were injected into the circuit.
+		void resetFullyDefinedSteps();
+		inline DataState &currentBatchState() { return *m_batchStates[m_currentBatchIndex]; }
+		inline const DataState &currentBatchState() const { return *m_batchStates[m_currentBatchIndex]; }
+
 		virtual void startCoroutine(SimulationFunction<void> coroutine) override;
 };
 
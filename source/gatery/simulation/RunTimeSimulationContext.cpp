@@ -71,6 +71,67 @@ void RunTimeSimulationContext::getSignal(const SigHandle &handle, DefaultBitVect
 	state = m_simulator->simProcGetValueOfOutput(handle.getOutput());
 }
 
+bool RunTimeSimulationContext::inPlaceAccess() const
+{
+	return m_simulator->getProgramId() != 0 && !m_simulator->simProcIOObserved();
+}
+
+void RunTimeSimulationContext::bind(SigHandle &handle)
+{
+	if (!inPlaceAccess())
+		return;
+
+	auto &binding = handle.getBinding();
+	auto programId = m_simulator->getProgramId();
+	if (binding.programId != programId) {
+		binding = {};
+		binding.programId = programId;
+		binding.stateOffset = m_simulator->getOutputStateOffset(handle.getOutput());
+	}
+}
+
+const DefaultBitVectorState *RunTimeSimulationContext::getSignalInPlace(const SigHandle &handle, size_t &offset)
+{
+	if (!inPlaceAccess())
+		return nullptr;
+
+	// Handles created outside of this program are looked up without caching, since other threads may be reading the same handle.
+	const auto &binding = handle.getBinding();
+	size_t stateOffset;
+	if (binding.programId == m_simulator->getProgramId())
+		stateOffset = binding.stateOffset;
+	else
+		stateOffset = m_simulator->getOutputStateOffset(handle.getOutput());
+
+	// Outputs that are not simulated are read as undefined through getSignal.
+	if (stateOffset == ~0ull)
+		return nullptr;
+
+	offset = stateOffset;
+	return m_simulator->getSignalState();
+}
+
+void RunTimeSimulationContext::overrideSignalWord(SigHandle &handle, std::uint64_t value, std::uint64_t defined)
+{
+	if (!inPlaceAccess()) {
+		SimulationContext::overrideSignalWord(handle, value, defined);
+		return;
+	}
+
+	bind(handle);
+	auto &binding = handle.getBinding();
+	if (binding.pin == nullptr) {
+		binding.pin = hlim::findInputPin(handle.getOutput());
+		HCL_DESIGNCHECK_HINT(binding.pin != nullptr, "Only io pin inputs allow run time overrides, but none was found!");
+		binding.pinStateOffset = m_simulator->getInternalStateOffset(binding.pin, 0);
+	}
+
+	if (binding.pinStateOffset == ~0ull)
+		SimulationContext::overrideSignalWord(handle, value, defined);
+	else
+		m_simulator->simProcSetInputPinWord(binding.pin, binding.pinStateOffset, value, defined);
+}
+
 void RunTimeSimulationContext::simulationProcessSuspending(std::coroutine_handle<> handle, WaitFor &waitFor)
 {
 	m_simulator->simulationProcessSuspending(handle, waitFor, {});
@@ -18,6 +18,7 @@
 #pragma once
 
 #include "SimulationContext.h"
+#include "SigHandle.h"
 
 #include <gatery/utils/StableContainers.h>
 
@@ -38,6 +39,9 @@ class RunTimeSimulationContext : public SimulationContext {
 		virtual void overrideSignal(const SigHandle &handle, const ExtendedBitVectorState &state) override;
 		virtual void overrideRegister(const SigHandle &handle, const DefaultBitVectorState &state) override;
 		virtual void getSignal(const SigHandle &handle, DefaultBitVectorState &state) override;
+		virtual const DefaultBitVectorState *getSignalInPlace(const SigHandle &handle, size_t &offset) override;
+		virtual void overrideSignalWord(SigHandle &handle, std::uint64_t value, std::uint64_t defined) override;
+		virtual void bind(SigHandle &handle) override;
 
 		virtual void onDebugMessage(const hlim::BaseNode *src, std::string msg) override;
 		virtual void onWarning(const hlim::BaseNode *src, std::string msg) override;
@@ -59,6 +63,9 @@ class RunTimeSimulationContext : public SimulationContext {
 
 		///@todo: This is not being cached because RunTimeSimulationContext is a very temporary object in the simulator
 		utils::UnstableMap<hlim::NodePort, hlim::Node_Pin*> m_sigOverridePinCache; 
+
+		/// Whether signals can be accessed in place, which requires an exposed state and no callbacks that observe every access.
+		bool inPlaceAccess() const;
 };
 
 
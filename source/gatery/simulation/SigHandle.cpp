@@ -32,6 +32,12 @@ size_t SigHandle::getWidth() const
 void SigHandle::operator=(std::uint64_t v)
 {
 	auto width = getWidth();
+	if (width <= 64 && !m_overrideRegister) {
+		if (width)
+			SimulationContext::current()->overrideSignalWord(*this, v, ~0ull);
+		return;
+	}
+
 	ExtendedBitVectorState state;
 	state.resize(width);
 	state.setRange(ExtendedConfig::DEFINED, 0, width);
@@ -47,6 +53,12 @@ void SigHandle::operator=(std::uint64_t v)
 void SigHandle::operator=(std::int64_t v)
 {
 	auto width = getWidth();
+	if (width <= 64 && !m_overrideRegister) {
+		if (width)
+			SimulationContext::current()->overrideSignalWord(*this, (std::uint64_t) v, ~0ull);
+		return;
+	}
+
 	ExtendedBitVectorState state;
 	state.resize(width);
 	state.setRange(ExtendedConfig::DEFINED, 0, width);
@@ -100,6 +112,14 @@ void SigHandle::operator=(std::span<const std::byte> rhs)
 	auto width = getWidth();
 	HCL_DESIGNCHECK_HINT(width == rhs.size() * 8, "The array that is to be assigned to the simulation signal has the wrong size!");
 
+	if (width <= 64 && !m_overrideRegister) {
+		std::uint64_t value = 0;
+		memcpy(&value, rhs.data(), rhs.size());
+		if (width)
+			SimulationContext::current()->overrideSignalWord(*this, value, ~0ull);
+		return;
+	}
+
 	if (m_overrideRegister)
 		SimulationContext::current()->overrideRegister(*this, sim::createDefaultBitVectorState(rhs.size()*8, rhs.data()));
 	else
@@ -109,6 +129,12 @@ void SigHandle::operator=(std::span<const std::byte> rhs)
 void SigHandle::invalidate()
 {
 	auto width = getWidth();
+	if (width <= 64 && !m_overrideRegister) {
+		if (width)
+			SimulationContext::current()->overrideSignalWord(*this, 0, 0);
+		return;
+	}
+
 	if (m_overrideRegister) {
 		DefaultBitVectorState state;
 		state.resize(width);
@@ -140,6 +166,10 @@ std::uint64_t SigHandle::value() const
 		return 0;
 
 	HCL_ASSERT(width <= 64);
+	size_t offset;
+	if (auto *inPlace = SimulationContext::current()->getSignalInPlace(*this, offset))
+		return inPlace->extract(DefaultConfig::VALUE, offset, width);
+
 	DefaultBitVectorState state;
 	SimulationContext::current()->getSignal(*this, state);
 	//HCL_ASSERT(sim::allDefinedNonStraddling(state, 0, width));
@@ -159,6 +189,16 @@ bool SigHandle::allDefined() const
 	if (!width)
 		return true;
 
+	size_t offset;
+	if (auto *inPlace = SimulationContext::current()->getSignalInPlace(*this, offset)) {
+		for (size_t i = 0; i < width; i += 64) {
+			size_t chunkSize = std::min<size_t>(64, width - i);
+			if (inPlace->extract(DefaultConfig::DEFINED, offset + i, chunkSize) != utils::bitMaskRange<std::uint64_t>(0, chunkSize))
+				return false;
+		}
+		return true;
+	}
+
 	DefaultBitVectorState state;
 	SimulationContext::current()->getSignal(*this, state);
 	return sim::allDefined<DefaultConfig>(state);
@@ -171,6 +211,10 @@ std::uint64_t SigHandle::defined() const
 		return 0;
 
 	HCL_ASSERT(width <= 64);
+	size_t offset;
+	if (auto *inPlace = SimulationContext::current()->getSignalInPlace(*this, offset))
+		return inPlace->extract(DefaultConfig::DEFINED, offset, width);
+
 	DefaultBitVectorState state;
 	SimulationContext::current()->getSignal(*this, state);
 	return state.extractNonStraddling(DefaultConfig::DEFINED, 0, width);
@@ -210,11 +254,7 @@ SigHandle::operator std::int64_t () const
 	if (!width)
 		return 0;
 
-	HCL_ASSERT(width <= 64);
-	DefaultBitVectorState state;
-	SimulationContext::current()->getSignal(*this, state);
-
-	std::uint64_t res = state.extractNonStraddling(DefaultConfig::VALUE, 0, width);
+	std::uint64_t res = value();
 	if (width < 64) {
 		bool negative = res >> (width-1);
 		if (negative)
@@ -228,10 +268,7 @@ SigHandle::operator bool () const
 	auto width = getWidth();
 	HCL_ASSERT(width == 1);
 
-	DefaultBitVectorState state;
-	SimulationContext::current()->getSignal(*this, state);
-
-	return state.get(sim::DefaultConfig::VALUE);
+	return value() != 0;
 }
 
 SigHandle::operator char () const
@@ -239,13 +276,10 @@ SigHandle::operator char () const
 	auto width = getWidth();
 	HCL_ASSERT(width == 1);
 
-	DefaultBitVectorState state;
-	SimulationContext::current()->getSignal(*this, state);
-
-	if (!state.get(sim::DefaultConfig::DEFINED))
+	if (!defined())
 		return 'x';
 
-	return state.get(sim::DefaultConfig::VALUE)?'1':'0';
+	return value()?'1':'0';
 }
 
 bool SigHandle::operator==(std::uint64_t v) const
@@ -290,28 +324,40 @@ bool SigHandle::operator==(char v) const
 {
 	if (v == '-') return true;
 
-	DefaultBitVectorState state;
-	SimulationContext::current()->getSignal(*this, state);
-	HCL_ASSERT(state.size() == 1);
+	HCL_ASSERT(getWidth() == 1);
 
 	if (v == 'x' || v == 'X')
-		return !state.get(sim::DefaultConfig::DEFINED);
-	if (!state.get(sim::DefaultConfig::DEFINED)) 
+		return !defined();
+	if (!defined()) 
 		return false;
 
 	HCL_DESIGNCHECK_HINT(v == '0' || v == '1', "Only '0' and '1' are valid values for comparison with a bit signal!")
 			
 	if (v == '1')
-		return state.get(sim::DefaultConfig::VALUE) == true;
+		return value() == 1;
 	else
-		return state.get(sim::DefaultConfig::VALUE) == false;
+		return value() == 0;
 }
 
 bool SigHandle::operator==(std::span<const std::byte> rhs) const
 {
 	auto width = getWidth();
 	HCL_DESIGNCHECK_HINT(width == rhs.size()*8, "The array that is to be compared to the simulation signal has the wrong size!");
-	
+
+	size_t offset;
+	if (auto *inPlace = SimulationContext::current()->getSignalInPlace(*this, offset)) {
+		for (size_t i = 0; i < width; i += 64) {
+			size_t chunkSize = std::min<size_t>(64, width - i);
+			std::uint64_t expected = 0;
+			memcpy(&expected, rhs.data() + i / 8, chunkSize / 8);
+			if (inPlace->extract(DefaultConfig::DEFINED, offset + i, chunkSize) != utils::bitMaskRange<std::uint64_t>(0, chunkSize))
+				return false;
+			if (inPlace->extract(DefaultConfig::VALUE, offset + i, chunkSize) != expected)
+				return false;
+		}
+		return true;
+	}
+
 	DefaultBitVectorState state;
 	SimulationContext::current()->getSignal(*this, state);
 
@@ -324,6 +370,14 @@ void SigHandle::overrideDrivingRegister()
 		m_output = reg->getNonForwardingDriver(hlim::Node_Register::DATA);
 	
 	m_overrideRegister = true;
+	m_binding = {};
+	bind();
+}
+
+void SigHandle::bind()
+{
+	if (auto *context = SimulationContext::current())
+		context->bind(*this);
 }
 
 }
@@ -27,11 +27,15 @@
 
 #include <span>
 
+namespace gtry::hlim {
+	class Node_Pin;
+}
+
 namespace gtry::sim {
 
 class SigHandle {
 	public:
-		SigHandle(hlim::NodePort output) : m_output(output) { }
+		SigHandle(hlim::NodePort output) : m_output(output) { bind(); }
 		void operator=(const SigHandle &rhs) { this->operator=(rhs.eval()); }
 
 
@@ -100,11 +104,25 @@ class SigHandle {
 		void overrideDrivingRegister();
 
 		size_t getWidth() const;
+
+		/// @brief Locations of the signal in the simulator's state, resolved by the simulation context when the handle is created.
+		/// @details Only valid for the compiled program they were resolved for, which allows simulation processes to access signals in place.
+		/// Reading a signal never modifies the binding, so handles can be shared between the threads of forked simulations.
+		struct Binding {
+			size_t programId = 0;
+			size_t stateOffset = ~0ull;
+			hlim::Node_Pin *pin = nullptr;
+			size_t pinStateOffset = ~0ull;
+		};
+		const Binding &getBinding() const { return m_binding; }
+		Binding &getBinding() { return m_binding; }
 	protected:
 		void assign(const sim::BigInt &v);
+		void bind();
 
 		hlim::NodePort m_output;
 		bool m_overrideRegister = false;
+		Binding m_binding;
 };
 
 
@@ -0,0 +1,199 @@
+/*  This file is part of Gatery, a library for circuit design.
+	Copyright (C) 2021 Michael Offel, Andreas Ley
+
+	Gatery is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 3 of the License, or (at your option) any later version.
+
+	Gatery is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include "gatery/pch.h"
+#include "SignalWatchIndex.h"
+#include "../utils/BitManipulation.h"
+#include "../utils/Range.h"
+
+namespace gtry::sim {
+
+void SignalWatchIndex::clear()
+{
+	m_watches.clear();
+	m_freeWatches.clear();
+	m_numWatches = 0;
+	m_pendingWatches.clear();
+	m_pendingRefs.resize(0);
+	m_words.clear();
+	m_wordToIndex.clear();
+}
+
+void SignalWatchIndex::add(std::coroutine_handle<> handle, std::uint64_t insertionId, std::span<const Range> ranges, const DefaultBitVectorState &state)
+{
+	size_t watchIdx;
+	if (!m_freeWatches.empty()) {
+		watchIdx = m_freeWatches.back();
+		m_freeWatches.pop_back();
+	} else {
+		watchIdx = m_watches.size();
+		m_watches.emplace_back();
+	}
+
+	auto &watch = m_watches[watchIdx];
+	watch.handle = handle;
+	watch.insertionId = insertionId;
+	watch.alive = true;
+	watch.ranges.assign(ranges.begin(), ranges.end());
+	watch.words.clear();
+	watch.pendingRefOffsets.clear();
+
+	for (const auto &r : ranges) {
+		size_t refOffset = (m_pendingRefs.size() + 63) / 64 * 64;
+		m_pendingRefs.resize(refOffset + r.size);
+		m_pendingRefs.copyRange(refOffset, state, r.offset, r.size);
+		watch.pendingRefOffsets.push_back(refOffset);
+	}
+
+	m_pendingWatches.push_back(watchIdx);
+	m_numWatches++;
+}
+
+void SignalWatchIndex::collectTriggered(const DefaultBitVectorState &state, std::vector<TriggeredWatch> &triggered)
+{
+	const auto *value = state.data(DefaultConfig::VALUE);
+	const auto *defined = state.data(DefaultConfig::DEFINED);
+
+	// Find the changed words and check the watches covering them.
+	for (auto wordIdx : utils::Range(m_words.size())) {
+		auto &w = m_words[wordIdx];
+		if (w.value == value[w.word] && w.defined == defined[w.word]) continue;
+
+		std::uint64_t changed = (w.defined ^ defined[w.word]) | ((w.value ^ value[w.word]) & w.defined);
+
+		size_t kept = 0;
+		for (auto ref : w.watches) {
+			const auto &watch = m_watches[ref.watch];
+			if (!watch.alive || watch.generation != ref.generation) continue;
+
+			if (changed & ref.mask)
+				trigger(ref.watch, triggered, wordIdx);
+			else
+				w.watches[kept++] = ref;
+		}
+		w.watches.resize(kept);
+
+		w.value = value[w.word];
+		w.defined = defined[w.word];
+	}
+	removeUnwatchedWords();
+
+	// New watches compare against their own copy once, since the state may have changed between adding them and this check.
+	for (auto watchIdx : m_pendingWatches) {
+		auto &watch = m_watches[watchIdx];
+		bool changed = false;
+		for (auto i : utils::Range(watch.ranges.size()))
+			if (!m_pendingRefs.compareRange(watch.pendingRefOffsets[i], state, watch.ranges[i].offset, watch.ranges[i].size)) {
+				changed = true;
+				break;
+			}
+
+		if (changed)
+			trigger(watchIdx, triggered);
+		else
+			index(watchIdx, state);
+	}
+	m_pendingWatches.clear();
+	m_pendingRefs.resize(0);
+}
+
+void SignalWatchIndex::trigger(size_t watchIdx, std::vector<TriggeredWatch> &triggered, size_t checkedWord)
+{
+	auto &watch = m_watches[watchIdx];
+	triggered.push_back({ .handle = watch.handle, .insertionId = watch.insertionId });
+
+	watch.alive = false;
+	watch.generation++;
+	watch.handle = {};
+	m_freeWatches.push_back(watchIdx);
+	m_numWatches--;
+
+	for (auto w : watch.words) {
+		auto &word = m_words[w];
+		word.numAlive--;
+		// Words that don't change keep the references of watches triggered through other words, so drop them once they are the majority.
+		if (w != checkedWord && word.numAlive * 2 < word.watches.size())
+			removeDeadReferences(word);
+	}
+}
+
+void SignalWatchIndex::removeDeadReferences(WatchedWord &word)
+{
+	std::erase_if(word.watches, [this](const WordReference &ref) {
+		const auto &watch = m_watches[ref.watch];
+		return !watch.alive || watch.generation != ref.generation;
+	});
+}
+
+void SignalWatchIndex::index(size_t watchIdx, const DefaultBitVectorState &state)
+{
+	auto &watch = m_watches[watchIdx];
+	watch.pendingRefOffsets.clear();
+
+	for (const auto &r : watch.ranges) {
+		for (size_t word = r.offset / 64; word * 64 < r.offset + r.size; word++) {
+			size_t begin = std::max(r.offset, word * 64) - word * 64;
+			size_t end = std::min(r.offset + r.size, word * 64 + 64) - word * 64;
+			std::uint64_t mask = utils::bitMaskRange<std::uint64_t>(begin, end - begin);
+
+			auto [it, inserted] = m_wordToIndex.try_emplace(word, m_words.size());
+			if (inserted)
+				m_words.push_back({
+					.word = word,
+					.value = state.data(DefaultConfig::VALUE)[word],
+					.defined = state.data(DefaultConfig::DEFINED)[word],
+				});
+			auto &w = m_words[it->second];
+
+			// Multiple ranges of the same watch may cover the same word.
+			if (!w.watches.empty() && w.watches.back().watch == watchIdx && w.watches.back().generation == watch.generation) {
+				w.watches.back().mask |= mask;
+			} else {
+				w.watches.push_back({ .watch = watchIdx, .generation = watch.generation, .mask = mask });
+				w.numAlive++;
+				watch.words.push_back(it->second);
+			}
+		}
+	}
+}
+
+void SignalWatchIndex::removeUnwatchedWords()
+{
+	for (size_t i = 0; i < m_words.size(); ) {
+		if (m_words[i].numAlive != 0) {
+			i++;
+			continue;
+		}
+
+		m_wordToIndex.erase(m_words[i].word);
+		if (i+1 != m_words.size()) {
+			m_words[i] = std::move(m_words.back());
+			m_wordToIndex[m_words[i].word] = i;
+			// Fix the word indices of the watches referencing the moved word.
+			for (const auto &ref : m_words[i].watches) {
+				auto &watch = m_watches[ref.watch];
+				if (!watch.alive || watch.generation != ref.generation) continue;
+				for (auto &w : watch.words)
+					if (w == m_words.size()-1)
+						w = i;
+			}
+		}
+		m_words.pop_back();
+	}
+}
+
+}
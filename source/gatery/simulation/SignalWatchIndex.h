@@ -0,0 +1,102 @@
+/*  This file is part of Gatery, a library for circuit design.
+	Copyright (C) 2021 Michael Offel, Andreas Ley
+
+	Gatery is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 3 of the License, or (at your option) any later version.
+
+	Gatery is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#pragma once
+
+#include "BitVectorState.h"
+
+#include <vector>
+#include <span>
+#include <unordered_map>
+#include <coroutine>
+#include <cstdint>
+
+namespace gtry::sim {
+
+/**
+ * @brief Simulation processes waiting for any of a set of state ranges to change (WaitChange), indexed by the 64-bit words of the state.
+ * @details A newly added watch keeps a copy of its ranges in an arena that is shared by all watches added in between two checks,
+ * and is compared against it once. Afterwards, the watch is registered with every state word it covers. The index keeps a single
+ * snapshot of every watched word, so checking finds the changed words with one comparison per word, no matter how many
+ * watches share it, and only examines the watches covering those words.
+ */
+class SignalWatchIndex
+{
+	public:
+		/// A range of bits in the signal state.
+		struct Range {
+			size_t offset;
+			size_t size;
+		};
+		struct TriggeredWatch {
+			std::coroutine_handle<> handle;
+			std::uint64_t insertionId;
+		};
+
+		void clear();
+		inline bool empty() const { return m_numWatches == 0; }
+
+		/// Adds a watch that triggers once any of the ranges differs from its current content in state.
+		void add(std::coroutine_handle<> handle, std::uint64_t insertionId, std::span<const Range> ranges, const DefaultBitVectorState &state);
+		/// Removes all watches that triggered since the last check and appends them to triggered.
+		void collectTriggered(const DefaultBitVectorState &state, std::vector<TriggeredWatch> &triggered);
+	protected:
+		struct Watch {
+			std::coroutine_handle<> handle;
+			std::uint64_t insertionId = 0;
+			/// Incremented whenever the watch is removed, to invalidate the references to it in the index.
+			std::uint64_t generation = 0;
+			bool alive = false;
+			std::vector<Range> ranges;
+			/// For each range, the offset of its copy in m_pendingRefs while the watch has not been checked yet.
+			std::vector<size_t> pendingRefOffsets;
+			/// Indices of the watched words in m_words. Only valid once the watch is indexed.
+			std::vector<size_t> words;
+		};
+		struct WordReference {
+			size_t watch;
+			std::uint64_t generation;
+			/// The bits of the word covered by the watch.
+			std::uint64_t mask;
+		};
+		struct WatchedWord {
+			size_t word;
+			std::uint64_t value;
+			std::uint64_t defined;
+			size_t numAlive = 0;
+			std::vector<WordReference> watches;
+		};
+
+		std::vector<Watch> m_watches;
+		std::vector<size_t> m_freeWatches;
+		size_t m_numWatches = 0;
+
+		/// Watches added since the last check and the arena with their copies of the watched ranges.
+		std::vector<size_t> m_pendingWatches;
+		DefaultBitVectorState m_pendingRefs;
+
+		std::vector<WatchedWord> m_words;
+		std::unordered_map<size_t, size_t> m_wordToIndex;
+
+		/// Removes a triggered watch. checkedWord is the word whose references are being iterated and must not be compacted.
+		void trigger(size_t watchIdx, std::vector<TriggeredWatch> &triggered, size_t checkedWord = ~0ull);
+		void removeDeadReferences(WatchedWord &word);
+		void index(size_t watchIdx, const DefaultBitVectorState &state);
+		void removeUnwatchedWords();
+};
+
+}
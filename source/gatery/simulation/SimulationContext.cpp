@@ -18,6 +18,7 @@
 #include "gatery/pch.h"
 #include "SimulationContext.h"
 #include "Simulator.h"
+#include "SigHandle.h"
 
 #include "../hlim/ClockRational.h"
 #include "../utils/Exceptions.h"
@@ -38,6 +39,14 @@ namespace gtry::sim {
 	{
 		m_current = m_overshadowed;
 	}
+
+	void SimulationContext::overrideSignalWord(SigHandle &handle, std::uint64_t value, std::uint64_t defined)
+	{
+		auto width = handle.getWidth();
+		HCL_ASSERT(width <= 64);
+
+		overrideSignal(handle, createExtendedBitVectorState(width, value, defined));
+	}
 /*
 	double SimulationContext::nowNs()
 	{
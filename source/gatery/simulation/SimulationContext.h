@@ -42,6 +42,13 @@ class SimulationContext {
 		virtual void overrideRegister(const SigHandle &handle, const DefaultBitVectorState &state) = 0;
 		virtual void overrideSignal(const SigHandle &handle, const ExtendedBitVectorState &state) = 0;
 		virtual void getSignal(const SigHandle &handle, DefaultBitVectorState &state) = 0;
+		/// @brief Returns a state from which the signal can be read in place, and the signal's offset in it.
+		/// @details Returns nullptr if the signal must be read through getSignal instead. The state is only valid until the simulation continues.
+		virtual const DefaultBitVectorState *getSignalInPlace(const SigHandle &handle, size_t &offset) { return nullptr; }
+		/// Assigns to a signal of up to 64 bits. Bits that are not defined become undefined.
+		virtual void overrideSignalWord(SigHandle &handle, std::uint64_t value, std::uint64_t defined);
+		/// Resolves the handle's binding to the state of the running simulation, if signals can be accessed in place.
+		virtual void bind(SigHandle &handle) { }
 
 		virtual void onDebugMessage(const hlim::BaseNode *src, std::string msg) = 0;
 		virtual void onWarning(const hlim::BaseNode *src, std::string msg) = 0;
@@ -20,73 +20,136 @@
 
 #include "../hlim/Circuit.h"
 #include "../hlim/Node.h"
+#include "../hlim/NodeGroup.h"
+#include "../hlim/coreNodes/Node_Pin.h"
 
 #include "../debug/DebugInterface.h"
 
 #include <chrono>
+#include <fstream>
 
 namespace gtry::sim {
 
 
+namespace {
+	std::mutex threadIdMutex;
+	std::vector<bool> threadIdInUse;
+
+	/// Index of the calling thread into the slots of all performance counters, which is handed to another thread once this one exits.
+	struct ThreadId {
+		size_t id;
+
+		ThreadId() {
+			std::lock_guard lock(threadIdMutex);
+			id = std::find(threadIdInUse.begin(), threadIdInUse.end(), false) - threadIdInUse.begin();
+			if (id == threadIdInUse.size())
+				threadIdInUse.push_back(true);
+			else
+				threadIdInUse[id] = true;
+		}
+		~ThreadId() {
+			std::lock_guard lock(threadIdMutex);
+			threadIdInUse[id] = false;
+		}
+	};
+	thread_local ThreadId threadId;
+}
+
+SimulatorPerformanceCounters::SimulatorPerformanceCounters()
+{
+}
+
+void SimulatorPerformanceCounters::setEnabled(bool enabled)
+{
+	m_enabled = enabled;
+	if (m_enabled && m_slots == nullptr)
+		m_slots = std::make_unique<Slot[]>(MAX_THREADS);
+}
+
 void SimulatorPerformanceCounters::reset(const hlim::Circuit &circuit)
 {
+	std::lock_guard lock(m_mutex);
+
 	m_byNodeGroup.clear();
 	m_byNodeType.clear();
 	m_typeNameMap.clear();
+	m_byStack.clear();
 
 	for (const auto &n : circuit.getNodes()) {
-		m_byNodeGroup[n->getGroup()].active = 0;
 		m_byNodeGroup[n->getGroup()].count = 0;
-		m_byNodeType[std::type_index(typeid(*n))].active = 0;
 		m_byNodeType[std::type_index(typeid(*n))].count = 0;
 		m_typeNameMap[std::type_index(typeid(*n))] = typeid(*n).name();
 	}
 
-	for (auto &p : m_byOther) {
-		p.active = 0;
+	for (auto &p : m_byOther)
 		p.count = 0;
-	}
 }
 
-SimulatorPerformanceCounters::NodeHandle::NodeHandle(SimulatorPerformanceCounters &tracker, const hlim::BaseNode *node)
+std::atomic<std::uintptr_t> *SimulatorPerformanceCounters::threadSlot()
 {
-	m_groupIt = tracker.m_byNodeGroup.find(node->getGroup());
-	m_typeIt = tracker.m_byNodeType.find(std::type_index(typeid(*node)));
-	m_groupIt->second.active++;
-	m_typeIt->second.active++;
+	if (threadId.id >= MAX_THREADS)
+		return nullptr;
+	return &m_slots[threadId.id].activity;
 }
 
-SimulatorPerformanceCounters::NodeHandle::~NodeHandle()
+SimulatorPerformanceCounters::Scope::Scope(SimulatorPerformanceCounters &tracker)
 {
-	m_groupIt->second.active--;
-	m_typeIt->second.active--;
+	if (tracker.m_enabled) {
+		m_slot = tracker.threadSlot();
+		if (m_slot)
+			m_previous = m_slot->load(std::memory_order_relaxed);
+	}
 }
 
-SimulatorPerformanceCounters::OtherHandle::OtherHandle(SimulatorPerformanceCounters &tracker, Other other)
+SimulatorPerformanceCounters::Scope::~Scope()
 {
-	m_it = tracker.m_byOther.begin() + (size_t) other;
-	m_it->active++;
+	if (m_slot)
+		m_slot->store(m_previous, std::memory_order_relaxed);
 }
 
-SimulatorPerformanceCounters::OtherHandle::~OtherHandle()
+void SimulatorPerformanceCounters::tick()
 {
-	m_it->active--;
+	std::lock_guard lock(m_mutex);
+
+	if (m_slots == nullptr)
+		return;
+
+	for (auto i : utils::Range(MAX_THREADS)) {
+		std::uintptr_t sample = m_slots[i].activity.load(std::memory_order_relaxed);
+		if (sample == 0) continue;
+
+		if (sample <= m_byOther.size()) {
+			m_byOther[sample-1].count++;
+			continue;
+		}
+
+		const auto *node = (const hlim::BaseNode *) sample;
+		std::type_index type(typeid(*node));
+		m_byNodeGroup[node->getGroup()].count++;
+		m_byNodeType[type].count++;
+
+		auto [it, inserted] = m_byStack.try_emplace({node->getGroup(), type});
+		if (inserted) {
+			std::string stack;
+			for (const auto *group = node->getGroup(); group != nullptr; group = group->getParent())
+				stack = group->getInstanceName() + ';' + stack;
+			it->second.first = stack + typeid(*node).name();
+			m_typeNameMap.try_emplace(type, typeid(*node).name());
+		}
+		it->second.second++;
+	}
 }
 
-
-void SimulatorPerformanceCounters::tick()
+void SimulatorPerformanceCounters::writeFoldedStacks(std::ostream &stream) const
 {
-	for (auto &p : m_byNodeGroup)
-		if (p.second.active > 0)
-			p.second.count++;
+	std::lock_guard lock(m_mutex);
 
-	for (auto &p : m_byNodeType)
-		if (p.second.active > 0)
-			p.second.count++;
+	stream << "Compilation " << m_byOther[(size_t) Other::COMPILATION].count << '\n';
+	stream << "Simulation processes " << m_byOther[(size_t) Other::SIMULATION_PROCESS].count << '\n';
+	stream << "Event callbacks " << m_byOther[(size_t) Other::EVENT_CALLBACKS].count << '\n';
 
-	for (auto &p : m_byOther)
-		if (p.active > 0)
-			p.count++;
+	for (const auto &p : m_byStack)
+		stream << p.second.first << ' ' << p.second.second << '\n';
 }
 
 
@@ -183,11 +246,40 @@ DefaultBitVectorState Simulator::simProcGetValueOfOutput(const hlim::NodePort &n
 	return value;
 }
 
+void Simulator::simProcSetInputPinWord(hlim::Node_Pin *pin, size_t stateOffset, std::uint64_t value, std::uint64_t defined)
+{
+	size_t width = pin->getOutputConnectionType(0).width;
+	HCL_ASSERT(width <= 64);
+
+	simProcSetInputPin(pin, createExtendedBitVectorState(width, value, defined));
+}
+
+
+std::unique_ptr<SimulatorCheckpoint> Simulator::saveCheckpoint()
+{
+	HCL_DESIGNCHECK_HINT(false, "This simulator does not support checkpoints!");
+	return {};
+}
+
+std::unique_ptr<SimulatorCheckpoint> Simulator::loadCheckpoint(std::istream &stream)
+{
+	HCL_DESIGNCHECK_HINT(false, "This simulator does not support checkpoints!");
+	return {};
+}
+
+void Simulator::restoreCheckpoint(const SimulatorCheckpoint &checkpoint)
+{
+	HCL_DESIGNCHECK_HINT(false, "This simulator does not support checkpoints!");
+}
+
 
 void Simulator::startPerformanceCounterThread(const PerformanceCounterOptions &options)
 {
 	stopPerformanceCounterThread();
 
+	m_performanceCounters.setEnabled(options.samplePerformanceCounters);
+	m_foldedStacksFile = options.foldedStacksFile;
+
 	if (options.samplePerformanceCounters) {
 		m_doRunPerformanceCounterThread = true;
 		m_performanceCounterThread = std::thread([this, options]{
@@ -219,13 +311,20 @@ void Simulator::stopPerformanceCounterThread()
 		m_doRunPerformanceCounterThread = false;
 		m_performanceCounterThread.join();
 		checkWritebackPerformanceCounters();
+
+		if (!m_foldedStacksFile.empty()) {
+			std::ofstream file(m_foldedStacksFile.c_str(), std::fstream::binary);
+			m_performanceCounters.writeFoldedStacks(file);
+		}
 	}
 }
 
 void Simulator::checkWritebackPerformanceCounters()
 {
-	if (m_performanceCountersNeedWriteback)
+	if (m_performanceCountersNeedWriteback) {
+		std::lock_guard lock(m_performanceCounters.getMutex());
 		dbg::updateSimulationPerformanceTrace(m_performanceCounters);
+	}
 }
 
 
@@ -40,6 +40,11 @@
 #include <any>
 #include <typeindex>
 #include <thread>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <filesystem>
 
 #include "../compat/CoroutineWrapper.h"
 
@@ -47,6 +52,7 @@ namespace gtry::hlim {
 	class Node_Pin;
 	class Node_Register;
 	class Circuit;
+	class NodeGroup;
 }
 
 namespace gtry::sim {
@@ -60,31 +66,21 @@ class WaitStable;
 
 
 
+/**
+ * @brief Sampling profiler that attributes simulation time to node groups, node types, and other activities.
+ * @details Every thread that simulates publishes what it is currently doing in its own slot, which costs a single store per node if sampling
+ * is enabled and only a predictable branch if it is disabled. A sampling thread periodically reads all slots and counts the samples.
+ */
 class SimulatorPerformanceCounters
 {
 	public:
 		struct Counter {
 			size_t count = 0;
-			std::atomic<size_t> active = {0};
 		};
 
 		using ByNodeGroup = std::map<const hlim::NodeGroup*, Counter>;
 		using ByNodeType = std::map<std::type_index, Counter>;
 
-		void reset(const hlim::Circuit &circuit);
-
-		class NodeHandle {
-			public:
-				NodeHandle(SimulatorPerformanceCounters &tracker, const hlim::BaseNode *node);
-				~NodeHandle();
-			private:
-				ByNodeGroup::iterator m_groupIt;
-				ByNodeType::iterator m_typeIt;
-		};
-
-		NodeHandle processNode(const hlim::BaseNode *node) { return  NodeHandle(*this, node); }
-
-
 		enum class Other {
 			COMPILATION,
 			SIMULATION_PROCESS,
@@ -92,29 +88,69 @@ class SimulatorPerformanceCounters
 		};
 		using ByOther = std::array<Counter, magic_enum::enum_count<Other>()>;
 
-		class OtherHandle {
+		/// Threads are identified by small ids that are reused once a thread exits. Threads beyond this many are not sampled.
+		static constexpr size_t MAX_THREADS = 256;
+
+		SimulatorPerformanceCounters();
+
+		void reset(const hlim::Circuit &circuit);
+		/// Must only be changed while no thread is simulating.
+		void setEnabled(bool enabled);
+		bool isEnabled() const { return m_enabled; }
+
+		/// @brief Publishes what the calling thread is doing and restores the previous activity when destroyed.
+		/// @details Loops over many nodes should keep one scope and call enter for each node.
+		class Scope {
 			public:
-				OtherHandle(SimulatorPerformanceCounters &tracker, Other other);
-				~OtherHandle();
+				Scope(SimulatorPerformanceCounters &tracker);
+				Scope(SimulatorPerformanceCounters &tracker, const hlim::BaseNode *node) : Scope(tracker) { enter(node); }
+				Scope(SimulatorPerformanceCounters &tracker, Other other) : Scope(tracker) { enter(other); }
+				~Scope();
+				Scope(const Scope&) = delete;
+				void operator=(const Scope&) = delete;
+
+				inline void enter(const hlim::BaseNode *node) { if (m_slot) m_slot->store((std::uintptr_t) node, std::memory_order_relaxed); }
+				inline void enter(Other other) { if (m_slot) m_slot->store((std::uintptr_t) other + 1, std::memory_order_relaxed); }
 			private:
-				ByOther::iterator m_it;
+				std::atomic<std::uintptr_t> *m_slot = nullptr;
+				std::uintptr_t m_previous = 0;
 		};
 
-		OtherHandle processOther(Other other) { return OtherHandle(*this, other); }
-
+		Scope processNode(const hlim::BaseNode *node) { return Scope(*this, node); }
+		Scope processOther(Other other) { return Scope(*this, other); }
 
+		/// Takes one sample of all threads, called by the sampling thread.
 		void tick();
 
+		/// Samples must not be taken while reading them.
+		std::mutex &getMutex() const { return m_mutex; }
 		inline const ByNodeGroup &getByGroup() const { return m_byNodeGroup; }
 		inline const ByNodeType &getByType() const { return m_byNodeType; }
 		inline const ByOther &getByOther() const { return m_byOther; }
 		inline const auto &getTypeNameMap() const { return m_typeNameMap; }
+
+		/// @brief Writes all samples as collapsed stacks of node groups, ending in the node type, e.g. for flamegraph.pl, inferno, or speedscope.
+		/// @details Each line holds one stack of semicolon separated frames followed by the number of samples.
+		void writeFoldedStacks(std::ostream &stream) const;
 	protected:
-		friend class Handle;
+		bool m_enabled = false;
+
+		/// Holds a node pointer, an Other+1, or zero if the thread is idle. Each slot fills its own cache line since every thread writes to its slot constantly.
+		struct alignas(64) Slot {
+			std::atomic<std::uintptr_t> activity = 0;
+		};
+		/// One slot per thread id, allocated when the counters are first enabled.
+		std::unique_ptr<Slot[]> m_slots;
+		mutable std::mutex m_mutex;
+
 		ByNodeGroup m_byNodeGroup;
 		ByNodeType m_byNodeType;
 		ByOther m_byOther;
 		std::map<std::type_index, const char*> m_typeNameMap;
+		/// Samples by node group and type with their stack in the folded format, which is assembled on the first sample.
+		std::map<std::pair<const hlim::NodeGroup*, std::type_index>, std::pair<std::string, size_t>> m_byStack;
+
+		std::atomic<std::uintptr_t> *threadSlot();
 };
 
 
@@ -124,14 +160,72 @@ struct PerformanceCounterOptions {
 	float performanceCounterSamplingFrequency = 1000.0f;
 	bool logPerformanceCounters = false;
 	float performanceCounterLoggingFrequency = 2.0f;
+	/// If set, the samples are written to this file as collapsed stacks (see @ref SimulatorPerformanceCounters::writeFoldedStacks) when sampling stops.
+	std::filesystem::path foldedStacksFile;
+};
+
+/// How the simulator arranges the state of all signals in memory.
+enum class StateLayout {
+	/// Packs small signals by size class in the order of the circuit's nodes.
+	SIZE_BUCKETS,
+	/// Places signals in the order in which they are evaluated, with registers and constants next to their first reader, to improve cache locality.
+	EVALUATION_ORDER
 };
 
 struct CompileOptions {
 	bool ignoreSimulationProcesses = false;
+	/// Only reevaluate those nodes whose inputs or state changed since the last evaluation instead of all nodes.
+	/// @details This assumes that all nodes' simulateEvaluate only depend on their inputs and internal state.
+	bool activityDrivenEvaluation = false;
+	/// Number of threads to evaluate independent parts of the circuit and to advance independent clocked nodes with.
+	/// @details 0 uses one thread per hardware thread. Nodes reporting to the simulator (asserts, debug messages, ...) are always processed by the simulation thread.
+	size_t numThreads = 1;
+	/// Once the inputs and outputs of a node were fully defined, evaluate it with a value-only kernel that skips computing and storing the DEFINED plane.
+	/// @details The inputs are still checked for undefined bits before every evaluation. Nodes whose inputs became (partially) undefined, no matter
+	/// whether from input pins, uninitialized registers, or conflicting drivers, return to regular evaluation until they are fully defined again.
+	bool twoStateEvaluation = false;
+	StateLayout stateLayout = StateLayout::EVALUATION_ORDER;
+	/// Number of independent instances of the circuit that are simulated as one batch.
+	/// @details This is a batch driver, not a vectorized simulation: Each node is simulated for every instance of the batch back to back through its own
+	/// simulateEvaluate call, the states of the instances are not interleaved. A batch only saves the per node overhead of the scheduler and keeps
+	/// the program hot in the caches while it runs over all instances. Every simulation process runs once per instance and can tell its instance
+	/// apart through gtry::simulationBatchIndex(), e.g. to seed its random number generator. Simulation fibers, visualizations, and waveform recorders
+	/// only see instance 0. All instances share the clocks and resets, but the simulation processes of an instance only see and drive its signals.
+	/// Not supported together with activity driven or two-state evaluation, compileProgram throws a DesignError for these combinations.
+	size_t batchSize = 1;
+	/// Reuse the compiled program of other simulators that compiled the same circuit with the same options, e.g. when running a test matrix.
+	/// @details The program is only shared as long as one of the simulators is still alive. See @ref gtry::sim::Program::compileShared.
+	bool shareProgram = false;
 	PerformanceCounterOptions perf = {};
 };
 
 
+/// Work done by a simulator since power on, e.g. for measuring its throughput.
+struct SimulatorStatistics {
+	/// Number of simulation time steps that were processed.
+	std::uint64_t numEvents = 0;
+	/// Number of (re)evaluations of the combinatorial part of the circuit.
+	std::uint64_t numReevaluations = 0;
+	/// Number of times a node was evaluated, summed over all instances of the batch.
+	std::uint64_t numNodeEvaluations = 0;
+};
+
+/**
+ * @brief Snapshot of a simulation between two time steps from which simulations of the same circuit can continue.
+ * @details Holds the state of all signals, clocks, resets, and memories as well as all pending clock and reset events.
+ * Simulation processes can not be captured, they are started anew when a checkpoint is restored (see @ref Simulator::resumedFromCheckpoint).
+ */
+class SimulatorCheckpoint
+{
+	public:
+		virtual ~SimulatorCheckpoint() = default;
+
+		/// Writes the checkpoint in a binary format (native byte order) that can be read with @ref Simulator::loadCheckpoint.
+		virtual void save(std::ostream &stream) const = 0;
+
+		hlim::ClockRational simulationTime = {0};
+};
+
 /**
  * @brief Interface for all logic simulators
  * 
@@ -143,7 +237,9 @@ class Simulator
 		virtual ~Simulator();
 
 		/// Adds a simulator callback hook to inform waveform recorders and test bench exporters about simulation events.
-		void addCallbacks(SimulatorCallbacks *simCallbacks) { m_callbackDispatcher.m_callbacks.push_back(simCallbacks); }
+		void addCallbacks(SimulatorCallbacks *simCallbacks) { m_callbackDispatcher.m_callbacks.push_back(simCallbacks); m_simProcIOObserved |= simCallbacks->observesSimProcIO(); }
+		/// Whether any of the callbacks needs to see every signal access of simulation processes (see @ref SimulatorCallbacks::observesSimProcIO).
+		bool simProcIOObserved() const { return m_simProcIOObserved; }
 
 
 		/**
@@ -163,6 +259,23 @@ class Simulator
 		/// Reset circuit and simulation processes into the power-on state
 		virtual void powerOn() = 0;
 
+		/**
+		 * @brief Captures the state of the simulation, e.g. to skip the shared initialization of many tests.
+		 * @details Must be called between time steps, i.e. not from within simulation processes.
+		 */
+		virtual std::unique_ptr<SimulatorCheckpoint> saveCheckpoint();
+		/// Reads a checkpoint written by @ref SimulatorCheckpoint::save.
+		virtual std::unique_ptr<SimulatorCheckpoint> loadCheckpoint(std::istream &stream);
+		/**
+		 * @brief Continues the simulation from a checkpoint instead of powering on.
+		 * @details The circuit must have been compiled with the same circuit and options as when the checkpoint was taken.
+		 * All simulation processes are started from the beginning at the time of the checkpoint and can check
+		 * @ref resumedFromCheckpoint to skip what was already done before the checkpoint.
+		 */
+		virtual void restoreCheckpoint(const SimulatorCheckpoint &checkpoint);
+		/// Whether the simulation continued from a checkpoint instead of starting with @ref powerOn.
+		inline bool resumedFromCheckpoint() const { return m_resumedFromCheckpoint; }
+
 		/// Forces a reevaluation of all combinatorics.
 		virtual void reevaluate() = 0;
 
@@ -216,6 +329,9 @@ class Simulator
 
 		/// Sets the value of an input pin
 		virtual void simProcSetInputPin(hlim::Node_Pin *pin, const ExtendedBitVectorState &state) = 0;
+		/// @brief Sets the value of an input pin of up to 64 bits whose internal state is at stateOffset in @ref getSignalState.
+		/// @details Does not build a bit vector state unless callbacks observe the override. Bits that are not defined become undefined, not high impedance.
+		virtual void simProcSetInputPinWord(hlim::Node_Pin *pin, size_t stateOffset, std::uint64_t value, std::uint64_t defined);
 		/// Overrides the output of a register until its next activation
 		virtual void simProcOverrideRegisterOutput(hlim::Node_Register *reg, const DefaultBitVectorState &state) = 0;
 		/// Returns @ref getValueOfOutput but also notifies potential testbench exporters via @ref SimulatorCallbacks of the "sampling" of this output.
@@ -227,6 +343,16 @@ class Simulator
 		virtual std::array<bool, DefaultConfig::NUM_PLANES> getValueOfClock(const hlim::Clock *clk) = 0;
 		virtual std::array<bool, DefaultConfig::NUM_PLANES> getValueOfReset(const hlim::Clock *clk) = 0;
 
+		/// @brief Direct read access to the state of all signals (of the current instance of the batch), for callbacks that check many signals on every commit.
+		/// @details Returns nullptr if the simulator does not keep such a state. The pointer is only valid until the simulation advances.
+		virtual const DefaultBitVectorState *getSignalState() const { return nullptr; }
+		/// Returns the offset of an output's value in @ref getSignalState or ~0ull if it is not part of the state.
+		virtual size_t getOutputStateOffset(const hlim::NodePort &nodePort) const { return ~0ull; }
+		/// Returns the offset of a node's internal state in @ref getSignalState or ~0ull if it is not part of the state.
+		virtual size_t getInternalStateOffset(const hlim::BaseNode *node, size_t idx) const { return ~0ull; }
+		/// Identifies the compiled program and thus the layout of @ref getSignalState, so that offsets can be cached. Zero if the state is not exposed.
+		virtual size_t getProgramId() const { return 0; }
+
 		/// @}
 
 		/// Returns the elapsed simulation time (in seconds) since @ref powerOn.
@@ -237,6 +363,13 @@ class Simulator
 		///			 entire coroutine stack is being destructed.
 		virtual bool simulationIsShuttingDown() const = 0;
 
+		/// Returns the index of the instance of the circuit in the batch that the currently running simulation process belongs to.
+		/// @see CompileOptions::batchSize
+		virtual size_t getCurrentBatchIndex() const { return 0; }
+
+		/// Returns the work done since the last power on. Simulators that do not keep track return all zeros.
+		virtual SimulatorStatistics getStatistics() const { return {}; }
+
 		/// Returns the elapsed micro ticks (reevaluations) within the current time step.
 		inline size_t getCurrentMicroTick() const { return m_microTick; }
 		/// Returns the current timing phase (eg. before registers at that time point trigger, while they trigger, or after they have triggered).
@@ -298,6 +431,8 @@ class Simulator
 		size_t m_microTick = 0;
 		WaitClock::TimingPhase m_timingPhase;
 		CallbackDispatcher m_callbackDispatcher;
+		bool m_simProcIOObserved = false;
+		bool m_resumedFromCheckpoint = false;
 
 		std::mutex m_mutex;
 
@@ -307,6 +442,7 @@ class Simulator
 		SimulatorPerformanceCounters m_performanceCounters;
 		std::atomic<bool> m_doRunPerformanceCounterThread = false;
 		std::thread m_performanceCounterThread;
+		std::filesystem::path m_foldedStacksFile;
 		void startPerformanceCounterThread(const PerformanceCounterOptions &options);
 		void stopPerformanceCounterThread();
 
@@ -117,6 +117,10 @@ class SimulatorCallbacks
 		 * @param state The value that was retrieved.
 		 */
 		virtual void onSimProcOutputRead(const hlim::NodePort &output, const DefaultBitVectorState &state) { }
+
+		/// Whether this needs to see every onSimProcOutputOverridden and onSimProcOutputRead. If no callback does, simulation processes access signals in place without these events.
+		/// Callbacks that ignore both events should return false.
+		virtual bool observesSimProcIO() const { return true; }
 	protected:
 };
 
@@ -132,6 +136,7 @@ class SimulatorConsoleOutput : public SimulatorCallbacks
 		virtual void onDebugMessage(const hlim::BaseNode *src, std::string msg) override;
 		virtual void onWarning(const hlim::BaseNode *src, std::string msg) override;
 		virtual void onAssert(const hlim::BaseNode *src, std::string msg) override;
+		virtual bool observesSimProcIO() const override { return false; }
 	protected:
 		hlim::ClockRational m_simTime;
 };
@@ -47,12 +47,17 @@ void UnitTestSimulationFixture::addSimulationFiber(std::function<void()> simFibe
 	m_simulator->addSimulationFiber(std::move(simFiber));
 }
 
+CompileOptions UnitTestSimulationFixture::getCompileOptions() const
+{
+	CompileOptions options = m_compileOptions;
+	options.perf.samplePerformanceCounters = m_traceSimulationPerformance;
+	options.perf.logPerformanceCounters = m_traceSimulationPerformance;
+	return options;
+}
+
 void UnitTestSimulationFixture::eval(hlim::Circuit &circuit)
 {
-	m_simulator->compileProgram(circuit, {}, { .perf = {
-					.samplePerformanceCounters = m_traceSimulationPerformance, 
-					.logPerformanceCounters = m_traceSimulationPerformance,
-	}});
+	m_simulator->compileProgram(circuit, {}, getCompileOptions());
 	m_simulator->powerOn();
 	//m_simulator->reevaluate();
 	m_simulator->commitState();
@@ -68,10 +73,7 @@ void UnitTestSimulationFixture::runTicks(hlim::Circuit &circuit, const hlim::Clo
 	m_runLimClock = 0;
 	m_runLimClock = clock;
 
-	m_simulator->compileProgram(circuit, {}, { .perf = {
-					.samplePerformanceCounters = m_traceSimulationPerformance, 
-					.logPerformanceCounters = m_traceSimulationPerformance,
-	}});
+	m_simulator->compileProgram(circuit, {}, getCompileOptions());
 	m_simulator->powerOn();
 	m_simulator->advance(hlim::ClockRational(numTicks) / clock->absoluteFrequency());
 	m_simulator->commitState();
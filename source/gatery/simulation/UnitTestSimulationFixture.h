@@ -18,6 +18,7 @@
 #pragma once
 
 #include "SimulatorCallbacks.h"
+#include "Simulator.h"
 #include "simProc/SimulationProcess.h"
 
 #include <memory>
@@ -49,6 +50,7 @@ namespace gtry::sim {
 		virtual void onDebugMessage(const hlim::BaseNode* src, std::string msg) override;
 		virtual void onWarning(const hlim::BaseNode* src, std::string msg) override;
 		virtual void onAssert(const hlim::BaseNode* src, std::string msg) override;
+		virtual bool observesSimProcIO() const override { return false; }
 
 		Simulator& getSimulator() { return *m_simulator; }
 	protected:
@@ -62,6 +64,10 @@ namespace gtry::sim {
 
 		bool m_traceSimulationPerformance = false;
 
+		/// Options for compiling the simulation. The performance counter options are overridden by m_traceSimulationPerformance.
+		CompileOptions m_compileOptions;
+		CompileOptions getCompileOptions() const;
+
 };
 
 
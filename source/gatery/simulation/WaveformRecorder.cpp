@@ -20,12 +20,18 @@
 
 #include "BitAllocator.h"
 #include "Simulator.h"
+#include "SigHandle.h"
+#include "waveformFormats/GTKWaveProjectFile.h"
 
 #include "../hlim/Circuit.h"
+#include "../hlim/Clock.h"
+#include "../hlim/NodeGroup.h"
 #include "../hlim/supportNodes/Node_SignalTap.h"
 #include "../hlim/supportNodes/Node_Memory.h"
 #include "../hlim/coreNodes/Node_Pin.h"
 #include "../hlim/coreNodes/Node_Signal.h"
+#include "../hlim/postprocessing/CDCDetection.h"
+#include "../debug/DebugInterface.h"
 
 #include <boost/format.hpp>
 
@@ -36,6 +42,292 @@ WaveformRecorder::WaveformRecorder(hlim::Circuit &circuit, Simulator &simulator)
 	m_simulator.addCallbacks(this);
 }
 
+WaveformRecorder::~WaveformRecorder()
+{
+	// Derived classes are already destroyed, so they must have written everything through finishWritingInDestructor().
+	assert(!m_asyncWriter && "Derived waveform recorders must call finishWritingInDestructor() in their destructor!");
+	assert(!(m_flightRecorder && m_flightRecorder->triggered) && "Derived waveform recorders must call finishWritingInDestructor() in their destructor!");
+
+	if (m_asyncWriter && m_asyncWriter->thread.joinable()) {
+		{
+			std::lock_guard lock(m_asyncWriter->mutex);
+			m_asyncWriter->filled.clear();
+			m_asyncWriter->shutdown = true;
+		}
+		m_asyncWriter->wakeWriter.notify_one();
+		m_asyncWriter->thread.join();
+	}
+}
+
+void WaveformRecorder::writeAsynchronously(size_t bufferSize, size_t numBuffers)
+{
+	HCL_DESIGNCHECK_HINT(!m_initialized, "Asynchronous waveform writing must be enabled before the simulation is powered on!");
+	HCL_DESIGNCHECK_HINT(!m_flightRecorder, "Asynchronous waveform writing can not be combined with windowed recording!");
+	HCL_ASSERT(numBuffers >= 2);
+	if (m_asyncWriter) return;
+
+	m_asyncWriter = std::make_unique<AsyncWriter>();
+	m_asyncWriter->bufferSize = bufferSize;
+	m_asyncWriter->numBuffers = numBuffers;
+	m_asyncWriter->capturing = std::make_unique<CaptureBuffer>();
+	for ([[maybe_unused]] auto i : utils::Range(numBuffers-1))
+		m_asyncWriter->free.push_back(std::make_unique<CaptureBuffer>());
+
+	m_asyncWriter->thread = std::thread([this, writer = m_asyncWriter.get()]{ writerThread(*writer); });
+}
+
+void WaveformRecorder::flush()
+{
+	if (!m_asyncWriter || !m_asyncWriter->thread.joinable()) return;
+	auto &writer = *m_asyncWriter;
+
+	if (!writer.capturing->changes.empty())
+		submitCaptureBuffer();
+
+	std::unique_lock lock(writer.mutex);
+	writer.wakeSimulation.wait(lock, [&]{ return writer.free.size()+1 == writer.numBuffers; });
+	if (writer.exception)
+		std::rethrow_exception(std::exchange(writer.exception, nullptr));
+}
+
+void WaveformRecorder::recordWindow(const hlim::ClockRational &window, bool triggerOnAssert, bool triggerOnWarning)
+{
+	HCL_DESIGNCHECK_HINT(!m_initialized, "Windowed waveform recording must be enabled before the simulation is powered on!");
+	HCL_DESIGNCHECK_HINT(window > hlim::ClockRational(0), "The recorded window must not be empty!");
+	HCL_DESIGNCHECK_HINT(!m_asyncWriter, "Windowed recording can not be combined with asynchronous waveform writing!");
+
+	if (!m_flightRecorder)
+		m_flightRecorder = std::make_unique<FlightRecorder>();
+	m_flightRecorder->window = window;
+	m_flightRecorder->triggerOnAssert = triggerOnAssert;
+	m_flightRecorder->triggerOnWarning = triggerOnWarning;
+}
+
+void WaveformRecorder::addTrigger(const hlim::NodePort &condition)
+{
+	HCL_DESIGNCHECK_HINT(m_flightRecorder, "Triggers require windowed waveform recording to be enabled first!");
+	HCL_DESIGNCHECK_HINT(!m_initialized, "Triggers must be added before the simulation is powered on!");
+	HCL_DESIGNCHECK_HINT(hlim::getOutputWidth(condition) == 1, "Triggers must be single bit signals!");
+
+	m_flightRecorder->triggers.push_back({ .condition = condition });
+}
+
+void WaveformRecorder::addTrigger(const SigHandle &condition)
+{
+	addTrigger(condition.getOutput());
+}
+
+void WaveformRecorder::trigger()
+{
+	HCL_DESIGNCHECK_HINT(m_flightRecorder, "Triggers require windowed waveform recording to be enabled first!");
+	m_flightRecorder->triggered = true;
+}
+
+void WaveformRecorder::finishWriting()
+{
+	if (m_flightRecorder && m_flightRecorder->triggered)
+		writeWindow();
+
+	if (!m_asyncWriter) return;
+	auto writer = std::move(m_asyncWriter);
+
+	{
+		std::lock_guard lock(writer->mutex);
+		if (!writer->capturing->changes.empty())
+			writer->filled.push_back(std::move(writer->capturing));
+		writer->shutdown = true;
+	}
+	writer->wakeWriter.notify_one();
+	writer->thread.join();
+
+	if (writer->exception)
+		std::rethrow_exception(writer->exception);
+}
+
+void WaveformRecorder::finishWritingInDestructor()
+{
+	try {
+		finishWriting();
+	} catch (const std::exception &e) {
+		dbg::log(dbg::LogMessage() << dbg::LogMessage::LOG_ERROR << "Writing the waveform failed: " << std::string(e.what()));
+	} catch (...) {
+		dbg::log(dbg::LogMessage() << dbg::LogMessage::LOG_ERROR << "Writing the waveform failed!");
+	}
+}
+
+size_t WaveformRecorder::CaptureBuffer::sizeInBytes() const
+{
+	size_t size = changes.size() * sizeof(CapturedChange) + states.size() / 4 + times.size() * sizeof(hlim::ClockRational);
+	for (const auto &m : messages)
+		size += m.second.size();
+	return size;
+}
+
+void WaveformRecorder::CaptureBuffer::clear()
+{
+	changes.clear();
+	states.resize(0);
+	times.clear();
+	messages.clear();
+}
+
+void WaveformRecorder::submitCaptureBuffer()
+{
+	auto &writer = *m_asyncWriter;
+
+	std::unique_lock lock(writer.mutex);
+	writer.filled.push_back(std::move(writer.capturing));
+	writer.wakeWriter.notify_one();
+
+	// Back pressure: Wait for the writer if all other buffers are still in flight.
+	writer.wakeSimulation.wait(lock, [&]{ return !writer.free.empty(); });
+	writer.capturing = std::move(writer.free.back());
+	writer.free.pop_back();
+
+	if (writer.exception)
+		std::rethrow_exception(std::exchange(writer.exception, nullptr));
+}
+
+void WaveformRecorder::writerThread(AsyncWriter &writer)
+{
+	std::unique_lock lock(writer.mutex);
+	while (true) {
+		writer.wakeWriter.wait(lock, [&]{ return !writer.filled.empty() || writer.shutdown; });
+		if (writer.filled.empty())
+			return;
+
+		auto buffer = std::move(writer.filled.front());
+		writer.filled.pop_front();
+		bool failed = (bool) writer.exception;
+		lock.unlock();
+
+		// After a failure, buffers are only recycled so that the simulation does not stall.
+		std::exception_ptr exception;
+		if (!failed) {
+			try {
+				replay(*buffer);
+			} catch (...) {
+				exception = std::current_exception();
+			}
+		}
+		buffer->clear();
+
+		lock.lock();
+		if (exception)
+			writer.exception = exception;
+		writer.free.push_back(std::move(buffer));
+		writer.wakeSimulation.notify_all();
+	}
+}
+
+WaveformRecorder::CaptureBuffer *WaveformRecorder::capturingBuffer()
+{
+	if (m_flightRecorder)
+		return &m_flightRecorder->chunks.back()->buffer;
+	if (m_asyncWriter)
+		return m_asyncWriter->capturing.get();
+	return nullptr;
+}
+
+void WaveformRecorder::replay(const CaptureBuffer &buffer, size_t firstChange)
+{
+	for (auto i : utils::Range(firstChange, buffer.changes.size())) {
+		const auto &change = buffer.changes[i];
+		switch (change.type) {
+			case CapturedChange::Type::SIGNAL: {
+				const auto &offsetSize = m_id2StateOffsetSize[change.index];
+				m_trackedState.copyRange(offsetSize.offset, buffer.states, change.stateOffset, offsetSize.size);
+				signalChanged(change.index);
+			} break;
+			case CapturedChange::Type::TICK:
+				advanceTick(buffer.times[change.index]);
+			break;
+			case CapturedChange::Type::CLOCK:
+				clockChanged(change.clock, change.value);
+			break;
+			case CapturedChange::Type::RESET:
+				resetChanged(change.clock, change.value);
+			break;
+			case CapturedChange::Type::MESSAGE: {
+				const auto &message = buffer.messages[change.index];
+				messageLogged(change.messageType, message.first, message.second);
+			} break;
+		}
+	}
+}
+
+void WaveformRecorder::startChunk(const hlim::ClockRational &simulationTime)
+{
+	auto &recorder = *m_flightRecorder;
+
+	std::unique_ptr<FlightRecorder::Chunk> chunk;
+	if (recorder.freeChunks.empty())
+		chunk = std::make_unique<FlightRecorder::Chunk>();
+	else {
+		chunk = std::move(recorder.freeChunks.back());
+		recorder.freeChunks.pop_back();
+	}
+	chunk->startTime = simulationTime;
+	chunk->startState = m_capturedState;
+	recorder.chunks.push_back(std::move(chunk));
+}
+
+void WaveformRecorder::recycleChunks(size_t count)
+{
+	auto &recorder = *m_flightRecorder;
+	for ([[maybe_unused]] auto i : utils::Range(count)) {
+		recorder.chunks.front()->buffer.clear();
+		recorder.freeChunks.push_back(std::move(recorder.chunks.front()));
+		recorder.chunks.pop_front();
+	}
+}
+
+void WaveformRecorder::checkTriggers()
+{
+	const auto *state = m_simulator.getSignalState();
+	for (auto &trigger : m_flightRecorder->triggers) {
+		bool value;
+		if (state != nullptr && trigger.stateOffset != ~0ull)
+			value = state->get(DefaultConfig::DEFINED, trigger.stateOffset) && state->get(DefaultConfig::VALUE, trigger.stateOffset);
+		else {
+			auto state = m_simulator.getValueOfOutput(trigger.condition);
+			value = state.size() != 0 && state.get(DefaultConfig::DEFINED) && state.get(DefaultConfig::VALUE);
+		}
+
+		if (value && !trigger.lastValue)
+			m_flightRecorder->triggered = true;
+		trigger.lastValue = value;
+	}
+}
+
+void WaveformRecorder::writeWindow()
+{
+	auto &recorder = *m_flightRecorder;
+	recorder.triggered = false;
+
+	for (auto i : utils::Range(recorder.chunks.size())) {
+		const auto &chunk = *recorder.chunks[i];
+		size_t firstChange = 0;
+
+		if (i == 0 && !recorder.continuous) {
+			// Start with the state of all signals at the beginning of the window.
+			advanceTick(chunk.startTime);
+			if (!chunk.buffer.changes.empty() && chunk.buffer.changes.front().type == CapturedChange::Type::TICK)
+				firstChange = 1;
+
+			m_trackedState = chunk.startState;
+			for (auto id : utils::Range(m_id2Signal.size()))
+				if (m_id2StateOffsetSize[id].size != 0)
+					signalChanged(id);
+		}
+
+		replay(chunk.buffer, firstChange);
+	}
+
+	recycleChunks(recorder.chunks.size());
+	recorder.continuous = true;
+}
+
 void WaveformRecorder::addSignal(hlim::NodePort driver, hlim::BaseNode *relevantNode, bool hidden)
 {
 	HCL_ASSERT(!hlim::outputIsDependency(driver));
@@ -159,7 +451,28 @@ void WaveformRecorder::addAllMemories()
 
 void WaveformRecorder::onAfterPowerOn()
 {
+	// Changes of a previous run must be written before the states are reset.
+	if (m_flightRecorder && m_flightRecorder->triggered)
+		writeWindow();
+	flush();
+
 	initializeStates();
+	buildStateMirror();
+	m_capturedState = m_trackedState;
+
+	if (m_flightRecorder) {
+		auto &recorder = *m_flightRecorder;
+		recycleChunks(recorder.chunks.size());
+		recorder.triggered = false;
+		recorder.continuous = false;
+		startChunk(m_simulator.getCurrentSimulationTime());
+
+		for (auto &trigger : recorder.triggers) {
+			trigger.stateOffset = m_simulator.getOutputStateOffset(trigger.condition);
+			trigger.lastValue = false;
+		}
+	}
+
 	initialize();
 	m_initialized = true;
 }
@@ -182,11 +495,85 @@ void WaveformRecorder::initializeStates()
 	}
 	m_trackedState.resize(allocator.getTotalSize());
 	m_trackedState.clearRange(DefaultConfig::DEFINED, 0, allocator.getTotalSize());
+	m_trackedState.clearRange(DefaultConfig::VALUE, 0, allocator.getTotalSize());
+}
+
+void WaveformRecorder::buildStateMirror()
+{
+	m_stateMirror.reset();
+
+	const auto *state = m_simulator.getSignalState();
+	if (state == nullptr) return;
+
+	auto mirror = std::make_unique<StateMirror>();
+	mirror->stateOffset.resize(m_id2Signal.size(), ~0ull);
+
+	constexpr size_t wordSize = DefaultConfig::NUM_BITS_PER_BLOCK;
+
+	// Collect the signals overlapping each word of the simulator's state, in order of the words.
+	std::map<size_t, std::vector<StateMirror::Watcher>> wordWatchers;
+	for (auto id : utils::Range(m_id2Signal.size())) {
+		auto &signal = m_id2Signal[id];
+		size_t size = m_id2StateOffsetSize[id].size;
+		if (size == 0) continue;
+
+		size_t offset;
+		if (signal.signalRef.driver.node != nullptr)
+			offset = m_simulator.getOutputStateOffset(signal.signalRef.driver);
+		else {
+			offset = m_simulator.getInternalStateOffset(signal.memory, (size_t) hlim::Node_Memory::Internal::data);
+			if (offset != ~0ull)
+				offset += signal.memoryWordIdx * signal.memoryWordSize;
+		}
+		// Signals that are not simulated never change.
+		if (offset == ~0ull) continue;
+		HCL_ASSERT(offset + size <= state->size());
+
+		mirror->stateOffset[id] = offset;
+		for (size_t word = offset / wordSize; word * wordSize < offset + size; word++) {
+			size_t start = std::max(offset, word * wordSize);
+			size_t end = std::min(offset + size, (word+1) * wordSize);
+			wordWatchers[word].push_back({ .id = id, .mask = utils::bitMaskRange<std::uint64_t>(start - word * wordSize, end - start) });
+		}
+	}
+
+	mirror->watcherStart.reserve(wordWatchers.size()+1);
+	for (auto &[word, watchers] : wordWatchers) {
+		if (mirror->runs.empty() || mirror->runs.back().stateWord + mirror->runs.back().numWords != word)
+			mirror->runs.push_back({ .stateWord = word, .mirrorWord = mirror->mask.size(), .numWords = 0 });
+		mirror->runs.back().numWords++;
+
+		std::uint64_t mask = 0;
+		for (const auto &watcher : watchers)
+			mask |= watcher.mask;
+		mirror->mask.push_back(mask);
+
+		mirror->watcherStart.push_back(mirror->watchers.size());
+		mirror->watchers.insert(mirror->watchers.end(), watchers.begin(), watchers.end());
+	}
+	mirror->watcherStart.push_back(mirror->watchers.size());
+
+	// Same as the tracked state: Everything starts out undefined.
+	mirror->value.resize(mirror->mask.size(), 0);
+	mirror->defined.resize(mirror->mask.size(), 0);
+
+	mirror->isChanged.resize(m_id2Signal.size(), 0);
+	mirror->changedIds.reserve(m_id2Signal.size());
+
+	m_stateMirror = std::move(mirror);
 }
 
 
 void WaveformRecorder::onCommitState()
 {
+	if (m_stateMirror) {
+		commitFromStateMirror();
+		return;
+	}
+
+	auto *buffer = capturingBuffer();
+	auto &trackedState = buffer ? m_capturedState : m_trackedState;
+
 	for (auto id : utils::Range(m_id2Signal.size())) {
 		auto &signal = m_id2Signal[id];
 		auto offset = m_id2StateOffsetSize[id].offset;
@@ -202,7 +589,7 @@ void WaveformRecorder::onCommitState()
 		bool stateChanged = false;
 		for (auto p : utils::Range(DefaultConfig::NUM_PLANES)) {
 			for (auto i : utils::Range(size))
-				if (newState.get(p, i) != m_trackedState.get(p, offset+i)) {
+				if (newState.get(p, i) != trackedState.get(p, offset+i)) {
 					stateChanged = true;
 					break;
 				}
@@ -210,18 +597,241 @@ void WaveformRecorder::onCommitState()
 		}
 
 		if (stateChanged) {
-			m_trackedState.copyRange(offset, newState, 0, size);
+			trackedState.copyRange(offset, newState, 0, size);
+			if (buffer) {
+				size_t stateOffset = buffer->states.size();
+				buffer->states.resize(stateOffset + size);
+				buffer->states.copyRange(stateOffset, newState, 0, size);
+				buffer->changes.push_back({ .type = CapturedChange::Type::SIGNAL, .index = id, .stateOffset = stateOffset });
+			} else
+				signalChanged(id);
+		}
+	}
+
+	if (m_flightRecorder)
+		checkTriggers();
+	else if (m_asyncWriter && m_asyncWriter->capturing->sizeInBytes() >= m_asyncWriter->bufferSize)
+		submitCaptureBuffer();
+}
+
+void WaveformRecorder::commitFromStateMirror()
+{
+	auto &mirror = *m_stateMirror;
+	const auto &state = *m_simulator.getSignalState();
+	const auto *value = state.data(DefaultConfig::VALUE);
+	const auto *defined = state.data(DefaultConfig::DEFINED);
+
+	for (const auto &run : mirror.runs)
+		for (auto i : utils::Range(run.numWords)) {
+			size_t stateWord = run.stateWord + i;
+			size_t mirrorWord = run.mirrorWord + i;
+			std::uint64_t diff = ((value[stateWord] ^ mirror.value[mirrorWord]) | (defined[stateWord] ^ mirror.defined[mirrorWord])) & mirror.mask[mirrorWord];
+			if (diff == 0) continue;
+
+			mirror.value[mirrorWord] = value[stateWord];
+			mirror.defined[mirrorWord] = defined[stateWord];
+			for (auto w : utils::Range(mirror.watcherStart[mirrorWord], mirror.watcherStart[mirrorWord+1])) {
+				const auto &watcher = mirror.watchers[w];
+				if ((watcher.mask & diff) && !mirror.isChanged[watcher.id]) {
+					mirror.isChanged[watcher.id] = true;
+					mirror.changedIds.push_back(watcher.id);
+				}
+			}
+		}
+
+	// Signals spanning several words can be found out of order, but are reported in the same order as without the mirror.
+	std::sort(mirror.changedIds.begin(), mirror.changedIds.end());
+
+	auto *buffer = capturingBuffer();
+	for (auto id : mirror.changedIds) {
+		mirror.isChanged[id] = false;
+		auto offset = m_id2StateOffsetSize[id].offset;
+		auto size = m_id2StateOffsetSize[id].size;
+
+		if (buffer) {
+			m_capturedState.copyRange(offset, state, mirror.stateOffset[id], size);
+			size_t stateOffset = buffer->states.size();
+			buffer->states.resize(stateOffset + size);
+			buffer->states.copyRange(stateOffset, state, mirror.stateOffset[id], size);
+			buffer->changes.push_back({ .type = CapturedChange::Type::SIGNAL, .index = id, .stateOffset = stateOffset });
+		} else {
+			m_trackedState.copyRange(offset, state, mirror.stateOffset[id], size);
 			signalChanged(id);
 		}
 	}
+	mirror.changedIds.clear();
+
+	if (m_flightRecorder)
+		checkTriggers();
+	else if (m_asyncWriter && m_asyncWriter->capturing->sizeInBytes() >= m_asyncWriter->bufferSize)
+		submitCaptureBuffer();
 }
 
 void WaveformRecorder::onNewTick(const hlim::ClockRational &simulationTime)
 {
-	if (m_initialized)
+	if (!m_initialized) return;
+
+	if (m_flightRecorder) {
+		auto &recorder = *m_flightRecorder;
+		if (recorder.triggered)
+			writeWindow();
+
+		if (recorder.chunks.empty() || simulationTime - recorder.chunks.back()->startTime >= recorder.window / FlightRecorder::CHUNKS_PER_WINDOW) {
+			startChunk(simulationTime);
+
+			size_t numOutdated = 0;
+			while (numOutdated+1 < recorder.chunks.size() && recorder.chunks[numOutdated+1]->startTime + recorder.window <= simulationTime)
+				numOutdated++;
+			if (numOutdated > 0) {
+				recycleChunks(numOutdated);
+				recorder.continuous = false;
+			}
+		}
+	}
+
+	if (auto *buffer = capturingBuffer()) {
+		buffer->changes.push_back({ .type = CapturedChange::Type::TICK, .index = buffer->times.size() });
+		buffer->times.push_back(simulationTime);
+	} else
 		advanceTick(simulationTime);
 }
 
+void WaveformRecorder::onClock(const hlim::Clock *clock, bool risingEdge)
+{
+	if (!m_initialized) return;
+
+	if (auto *buffer = capturingBuffer())
+		buffer->changes.push_back({ .type = CapturedChange::Type::CLOCK, .clock = clock, .value = risingEdge });
+	else
+		clockChanged(clock, risingEdge);
+}
+
+void WaveformRecorder::onReset(const hlim::Clock *clock, bool resetAsserted)
+{
+	if (!m_initialized) return;
+
+	if (auto *buffer = capturingBuffer())
+		buffer->changes.push_back({ .type = CapturedChange::Type::RESET, .clock = clock, .value = resetAsserted });
+	else
+		resetChanged(clock, resetAsserted);
+}
+
+void WaveformRecorder::onDebugMessage(const hlim::BaseNode *src, std::string msg)
+{
+	captureMessage(MessageType::DEBUG_MESSAGE, std::move(msg));
+}
+
+void WaveformRecorder::onWarning(const hlim::BaseNode *src, std::string msg)
+{
+	captureMessage(MessageType::WARNING, std::move(msg));
+	if (m_initialized && m_flightRecorder && m_flightRecorder->triggerOnWarning)
+		m_flightRecorder->triggered = true;
+}
+
+void WaveformRecorder::onAssert(const hlim::BaseNode *src, std::string msg)
+{
+	captureMessage(MessageType::ASSERT, std::move(msg));
+	if (m_initialized && m_flightRecorder && m_flightRecorder->triggerOnAssert)
+		m_flightRecorder->triggered = true;
+}
+
+void WaveformRecorder::captureMessage(MessageType type, std::string msg)
+{
+	if (!m_initialized) return;
+
+	if (auto *buffer = capturingBuffer()) {
+		buffer->changes.push_back({ .type = CapturedChange::Type::MESSAGE, .index = buffer->messages.size(), .messageType = type });
+		buffer->messages.push_back({ m_simulator.getCurrentSimulationTime(), std::move(msg) });
+	} else
+		messageLogged(type, m_simulator.getCurrentSimulationTime(), msg);
+}
+
+WaveformRecorder::ModuleHierarchy WaveformRecorder::buildModuleHierarchy() const
+{
+	ModuleHierarchy root;
+
+	for (auto id : utils::Range(m_id2Signal.size())) {
+		auto &signal = m_id2Signal[id];
+
+		std::vector<const hlim::NodeGroup*> nodeGroupTrace;
+		const hlim::NodeGroup* grp = signal.nodeGroup;
+		while (grp != nullptr) {
+			nodeGroupTrace.push_back(grp);
+			grp = grp->getParent();
+		}
+		ModuleHierarchy* m = &root;
+		for (auto it = nodeGroupTrace.rbegin(); it != nodeGroupTrace.rend(); ++it)
+			m = &m->subModules[*it];
+
+		if (signal.signalRef.driver.node != nullptr)
+			m->signals.push_back({ signal.signalRef.driver, id });
+		else
+			m->memoryWords[signal.memory].push_back(id);
+	}
+
+	return root;
+}
+
+void WaveformRecorder::appendPinsAndTapsByClockDomain(GTKWaveProjectFile &projectFile)
+{
+	// For easier extension in the future (beyond IO pins) determine clock domains for all signals so
+	// that they can be sorted by clocks without relying on the clock ports of the io pins.
+	utils::UnstableMap<hlim::NodePort, hlim::SignalClockDomain> clockDomains;
+	hlim::inferClockDomains(m_circuit, clockDomains);
+
+	utils::StableMap<hlim::Clock*, std::vector<Signal*>> signalsByClocks;
+
+	for (auto &s : m_id2Signal) {
+		if (!s.isPin && !s.isTap) continue;
+
+		auto it = clockDomains.find(s.signalRef.driver);
+		if (it == clockDomains.end() || it->second.type != hlim::SignalClockDomain::CLOCK)
+			signalsByClocks[nullptr].push_back(&s);
+		else
+			signalsByClocks[it->second.clk].push_back(&s);
+	}
+
+
+	auto constructFullSignalName = [](const Signal &signal) {
+		std::string name = signal.name;
+		auto *grp = signal.nodeGroup;
+		while (grp != nullptr) {
+			name = grp->getInstanceName() + '.' + name;
+			grp = grp->getParent();
+		}
+		return name;
+	};
+
+	for (auto &clockDomain : signalsByClocks) {
+		if (clockDomain.first != nullptr) {
+			auto *clockPin = clockDomain.first->getClockPinSource();
+			projectFile.appendSignal(std::string("clocks.")+clockPin->getName()).color = GTKWaveProjectFile::Signal::BLUE;
+			if(auto* rstPin = clockDomain.first->getResetPinSource())
+				projectFile.appendSignal(std::string("clocks.")+rstPin->getResetName()).color = GTKWaveProjectFile::Signal::INDIGO;
+		}
+
+		projectFile.appendBlank();
+
+		std::sort(clockDomain.second.begin(), clockDomain.second.end(), [](Signal* lhs, Signal* rhs)->bool{
+			return lhs->sortOrder < rhs->sortOrder;
+		});
+
+		for (auto *signal : clockDomain.second) {
+			std::string vcdName = constructFullSignalName(*signal);
+
+			auto connectionType = hlim::getOutputConnectionType(signal->signalRef.driver);
+
+			// GTKWave does not include 1 bit vectors in the signal list, so we need to treat them as bits
+			if (!connectionType.isBool() && connectionType.width > 1)
+				vcdName = (boost::format("%s[%d:0]") % vcdName % (connectionType.width-1)).str();
+
+			projectFile.appendSignal(vcdName);
+		}
+
+		projectFile.appendBlank();
+	}
+}
+
 
 
 }
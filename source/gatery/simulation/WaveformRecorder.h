@@ -22,10 +22,19 @@
 #include "SimulatorCallbacks.h"
 #include "BitVectorState.h"
 #include "../hlim/NodePtr.h"
+#include "../hlim/ClockRational.h"
+#include "../hlim/NodeGroup.h"
+#include "../hlim/supportNodes/Node_Memory.h"
 
 #include <vector>
 #include <map>
 #include <set>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
 
 namespace gtry::hlim {
 	class Circuit;
@@ -38,15 +47,52 @@ namespace gtry::hlim {
 namespace gtry::sim {
 
 class Simulator;
+class SigHandle;
+class GTKWaveProjectFile;
 
 /**
  * @brief Base class for waveform recorders (e.g. to write VCD files of a simulation run).
+ * @details Derived classes receive the recorded changes through signalChanged, advanceTick, clockChanged, resetChanged, and messageLogged.
+ * These are either called directly from the simulator's callbacks or, if writeAsynchronously is enabled, from a background thread.
+ * With recordWindow, only the most recent changes are kept in memory and passed on when a trigger fires.
  */
 class WaveformRecorder : public SimulatorCallbacks
 {
 	public:
+		enum class MessageType {
+			DEBUG_MESSAGE,
+			WARNING,
+			ASSERT,
+		};
+
 		WaveformRecorder(hlim::Circuit &circuit, Simulator &simulator);
-		virtual ~WaveformRecorder() = default;
+		virtual ~WaveformRecorder();
+
+		/// @brief Moves the formatting and writing of the waveform off the simulation thread.
+		/// @details The simulation thread only captures the changed signal states, clock and reset edges, and messages into a buffer of about
+		/// bufferSize bytes and hands full buffers to a writer thread. If all numBuffers buffers are in flight, the simulation waits for the writer.
+		/// Must be enabled before the simulation is powered on. Can not be combined with recordWindow, whose windows are only written when a
+		/// trigger fires and then directly from the simulation thread.
+		void writeAsynchronously(size_t bufferSize = 4ull << 20, size_t numBuffers = 2);
+		/// Waits for all captured changes to be written. No-op if not writing asynchronously.
+		void flush();
+		/// @brief Writes all captured changes, including a triggered window, and stops the writer thread.
+		/// @details Replaying captured changes needs the derived class, so every derived class calls finishWritingInDestructor first thing in its
+		/// destructor. Owners can call this earlier to have the waveform complete at a defined point and to receive the exception if writing failed,
+		/// including failures of the writer thread. Changes recorded afterwards are written directly.
+		void finishWriting();
+
+		/// @brief Only keeps the changes of (at least) the last window of simulation time in memory and writes them when a trigger fires.
+		/// @details Triggers are asserts and warnings (if enabled), signals added through addTrigger, and calls to trigger. The window is written
+		/// at the start of the next tick, so it includes the entire tick in which the trigger fired. Changes before the window are never written.
+		/// Must be enabled before the simulation is powered on. Can not be combined with writeAsynchronously.
+		void recordWindow(const hlim::ClockRational &window, bool triggerOnAssert = true, bool triggerOnWarning = false);
+		/// Writes the window whenever the given single bit signal becomes high.
+		void addTrigger(const hlim::NodePort &condition);
+		/// Writes the window whenever the given single bit signal becomes high.
+		void addTrigger(const SigHandle &condition);
+		/// Writes the window at the start of the next tick, e.g. when called from a simulation process.
+		void trigger();
 
 		void addSignal(hlim::NodePort driver, hlim::BaseNode *relevantNode, bool hidden);
 		void addMemory(hlim::Node_Memory *mem, hlim::NodeGroup *group, const std::string &nameOverride = {}, size_t sortOrder = 0);
@@ -60,6 +106,12 @@ class WaveformRecorder : public SimulatorCallbacks
 		virtual void onAfterPowerOn() override;
 		virtual void onCommitState() override;
 		virtual void onNewTick(const hlim::ClockRational &simulationTime) override;
+		virtual void onClock(const hlim::Clock *clock, bool risingEdge) override;
+		virtual void onReset(const hlim::Clock *clock, bool resetAsserted) override;
+		virtual void onDebugMessage(const hlim::BaseNode *src, std::string msg) override;
+		virtual void onWarning(const hlim::BaseNode *src, std::string msg) override;
+		virtual void onAssert(const hlim::BaseNode *src, std::string msg) override;
+		virtual bool observesSimProcIO() const override { return false; }
 	protected:
 		hlim::Circuit &m_circuit;
 		Simulator &m_simulator;
@@ -100,10 +152,152 @@ class WaveformRecorder : public SimulatorCallbacks
 		utils::UnstableMap<SignalReference, size_t> m_alreadyAddedNodePorts;
 		utils::UnstableMap<hlim::Node_Memory *, size_t> m_alreadyAddedMemories;
 
+		/// Signal ids grouped by the node group hierarchy, which waveform formats declare as nested modules.
+		struct ModuleHierarchy {
+			utils::StableMap<const hlim::NodeGroup*, ModuleHierarchy> subModules;
+			std::vector<std::pair<hlim::NodePort, size_t>> signals;
+			utils::StableMap<hlim::Node_Memory*, std::vector<size_t>> memoryWords;
+		};
+		ModuleHierarchy buildModuleHierarchy() const;
+		/// Appends all pins and taps, sorted by clock domain, to the signal list of the project file.
+		void appendPinsAndTapsByClockDomain(GTKWaveProjectFile &projectFile);
+
+		/// A change captured on the simulation thread, to be replayed on the writer thread.
+		struct CapturedChange {
+			enum class Type {
+				SIGNAL,
+				TICK,
+				CLOCK,
+				RESET,
+				MESSAGE,
+			};
+			Type type;
+			/// Signal id or index into CaptureBuffer::times or CaptureBuffer::messages
+			size_t index = 0;
+			/// Offset of the signal's state in CaptureBuffer::states
+			size_t stateOffset = 0;
+			const hlim::Clock *clock = nullptr;
+			/// Rising edge or reset asserted
+			bool value = false;
+			MessageType messageType = MessageType::DEBUG_MESSAGE;
+		};
+		struct CaptureBuffer {
+			std::vector<CapturedChange> changes;
+			DefaultBitVectorState states;
+			std::vector<hlim::ClockRational> times;
+			std::vector<std::pair<hlim::ClockRational, std::string>> messages;
+
+			size_t sizeInBytes() const;
+			void clear();
+		};
+		struct AsyncWriter {
+			size_t bufferSize;
+			std::thread thread;
+			std::mutex mutex;
+			std::condition_variable wakeWriter;
+			std::condition_variable wakeSimulation;
+			std::deque<std::unique_ptr<CaptureBuffer>> filled;
+			std::vector<std::unique_ptr<CaptureBuffer>> free;
+			size_t numBuffers;
+			bool shutdown = false;
+			std::exception_ptr exception;
+
+			/// The buffer currently filled by the simulation thread.
+			std::unique_ptr<CaptureBuffer> capturing;
+		};
+		std::unique_ptr<AsyncWriter> m_asyncWriter;
+
+		struct FlightRecorder {
+			/// Number of chunks a window is split into, the oldest chunk is dropped once the remaining ones still cover the window.
+			static constexpr size_t CHUNKS_PER_WINDOW = 8;
+
+			hlim::ClockRational window;
+			bool triggerOnAssert;
+			bool triggerOnWarning;
+
+			struct Trigger {
+				hlim::RefCtdNodePort condition;
+				/// Offset of the condition in the simulator's state or ~0ull if it is not exposed.
+				size_t stateOffset = ~0ull;
+				bool lastValue = false;
+			};
+			std::vector<Trigger> triggers;
+
+			/// The changes captured since startTime, together with the states of all recorded signals at startTime.
+			struct Chunk {
+				hlim::ClockRational startTime;
+				sim::DefaultBitVectorState startState;
+				CaptureBuffer buffer;
+			};
+			std::deque<std::unique_ptr<Chunk>> chunks;
+			std::vector<std::unique_ptr<Chunk>> freeChunks;
+
+			bool triggered = false;
+			/// Whether the oldest chunk continues where the last written window ended, so that its start state needs not be written.
+			bool continuous = false;
+		};
+		std::unique_ptr<FlightRecorder> m_flightRecorder;
+
+		/// Copy of the recorded signals' states while changes are captured instead of written, as m_trackedState then reflects what has been written.
+		sim::DefaultBitVectorState m_capturedState;
+
+		/**
+		 * @brief Copy of the simulator's state words that contain recorded signals, to find changed signals without extracting every signal on every commit.
+		 * @details Built once on power on if the simulator exposes its state. Each commit compares whole 64-bit words of the simulator's
+		 * state against the copy, run by run, and only visits the signals overlapping the words that differ.
+		 */
+		struct StateMirror {
+			/// Consecutive words of the simulator's state, stored consecutively in the mirror.
+			struct WordRun {
+				size_t stateWord;
+				size_t mirrorWord;
+				size_t numWords;
+			};
+			/// A signal overlapping a mirrored word and the bits it occupies in that word.
+			struct Watcher {
+				size_t id;
+				std::uint64_t mask;
+			};
+			std::vector<WordRun> runs;
+			std::vector<std::uint64_t> value;
+			std::vector<std::uint64_t> defined;
+			/// Bits of each mirrored word that belong to recorded signals.
+			std::vector<std::uint64_t> mask;
+			/// The watchers of mirrored word i are watchers[watcherStart[i]] to watchers[watcherStart[i+1]-1].
+			std::vector<size_t> watcherStart;
+			std::vector<Watcher> watchers;
+			/// Offset of each signal in the simulator's state or ~0ull if it is not simulated.
+			std::vector<size_t> stateOffset;
+
+			std::vector<std::uint8_t> isChanged;
+			std::vector<size_t> changedIds;
+		};
+		std::unique_ptr<StateMirror> m_stateMirror;
+
+		/// Same as finishWriting, but logs failures instead of throwing them, for the destructors of derived classes.
+		void finishWritingInDestructor();
+
 		void initializeStates();
+		void buildStateMirror();
+		void commitFromStateMirror();
 		virtual void initialize() = 0;
 		virtual void signalChanged(size_t id) = 0;
 		virtual void advanceTick(const hlim::ClockRational &simulationTime) = 0;
+		virtual void clockChanged(const hlim::Clock *clock, bool risingEdge) { }
+		virtual void resetChanged(const hlim::Clock *clock, bool resetAsserted) { }
+		virtual void messageLogged(MessageType type, const hlim::ClockRational &simulationTime, const std::string &msg) { }
+
+		void captureMessage(MessageType type, std::string msg);
+		/// The buffer that changes are captured into or nullptr if they are written directly.
+		CaptureBuffer *capturingBuffer();
+		void submitCaptureBuffer();
+		void replay(const CaptureBuffer &buffer, size_t firstChange = 0);
+
+		void startChunk(const hlim::ClockRational &simulationTime);
+		void recycleChunks(size_t count);
+		void checkTriggers();
+		void writeWindow();
+		void writerThread(AsyncWriter &writer);
 };
 
 
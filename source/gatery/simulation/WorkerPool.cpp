@@ -0,0 +1,203 @@
+/*  This file is part of Gatery, a library for circuit design.
+	Copyright (C) 2021 Michael Offel, Andreas Ley
+
+	Gatery is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 3 of the License, or (at your option) any later version.
+
+	Gatery is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include "gatery/pch.h"
+#include "WorkerPool.h"
+
+#include "../utils/Range.h"
+#include "../utils/Exceptions.h"
+#include "../utils/Preprocessor.h"
+
+namespace gtry::sim {
+
+void TaskGraph::resize(size_t numTasks)
+{
+	dependents.resize(numTasks);
+	numDependencies.resize(numTasks, 0);
+}
+
+void TaskGraph::addDependency(size_t task, size_t dependsOn)
+{
+	auto &list = dependents[dependsOn];
+	if (std::find(list.begin(), list.end(), task) != list.end())
+		return;
+	list.push_back(task);
+	numDependencies[task]++;
+}
+
+
+WorkerPool::WorkerPool(size_t numThreads)
+{
+	HCL_ASSERT(numThreads > 0);
+
+	m_queues.resize(numThreads);
+	for (auto &q : m_queues)
+		q = std::make_unique<Queue>();
+
+	m_threads.reserve(numThreads-1);
+	for (auto i : utils::Range<size_t>(1, numThreads))
+		m_threads.emplace_back([this, i]{ worker(i); });
+}
+
+WorkerPool::~WorkerPool()
+{
+	m_shutdown.store(true);
+	m_generation.fetch_add(1, std::memory_order_release);
+	m_generation.notify_all();
+
+	for (auto &t : m_threads)
+		t.join();
+}
+
+void WorkerPool::run(const TaskGraph &graph, const TaskFunction &function)
+{
+	if (graph.size() == 0)
+		return;
+
+	m_graph = &graph;
+	m_function = &function;
+
+	if (m_remainingDependenciesSize < graph.size()) {
+		m_remainingDependencies = std::make_unique<std::atomic<size_t>[]>(graph.size());
+		m_remainingDependenciesSize = graph.size();
+	}
+	for (auto i : utils::Range(graph.size()))
+		m_remainingDependencies[i].store(graph.numDependencies[i], std::memory_order_relaxed);
+
+	m_failed.store(false, std::memory_order_relaxed);
+	m_tasksRemaining.store(graph.size(), std::memory_order_relaxed);
+
+	// Distribute the initially ready tasks round robin, the rest is balanced by stealing.
+	size_t nextQueue = 0;
+	for (auto i : utils::Range(graph.size()))
+		if (graph.numDependencies[i] == 0) {
+			pushTask(nextQueue, i);
+			nextQueue = (nextQueue + 1) % m_queues.size();
+		}
+
+	m_generation.fetch_add(1, std::memory_order_release);
+	m_generation.notify_all();
+
+	work(0);
+
+	// Once no tasks remain, no worker touches the graph or the function anymore.
+	m_graph = nullptr;
+	m_function = nullptr;
+
+	if (m_failed.load(std::memory_order_acquire)) {
+		std::exception_ptr exception;
+		{
+			std::lock_guard lock(m_exceptionMutex);
+			std::swap(exception, m_exception);
+		}
+		std::rethrow_exception(exception);
+	}
+}
+
+void WorkerPool::run(size_t numTasks, const TaskFunction &function)
+{
+	m_independentTasks.resize(numTasks);
+	run(m_independentTasks, function);
+}
+
+void WorkerPool::worker(size_t thread)
+{
+	// Number of times to check for new work before going to sleep.
+	constexpr size_t spinCount = 1000;
+
+	std::uint64_t seenGeneration = 0;
+	while (true) {
+		std::uint64_t generation;
+		size_t spins = 0;
+		while ((generation = m_generation.load(std::memory_order_acquire)) == seenGeneration) {
+			if (++spins < spinCount)
+				std::this_thread::yield();
+			else
+				m_generation.wait(seenGeneration, std::memory_order_acquire);
+		}
+		seenGeneration = generation;
+
+		if (m_shutdown.load())
+			return;
+
+		work(thread);
+	}
+}
+
+void WorkerPool::work(size_t thread)
+{
+	size_t task;
+	while (m_tasksRemaining.load(std::memory_order_acquire) != 0) {
+		if (popTask(thread, task))
+			executeTask(thread, task);
+		else
+			std::this_thread::yield();
+	}
+}
+
+bool WorkerPool::popTask(size_t thread, size_t &task)
+{
+	{
+		auto &own = *m_queues[thread];
+		std::lock_guard lock(own.mutex);
+		if (!own.tasks.empty()) {
+			task = own.tasks.back();
+			own.tasks.pop_back();
+			return true;
+		}
+	}
+
+	for (auto i : utils::Range<size_t>(1, m_queues.size())) {
+		auto &victim = *m_queues[(thread + i) % m_queues.size()];
+		std::lock_guard lock(victim.mutex);
+		if (!victim.tasks.empty()) {
+			task = victim.tasks.front();
+			victim.tasks.pop_front();
+			return true;
+		}
+	}
+	return false;
+}
+
+void WorkerPool::pushTask(size_t thread, size_t task)
+{
+	auto &queue = *m_queues[thread];
+	std::lock_guard lock(queue.mutex);
+	queue.tasks.push_back(task);
+}
+
+void WorkerPool::executeTask(size_t thread, size_t task)
+{
+	if (!m_failed.load(std::memory_order_relaxed)) {
+		try {
+			(*m_function)(task, thread);
+		} catch (...) {
+			std::lock_guard lock(m_exceptionMutex);
+			if (!m_exception)
+				m_exception = std::current_exception();
+			m_failed.store(true, std::memory_order_release);
+		}
+	}
+
+	for (auto dependent : m_graph->dependents[task])
+		if (m_remainingDependencies[dependent].fetch_sub(1, std::memory_order_acq_rel) == 1)
+			pushTask(thread, dependent);
+
+	m_tasksRemaining.fetch_sub(1, std::memory_order_release);
+}
+
+}
@@ -0,0 +1,97 @@
+/*  This file is part of Gatery, a library for circuit design.
+	Copyright (C) 2021 Michael Offel, Andreas Ley
+
+	Gatery is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 3 of the License, or (at your option) any later version.
+
+	Gatery is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <exception>
+#include <memory>
+
+namespace gtry::sim {
+
+/**
+ * @brief Tasks with dependencies among each other, to be executed by a WorkerPool.
+ */
+struct TaskGraph
+{
+	/// For each task, the tasks that may only start after it has finished.
+	std::vector<std::vector<size_t>> dependents;
+	/// For each task, the number of tasks it has to wait for.
+	std::vector<size_t> numDependencies;
+
+	inline size_t size() const { return dependents.size(); }
+	void resize(size_t numTasks);
+	/// Lets task wait for dependsOn to finish. Duplicate dependencies are ignored.
+	void addDependency(size_t task, size_t dependsOn);
+};
+
+/**
+ * @brief A pool of worker threads with work stealing that is optimized for frequently running small task graphs.
+ * @details The thread calling run() participates in the work as thread 0, so a pool of n threads spawns n-1 workers.
+ * Idle workers spin for a short while before going to sleep since the simulator issues runs in quick succession.
+ */
+class WorkerPool
+{
+	public:
+		/// Function executing a task, receives the task index and the index of the executing thread.
+		using TaskFunction = std::function<void(size_t task, size_t thread)>;
+
+		WorkerPool(size_t numThreads);
+		~WorkerPool();
+
+		inline size_t getNumThreads() const { return m_queues.size(); }
+
+		/// Executes all tasks of the graph, respecting their dependencies, and returns once all are done.
+		/// @details If any task throws, the remaining tasks are skipped and the first exception is rethrown.
+		void run(const TaskGraph &graph, const TaskFunction &function);
+		/// Executes the tasks 0 to numTasks-1 which do not depend on each other.
+		void run(size_t numTasks, const TaskFunction &function);
+	protected:
+		struct alignas(64) Queue {
+			std::mutex mutex;
+			std::deque<size_t> tasks;
+		};
+		std::vector<std::unique_ptr<Queue>> m_queues;
+		std::vector<std::thread> m_threads;
+		TaskGraph m_independentTasks;
+
+		const TaskGraph *m_graph = nullptr;
+		const TaskFunction *m_function = nullptr;
+		std::unique_ptr<std::atomic<size_t>[]> m_remainingDependencies;
+		size_t m_remainingDependenciesSize = 0;
+
+		alignas(64) std::atomic<size_t> m_tasksRemaining = 0;
+		alignas(64) std::atomic<std::uint64_t> m_generation = 0;
+		std::atomic<bool> m_shutdown = false;
+
+		std::atomic<bool> m_failed = false;
+		std::mutex m_exceptionMutex;
+		std::exception_ptr m_exception;
+
+		void worker(size_t thread);
+		void work(size_t thread);
+		bool popTask(size_t thread, size_t &task);
+		void pushTask(size_t thread, size_t task);
+		void executeTask(size_t thread, size_t task);
+};
+
+}
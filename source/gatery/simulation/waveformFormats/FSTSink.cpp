@@ -0,0 +1,168 @@
+/*  This file is part of Gatery, a library for circuit design.
+	Copyright (C) 2021 Michael Offel, Andreas Ley
+
+	Gatery is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 3 of the License, or (at your option) any later version.
+
+	Gatery is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include "gatery/pch.h"
+#include "FSTSink.h"
+
+#include "../../hlim/NodeGroup.h"
+#include "../../hlim/Circuit.h"
+#include "../../hlim/Node.h"
+#include "../../hlim/supportNodes/Node_Memory.h"
+#include "../Simulator.h"
+#include "../../hlim/postprocessing/ClockPinAllocation.h"
+#include "../../hlim/Subnet.h"
+
+#include <functional>
+
+namespace gtry::sim
+{
+	FSTSink::FSTSink(hlim::Circuit& circuit, Simulator& simulator, const char* filename) :
+		WaveformRecorder(circuit, simulator),
+		m_FST(filename)
+	{
+		m_gtkWaveProjectFile.setWaveformFile(filename);
+
+		auto clockPins = hlim::extractClockPins(circuit, hlim::Subnet::allForSimulation(circuit));
+
+		for(auto& clk : clockPins.clockPins)
+			m_clocks.push_back(clk.source);
+
+		for(auto& rst : clockPins.resetPins)
+			m_resets.push_back(rst.source);
+	}
+
+	FSTSink::~FSTSink()
+	{
+		finishWritingInDestructor();
+		m_FST.close();
+		writeGtkWaveProjFile();
+	}
+
+	void FSTSink::writeGtkWaveProjFile()
+	{
+		m_gtkWaveProjectFile.write((m_gtkWaveProjectFile.getWaveformFile()+".gtkw").c_str());
+		m_gtkWaveProjectFile.writeSurferScript(m_gtkWaveProjectFile.getWaveformFile() + ".surfer");
+	}
+
+	void FSTSink::messageLogged(MessageType type, const hlim::ClockRational &simulationTime, const std::string &msg)
+	{
+		if (type != MessageType::ASSERT) return;
+
+		try {
+			m_gtkWaveProjectFile.addMarker(simulationTime);
+		} catch (...) {
+		}
+	}
+
+	void FSTSink::initialize()
+	{
+		m_id2handle.resize(m_id2Signal.size());
+
+		auto root = buildModuleHierarchy();
+
+		std::function<void(const ModuleHierarchy*)> reccurWriteModules;
+		reccurWriteModules = [&](const ModuleHierarchy* module) {
+			for(const auto& p : module->subModules) {
+				auto named_module = m_FST.beginModule(p.first->getInstanceName());
+				reccurWriteModules(&p.second);
+			}
+
+			for(const auto& sigId : module->signals) {
+				if(m_id2Signal[sigId.second].isHidden)
+					continue;
+
+				auto width = hlim::getOutputWidth(sigId.first);
+				if (width == 0) continue;
+				m_id2handle[sigId.second] = m_FST.declareWire(width, m_id2Signal[sigId.second].name);
+			}
+
+			for(const auto& mem : module->memoryWords) {
+				auto named_module = m_FST.beginModule("memory_"+mem.first->getName());
+				for(const auto& sigId : mem.second) {
+					auto& signal = m_id2Signal[sigId];
+					if (signal.memoryWordSize == 0) continue;
+					m_id2handle[sigId] = m_FST.declareWire(signal.memoryWordSize, m_id2Signal[sigId].name);
+				}
+			}
+
+			auto hidden_module = m_FST.beginModule("__hidden");
+			for(const auto& sigId : module->signals) {
+				if(!m_id2Signal[sigId.second].isHidden)
+					continue;
+
+				auto width = hlim::getOutputWidth(sigId.first);
+				if (width == 0) continue;
+				m_id2handle[sigId.second] = m_FST.declareWire(width, m_id2Signal[sigId.second].name);
+			}
+		};
+
+		reccurWriteModules(&root);
+
+		{
+			auto clocks_module = m_FST.beginModule("clocks");
+
+			for(auto& clk : m_clocks)
+				m_clock2handle[clk] = m_FST.declareWire(1, clk->getName());
+
+			for(auto& rst : m_resets)
+				m_rst2handle[rst] = m_FST.declareWire(1, rst->getResetName());
+		}
+
+		for(auto& c : m_clock2handle) {
+			auto value = m_simulator.getValueOfClock(c.first);
+			if(value[DefaultConfig::DEFINED])
+				m_FST.writeBitState(c.second, true, value[DefaultConfig::VALUE]);
+		}
+
+		for(auto& c : m_rst2handle) {
+			auto value = m_simulator.getValueOfReset(c.first);
+			if(value[DefaultConfig::DEFINED])
+				m_FST.writeBitState(c.second, true, value[DefaultConfig::VALUE]);
+		}
+
+		appendPinsAndTapsByClockDomain(m_gtkWaveProjectFile);
+		m_gtkWaveProjectFile.writeEnumFilterFiles();
+		writeGtkWaveProjFile();
+	}
+
+	void FSTSink::signalChanged(size_t id)
+	{
+		const auto& offsetSize = m_id2StateOffsetSize[id];
+		m_FST.writeState(m_id2handle[id], m_trackedState, offsetSize.offset, offsetSize.size);
+	}
+
+	void FSTSink::advanceTick(const hlim::ClockRational& simulationTime)
+	{
+		auto ratTickIdx = simulationTime / hlim::ClockRational(1, 1'000'000'000'000ull);
+		std::uint64_t tickIdx = ratTickIdx.numerator() / ratTickIdx.denominator();
+		m_FST.writeTime(tickIdx);
+	}
+
+	void FSTSink::clockChanged(const hlim::Clock* clock, bool risingEdge)
+	{
+		auto it = m_clock2handle.find((hlim::Clock*)clock);
+		if(it != m_clock2handle.end())
+			m_FST.writeBitState(it->second, true, risingEdge);
+	}
+
+	void FSTSink::resetChanged(const hlim::Clock* clock, bool inReset)
+	{
+		auto it = m_rst2handle.find((hlim::Clock*)clock);
+		if(it != m_rst2handle.end())
+			m_FST.writeBitState(it->second, true, inReset);
+	}
+}
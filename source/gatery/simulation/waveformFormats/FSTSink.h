@@ -0,0 +1,60 @@
+/*  This file is part of Gatery, a library for circuit design.
+	Copyright (C) 2021 Michael Offel, Andreas Ley
+
+	Gatery is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 3 of the License, or (at your option) any later version.
+
+	Gatery is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#pragma once
+
+#include "../WaveformRecorder.h"
+#include "FSTWriter.h"
+#include "GTKWaveProjectFile.h"
+
+#include <gatery/utils/StableContainers.h>
+
+#include <string>
+
+namespace gtry::sim {
+
+/**
+ * @brief Records waveforms into compressed FST files, which are much smaller than VCD files and can be opened by GTKWave and Surfer without loading the entire trace.
+ * @details Contains the same hierarchy and signals as the VCD files of the VCDSink and writes the same GTKWave and Surfer project files.
+ * Debug messages, warnings, and asserts are not recorded as string signals, but asserts are still marked in the project files.
+ */
+class FSTSink : public WaveformRecorder
+{
+	public:
+		FSTSink(hlim::Circuit &circuit, Simulator &simulator, const char *filename);
+		virtual ~FSTSink() override;
+	protected:
+		FSTWriter m_FST;
+		GTKWaveProjectFile m_gtkWaveProjectFile;
+
+		std::vector<FSTWriter::Handle> m_id2handle;
+		utils::StableMap<hlim::Clock*, FSTWriter::Handle> m_clock2handle;
+		utils::StableMap<hlim::Clock*, FSTWriter::Handle> m_rst2handle;
+		std::vector<hlim::Clock*> m_clocks;
+		std::vector<hlim::Clock*> m_resets;
+
+		virtual void initialize() override;
+		virtual void signalChanged(size_t id) override;
+		virtual void advanceTick(const hlim::ClockRational &simulationTime) override;
+		virtual void clockChanged(const hlim::Clock *clock, bool risingEdge) override;
+		virtual void resetChanged(const hlim::Clock *clock, bool inReset) override;
+		virtual void messageLogged(MessageType type, const hlim::ClockRational &simulationTime, const std::string &msg) override;
+
+		void writeGtkWaveProjFile();
+};
+
+}
@@ -0,0 +1,430 @@
+/*  This file is part of Gatery, a library for circuit design.
+	Copyright (C) 2021 Michael Offel, Andreas Ley
+
+	Gatery is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 3 of the License, or (at your option) any later version.
+
+	Gatery is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include "gatery/pch.h"
+#include "FSTWriter.h"
+#include "../../utils/Range.h"
+
+#include <zlib.h>
+
+#include <chrono>
+#include <cstring>
+
+namespace gtry::sim
+{
+	namespace {
+		// Block types, scope and variable tags of the FST format (see fstapi.h of GTKWave).
+		enum : std::uint8_t {
+			FST_BL_HDR = 0,
+			FST_BL_GEOM = 3,
+			FST_BL_HIER = 4,
+			FST_BL_VCDATA_DYN_ALIAS2 = 8,
+
+			FST_ST_VCD_MODULE = 0,
+			FST_ST_VCD_SCOPE = 254,
+			FST_ST_VCD_UPSCOPE = 255,
+
+			FST_VT_VCD_WIRE = 16,
+			FST_VD_IMPLICIT = 0,
+		};
+		const size_t FST_HDR_SIZE = 329;
+		const int compressionLevel = 4;
+
+		void appendVarint(std::vector<std::uint8_t> &dst, std::uint64_t v)
+		{
+			while (v >= 0x80) {
+				dst.push_back(std::uint8_t(v | 0x80));
+				v >>= 7;
+			}
+			dst.push_back(std::uint8_t(v));
+		}
+
+		void appendSVarint(std::vector<std::uint8_t> &dst, std::int64_t v)
+		{
+			while (true) {
+				std::uint8_t byte = v & 0x7F;
+				v >>= 7;
+				if ((v == 0 && !(byte & 0x40)) || (v == -1 && (byte & 0x40))) {
+					dst.push_back(byte);
+					return;
+				}
+				dst.push_back(byte | 0x80);
+			}
+		}
+
+		void appendU64(std::vector<std::uint8_t> &dst, std::uint64_t v)
+		{
+			for (int shift = 56; shift >= 0; shift -= 8)
+				dst.push_back(std::uint8_t(v >> shift));
+		}
+
+		/// Returns the zlib compressed data or an empty vector if compression does not make it smaller.
+		std::vector<std::uint8_t> compress(const std::uint8_t *data, size_t size)
+		{
+			std::vector<std::uint8_t> result;
+			if (size < 32)
+				return result;
+
+			uLongf compressedSize = compressBound((uLong) size);
+			result.resize(compressedSize);
+			if (compress2(result.data(), &compressedSize, data, (uLong) size, compressionLevel) != Z_OK || compressedSize >= size)
+				result.clear();
+			else
+				result.resize(compressedSize);
+			return result;
+		}
+	}
+
+	FSTWriter::FSTWriter(std::string filename, size_t blockSize) :
+		m_blockSize(blockSize)
+	{
+		auto parentPath = std::filesystem::path(filename).parent_path();
+		if (!parentPath.empty())
+			std::filesystem::create_directories(parentPath);
+
+		m_File.open(filename.c_str(), std::fstream::binary);
+		if (!m_File)
+			throw std::runtime_error("Could not open FST file for writing!");
+
+		// Placeholder, rewritten with the final numbers on close.
+		writeHeader();
+	}
+
+	FSTWriter::~FSTWriter()
+	{
+		close();
+	}
+
+	FSTWriter::Scope FSTWriter::beginModule(std::string_view name)
+	{
+		assert(!name.empty());
+		assert(!m_valuesStarted);
+
+		m_hierarchy.push_back(FST_ST_VCD_SCOPE);
+		m_hierarchy.push_back(FST_ST_VCD_MODULE);
+		m_hierarchy.insert(m_hierarchy.end(), name.begin(), name.end());
+		m_hierarchy.push_back(0);
+		m_hierarchy.push_back(0); // no component name
+		m_numScopes++;
+
+		return Scope([this]{ m_hierarchy.push_back(FST_ST_VCD_UPSCOPE); });
+	}
+
+	FSTWriter::Handle FSTWriter::declareWire(size_t width, std::string_view label)
+	{
+		assert(width > 0);
+		assert(!m_valuesStarted);
+
+		m_hierarchy.push_back(FST_VT_VCD_WIRE);
+		m_hierarchy.push_back(FST_VD_IMPLICIT);
+		m_hierarchy.insert(m_hierarchy.end(), label.begin(), label.end());
+		m_hierarchy.push_back(0);
+		appendVarint(m_hierarchy, width);
+		appendVarint(m_hierarchy, 0); // not an alias of another signal
+
+		m_signals.push_back({ .width = width, .valueOffset = m_currentValues.size() });
+		m_currentValues.append(width, 'x');
+
+		return m_signals.size()-1;
+	}
+
+	size_t FSTWriter::beginChange(Handle handle)
+	{
+		assert(!m_closed);
+		m_valuesStarted = true;
+
+		if (m_blockTimes.empty() || m_blockTimes.back() != m_time) {
+			if (m_blockTimes.empty())
+				m_blockStartValues = m_currentValues;
+			m_blockTimes.push_back(m_time);
+		}
+
+		// Changes are stored relative to the previous change of the same signal in the block's time table.
+		auto &signal = m_signals[handle];
+		size_t timeIdx = m_blockTimes.size()-1;
+		size_t delta = timeIdx - signal.lastTimeIdx;
+		signal.lastTimeIdx = timeIdx;
+		return delta;
+	}
+
+	void FSTWriter::writeState(Handle handle, const DefaultBitVectorState& state, size_t offset, size_t size)
+	{
+		size_t delta = beginChange(handle);
+		auto &signal = m_signals[handle];
+		assert(signal.width == size);
+
+		char *values = m_currentValues.data() + signal.valueOffset;
+		bool allDefined = true;
+		for (auto i : utils::Range(size)) {
+			auto bitIdx = size - 1 - i;
+			if (!state.get(DefaultConfig::DEFINED, offset + bitIdx)) {
+				values[i] = 'x';
+				allDefined = false;
+			} else
+				values[i] = state.get(DefaultConfig::VALUE, offset + bitIdx) ? '1' : '0';
+		}
+
+		size_t prevSize = signal.changes.size();
+		if (size == 1) {
+			if (allDefined)
+				appendVarint(signal.changes, (delta << 2) | (size_t(values[0] == '1') << 1));
+			else
+				appendVarint(signal.changes, (delta << 4) | 1);
+		} else if (allDefined) {
+			appendVarint(signal.changes, delta << 1);
+			size_t packedOffset = signal.changes.size();
+			signal.changes.resize(packedOffset + (size+7)/8, 0);
+			for (auto i : utils::Range(size))
+				if (values[i] == '1')
+					signal.changes[packedOffset + i/8] |= 0x80 >> (i % 8);
+		} else {
+			appendVarint(signal.changes, (delta << 1) | 1);
+			signal.changes.insert(signal.changes.end(), values, values + size);
+		}
+		m_blockBytes += signal.changes.size() - prevSize;
+	}
+
+	void FSTWriter::writeBitState(Handle handle, bool defined, bool value)
+	{
+		size_t delta = beginChange(handle);
+		auto &signal = m_signals[handle];
+		assert(signal.width == 1);
+
+		size_t prevSize = signal.changes.size();
+		if (defined) {
+			m_currentValues[signal.valueOffset] = value ? '1' : '0';
+			appendVarint(signal.changes, (delta << 2) | (size_t(value) << 1));
+		} else {
+			m_currentValues[signal.valueOffset] = 'x';
+			appendVarint(signal.changes, (delta << 4) | 1);
+		}
+		m_blockBytes += signal.changes.size() - prevSize;
+	}
+
+	void FSTWriter::writeTime(std::uint64_t time)
+	{
+		assert(time >= m_time);
+		if (time != m_time && m_blockBytes >= m_blockSize)
+			writeBlock();
+		m_time = time;
+	}
+
+	void FSTWriter::close()
+	{
+		if (m_closed) return;
+
+		// Viewers expect at least one value change block, even if nothing ever changed.
+		if (m_numBlocks == 0 && m_blockTimes.empty()) {
+			m_blockStartValues = m_currentValues;
+			m_blockTimes.push_back(m_time);
+		}
+		writeBlock();
+		writeGeometry();
+		writeHierarchy();
+
+		m_File.seekp(0);
+		writeHeader();
+		m_File.close();
+		m_closed = true;
+	}
+
+	void FSTWriter::writeBlock()
+	{
+		if (m_blockTimes.empty()) return;
+
+		std::vector<std::uint8_t> buffer;
+
+		std::uint64_t memRequired = 0;
+		for (const auto &signal : m_signals)
+			memRequired += signal.changes.size();
+
+		auto blockStart = m_File.tellp();
+		buffer.push_back(FST_BL_VCDATA_DYN_ALIAS2);
+		appendU64(buffer, 0); // section length, patched below
+		appendU64(buffer, m_blockTimes.front());
+		appendU64(buffer, m_blockTimes.back());
+		appendU64(buffer, memRequired);
+
+		// Values of all signals at the start of the block
+		const auto *frame = (const std::uint8_t *) m_blockStartValues.data();
+		auto compressedFrame = compress(frame, m_blockStartValues.size());
+		appendVarint(buffer, m_blockStartValues.size());
+		if (compressedFrame.empty()) {
+			appendVarint(buffer, m_blockStartValues.size());
+			appendVarint(buffer, m_signals.size());
+			buffer.insert(buffer.end(), frame, frame + m_blockStartValues.size());
+		} else {
+			appendVarint(buffer, compressedFrame.size());
+			appendVarint(buffer, m_signals.size());
+			buffer.insert(buffer.end(), compressedFrame.begin(), compressedFrame.end());
+		}
+
+		// Per signal change lists, located through a table of their offsets relative to the pack type byte.
+		appendVarint(buffer, m_signals.size());
+		size_t vcStart = buffer.size();
+		buffer.push_back('Z');
+
+		std::vector<std::uint8_t> positionTable;
+		size_t prevPosition = 0;
+		size_t numUnchanged = 0;
+		for (auto &signal : m_signals) {
+			if (signal.changes.empty()) {
+				numUnchanged++;
+				continue;
+			}
+			if (numUnchanged != 0) {
+				appendVarint(positionTable, numUnchanged << 1);
+				numUnchanged = 0;
+			}
+			size_t position = buffer.size() - vcStart;
+			appendSVarint(positionTable, std::int64_t(((position - prevPosition) << 1) | 1));
+			prevPosition = position;
+
+			auto compressedChanges = compress(signal.changes.data(), signal.changes.size());
+			if (compressedChanges.empty()) {
+				appendVarint(buffer, 0);
+				buffer.insert(buffer.end(), signal.changes.begin(), signal.changes.end());
+			} else {
+				appendVarint(buffer, signal.changes.size());
+				buffer.insert(buffer.end(), compressedChanges.begin(), compressedChanges.end());
+			}
+
+			signal.changes.clear();
+			signal.lastTimeIdx = 0;
+		}
+		if (numUnchanged != 0)
+			appendVarint(positionTable, numUnchanged << 1);
+
+		buffer.insert(buffer.end(), positionTable.begin(), positionTable.end());
+		appendU64(buffer, positionTable.size());
+
+		std::vector<std::uint8_t> timeTable;
+		std::uint64_t prevTime = 0;
+		for (auto time : m_blockTimes) {
+			appendVarint(timeTable, time - prevTime);
+			prevTime = time;
+		}
+		auto compressedTimeTable = compress(timeTable.data(), timeTable.size());
+		if (compressedTimeTable.empty())
+			buffer.insert(buffer.end(), timeTable.begin(), timeTable.end());
+		else
+			buffer.insert(buffer.end(), compressedTimeTable.begin(), compressedTimeTable.end());
+		appendU64(buffer, timeTable.size());
+		appendU64(buffer, compressedTimeTable.empty() ? timeTable.size() : compressedTimeTable.size());
+		appendU64(buffer, m_blockTimes.size());
+
+		std::vector<std::uint8_t> sectionLength;
+		appendU64(sectionLength, buffer.size() - 1);
+		std::copy(sectionLength.begin(), sectionLength.end(), buffer.begin() + 1);
+
+		m_File.write((const char *) buffer.data(), buffer.size());
+
+		if (m_numBlocks == 0)
+			m_startTime = m_blockTimes.front();
+		m_endTime = m_blockTimes.back();
+		m_numBlocks++;
+
+		m_blockTimes.clear();
+		m_blockBytes = 0;
+	}
+
+	void FSTWriter::writeGeometry()
+	{
+		std::vector<std::uint8_t> geometry;
+		for (const auto &signal : m_signals)
+			appendVarint(geometry, signal.width);
+
+		auto compressedGeometry = compress(geometry.data(), geometry.size());
+		const auto &data = compressedGeometry.empty() ? geometry : compressedGeometry;
+
+		std::vector<std::uint8_t> buffer;
+		buffer.push_back(FST_BL_GEOM);
+		appendU64(buffer, data.size() + 24);
+		appendU64(buffer, geometry.size());
+		appendU64(buffer, m_signals.size());
+		buffer.insert(buffer.end(), data.begin(), data.end());
+		m_File.write((const char *) buffer.data(), buffer.size());
+	}
+
+	void FSTWriter::writeHierarchy()
+	{
+		// Unlike the other blocks, the hierarchy is stored as a gzip stream.
+		z_stream stream = {};
+		if (deflateInit2(&stream, compressionLevel, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+			throw std::runtime_error("Could not initialize compression of FST hierarchy!");
+
+		std::vector<std::uint8_t> compressed(deflateBound(&stream, (uLong) m_hierarchy.size()));
+		stream.next_in = m_hierarchy.data();
+		stream.avail_in = (uInt) m_hierarchy.size();
+		stream.next_out = compressed.data();
+		stream.avail_out = (uInt) compressed.size();
+		int result = deflate(&stream, Z_FINISH);
+		compressed.resize(stream.total_out);
+		deflateEnd(&stream);
+		if (result != Z_STREAM_END)
+			throw std::runtime_error("Could not compress FST hierarchy!");
+
+		std::vector<std::uint8_t> buffer;
+		buffer.push_back(FST_BL_HIER);
+		appendU64(buffer, compressed.size() + 16);
+		appendU64(buffer, m_hierarchy.size());
+		buffer.insert(buffer.end(), compressed.begin(), compressed.end());
+		m_File.write((const char *) buffer.data(), buffer.size());
+	}
+
+	void FSTWriter::writeHeader()
+	{
+		std::vector<std::uint8_t> buffer;
+		buffer.push_back(FST_BL_HDR);
+		appendU64(buffer, FST_HDR_SIZE);
+		appendU64(buffer, m_startTime);
+		appendU64(buffer, m_endTime);
+
+		// Readers determine the byte order of doubles from this constant.
+		double endianTest = 2.7182818284590452354;
+		std::uint8_t endianTestBytes[sizeof(double)];
+		std::memcpy(endianTestBytes, &endianTest, sizeof(double));
+		buffer.insert(buffer.end(), endianTestBytes, endianTestBytes + sizeof(double));
+
+		appendU64(buffer, m_blockSize);
+		appendU64(buffer, m_numScopes);
+		appendU64(buffer, m_signals.size());
+		appendU64(buffer, m_signals.size());
+		appendU64(buffer, m_numBlocks);
+		buffer.push_back(std::uint8_t(-12)); // timescale 1ps
+
+		char version[128] = "Gatery simulation output";
+		buffer.insert(buffer.end(), version, version + sizeof(version));
+
+		char date[119] = {};
+		auto now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+		tm now_tb;
+#ifdef WIN32
+		localtime_s(&now_tb, &now);
+#else
+		localtime_r(&now, &now_tb);
+#endif
+		std::strftime(date, sizeof(date), "%Y-%m-%d %X", &now_tb);
+		buffer.insert(buffer.end(), date, date + sizeof(date));
+
+		buffer.push_back(0); // file type: verilog
+		appendU64(buffer, 0); // time zero
+
+		assert(buffer.size() == FST_HDR_SIZE + 1);
+		m_File.write((const char *) buffer.data(), buffer.size());
+	}
+}
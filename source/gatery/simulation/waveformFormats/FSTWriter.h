@@ -0,0 +1,105 @@
+/*  This file is part of Gatery, a library for circuit design.
+	Copyright (C) 2021 Michael Offel, Andreas Ley
+
+	Gatery is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 3 of the License, or (at your option) any later version.
+
+	Gatery is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#pragma once
+#include <string>
+#include <string_view>
+#include <fstream>
+#include <functional>
+#include <vector>
+#include <cstdint>
+
+#include "../BitVectorState.h"
+
+namespace gtry::sim
+{
+	/**
+	 * @brief Writes waveforms in the FST format of GTKWave.
+	 * @details Value changes are buffered per signal and written in blocks of compressed per signal change lists, each with its own
+	 * table of time stamps and a frame of all values at the start of the block. Viewers can thus load individual signals and seek to a
+	 * time without decompressing the entire file. The hierarchy and the signal widths are written when the file is closed.
+	 * All wires must be declared before the first value is written.
+	 */
+	class FSTWriter
+	{
+	public:
+		class Scope
+		{
+		public:
+			Scope(std::function<void()> exitFunc) : m_EndScope(exitFunc) {}
+			~Scope() { m_EndScope(); }
+		private:
+			std::function<void()> m_EndScope;
+		};
+
+		using Handle = size_t;
+
+		/// @param blockSize Uncompressed size of buffered value changes after which a block is written out.
+		FSTWriter(std::string filename, size_t blockSize = 32ull << 20);
+		~FSTWriter();
+
+		explicit operator bool () const { return (bool)m_File; }
+
+		Scope beginModule(std::string_view name);
+		Handle declareWire(size_t width, std::string_view label);
+
+		void writeState(Handle handle, const DefaultBitVectorState& state, size_t offset, size_t size);
+		void writeBitState(Handle handle, bool defined, bool value);
+		/// Time in picoseconds, must not decrease.
+		void writeTime(std::uint64_t time);
+
+		/// Writes all buffered changes, the hierarchy, and the final header. No more values can be written afterwards.
+		void close();
+	protected:
+		struct Signal {
+			size_t width;
+			/// Offset of the signal's characters in m_currentValues and m_blockStartValues.
+			size_t valueOffset;
+			/// Encoded value changes of the current block.
+			std::vector<std::uint8_t> changes;
+			/// Index into m_blockTimes of the last change in the current block.
+			size_t lastTimeIdx = 0;
+		};
+
+		std::ofstream m_File;
+		size_t m_blockSize;
+		bool m_closed = false;
+
+		std::vector<std::uint8_t> m_hierarchy;
+		size_t m_numScopes = 0;
+		std::vector<Signal> m_signals;
+
+		/// All signal values as '0', '1', 'x' characters, MSB first.
+		std::string m_currentValues;
+		std::string m_blockStartValues;
+		bool m_valuesStarted = false;
+
+		std::uint64_t m_time = 0;
+		std::vector<std::uint64_t> m_blockTimes;
+		size_t m_blockBytes = 0;
+
+		size_t m_numBlocks = 0;
+		std::uint64_t m_startTime = 0;
+		std::uint64_t m_endTime = 0;
+
+		size_t beginChange(Handle handle);
+		void writeBlock();
+		void writeGeometry();
+		void writeHierarchy();
+		void writeHeader();
+	};
+}
@@ -28,6 +28,10 @@ MemoryTraceRecorder::MemoryTraceRecorder(MemoryTrace &trace, hlim::Circuit &circ
 	m_trace.clear();
 }
 
+MemoryTraceRecorder::~MemoryTraceRecorder()
+{
+	finishWritingInDestructor();
+}
 
 void MemoryTraceRecorder::start()
 {
@@ -56,21 +60,7 @@ void MemoryTraceRecorder::onAnnotationEnd(const hlim::ClockRational &simulationT
 	it->second.ranges.back().end = simulationTime;
 }
 
-
-
-void MemoryTraceRecorder::onDebugMessage(const hlim::BaseNode *src, std::string msg)
-{
-}
-
-void MemoryTraceRecorder::onWarning(const hlim::BaseNode *src, std::string msg)
-{
-}
-
-void MemoryTraceRecorder::onAssert(const hlim::BaseNode *src, std::string msg)
-{
-}
-
-void MemoryTraceRecorder::onClock(const hlim::Clock *clock, bool risingEdge)
+void MemoryTraceRecorder::clockChanged(const hlim::Clock *clock, bool risingEdge)
 {
 	auto it = m_clock2idx.find(clock);
 	HCL_ASSERT(it != m_clock2idx.end());
@@ -32,6 +32,7 @@ class MemoryTraceRecorder : public WaveformRecorder
 {
 	public:
 		MemoryTraceRecorder(MemoryTrace &trace, hlim::Circuit &circuit, Simulator &simulator, bool startImmediately = true);
+		virtual ~MemoryTraceRecorder() override;
 
 		void start();
 		void stop();
@@ -39,11 +40,6 @@ class MemoryTraceRecorder : public WaveformRecorder
 		virtual void onAnnotationStart(const hlim::ClockRational &simulationTime, const std::string &id, const std::string &desc) override;
 		virtual void onAnnotationEnd(const hlim::ClockRational &simulationTime, const std::string &id) override;
 
-		virtual void onDebugMessage(const hlim::BaseNode *src, std::string msg) override;
-		virtual void onWarning(const hlim::BaseNode *src, std::string msg) override;
-		virtual void onAssert(const hlim::BaseNode *src, std::string msg) override;
-		virtual void onClock(const hlim::Clock *clock, bool risingEdge) override;
-
 		inline const MemoryTrace &getTrace() const { return m_trace; }
 	protected:
 		bool m_record;
@@ -56,6 +52,7 @@ class MemoryTraceRecorder : public WaveformRecorder
 		virtual void initialize() override;
 		virtual void signalChanged(size_t id) override;
 		virtual void advanceTick(const hlim::ClockRational &simulationTime) override;
+		virtual void clockChanged(const hlim::Clock *clock, bool risingEdge) override;
 };
 
 }
@@ -24,7 +24,6 @@
 #include "../../hlim/supportNodes/Node_Memory.h"
 #include "../Simulator.h"
 #include "../../hlim/postprocessing/ClockPinAllocation.h"
-#include "../../hlim/postprocessing/CDCDetection.h"
 #include "../../hlim/Subnet.h"
 
 
@@ -71,6 +70,7 @@ namespace gtry::sim
 	}
 	VCDSink::~VCDSink() 
 	{
+		finishWritingInDestructor();
 		writeGtkWaveProjFile();
 	}
 
@@ -80,25 +80,25 @@ namespace gtry::sim
 		m_gtkWaveProjectFile.writeSurferScript(m_gtkWaveProjectFile.getWaveformFile() + ".surfer");
 	}
 
-	void VCDSink::onDebugMessage(const hlim::BaseNode* src, std::string msg)
+	void VCDSink::messageLogged(MessageType type, const hlim::ClockRational &simulationTime, const std::string &msg)
 	{
-		if (m_includeDebugMessages)
-			m_VCD.writeString(m_debugMessageID, msg);
-	}
-
-	void VCDSink::onWarning(const hlim::BaseNode* src, std::string msg)
-	{
-		if (m_includeWarnings)
-			m_VCD.writeString(m_warningsID, msg);
-	}
-
-	void VCDSink::onAssert(const hlim::BaseNode* src, std::string msg)
-	{
-		if (m_includeAsserts)
-			m_VCD.writeString(m_assertsID, msg);
-		try {
-			m_gtkWaveProjectFile.addMarker(m_simulator.getCurrentSimulationTime());
-		} catch (...) {
+		switch (type) {
+			case MessageType::DEBUG_MESSAGE:
+				if (m_includeDebugMessages)
+					m_VCD.writeString(m_debugMessageID, msg);
+			break;
+			case MessageType::WARNING:
+				if (m_includeWarnings)
+					m_VCD.writeString(m_warningsID, msg);
+			break;
+			case MessageType::ASSERT:
+				if (m_includeAsserts)
+					m_VCD.writeString(m_assertsID, msg);
+				try {
+					m_gtkWaveProjectFile.addMarker(simulationTime);
+				} catch (...) {
+				}
+			break;
 		}
 	}
 
@@ -145,36 +145,12 @@ namespace gtry::sim
 		VCDIdentifierGenerator identifierGenerator;
 		m_id2sigCode.resize(m_id2Signal.size());
 
-		struct Module {
-			utils::StableMap<const hlim::NodeGroup*, Module> subModules;
-			std::vector<std::pair<hlim::NodePort, size_t>> signals;
-			utils::StableMap<hlim::Node_Memory*, std::vector<size_t>> memoryWords;
-		};
-
-		Module root;
-
-		for(auto id : utils::Range(m_id2Signal.size())) {
-			auto& signal = m_id2Signal[id];
+		auto root = buildModuleHierarchy();
+		for(auto id : utils::Range(m_id2Signal.size()))
 			m_id2sigCode[id] = identifierGenerator.getIdentifer();
 
-			std::vector<const hlim::NodeGroup*> nodeGroupTrace;
-			const hlim::NodeGroup* grp = signal.nodeGroup;
-			while(grp != nullptr) {
-				nodeGroupTrace.push_back(grp);
-				grp = grp->getParent();
-			}
-			Module* m = &root;
-			for(auto it = nodeGroupTrace.rbegin(); it != nodeGroupTrace.rend(); ++it)
-				m = &m->subModules[*it];
-
-			if (signal.signalRef.driver.node != nullptr)
-				m->signals.push_back({ signal.signalRef.driver, id });
-			else
-				m->memoryWords[signal.memory].push_back(id);
-		}
-
-		std::function<void(const Module*)> reccurWriteModules;
-		reccurWriteModules = [&](const Module* module) {
+		std::function<void(const ModuleHierarchy*)> reccurWriteModules;
+		reccurWriteModules = [&](const ModuleHierarchy* module) {
 			for(const auto& p : module->subModules) {
 				auto named_module = m_VCD.beginModule(p.first->getInstanceName());
 				reccurWriteModules(&p.second);
@@ -276,30 +252,25 @@ namespace gtry::sim
 		auto ratTickIdx = simulationTime / hlim::ClockRational(1, 1'000'000'000'000ull);
 		size_t tickIdx = ratTickIdx.numerator() / ratTickIdx.denominator();
 		m_VCD.writeTime(tickIdx);
+
+		if (m_commitCounter++ % 128 == 0)
+			m_VCD.commit();
 	}
 
-	void VCDSink::onClock(const hlim::Clock* clock, bool risingEdge)
+	void VCDSink::clockChanged(const hlim::Clock* clock, bool risingEdge)
 	{
 		auto it = m_clock2code.find((hlim::Clock*)clock);
 		if(it != m_clock2code.end())
 			m_VCD.writeBitState(it->second, true, risingEdge);
 	}
 
-	void VCDSink::onReset(const hlim::Clock* clock, bool inReset)
+	void VCDSink::resetChanged(const hlim::Clock* clock, bool inReset)
 	{
 		auto it = m_rst2code.find((hlim::Clock*)clock);
 		if(it != m_rst2code.end())
 			m_VCD.writeBitState(it->second, true, inReset);
 	}
 
-	void VCDSink::onCommitState()
-	{
-		WaveformRecorder::onCommitState();
-
-		if (m_commitCounter++ % 128 == 0)
-			m_VCD.commit();
-	}
-
 	void VCDSink::setupGtkWaveProjFileSignals()
 	{
 		if (m_includeDebugMessages)
@@ -312,62 +283,7 @@ namespace gtry::sim
 		if (m_includeDebugMessages || m_includeWarnings || m_includeAsserts)
 		m_gtkWaveProjectFile.appendBlank();
 
-		// For easier extension in the future (beyond IO pins) determine clock domains for all signals so
-		// that they can be sorted by clocks without relying on the clock ports of the io pins.
-		utils::UnstableMap<hlim::NodePort, hlim::SignalClockDomain> clockDomains;
-		hlim::inferClockDomains(m_circuit, clockDomains);
-
-		utils::StableMap<hlim::Clock*, std::vector<Signal*>> signalsByClocks;
-
-		for (auto &s : m_id2Signal) {
-			if (!s.isPin && !s.isTap) continue;
-
-			auto it = clockDomains.find(s.signalRef.driver);
-			if (it == clockDomains.end() || it->second.type != hlim::SignalClockDomain::CLOCK)
-				signalsByClocks[nullptr].push_back(&s);
-			else
-				signalsByClocks[it->second.clk].push_back(&s);
-		}
-
-
-		auto constructFullSignalName = [](const Signal &signal) {
-			std::string name = signal.name;
-			auto *grp = signal.nodeGroup;
-			while (grp != nullptr) {
-				name = grp->getInstanceName() + '.' + name;
-				grp = grp->getParent();
-			}
-			return name;
-		};
-
-		for (auto &clockDomain : signalsByClocks) {
-			if (clockDomain.first != nullptr) {
-				auto *clockPin = clockDomain.first->getClockPinSource();
-				m_gtkWaveProjectFile.appendSignal(std::string("clocks.")+clockPin->getName()).color = GTKWaveProjectFile::Signal::BLUE;
-				if(auto* rstPin = clockDomain.first->getResetPinSource())
-					m_gtkWaveProjectFile.appendSignal(std::string("clocks.")+rstPin->getResetName()).color = GTKWaveProjectFile::Signal::INDIGO;
-			}
-
-			m_gtkWaveProjectFile.appendBlank();
-
-			std::sort(clockDomain.second.begin(), clockDomain.second.end(), [](Signal* lhs, Signal* rhs)->bool{
-				return lhs->sortOrder < rhs->sortOrder;
-			});
-
-			for (auto *signal : clockDomain.second) {
-				std::string vcdName = constructFullSignalName(*signal);
-
-				auto connectionType = hlim::getOutputConnectionType(signal->signalRef.driver);
-
-				// GTKWave does not include 1 bit vectors in the signal list, so we need to treat them as bits
-				if (!connectionType.isBool() && connectionType.width > 1)
-					vcdName = (boost::format("%s[%d:0]") % vcdName % (connectionType.width-1)).str();
-
-				m_gtkWaveProjectFile.appendSignal(vcdName);
-			}
-
-			m_gtkWaveProjectFile.appendBlank();
-		}
+		appendPinsAndTapsByClockDomain(m_gtkWaveProjectFile);
 	}
 
 }
@@ -35,13 +35,6 @@ class VCDSink : public WaveformRecorder
 		VCDSink(hlim::Circuit &circuit, Simulator &simulator, const char *filename, const char *logFilename = nullptr);
 		virtual ~VCDSink() override;
 
-		virtual void onDebugMessage(const hlim::BaseNode *src, std::string msg) override;
-		virtual void onWarning(const hlim::BaseNode *src, std::string msg) override;
-		virtual void onAssert(const hlim::BaseNode *src, std::string msg) override;
-		virtual void onClock(const hlim::Clock *clock, bool risingEdge) override;
-		virtual void onReset(const hlim::Clock *clock, bool inReset) override;
-		virtual void onCommitState() override;
-
 		/// @brief Add a pseudo-signal to the VCD file which contains debug messages as strings
 		VCDSink &includeDebugMessages() { m_includeDebugMessages = true; return *this; }
 		/// @brief Add a pseudo-signal to the VCD file which contains warnings as strings
@@ -72,6 +65,9 @@ class VCDSink : public WaveformRecorder
 		virtual void initialize() override;
 		virtual void signalChanged(size_t id) override;
 		virtual void advanceTick(const hlim::ClockRational &simulationTime) override;
+		virtual void clockChanged(const hlim::Clock *clock, bool risingEdge) override;
+		virtual void resetChanged(const hlim::Clock *clock, bool inReset) override;
+		virtual void messageLogged(MessageType type, const hlim::ClockRational &simulationTime, const std::string &msg) override;
 
 		void stateToFile(size_t offset, size_t size);
 
@@ -0,0 +1,301 @@
+/*  This file is part of Gatery, a library for circuit design.
+	Copyright (C) 2021 Michael Offel, Andreas Ley
+
+	Gatery is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 3 of the License, or (at your option) any later version.
+
+	Gatery is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+
+namespace gtry::utils {
+
+/**
+ * @brief Set of pointers to objects with unique, densely allocated ids (e.g. nodes of a circuit), indexed by their getId().
+ * @details Membership is stored in a paged bitmap, so insertion, removal, and lookup are cheap and unions, differences, and intersections
+ * operate on whole words. Pages with few elements only store those, in id order, and locate them through the number of elements
+ * in the preceding words. Once a page holds more than an eighth of its ids, it switches to one slot per id.
+ * Iteration is always in ascending id order and thus as deterministic as a StableSet.
+ * Elements may be inserted or erased while iterating, iterators only hold the id of the current element.
+ */
+template<typename Type>
+class IdSet
+{
+	public:
+		class iterator {
+			public:
+				using iterator_category = std::forward_iterator_tag;
+				using value_type = Type;
+				using difference_type = std::ptrdiff_t;
+				using pointer = const Type*;
+				using reference = const Type&;
+
+				iterator() = default;
+				iterator(const IdSet *set, std::uint64_t id) : m_set(set), m_id(id) { }
+
+				const Type &operator*() const { return m_set->element(m_id); }
+				const Type *operator->() const { return &**this; }
+				iterator &operator++() { m_id = m_set->findNext(m_id+1); return *this; }
+				iterator operator++(int) { iterator res = *this; ++*this; return res; }
+				bool operator==(const iterator &rhs) const { return m_id == rhs.m_id; }
+			protected:
+				const IdSet *m_set = nullptr;
+				std::uint64_t m_id = END;
+		};
+		using const_iterator = iterator;
+		using value_type = Type;
+
+		IdSet() = default;
+		template<typename Iterator>
+		IdSet(Iterator begin, Iterator end) { insert(begin, end); }
+
+		/// Inserts an element and returns whether it was not yet contained.
+		bool insert(Type elem) {
+			std::uint64_t id = elem->getId();
+			size_t pageIdx = id / PAGE_SIZE;
+			if (pageIdx >= m_pages.size())
+				m_pages.resize(pageIdx+1);
+
+			auto &page = m_pages[pageIdx];
+			if (page.bits.empty()) {
+				page.bits.resize(WORDS_PER_PAGE, 0);
+				page.rank.resize(WORDS_PER_PAGE, 0);
+			}
+
+			size_t idx = id % PAGE_SIZE;
+			std::uint64_t &word = page.bits[idx / 64];
+			std::uint64_t mask = std::uint64_t(1) << (idx % 64);
+			if (word & mask) return false;
+			word |= mask;
+			if (page.dense)
+				page.elements[idx] = elem;
+			else {
+				page.elements.insert(page.elements.begin() + page.slot(idx), elem);
+				for (size_t w = idx / 64 + 1; w < WORDS_PER_PAGE; w++)
+					page.rank[w]++;
+				if (page.elements.size() > SPARSE_LIMIT)
+					page.makeDense();
+			}
+			m_size++;
+			return true;
+		}
+
+		template<typename Iterator>
+		void insert(Iterator begin, Iterator end) { for (; begin != end; ++begin) insert(*begin); }
+
+		/// Removes an element and returns whether it was contained.
+		bool erase(Type elem) {
+			std::uint64_t id = elem->getId();
+			if (!containsId(id)) return false;
+			auto &page = m_pages[id / PAGE_SIZE];
+			size_t idx = id % PAGE_SIZE;
+			page.bits[idx / 64] &= ~(std::uint64_t(1) << (idx % 64));
+			if (page.dense)
+				page.elements[idx] = nullptr;
+			else {
+				page.elements.erase(page.elements.begin() + page.slot(idx));
+				for (size_t w = idx / 64 + 1; w < WORDS_PER_PAGE; w++)
+					page.rank[w]--;
+			}
+			m_size--;
+			return true;
+		}
+
+		bool contains(Type elem) const { return containsId(elem->getId()); }
+
+		/// Adds all elements of the other set.
+		void insert(const IdSet &other) {
+			if (other.m_pages.size() > m_pages.size())
+				m_pages.resize(other.m_pages.size());
+
+			for (size_t pageIdx = 0; pageIdx < other.m_pages.size(); pageIdx++) {
+				const auto &src = other.m_pages[pageIdx];
+				if (src.bits.empty()) continue;
+				auto &dst = m_pages[pageIdx];
+				if (dst.bits.empty()) {
+					dst = src;
+					for (auto w : src.bits)
+						m_size += std::popcount(w);
+					continue;
+				}
+
+				size_t numAdded = 0;
+				for (size_t w = 0; w < WORDS_PER_PAGE; w++)
+					numAdded += std::popcount(src.bits[w] & ~dst.bits[w]);
+				if (numAdded == 0) continue;
+				m_size += numAdded;
+
+				if (!dst.dense && dst.elements.size() + numAdded > SPARSE_LIMIT)
+					dst.makeDense();
+
+				if (dst.dense) {
+					for (size_t w = 0; w < WORDS_PER_PAGE; w++) {
+						std::uint64_t added = src.bits[w] & ~dst.bits[w];
+						dst.bits[w] |= added;
+						for (; added; added &= added-1) {
+							size_t i = w*64 + std::countr_zero(added);
+							dst.elements[i] = src.elements[src.slot(i)];
+						}
+					}
+				} else {
+					// Merge both pages in id order.
+					std::vector<Type> merged;
+					merged.reserve(dst.elements.size() + numAdded);
+					for (size_t w = 0; w < WORDS_PER_PAGE; w++)
+						for (std::uint64_t bits = dst.bits[w] | src.bits[w]; bits; bits &= bits-1) {
+							size_t i = w*64 + std::countr_zero(bits);
+							if (dst.bits[w] & (std::uint64_t(1) << (i % 64)))
+								merged.push_back(dst.elements[dst.slot(i)]);
+							else
+								merged.push_back(src.elements[src.slot(i)]);
+						}
+					dst.elements = std::move(merged);
+					for (size_t w = 0; w < WORDS_PER_PAGE; w++)
+						dst.bits[w] |= src.bits[w];
+					dst.updateRank();
+				}
+			}
+		}
+
+		/// Removes all elements of the other set.
+		void erase(const IdSet &other) {
+			for (size_t pageIdx = 0; pageIdx < std::min(m_pages.size(), other.m_pages.size()); pageIdx++)
+				if (!m_pages[pageIdx].bits.empty() && !other.m_pages[pageIdx].bits.empty())
+					retainBits(m_pages[pageIdx], [&](size_t w, std::uint64_t bits) -> std::uint64_t { return bits & ~other.m_pages[pageIdx].bits[w]; });
+		}
+
+		/// Removes all elements that are not in the other set.
+		void intersect(const IdSet &other) {
+			for (size_t pageIdx = 0; pageIdx < m_pages.size(); pageIdx++) {
+				if (m_pages[pageIdx].bits.empty()) continue;
+				if (pageIdx >= other.m_pages.size() || other.m_pages[pageIdx].bits.empty())
+					retainBits(m_pages[pageIdx], [](size_t, std::uint64_t) { return std::uint64_t(0); });
+				else
+					retainBits(m_pages[pageIdx], [&](size_t w, std::uint64_t bits) -> std::uint64_t { return bits & other.m_pages[pageIdx].bits[w]; });
+			}
+		}
+
+		void clear() { m_pages.clear(); m_size = 0; }
+		size_t size() const { return m_size; }
+		bool empty() const { return m_size == 0; }
+
+		iterator begin() const { return iterator(this, findNext(0)); }
+		/// Returns an iterator to the first element whose id is not smaller than the given id.
+		iterator lowerBound(std::uint64_t id) const { return iterator(this, findNext(id)); }
+		iterator end() const { return iterator(this, END); }
+
+		bool operator==(const IdSet &rhs) const { return m_size == rhs.m_size && std::equal(begin(), end(), rhs.begin()); }
+	protected:
+		static constexpr std::uint64_t END = ~0ull;
+		static constexpr size_t WORDS_PER_PAGE = 64;
+		static constexpr size_t PAGE_SIZE = WORDS_PER_PAGE * 64;
+		/// Pages with more elements store one slot per id.
+		static constexpr size_t SPARSE_LIMIT = PAGE_SIZE / 8;
+
+		/// Pages of ids are only allocated once an element falls into them, so that small sets of high ids stay small.
+		struct Page {
+			std::vector<std::uint64_t> bits;
+			/// Either only the contained elements in id order or, for dense pages, one slot per id.
+			std::vector<Type> elements;
+			/// For pages that are not dense, the number of elements in the words before each word.
+			std::vector<std::uint16_t> rank;
+			bool dense = false;
+
+			size_t slot(size_t idx) const {
+				if (dense) return idx;
+				size_t w = idx / 64;
+				return rank[w] + std::popcount(bits[w] & ((std::uint64_t(1) << (idx % 64)) - 1));
+			}
+
+			void updateRank() {
+				size_t r = 0;
+				for (size_t w = 0; w < WORDS_PER_PAGE; w++) {
+					rank[w] = (std::uint16_t) r;
+					r += std::popcount(bits[w]);
+				}
+			}
+
+			void makeDense() {
+				std::vector<Type> slots(PAGE_SIZE, nullptr);
+				size_t next = 0;
+				for (size_t w = 0; w < WORDS_PER_PAGE; w++)
+					for (std::uint64_t b = bits[w]; b; b &= b-1)
+						slots[w*64 + std::countr_zero(b)] = elements[next++];
+				elements = std::move(slots);
+				rank = {};
+				dense = true;
+			}
+		};
+		std::vector<Page> m_pages;
+		size_t m_size = 0;
+
+		bool containsId(std::uint64_t id) const {
+			size_t pageIdx = id / PAGE_SIZE;
+			if (pageIdx >= m_pages.size() || m_pages[pageIdx].bits.empty()) return false;
+			return m_pages[pageIdx].bits[(id % PAGE_SIZE) / 64] & (std::uint64_t(1) << (id % 64));
+		}
+
+		const Type &element(std::uint64_t id) const {
+			const auto &page = m_pages[id / PAGE_SIZE];
+			return page.elements[page.slot(id % PAGE_SIZE)];
+		}
+
+		std::uint64_t findNext(std::uint64_t id) const {
+			for (size_t pageIdx = id / PAGE_SIZE; pageIdx < m_pages.size(); pageIdx++, id = pageIdx * PAGE_SIZE) {
+				const auto &page = m_pages[pageIdx];
+				if (page.bits.empty()) continue;
+				size_t w = (id % PAGE_SIZE) / 64;
+				std::uint64_t word = page.bits[w] & (~0ull << (id % 64));
+				while (true) {
+					if (word)
+						return pageIdx * PAGE_SIZE + w * 64 + std::countr_zero(word);
+					if (++w == WORDS_PER_PAGE) break;
+					word = page.bits[w];
+				}
+			}
+			return END;
+		}
+
+		template<typename Filter>
+		void retainBits(Page &page, Filter filter) {
+			if (page.dense) {
+				for (size_t w = 0; w < WORDS_PER_PAGE; w++) {
+					std::uint64_t removed = page.bits[w] & ~filter(w, page.bits[w]);
+					page.bits[w] &= ~removed;
+					m_size -= std::popcount(removed);
+					for (; removed; removed &= removed-1)
+						page.elements[w*64 + std::countr_zero(removed)] = nullptr;
+				}
+				return;
+			}
+
+			size_t kept = 0, next = 0;
+			for (size_t w = 0; w < WORDS_PER_PAGE; w++) {
+				std::uint64_t retained = page.bits[w] & filter(w, page.bits[w]);
+				for (std::uint64_t b = page.bits[w]; b; b &= b-1, next++)
+					if (retained & (std::uint64_t(1) << std::countr_zero(b)))
+						page.elements[kept++] = page.elements[next];
+				m_size -= std::popcount(page.bits[w] & ~retained);
+				page.bits[w] = retained;
+			}
+			page.elements.resize(kept);
+			page.updateRank();
+		}
+};
+
+}
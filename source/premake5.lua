@@ -94,6 +94,11 @@ function GateryWorkspaceDefaults()
         description = "On windows, enables the driver project"
     }
 
+    newoption {
+        trigger = "native-arch",
+        description = "Compile for the instruction sets of the build machine (enables the SIMD simulation kernels)"
+    }
+
     configurations { "Debug", "Release", "Coverage" }
     architecture "x64"
     symbols "On"
@@ -126,9 +131,16 @@ function GateryWorkspaceDefaults()
             "pthread",
             "yaml-cpp",
             "boost_json",
+            "z",
             "dl"
         }
 		
+	filter { "options:native-arch", "system:windows" }
+        buildoptions { "/arch:AVX2" }
+
+	filter { "options:native-arch", "system:linux" }
+        buildoptions { "-march=native" }
+
 	filter {}
 end
 
@@ -0,0 +1,185 @@
+/*  This file is part of Gatery, a library for circuit design.
+	Copyright (C) 2021 Michael Offel, Andreas Ley
+
+	Gatery is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 3 of the License, or (at your option) any later version.
+
+	Gatery is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include "bench/pch.h"
+#include "Benchmark.h"
+
+#include <gatery/simulation/ReferenceSimulator.h>
+#include <gatery/hlim/Circuit.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace gtry::bench {
+
+boost::json::object BenchmarkResult::toJson() const
+{
+	boost::json::object json;
+	json["name"] = name;
+	json["cycles"] = numCycles;
+	json["nodes"] = numNodes;
+	json["setup_seconds"] = setupSeconds;
+	json["simulation_seconds"] = simulationSeconds;
+	json["events"] = statistics.numEvents;
+	json["reevaluations"] = statistics.numReevaluations;
+	json["node_evaluations"] = statistics.numNodeEvaluations;
+	json["cycles_per_second"] = cyclesPerSecond();
+	json["events_per_second"] = eventsPerSecond();
+	json["node_evaluations_per_second"] = nodeEvaluationsPerSecond();
+	json["peak_rss_bytes"] = peakRssBytes;
+	if (cacheMisses)
+		json["cache_misses"] = *cacheMisses;
+
+	boost::json::array jsonErrors;
+	for (const auto &e : errors)
+		jsonErrors.emplace_back(e);
+	json["errors"] = std::move(jsonErrors);
+	return json;
+}
+
+BenchmarkContext::BenchmarkContext(std::string name, const BenchmarkOptions &options) : m_options(options)
+{
+	m_result.name = std::move(name);
+	m_constructionStart = std::chrono::steady_clock::now();
+
+	m_simulator.reset(new sim::ReferenceSimulator(false));
+	m_simulator->addCallbacks(this);
+}
+
+BenchmarkContext::~BenchmarkContext()
+{
+	// Simulation processes hold frontend signals, which must be gone before the DesignScope.
+	m_simulator.reset(nullptr);
+}
+
+void BenchmarkContext::addSimulationProcess(std::function<SimProcess()> simProc)
+{
+	m_simulator->addSimulationProcess(std::move(simProc));
+}
+
+void BenchmarkContext::run(const Clock &clock, std::uint64_t numCycles)
+{
+	m_result.numCycles = std::max<std::uint64_t>(1, std::uint64_t(numCycles * m_options.cycleScale));
+
+	design.postprocess();
+	m_result.numNodes = design.getCircuit().getNodes().size();
+
+	m_simulator->compileProgram(design.getCircuit(), {}, m_options.compileOptions);
+	m_simulator->powerOn();
+
+	CacheMissCounter cacheMissCounter;
+
+	auto start = std::chrono::steady_clock::now();
+	m_result.setupSeconds = std::chrono::duration<double>(start - m_constructionStart).count();
+
+	cacheMissCounter.start();
+	m_simulator->advance(hlim::ClockRational(m_result.numCycles) / clock.absoluteFrequency());
+	m_simulator->commitState();
+	std::uint64_t cacheMisses = cacheMissCounter.stop();
+
+	auto end = std::chrono::steady_clock::now();
+	if (cacheMissCounter.available())
+		m_result.cacheMisses = cacheMisses;
+	m_result.simulationSeconds = std::chrono::duration<double>(end - start).count();
+	m_result.statistics = m_simulator->getStatistics();
+	m_result.peakRssBytes = peakResidentSetSize();
+}
+
+void BenchmarkContext::onWarning(const hlim::BaseNode *src, std::string msg)
+{
+	m_result.errors.push_back("Warning: " + msg);
+}
+
+void BenchmarkContext::onAssert(const hlim::BaseNode *src, std::string msg)
+{
+	m_result.errors.push_back("Assertion failed: " + msg);
+}
+
+std::uint64_t peakResidentSetSize()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return 0;
+	return counters.PeakWorkingSetSize;
+#else
+	rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0;
+#ifdef __APPLE__
+	return usage.ru_maxrss;
+#else
+	return usage.ru_maxrss * 1024ull;
+#endif
+#endif
+}
+
+CacheMissCounter::CacheMissCounter()
+{
+#ifdef __linux__
+	perf_event_attr attr = {};
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.size = sizeof(attr);
+	attr.config = PERF_COUNT_HW_CACHE_MISSES;
+	attr.disabled = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	m_fd = (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+}
+
+CacheMissCounter::~CacheMissCounter()
+{
+#ifdef __linux__
+	if (m_fd >= 0) close(m_fd);
+#endif
+}
+
+void CacheMissCounter::start()
+{
+#ifdef __linux__
+	if (m_fd < 0) return;
+	ioctl(m_fd, PERF_EVENT_IOC_RESET, 0);
+	ioctl(m_fd, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+}
+
+std::uint64_t CacheMissCounter::stop()
+{
+	std::uint64_t count = 0;
+#ifdef __linux__
+	if (m_fd < 0) return 0;
+	ioctl(m_fd, PERF_EVENT_IOC_DISABLE, 0);
+	if (read(m_fd, &count, sizeof(count)) != sizeof(count))
+		count = 0;
+#endif
+	return count;
+}
+
+}
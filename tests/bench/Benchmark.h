@@ -0,0 +1,123 @@
+/*  This file is part of Gatery, a library for circuit design.
+	Copyright (C) 2021 Michael Offel, Andreas Ley
+
+	Gatery is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 3 of the License, or (at your option) any later version.
+
+	Gatery is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#pragma once
+
+#include <gatery/frontend.h>
+#include <gatery/simulation/Simulator.h>
+#include <gatery/simulation/SimulatorCallbacks.h>
+
+#include <boost/json.hpp>
+
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace gtry::bench {
+
+struct BenchmarkOptions {
+	/// Multiplies the number of simulated cycles of every workload.
+	double cycleScale = 1.0;
+	/// Program for the RISC-V workload. If not set, a built in loop is executed.
+	std::optional<std::filesystem::path> elfFile;
+	sim::CompileOptions compileOptions;
+};
+
+struct BenchmarkResult {
+	std::string name;
+	std::uint64_t numCycles = 0;
+	size_t numNodes = 0;
+	/// Wall clock time of the simulation only, excluding circuit construction, postprocessing, and compilation.
+	double simulationSeconds = 0.0;
+	double setupSeconds = 0.0;
+	sim::SimulatorStatistics statistics;
+	/// Peak resident set size of the process after the benchmark (not just the benchmark's own peak).
+	std::uint64_t peakRssBytes = 0;
+	/// Last level cache misses of the thread driving the simulation, if hardware counters are available.
+	std::optional<std::uint64_t> cacheMisses;
+	std::vector<std::string> errors;
+
+	double cyclesPerSecond() const { return numCycles / simulationSeconds; }
+	double eventsPerSecond() const { return statistics.numEvents / simulationSeconds; }
+	double nodeEvaluationsPerSecond() const { return statistics.numNodeEvaluations / simulationSeconds; }
+
+	boost::json::object toJson() const;
+};
+
+/**
+ * @brief Builds the circuit of one workload and measures the speed of simulating it.
+ * @details Workloads construct their circuit in the design scope and add their simulation processes just like a unit test would,
+ * and end with a call to run(), which keeps the clocks and signals of the workload alive while the simulation runs.
+ * Simulation processes are expected to generate traffic indefinitely, the simulation always covers a fixed number of cycles.
+ */
+class BenchmarkContext : public sim::SimulatorCallbacks
+{
+	public:
+		BenchmarkContext(std::string name, const BenchmarkOptions &options);
+		~BenchmarkContext();
+
+		DesignScope design;
+
+		const BenchmarkOptions &options() const { return m_options; }
+		void addSimulationProcess(std::function<SimProcess()> simProc);
+
+		/// Postprocesses the design and simulates numCycles cycles (scaled by BenchmarkOptions::cycleScale) of the given clock.
+		void run(const Clock &clock, std::uint64_t numCycles);
+
+		const BenchmarkResult &result() const { return m_result; }
+
+		virtual void onWarning(const hlim::BaseNode *src, std::string msg) override;
+		virtual void onAssert(const hlim::BaseNode *src, std::string msg) override;
+		virtual bool observesSimProcIO() const override { return false; }
+	protected:
+		BenchmarkOptions m_options;
+		std::unique_ptr<sim::Simulator> m_simulator;
+		BenchmarkResult m_result;
+		std::chrono::steady_clock::time_point m_constructionStart;
+};
+
+struct Workload {
+	std::string name;
+	std::string description;
+	std::function<void(BenchmarkContext&)> body;
+};
+
+const std::vector<Workload> &allWorkloads();
+
+/// Peak resident set size of this process in bytes or 0 if unknown.
+std::uint64_t peakResidentSetSize();
+
+/// Counts the last level cache misses of the calling thread, if the platform allows it.
+class CacheMissCounter {
+	public:
+		CacheMissCounter();
+		~CacheMissCounter();
+		CacheMissCounter(const CacheMissCounter&) = delete;
+		void operator=(const CacheMissCounter&) = delete;
+
+		bool available() const { return m_fd >= 0; }
+
+		void start();
+		std::uint64_t stop();
+	protected:
+		int m_fd = -1;
+};
+
+}
@@ -0,0 +1,177 @@
+/*  This file is part of Gatery, a library for circuit design.
+	Copyright (C) 2021 Michael Offel, Andreas Ley
+
+	Gatery is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 3 of the License, or (at your option) any later version.
+
+	Gatery is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include "bench/pch.h"
+#include "Benchmark.h"
+
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+
+using namespace gtry;
+using namespace gtry::bench;
+
+namespace {
+
+void printUsage()
+{
+	std::cout
+		<< "Usage: gatery_bench [options]\n"
+		<< "  --list                  List all workloads and exit.\n"
+		<< "  --filter <substring>    Only run workloads whose name contains the substring. Can be given multiple times.\n"
+		<< "  --scale <factor>        Multiply the number of simulated cycles of all workloads.\n"
+		<< "  --elf <file>            Program for the riscv_dual_cycle workload.\n"
+		<< "  --threads <n>           Number of simulation threads (0 for all hardware threads).\n"
+		<< "  --activity-driven       Only reevaluate nodes whose inputs changed.\n"
+		<< "  --state-layout <layout> Order of the simulation state, evaluation_order (default) or size_buckets.\n"
+		<< "  --json <file>           Write the results as json.\n"
+		<< "  --baseline <file>       Compare against the json results of a previous run and fail if any workload got slower.\n"
+		<< "  --tolerance <fraction>  Allowed slowdown against the baseline in simulated cycles per second (default 0.1).\n";
+}
+
+/// Returns the names of all workloads whose cycles per second dropped by more than the tolerance relative to the baseline.
+std::vector<std::string> findRegressions(const std::vector<BenchmarkResult> &results, const boost::json::value &baseline, double tolerance)
+{
+	std::vector<std::string> regressions;
+	for (const auto &jsonResult : baseline.at("results").as_array()) {
+		const auto &obj = jsonResult.as_object();
+		auto it = std::find_if(results.begin(), results.end(), [&](const BenchmarkResult &r) { return r.name == obj.at("name").as_string(); });
+		if (it == results.end()) continue;
+
+		double baselineCyclesPerSecond = obj.at("cycles_per_second").to_number<double>();
+		double ratio = it->cyclesPerSecond() / baselineCyclesPerSecond;
+		std::cout << std::setw(24) << std::left << it->name << " " << std::fixed << std::setprecision(3) << ratio << "x of baseline" << std::endl;
+		if (ratio < 1.0 - tolerance)
+			regressions.push_back(it->name);
+	}
+	return regressions;
+}
+
+}
+
+int main(int argc, char **argv)
+{
+	BenchmarkOptions options;
+	std::vector<std::string> filters;
+	std::optional<std::filesystem::path> jsonFile;
+	std::optional<std::filesystem::path> baselineFile;
+	double tolerance = 0.1;
+
+	for (int i = 1; i < argc; i++) {
+		std::string_view arg(argv[i]);
+		auto param = [&]() -> std::string_view {
+			if (i+1 >= argc)
+				throw std::runtime_error(std::string("Missing command line argument after ") + argv[i]);
+			return argv[++i];
+		};
+
+		if (arg == "--list") {
+			for (const auto &w : allWorkloads())
+				std::cout << std::setw(24) << std::left << w.name << " " << w.description << '\n';
+			return 0;
+		} else if (arg == "--filter")
+			filters.emplace_back(param());
+		else if (arg == "--scale")
+			options.cycleScale = std::stod(std::string(param()));
+		else if (arg == "--elf")
+			options.elfFile = param();
+		else if (arg == "--threads")
+			options.compileOptions.numThreads = std::stoull(std::string(param()));
+		else if (arg == "--activity-driven")
+			options.compileOptions.activityDrivenEvaluation = true;
+		else if (arg == "--state-layout") {
+			std::string_view layout = param();
+			if (layout == "evaluation_order")
+				options.compileOptions.stateLayout = sim::StateLayout::EVALUATION_ORDER;
+			else if (layout == "size_buckets")
+				options.compileOptions.stateLayout = sim::StateLayout::SIZE_BUCKETS;
+			else
+				throw std::runtime_error(std::string("Unknown state layout ") + std::string(layout));
+		} else if (arg == "--json")
+			jsonFile = param();
+		else if (arg == "--baseline")
+			baselineFile = param();
+		else if (arg == "--tolerance")
+			tolerance = std::stod(std::string(param()));
+		else {
+			printUsage();
+			return arg == "--help" ? 0 : 1;
+		}
+	}
+
+	std::vector<BenchmarkResult> results;
+	bool anyErrors = false;
+
+	std::cout << std::setw(24) << std::left << "workload"
+		<< std::setw(12) << std::right << "cycles/s"
+		<< std::setw(14) << "events/s"
+		<< std::setw(16) << "node evals/s"
+		<< std::setw(14) << "peak RSS MiB"
+		<< std::setw(16) << "misses/cycle" << std::endl;
+
+	for (const auto &workload : allWorkloads()) {
+		if (!filters.empty() && std::none_of(filters.begin(), filters.end(), [&](const std::string &f) { return workload.name.find(f) != std::string::npos; }))
+			continue;
+
+		BenchmarkContext context(workload.name, options);
+		workload.body(context);
+		const auto &result = context.result();
+
+		std::cout << std::setw(24) << std::left << result.name << std::right << std::fixed << std::setprecision(0)
+			<< std::setw(12) << result.cyclesPerSecond()
+			<< std::setw(14) << result.eventsPerSecond()
+			<< std::setw(16) << result.nodeEvaluationsPerSecond()
+			<< std::setw(14) << std::setprecision(1) << result.peakRssBytes / (1024.0 * 1024.0);
+		if (result.cacheMisses)
+			std::cout << std::setw(16) << std::setprecision(2) << (double) *result.cacheMisses / result.numCycles;
+		else
+			std::cout << std::setw(16) << "n/a";
+		std::cout << std::endl;
+		for (const auto &e : result.errors)
+			std::cout << "    " << e << std::endl;
+		anyErrors |= !result.errors.empty();
+
+		results.push_back(result);
+	}
+
+	if (jsonFile) {
+		boost::json::array jsonResults;
+		for (const auto &r : results)
+			jsonResults.emplace_back(r.toJson());
+
+		boost::json::object json;
+		json["results"] = std::move(jsonResults);
+
+		std::ofstream file(*jsonFile, std::ofstream::binary);
+		file << boost::json::serialize(json) << '\n';
+	}
+
+	if (baselineFile) {
+		std::ifstream file(*baselineFile, std::ifstream::binary);
+		std::stringstream content;
+		content << file.rdbuf();
+
+		auto regressions = findRegressions(results, boost::json::parse(content.str()), tolerance);
+		for (const auto &name : regressions)
+			std::cout << "Regression: " << name << " is more than " << tolerance * 100 << "% slower than the baseline" << std::endl;
+		if (!regressions.empty())
+			return 2;
+	}
+
+	return anyErrors ? 1 : 0;
+}
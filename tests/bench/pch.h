@@ -0,0 +1,47 @@
+/*  This file is part of Gatery, a library for circuit design.
+	Copyright (C) 2021 Michael Offel, Andreas Ley
+
+	Gatery is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 3 of the License, or (at your option) any later version.
+
+	Gatery is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#pragma once
+
+#include <gatery/frontend.h>
+#include <gatery/simulation/Simulator.h>
+#include <gatery/simulation/SimulatorCallbacks.h>
+#include <gatery/utils.h>
+
+#include <gatery/scl/FifoArray.h>
+#include <gatery/scl/stream/strm.h>
+#include <gatery/scl/stream/SimuHelpers.h>
+#include <gatery/scl/tilelink/tilelink.h>
+#include <gatery/scl/tilelink/TileLinkStreamFetch.h>
+#include <gatery/scl/tilelink/TileLinkAdapter.h>
+#include <gatery/scl/memory/MemoryTester.h>
+#include <gatery/scl/memory/SdramControllerSimulation.h>
+#include <gatery/scl/riscv/DualCycleRV.h>
+#include <gatery/scl/riscv/ElfLoader.h>
+#include <gatery/scl/riscv/EmbeddedSystemBuilder.h>
+#include <gatery/scl/riscv/RiscVAssembler.h>
+#include <gatery/scl/Avalon.h>
+
+#include <boost/json.hpp>
+
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
@@ -0,0 +1,306 @@
+/*  This file is part of Gatery, a library for circuit design.
+	Copyright (C) 2021 Michael Offel, Andreas Ley
+
+	Gatery is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 3 of the License, or (at your option) any later version.
+
+	Gatery is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include "bench/pch.h"
+#include "Benchmark.h"
+
+using namespace gtry;
+
+namespace gtry::bench {
+
+namespace {
+
+/// A loop summing up integers and storing/loading the partial sums to/from data memory. Gets stuck on a branch if a load returns the wrong value.
+std::vector<uint32_t> defaultRiscVProgram()
+{
+	using namespace scl::riscv::assembler;
+	return {
+		addi(1, 0, 0),
+		addi(2, 0, 1),
+		// loop:
+		add(1, 1, 2),
+		addi(2, 2, 1),
+		andi(3, 2, 255),
+		slli(3, 3, 2),
+		sw(3, 1, 0),
+		lw(4, 3, 0),
+		xor_(5, 4, 1),
+		bne(5, 0, 0),
+		jal(0, -8*4),
+	};
+}
+
+void riscvDualCycle(BenchmarkContext &ctx)
+{
+	Clock clock({
+		.absoluteFrequency = 100'000'000,
+		.resetType = ClockConfig::ResetType::NONE
+	});
+	ClockScope clkScp(clock);
+
+	if (ctx.options().elfFile) {
+		scl::riscv::EmbeddedSystemBuilder esb;
+		esb.addCpu(scl::riscv::ElfLoader(*ctx.options().elfFile), 16_KiB, true, false);
+		ctx.run(clock, 200'000);
+		return;
+	}
+
+	scl::riscv::DualCycleRV rv(8_b, 32_b);
+	Memory<UInt>& imem = rv.fetch();
+	std::vector<uint32_t> program = defaultRiscVProgram();
+	imem.fillPowerOnState(sim::createDefaultBitVectorState(program.size()*32, program.data()));
+
+	scl::AvalonMM avmm;
+	avmm.readLatency = 1;
+	avmm.readData = 32_b;
+
+	avmm.read = Bit{};
+	avmm.readDataValid = reg(*avmm.read, '0');
+	rv.execute();
+	rv.mem(avmm);
+
+	Memory<UInt> dmem(1024, 32_b);
+	auto dport = dmem[avmm.address(2, 10_b)];
+
+	IF(*avmm.write)
+		dport = *avmm.writeData;
+	*avmm.readData = reg(dport.read(), {.allowRetimingBackward=true});
+
+	pinOut(avmm.address).setName("avmm_address");
+	pinOut(*avmm.write).setName("avmm_write");
+	pinOut(*avmm.writeData).setName("avmm_writedata");
+
+	ctx.run(clock, 200'000);
+}
+
+void streamPacketPipeline(BenchmarkContext &ctx)
+{
+	Clock clock({ .absoluteFrequency = 100'000'000 });
+	ClockScope clkScp(clock);
+
+	scl::RvPacketStream<BVec, scl::Error> in{ 32_b };
+	auto stage1 = scl::strm::storeForwardFifo(in, 32);
+	auto stage2 = scl::strm::storeForwardFifo(stage1, 32);
+	auto stage3 = scl::strm::storeForwardFifo(stage2, 32);
+	auto out = scl::strm::storeForwardFifo(stage3, 32);
+	pinIn(in, "in");
+	pinOut(out, "out");
+
+	std::mt19937 rng{ 12524 };
+	ctx.addSimulationProcess([&]()->SimProcess {
+		std::uniform_int_distribution<size_t> rngSize{ 1, 64 };
+		std::vector<uint8_t> data;
+		while (true) {
+			data.resize(rngSize(rng));
+			for (uint8_t &it : data)
+				it = (uint8_t)rng();
+
+			scl::strm::SimPacket packet{ data };
+			packet.error(rng() % 8 == 0 ? '1' : '0');
+			co_await scl::strm::sendPacket(in, packet, clock);
+		}
+	});
+
+	ctx.addSimulationProcess([&]()->SimProcess {
+		fork(scl::strm::readyDriverRNG(out, clock, 80));
+		while (true)
+			co_await scl::strm::receivePacket(out, clock);
+	});
+
+	ctx.run(clock, 100'000);
+}
+
+void tileLinkDma(BenchmarkContext &ctx)
+{
+	Clock clock({
+		.absoluteFrequency = 100'000'000,
+		.memoryResetType = ClockConfig::ResetType::NONE
+	});
+	ClockScope clkScp(clock);
+
+	std::vector<uint8_t> memData(4096 * 4);
+	for (size_t i = 0; i < memData.size(); ++i)
+		memData[i] = (uint8_t)i;
+
+	Memory<BVec> mem(4096, 32_b);
+	mem.fillPowerOnState(sim::createDefaultBitVectorState(memData.size()*8, memData.data()));
+
+	scl::RvStream<scl::TileLinkStreamFetch::Command> cmd;
+	cmd->address = mem.addressWidth();
+	cmd->beats = 5_b;
+	pinIn(cmd, "cmd");
+
+	scl::RvStream<BVec> data{ 32_b };
+	pinOut(data, "data");
+
+	scl::TileLinkUB fetcher = scl::TileLinkStreamFetch{}.enableBursts(128).generate(cmd, data, 0_b);
+
+	scl::TileLinkUL memTL = scl::tileLinkInit<scl::TileLinkUL>(fetcher.a->address.width(), fetcher.a->data.width(), fetcher.a->source.width() + 5_b);
+	mem <<= memTL;
+	scl::tileLinkAddBurst(memTL, fetcher.a->size.width()) <<= fetcher;
+
+	std::mt19937 rng{ 5412 };
+	ctx.addSimulationProcess([&]()->SimProcess {
+		while (true) {
+			simu(cmd->address) = (rng() % 512) * 4;
+			simu(cmd->beats) = rng() % 16 + 1;
+			co_await scl::strm::performTransfer(cmd, clock);
+		}
+	});
+
+	ctx.addSimulationProcess([&]()->SimProcess {
+		fork(scl::strm::readyDriverRNG(data, clock, 80));
+		while (true)
+			co_await scl::strm::receivePacket(data, clock);
+	});
+
+	ctx.run(clock, 100'000);
+}
+
+void sdramController(BenchmarkContext &ctx)
+{
+	Clock clock(ClockConfig{
+		.absoluteFrequency = {{100'000'000,1}},
+		.initializeRegs = false,
+	});
+	ClockScope clkScp(clock);
+
+	scl::sdram::SdramControllerSimulation controller;
+	controller.timings({
+		.cl = 2,
+		.rcd = 18,
+		.ras = 42,
+		.rp = 18,
+		.rc = 42 + 18 + 20,
+		.rrd = 12,
+		.refi = 1560,
+	});
+	controller.dataBusWidth(16_b);
+	controller.addressMap({
+		.column = Selection::Slice(1, 8),
+		.row = Selection::Slice(9, 4),
+		.bank = Selection::Slice(13, 2)
+	});
+	controller.burstLimit(3);
+
+	scl::TileLinkUB link;
+	scl::tileLinkInit(link, 15_b, 16_b, 2_b, 4_b);
+	controller.generate(link);
+
+	// Writes the entire memory and then keeps reading it back.
+	scl::MemoryTester tester;
+	tester.generate(link);
+	sim_assert(tester.numErrors() == 0) << "found memory errors";
+	pinOut(tester.numErrors()).setName("numErrors");
+
+	ctx.run(clock, 100'000);
+}
+
+void fifoArray(BenchmarkContext &ctx)
+{
+	Clock clock({ .absoluteFrequency = 100'000'000 });
+	ClockScope clkScp(clock);
+
+	const size_t numberOfFifos = 64;
+	scl::FifoArray<UInt> fifos(numberOfFifos, 512, UInt{ 32_b });
+
+	Bit pushEnable; pinIn(pushEnable, "pushEnable");
+	UInt pushSelector = BitWidth::count(numberOfFifos); pinIn(pushSelector, "pushSelector");
+	UInt pushData = 32_b; pinIn(pushData, "pushData");
+
+	fifos.selectPush(pushSelector);
+	pinOut(fifos.full(), "pushFull");
+	IF(pushEnable) fifos.push(pushData);
+
+	Bit popEnable; pinIn(popEnable, "popEnable");
+	UInt popSelector = constructFrom(pushSelector); pinIn(popSelector, "popSelector");
+	UInt popData = reg(fifos.peek(), RegisterSettings{ .allowRetimingBackward = true });
+	pinOut(popData, "popData");
+
+	fifos.selectPop(popSelector);
+	pinOut(fifos.empty(), "popEmpty");
+	IF(popEnable) fifos.pop();
+
+	fifos.generate();
+
+	std::mt19937 rng{ 1337 };
+	ctx.addSimulationProcess([&]()->SimProcess {
+		while (true) {
+			simu(pushSelector) = rng() % numberOfFifos;
+			simu(pushData) = rng();
+			simu(popSelector) = rng() % numberOfFifos;
+
+			simu(pushEnable) = (rng() % 4 != 0 && simu(fifos.full()) == '0') ? '1' : '0';
+			simu(popEnable) = (rng() % 2 != 0 && simu(fifos.empty()) == '0') ? '1' : '0';
+			co_await OnClk(clock);
+		}
+	});
+
+	ctx.run(clock, 100'000);
+}
+
+void mixedWidthLanes(BenchmarkContext &ctx)
+{
+	Clock clock({ .absoluteFrequency = 100'000'000, .resetType = ClockConfig::ResetType::NONE });
+	ClockScope clkScp(clock);
+
+	const size_t numLanes = 1024;
+	const size_t numStages = 8;
+
+	auto incrementPin = pinIn(8_b);
+	incrementPin.setName("increment");
+	for (auto lane : Range(numLanes)) {
+		UInt increment = incrementPin;
+		UInt wide = cat(increment, increment, increment, increment, increment, increment, increment, increment, increment, increment, increment, increment);
+		for (auto stage : Range(numStages)) {
+			increment = (increment ^ (lane * numStages + stage)) + 1;
+			Bit odd = increment.lsb();
+			wide = mux(odd, { wide, wide ^ (wide >> 1) });
+		}
+
+		UInt accumulator(8_b);
+		accumulator = reg(accumulator, 0);
+		pinOut(accumulator).setName("accumulator_" + std::to_string(lane));
+		accumulator += increment ^ wide.lower(8_b);
+	}
+
+	ctx.addSimulationProcess([&]()->SimProcess {
+		for (size_t i = 0; ; i++) {
+			simu(incrementPin) = i % 256;
+			co_await OnClk(clock);
+		}
+	});
+
+	ctx.run(clock, 2'000);
+}
+
+}
+
+const std::vector<Workload> &allWorkloads()
+{
+	static const std::vector<Workload> workloads = {
+		{ "riscv_dual_cycle", "DualCycleRV executing a program (--elf) or a built in load/store loop", &riscvDualCycle },
+		{ "stream_packet_pipeline", "Random packets through a chain of store and forward fifos with back pressure", &streamPacketPipeline },
+		{ "tilelink_dma", "TileLinkStreamFetch bursting random ranges out of a memory", &tileLinkDma },
+		{ "sdram_controller", "SDRAM controller against the SDRAM module model, driven by the MemoryTester", &sdramController },
+		{ "fifo_array", "FifoArray with 64 fifos under random pushes and pops", &fifoArray },
+		{ "mixed_width_lanes", "1024 independent lanes mixing narrow and 96 bit signals, compare the state layouts with --state-layout", &mixedWidthLanes },
+	};
+	return workloads;
+}
+
+}
@@ -18,6 +18,7 @@
 #include "frontend/pch.h"
 
 #include <gatery/simulation/Simulator.h>
+#include <gatery/simulation/waveformFormats/FSTWriter.h>
 
 #include <boost/test/unit_test.hpp>
 #include <boost/test/data/dataset.hpp>
@@ -25,6 +26,8 @@
 #include <boost/test/data/monomorphic.hpp>
 #include <random>
 
+#include <zlib.h>
+
 using namespace boost::unit_test;
 using namespace gtry;
 using namespace gtry::utils;
@@ -55,6 +58,24 @@ class IgnoreTapMessages : public BaseFixture
 };
 
 
+/// VCD sink that can be forced to extract every recorded signal on every commit instead of comparing the mirrored state words.
+class ScanModeVCDSink : public sim::VCDSink
+{
+	public:
+		ScanModeVCDSink(hlim::Circuit &circuit, sim::Simulator &simulator, const std::string &filename, bool fullScan) :
+			VCDSink(circuit, simulator, filename.c_str()), m_fullScan(fullScan) { }
+
+		virtual void onAfterPowerOn() override {
+			VCDSink::onAfterPowerOn();
+			if (m_fullScan)
+				m_stateMirror.reset();
+		}
+
+		bool usesStateMirror() const { return m_stateMirror != nullptr; }
+	protected:
+		bool m_fullScan;
+};
+
 template<class BaseFixture>
 VCDTestFixture<BaseFixture>::VCDTestFixture()
 {
@@ -99,6 +120,330 @@ bool VCDTestFixture<BaseFixture>::GTKWaveProjectFileContains(const std::regex &r
 }
 
 
+namespace {
+
+	/// Value of a signal from the given time on, as '0', '1', and 'x' characters with the MSB first.
+	using Timeline = std::vector<std::pair<std::uint64_t, std::string>>;
+
+	struct WaveformContent {
+		/// Hierarchical names of all wires, in the order of declaration.
+		std::vector<std::string> names;
+		std::vector<size_t> widths;
+		std::vector<Timeline> timelines;
+		size_t numBlocks = 0;
+
+		/// Keeps only the last value of each time and drops values that do not change anything, starting from all undefined.
+		void normalize() {
+			for (auto i : gtry::utils::Range(timelines.size())) {
+				Timeline normalized;
+				std::string previous(widths[i], 'x');
+				for (auto &[time, value] : timelines[i]) {
+					if (!normalized.empty() && normalized.back().first == time) {
+						normalized.pop_back();
+						previous = normalized.empty() ? std::string(widths[i], 'x') : normalized.back().second;
+					}
+					if (value != previous)
+						normalized.emplace_back(time, value);
+					previous = value;
+				}
+				timelines[i] = std::move(normalized);
+			}
+		}
+	};
+
+	/// Minimal reader for the subset of the FST format that FSTWriter produces.
+	class FSTReader {
+		public:
+			FSTReader(const std::filesystem::path &filename) {
+				std::ifstream file(filename, std::ifstream::binary);
+				m_data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+			}
+
+			WaveformContent read() {
+				WaveformContent content;
+				std::vector<std::pair<size_t, size_t>> blocks;
+				std::vector<std::uint8_t> hierarchy;
+
+				size_t pos = 0;
+				while (pos < m_data.size()) {
+					std::uint8_t type = m_data[pos];
+					size_t start = pos + 1;
+					size_t length = u64(start);
+					switch (type) {
+						case 0: // header
+							check(length == 329, "header length");
+						break;
+						case 3: { // geometry
+							auto geometry = uncompress(start + 24, length - 24, u64(start + 8));
+							for (size_t p = 0; p < geometry.size(); )
+								content.widths.push_back(varint(geometry, p));
+						} break;
+						case 4: // hierarchy
+							hierarchy = gunzip(start + 16, length - 16, u64(start + 8));
+						break;
+						case 8: // value changes
+							blocks.emplace_back(start, length);
+						break;
+						default:
+							check(false, "block type");
+					}
+					pos = start + length;
+				}
+				check(pos == m_data.size(), "file length");
+
+				std::vector<std::string> scopes;
+				for (size_t p = 0; p < hierarchy.size(); ) {
+					std::uint8_t tag = hierarchy[p++];
+					if (tag == 254) {
+						p++;
+						scopes.push_back(string(hierarchy, p));
+						string(hierarchy, p);
+					} else if (tag == 255) {
+						scopes.pop_back();
+					} else {
+						p++;
+						std::string name;
+						for (const auto &s : scopes)
+							name += s + '.';
+						content.names.push_back(name + string(hierarchy, p));
+						check(varint(hierarchy, p) == content.widths[content.names.size()-1], "width in hierarchy");
+						check(varint(hierarchy, p) == 0, "no aliases");
+					}
+				}
+				check(content.names.size() == content.widths.size(), "number of signals");
+
+				content.timelines.resize(content.widths.size());
+				for (auto [start, length] : blocks)
+					readBlock(content, start, length);
+				content.numBlocks = blocks.size();
+				return content;
+			}
+		protected:
+			std::vector<std::uint8_t> m_data;
+
+			static void check(bool condition, const char *what) {
+				if (!condition)
+					throw std::runtime_error(std::string("Malformed FST file: ") + what);
+			}
+
+			std::uint64_t u64(size_t pos) const {
+				std::uint64_t v = 0;
+				for (auto i : gtry::utils::Range(8))
+					v = (v << 8) | m_data[pos + i];
+				return v;
+			}
+
+			static std::uint64_t varint(const std::vector<std::uint8_t> &buffer, size_t &pos) {
+				std::uint64_t v = 0;
+				for (size_t shift = 0; ; shift += 7) {
+					std::uint8_t byte = buffer[pos++];
+					v |= std::uint64_t(byte & 0x7F) << shift;
+					if (!(byte & 0x80)) return v;
+				}
+			}
+
+			static std::int64_t svarint(const std::vector<std::uint8_t> &buffer, size_t &pos) {
+				std::int64_t v = 0;
+				size_t shift = 0;
+				std::uint8_t byte;
+				do {
+					byte = buffer[pos++];
+					v |= std::int64_t(byte & 0x7F) << shift;
+					shift += 7;
+				} while (byte & 0x80);
+				if (byte & 0x40)
+					v -= std::int64_t(1) << shift;
+				return v;
+			}
+
+			static std::string string(const std::vector<std::uint8_t> &buffer, size_t &pos) {
+				size_t end = pos;
+				while (buffer[end] != 0) end++;
+				std::string result(buffer.begin() + pos, buffer.begin() + end);
+				pos = end + 1;
+				return result;
+			}
+
+			/// Blocks are only compressed if that makes them smaller.
+			std::vector<std::uint8_t> uncompress(size_t pos, size_t size, size_t uncompressedSize) const {
+				if (size == uncompressedSize)
+					return { m_data.begin() + pos, m_data.begin() + pos + size };
+
+				std::vector<std::uint8_t> result(uncompressedSize);
+				uLongf resultSize = (uLongf) uncompressedSize;
+				check(::uncompress(result.data(), &resultSize, m_data.data() + pos, (uLong) size) == Z_OK && resultSize == uncompressedSize, "zlib data");
+				return result;
+			}
+
+			std::vector<std::uint8_t> gunzip(size_t pos, size_t size, size_t uncompressedSize) const {
+				std::vector<std::uint8_t> result(uncompressedSize);
+				z_stream stream = {};
+				check(inflateInit2(&stream, 15 + 16) == Z_OK, "gzip init");
+				stream.next_in = const_cast<std::uint8_t*>(m_data.data() + pos);
+				stream.avail_in = (uInt) size;
+				stream.next_out = result.data();
+				stream.avail_out = (uInt) result.size();
+				int status = inflate(&stream, Z_FINISH);
+				inflateEnd(&stream);
+				check(status == Z_STREAM_END && stream.total_out == uncompressedSize, "gzip data");
+				return result;
+			}
+
+			void readBlock(WaveformContent &content, size_t start, size_t length) {
+				const size_t numSignals = content.widths.size();
+				const size_t end = start + length;
+				std::uint64_t beginTime = u64(start + 8);
+				std::uint64_t memRequired = u64(start + 24);
+
+				size_t timeUncompressed = u64(end - 24), timeCompressed = u64(end - 16), numTimes = u64(end - 8);
+				auto timeData = uncompress(end - 24 - timeCompressed, timeCompressed, timeUncompressed);
+				std::vector<std::uint64_t> times;
+				std::uint64_t time = 0;
+				for (size_t p = 0; times.size() < numTimes; ) {
+					time += varint(timeData, p);
+					times.push_back(time);
+				}
+				check(times.front() == beginTime, "block start time");
+				check(times.back() == u64(start + 16), "block end time");
+
+				size_t p = start + 32;
+				size_t frameUncompressed = varint(m_data, p);
+				size_t frameCompressed = varint(m_data, p);
+				check(varint(m_data, p) == numSignals, "frame signal count");
+				auto frame = uncompress(p, frameCompressed, frameUncompressed);
+				p += frameCompressed;
+
+				size_t offset = 0;
+				for (auto i : gtry::utils::Range(numSignals)) {
+					std::string value(frame.begin() + offset, frame.begin() + offset + content.widths[i]);
+					offset += content.widths[i];
+					if (content.numBlocks == 0)
+						content.timelines[i].emplace_back(beginTime, value);
+					else
+						check(content.timelines[i].back().second == value, "frame matches previous block");
+				}
+
+				check(varint(m_data, p) == numSignals, "maximum handle");
+				size_t valueChangesStart = p;
+				check(m_data[p] == 'Z', "pack type");
+
+				size_t positionTableLength = u64(end - 24 - timeCompressed - 8);
+				size_t positionTableStart = end - 24 - timeCompressed - 8 - positionTableLength;
+				std::vector<size_t> positions(numSignals, 0);
+				size_t q = positionTableStart;
+				std::int64_t position = 0;
+				for (size_t idx = 0; idx < numSignals; ) {
+					if (m_data[q] & 1) {
+						position += svarint(m_data, q) >> 1;
+						positions[idx++] = position;
+					} else
+						idx += varint(m_data, q) >> 1;
+				}
+				check(q == positionTableStart + positionTableLength, "position table length");
+
+				std::vector<size_t> changed;
+				for (auto i : gtry::utils::Range(numSignals))
+					if (positions[i] != 0)
+						changed.push_back(i);
+
+				size_t totalChangeBytes = 0;
+				for (auto k : gtry::utils::Range(changed.size())) {
+					size_t i = changed[k];
+					size_t changesStart = valueChangesStart + positions[i];
+					size_t changesEnd = k+1 < changed.size() ? valueChangesStart + positions[changed[k+1]] : positionTableStart;
+					size_t uncompressedSize = varint(m_data, changesStart);
+					auto changes = uncompressedSize == 0 ?
+						std::vector<std::uint8_t>(m_data.begin() + changesStart, m_data.begin() + changesEnd) :
+						uncompress(changesStart, changesEnd - changesStart, uncompressedSize);
+					totalChangeBytes += changes.size();
+
+					const size_t width = content.widths[i];
+					size_t timeIdx = 0;
+					for (size_t c = 0; c < changes.size(); ) {
+						std::uint64_t v = varint(changes, c);
+						std::string value;
+						if (width == 1) {
+							if (!(v & 1)) {
+								timeIdx += v >> 2;
+								value = (v & 2) ? "1" : "0";
+							} else {
+								timeIdx += v >> 4;
+								value = "x";
+							}
+						} else {
+							timeIdx += v >> 1;
+							if (v & 1) {
+								value.assign(changes.begin() + c, changes.begin() + c + width);
+								c += width;
+							} else {
+								for (auto b : gtry::utils::Range(width))
+									value += (changes[c + b/8] & (0x80 >> (b % 8))) ? '1' : '0';
+								c += (width + 7) / 8;
+							}
+						}
+						check(timeIdx < times.size(), "time index");
+						content.timelines[i].emplace_back(times[timeIdx], value);
+					}
+				}
+				check(totalChangeBytes == memRequired, "size of value changes");
+			}
+	};
+
+	/// Reads the wires and their values from a VCD file, ignoring all string variables.
+	WaveformContent readVCD(const std::filesystem::path &filename)
+	{
+		WaveformContent content;
+		std::map<std::string, size_t> code2signal;
+		std::vector<std::string> scopes;
+
+		std::ifstream file(filename, std::ifstream::binary);
+		std::string token;
+		std::uint64_t time = 0;
+		auto addValue = [&](const std::string &code, std::string value) {
+			auto it = code2signal.find(code);
+			if (it == code2signal.end()) return;
+			for (auto &c : value)
+				c = (char) std::tolower(c);
+			content.timelines[it->second].emplace_back(time, std::move(value));
+		};
+
+		while (file >> token) {
+			if (token == "$date" || token == "$version" || token == "$timescale" || token == "$comment") {
+				while (file >> token && token != "$end");
+			} else if (token == "$scope") {
+				std::string type, name;
+				file >> type >> name >> token;
+				scopes.push_back(name);
+			} else if (token == "$upscope") {
+				file >> token;
+				scopes.pop_back();
+			} else if (token == "$var") {
+				std::string type, code, name;
+				size_t width;
+				file >> type >> width >> code >> name >> token;
+				if (type != "wire") continue;
+
+				for (auto it = scopes.rbegin(); it != scopes.rend(); ++it)
+					name = *it + '.' + name;
+				code2signal[code] = content.names.size();
+				content.names.push_back(name);
+				content.widths.push_back(width);
+				content.timelines.emplace_back();
+			} else if (token == "$enddefinitions" || token == "$dumpvars" || token == "$end") {
+			} else if (token[0] == '#') {
+				time = std::stoull(token.substr(1));
+			} else if (token[0] == 'b' || token[0] == 's') {
+				std::string code;
+				file >> code;
+				addValue(code, token.substr(1));
+			} else {
+				addValue(token.substr(1), token.substr(0, 1));
+			}
+		}
+		return content;
+	}
+}
+
 
 BOOST_AUTO_TEST_SUITE(VCD)
 
@@ -315,4 +660,458 @@ BOOST_FIXTURE_TEST_CASE(testMultiSignalsSameDriver, VCDTestFixture<BoostUnitTest
 
 
 
+BOOST_FIXTURE_TEST_CASE(fstSmallerThanVCD, VCDTestFixture<BoostUnitTestSimulationFixture>)
+{
+	using namespace gtry;
+
+	Clock clock({ .absoluteFrequency = 10'000 });
+
+	UInt counter = 8_b;
+	counter = reg(counter+1, 0);
+	HCL_NAMED(counter);
+	pinOut(counter);
+
+	UInt unused = counter ^ 1;
+	HCL_NAMED(unused);
+	tap(unused);
+
+	addSimulationProcess([clock,this]()->SimProcess {
+
+		for ([[maybe_unused]] auto i : gtry::utils::Range(1000)) {
+			co_await AfterClk(clock);
+		}
+
+		stopTest();
+	});
+
+	design.postprocess();
+	recordFST((m_testDir / "test.fst").string());
+
+	runTicks(clock.getClk(), 100000);
+
+	m_fstSink.reset();
+	m_vcdSink.reset();
+
+	std::ifstream file((m_testDir / "test.fst").string(), std::ifstream::binary);
+	BOOST_TEST((bool) file);
+	std::array<std::uint8_t, 25> header;
+	file.read((char*) header.data(), header.size());
+	BOOST_TEST(header[0] == 0); // header block
+	std::uint64_t headerLength = 0, endTime = 0;
+	for (auto i : gtry::utils::Range(8)) {
+		headerLength = (headerLength << 8) | header[1 + i];
+		endTime = (endTime << 8) | header[17 + i];
+	}
+	BOOST_TEST(headerLength == 329);
+	BOOST_TEST(endTime > 0);
+
+	BOOST_TEST(std::filesystem::file_size(m_testDir / "test.fst") * 5 < std::filesystem::file_size(m_testDir / "test.vcd"));
+
+	std::fstream gtkwFile((m_testDir / "test.fst.gtkw").string(), std::fstream::in);
+	std::stringstream buffer;
+	buffer << gtkwFile.rdbuf();
+	BOOST_TEST(std::regex_search(buffer.str(), std::regex{"test\\.fst"}));
+	BOOST_TEST(std::regex_search(buffer.str(), std::regex{"unused"}));
+}
+
+BOOST_AUTO_TEST_CASE(fstRoundTrip)
+{
+	using namespace gtry;
+
+	const std::vector<size_t> widths = { 1, 5, 64, 100, 1 };
+	std::vector<Timeline> expected(widths.size());
+
+	auto testDir = std::filesystem::path{ "tmp" } / "VCD" / "fstRoundTrip";
+	std::filesystem::create_directories(testDir);
+	{
+		// A tiny block size, so that values are carried from block to block in the frames.
+		sim::FSTWriter writer((testDir / "test.fst").string(), 256);
+
+		std::vector<sim::FSTWriter::Handle> handles;
+		{
+			auto top = writer.beginModule("top");
+			handles.push_back(writer.declareWire(widths[0], "bit"));
+			handles.push_back(writer.declareWire(widths[1], "narrow"));
+			{
+				auto sub = writer.beginModule("sub");
+				handles.push_back(writer.declareWire(widths[2], "full"));
+				handles.push_back(writer.declareWire(widths[3], "wide"));
+			}
+			handles.push_back(writer.declareWire(widths[4], "flag"));
+		}
+
+		std::mt19937 rng{ 1234 };
+		sim::DefaultBitVectorState state;
+		for (auto t : utils::Range(500)) {
+			writer.writeTime(t * 1000);
+			for (auto i : utils::Range(widths.size())) {
+				if (rng() % 3 == 0) continue;
+
+				state.resize(widths[i]);
+				std::string value;
+				bool undefined = rng() % 8 == 0;
+				for (auto b : utils::Range(widths[i])) {
+					state.set(sim::DefaultConfig::VALUE, b, rng() & 1);
+					state.set(sim::DefaultConfig::DEFINED, b, !undefined || rng() % 2 == 0);
+				}
+				for (auto b : utils::Range(widths[i])) {
+					auto bit = widths[i] - 1 - b;
+					value += !state.get(sim::DefaultConfig::DEFINED, bit) ? 'x' : (state.get(sim::DefaultConfig::VALUE, bit) ? '1' : '0');
+				}
+
+				if (i == 4)
+					writer.writeBitState(handles[i], !undefined, value == "1");
+				else
+					writer.writeState(handles[i], state, 0, widths[i]);
+				if (i == 4 && undefined)
+					value = "x";
+				expected[i].emplace_back(t * 1000, value);
+			}
+		}
+		writer.close();
+	}
+
+	auto content = FSTReader(testDir / "test.fst").read();
+	BOOST_TEST(content.numBlocks > 1);
+	BOOST_TEST(content.names == std::vector<std::string>({ "top.bit", "top.narrow", "top.sub.full", "top.sub.wide", "top.flag" }), boost::test_tools::per_element());
+	BOOST_TEST(content.widths == widths, boost::test_tools::per_element());
+
+	WaveformContent reference;
+	reference.widths = widths;
+	reference.timelines = std::move(expected);
+	reference.normalize();
+	content.normalize();
+	for (auto i : utils::Range(widths.size()))
+		BOOST_TEST((content.timelines[i] == reference.timelines[i]));
+}
+
+BOOST_FIXTURE_TEST_CASE(fstMatchesVCD, VCDTestFixture<BoostUnitTestSimulationFixture>)
+{
+	using namespace gtry;
+
+	Clock clock({ .absoluteFrequency = 10'000 });
+	ClockScope clkScp(clock);
+
+	UInt counter = 8_b;
+	counter = reg(counter+1, 0);
+	HCL_NAMED(counter);
+	pinOut(counter);
+
+	UInt input = pinIn(70_b);
+	HCL_NAMED(input);
+	UInt wide = reg(input ^ zext(counter, 70_b));
+	HCL_NAMED(wide);
+	pinOut(wide);
+
+	Bit odd = counter.lsb();
+	HCL_NAMED(odd);
+	tap(odd);
+
+	addSimulationProcess([=,this]()->SimProcess {
+		std::mt19937 rng{ 1234 };
+		for ([[maybe_unused]] auto i : gtry::utils::Range(200)) {
+			if (rng() % 4 == 0)
+				simu(input).invalidate();
+			else
+				simu(input) = sim::createRandomDefaultBitVectorState(70, rng);
+			co_await AfterClk(clock);
+		}
+		stopTest();
+	});
+
+	design.postprocess();
+	recordFST((m_testDir / "test.fst").string());
+
+	runTest(hlim::ClockRational(1000, 1) / clock.getClk()->absoluteFrequency());
+
+	m_fstSink.reset();
+	m_vcdSink.reset();
+
+	auto fst = FSTReader(m_testDir / "test.fst").read();
+	auto vcd = readVCD(m_testDir / "test.vcd");
+	fst.normalize();
+	vcd.normalize();
+
+	BOOST_TEST(fst.names == vcd.names, boost::test_tools::per_element());
+	BOOST_TEST(fst.widths == vcd.widths, boost::test_tools::per_element());
+	BOOST_REQUIRE(fst.timelines.size() == vcd.timelines.size());
+	for (auto i : gtry::utils::Range(fst.timelines.size())) {
+		BOOST_TEST_CONTEXT(fst.names[i])
+			BOOST_TEST((fst.timelines[i] == vcd.timelines[i]));
+	}
+
+	// The wide signals must actually have been compared, not just their initial values.
+	size_t numWideChanges = 0;
+	for (auto i : gtry::utils::Range(fst.timelines.size()))
+		if (fst.widths[i] == 70)
+			numWideChanges += fst.timelines[i].size();
+	BOOST_TEST(numWideChanges > 100);
+}
+
+BOOST_FIXTURE_TEST_CASE(asyncVCDMatchesSync, IgnoreTapMessages<BoostUnitTestSimulationFixture>)
+{
+	using namespace gtry;
+
+	Clock clock({ .absoluteFrequency = 10'000 });
+	ClockScope clkScp(clock);
+
+	UInt counter = 8_b;
+	counter = reg(counter+1, 0);
+	HCL_NAMED(counter);
+	pinOut(counter);
+
+	UInt input = pinIn(70_b).setName("input");
+	UInt wide = reg(input ^ zext(counter, 70_b));
+	HCL_NAMED(wide);
+	pinOut(wide);
+
+	sim_assert(counter.lower(4_b) != 0) << "counter wrapped: " << counter;
+
+	addSimulationProcess([=,this]()->SimProcess {
+		std::mt19937 rng{ 1234 };
+		for ([[maybe_unused]] auto i : gtry::utils::Range(500)) {
+			simu(input) = sim::createRandomDefaultBitVectorState(70, rng);
+			co_await AfterClk(clock);
+		}
+		stopTest();
+	});
+
+	design.postprocess();
+
+	auto testDir = std::filesystem::path{ "tmp" } / "VCD" / "asyncVCDMatchesSync";
+	std::filesystem::create_directories(testDir);
+	{
+		sim::VCDSink syncSink(design.getCircuit(), getSimulator(), (testDir / "sync.vcd").string().c_str());
+		sim::VCDSink asyncSink(design.getCircuit(), getSimulator(), (testDir / "async.vcd").string().c_str());
+		// Tiny buffers, so that the simulation keeps handing buffers to the writer thread and waiting for it.
+		asyncSink.writeAsynchronously(1024, 3);
+		for (auto *sink : { &syncSink, &asyncSink }) {
+			sink->includeAsserts();
+			sink->addAllPins();
+			sink->addAllNamedSignals();
+		}
+
+		runTest(hlim::ClockRational(1000, 1) / clock.getClk()->absoluteFrequency());
+	}
+
+	// Everything but the date must be identical.
+	auto readWithoutDate = [](const std::filesystem::path &filename) {
+		std::ifstream file(filename, std::ifstream::binary);
+		std::stringstream content;
+		content << file.rdbuf();
+		std::string str = content.str();
+		BOOST_REQUIRE(str.starts_with("$date\n"));
+		return str.substr(str.find("$end\n") + 5);
+	};
+	auto sync = readWithoutDate(testDir / "sync.vcd");
+	auto async = readWithoutDate(testDir / "async.vcd");
+	BOOST_TEST(sync.size() > 16 * 1024);
+	BOOST_TEST(sync.find("counter\\x20wrapped") != std::string::npos);
+	BOOST_TEST((sync == async));
+}
+
+namespace {
+	/// Fails to write every tick, to check that failures of the writer thread reach the owner.
+	class FailingWaveformRecorder : public sim::WaveformRecorder
+	{
+		public:
+			using WaveformRecorder::WaveformRecorder;
+			virtual ~FailingWaveformRecorder() override { finishWritingInDestructor(); }
+		protected:
+			virtual void initialize() override { }
+			virtual void signalChanged(size_t id) override { }
+			virtual void advanceTick(const hlim::ClockRational &simulationTime) override { throw std::runtime_error("disk full"); }
+	};
+}
+
+BOOST_FIXTURE_TEST_CASE(asyncWriterFailureIsRethrownByFinishWriting, BoostUnitTestSimulationFixture)
+{
+	using namespace gtry;
+
+	Clock clock({ .absoluteFrequency = 10'000 });
+	ClockScope clkScp(clock);
+
+	UInt counter = 8_b;
+	counter = reg(counter+1, 0);
+	HCL_NAMED(counter);
+	pinOut(counter);
+
+	design.postprocess();
+
+	FailingWaveformRecorder recorder(design.getCircuit(), getSimulator());
+	// The buffer holds the entire simulation, so the writer thread only fails once finishWriting hands it over.
+	recorder.writeAsynchronously();
+	recorder.addAllNamedSignals();
+
+	runTest(hlim::ClockRational(10, 1) / clock.getClk()->absoluteFrequency());
+	BOOST_CHECK_THROW(recorder.finishWriting(), std::runtime_error);
+}
+
+BOOST_FIXTURE_TEST_CASE(stateMirrorMatchesFullScan, BoostUnitTestSimulationFixture)
+{
+	using namespace gtry;
+
+	Clock clock({ .absoluteFrequency = 10'000 });
+	ClockScope clkScp(clock);
+
+	// Narrow signals sharing state words, a signal spanning several words, and the words of a memory.
+	UInt counter = 8_b;
+	counter = reg(counter+1, 0);
+	HCL_NAMED(counter);
+	pinOut(counter);
+
+	Bit odd = counter.lsb();
+	HCL_NAMED(odd);
+	tap(odd);
+
+	UInt input = pinIn(70_b).setName("input");
+	UInt wide = reg(input ^ zext(counter, 70_b));
+	HCL_NAMED(wide);
+	pinOut(wide);
+
+	Memory<UInt> mem(16, 6_b);
+	mem.noConflicts();
+	mem.setName("mem");
+	UInt addr = pinIn(4_b).setName("addr");
+	UInt wrData = pinIn(6_b).setName("wrData");
+	Bit wrEn = pinIn().setName("wrEn");
+	IF (wrEn)
+		mem[addr] = wrData;
+	pinOut(mem[addr]).setName("rdData");
+
+	addSimulationProcess([=,this]()->SimProcess {
+		std::mt19937 rng{ 1234 };
+		for ([[maybe_unused]] auto i : gtry::utils::Range(300)) {
+			// Mostly defined values, but also partially undefined ones and values that do not change.
+			if (rng() % 4 != 0)
+				simu(input) = sim::createRandomDefaultBitVectorState(70, rng);
+			simu(addr) = rng() % 16;
+			simu(wrData) = sim::createRandomDefaultBitVectorState(6, rng);
+			simu(wrEn) = rng() % 2 == 0;
+			co_await AfterClk(clock);
+		}
+		stopTest();
+	});
+
+	design.postprocess();
+
+	auto testDir = std::filesystem::path{ "tmp" } / "VCD" / "stateMirrorMatchesFullScan";
+	std::filesystem::create_directories(testDir);
+	{
+		ScanModeVCDSink mirrorSink(design.getCircuit(), getSimulator(), (testDir / "mirror.vcd").string(), false);
+		ScanModeVCDSink fullScanSink(design.getCircuit(), getSimulator(), (testDir / "fullScan.vcd").string(), true);
+		for (auto *sink : { &mirrorSink, &fullScanSink }) {
+			sink->addAllPins();
+			sink->addAllNamedSignals();
+			sink->addAllTaps();
+			sink->addAllMemories();
+		}
+
+		runTest(hlim::ClockRational(1000, 1) / clock.getClk()->absoluteFrequency());
+
+		BOOST_TEST(mirrorSink.usesStateMirror());
+		BOOST_TEST(!fullScanSink.usesStateMirror());
+	}
+
+	auto mirror = readVCD(testDir / "mirror.vcd");
+	auto fullScan = readVCD(testDir / "fullScan.vcd");
+	BOOST_TEST(mirror.names == fullScan.names, boost::test_tools::per_element());
+	BOOST_REQUIRE(mirror.timelines.size() == fullScan.timelines.size());
+	size_t numChanges = 0;
+	for (auto i : gtry::utils::Range(mirror.timelines.size())) {
+		// Not normalized, both must report exactly the same changes.
+		BOOST_TEST_CONTEXT(mirror.names[i])
+			BOOST_TEST((mirror.timelines[i] == fullScan.timelines[i]));
+		numChanges += mirror.timelines[i].size();
+	}
+	BOOST_TEST(numChanges > 1000);
+	BOOST_TEST(std::count_if(mirror.names.begin(), mirror.names.end(), [](const std::string &name) { return name.find("addr_") != std::string::npos; }) == 16);
+}
+
+
+template<class BaseFixture>
+class VCDWindowTestFixture : public VCDTestFixture<BaseFixture>
+{
+	protected:
+		void prepRun() override {
+			VCDTestFixture<BaseFixture>::prepRun();
+			BaseFixture::m_vcdSink->recordWindow(hlim::ClockRational(100, 10'000));
+		}
+};
+
+BOOST_FIXTURE_TEST_CASE(vcdWindowWrittenOnTrigger, VCDWindowTestFixture<BoostUnitTestSimulationFixture>)
+{
+	using namespace gtry;
+
+	Clock clock({ .absoluteFrequency = 10'000 });
+
+	UInt counter = 8_b;
+	counter = reg(counter+1, 0);
+	HCL_NAMED(counter);
+	pinOut(counter);
+
+	addSimulationProcess([clock,this]()->SimProcess {
+
+		for ([[maybe_unused]] auto i : gtry::utils::Range(1000))
+			co_await AfterClk(clock);
+
+		m_vcdSink->trigger();
+
+		for ([[maybe_unused]] auto i : gtry::utils::Range(5))
+			co_await AfterClk(clock);
+
+		stopTest();
+	});
+
+	design.postprocess();
+
+	runTicks(clock.getClk(), 100000);
+
+	m_vcdSink.reset();
+	std::fstream file((m_testDir / "test.vcd").string(), std::fstream::in);
+	BOOST_TEST((bool) file);
+
+	std::vector<std::uint64_t> times;
+	std::string line;
+	while (std::getline(file, line))
+		if (line.size() > 1 && line[0] == '#' && line != "#0")
+			times.push_back(std::stoull(line.substr(1)));
+
+	// Only the window of 100 to 112.5 cycles before the trigger (in the 1000th cycle) is written.
+	const std::uint64_t cyclePs = 100'000'000;
+	BOOST_REQUIRE(!times.empty());
+	BOOST_TEST(times.front() >= 1000 * cyclePs - 113 * cyclePs);
+	BOOST_TEST(times.front() <= 1001 * cyclePs - 100 * cyclePs);
+	BOOST_TEST(times.back() <= 1001 * cyclePs);
+}
+
+
+BOOST_FIXTURE_TEST_CASE(vcdWindowRejectsAsynchronousWriting, BoostUnitTestSimulationFixture)
+{
+	using namespace gtry;
+
+	Clock clock({ .absoluteFrequency = 10'000 });
+	ClockScope clkScp(clock);
+
+	UInt counter = 8_b;
+	counter = reg(counter+1, 0);
+	HCL_NAMED(counter);
+	pinOut(counter);
+
+	design.postprocess();
+
+	auto testDir = std::filesystem::path{ "tmp" } / "VCD" / "vcdWindowRejectsAsynchronousWriting";
+	std::filesystem::create_directories(testDir);
+
+	sim::VCDSink windowFirst(design.getCircuit(), getSimulator(), (testDir / "windowFirst.vcd").string().c_str());
+	windowFirst.recordWindow(hlim::ClockRational(100, 10'000));
+	BOOST_CHECK_THROW(windowFirst.writeAsynchronously(), gtry::utils::DesignError);
+
+	sim::VCDSink asyncFirst(design.getCircuit(), getSimulator(), (testDir / "asyncFirst.vcd").string().c_str());
+	asyncFirst.writeAsynchronously();
+	BOOST_CHECK_THROW(asyncFirst.recordWindow(hlim::ClockRational(100, 10'000)), gtry::utils::DesignError);
+	asyncFirst.finishWriting();
+}
+
+
 BOOST_AUTO_TEST_SUITE_END()
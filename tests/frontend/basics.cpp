@@ -16,11 +16,20 @@
 	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 */
 #include "frontend/pch.h"
+#include <gatery/simulation/CompiledSimulator.h>
+#include <gatery/hlim/GraphSnapshot.h>
+#include <gatery/hlim/postprocessing/LocalRewriter.h>
+#include <gatery/hlim/coreNodes/Node_Constant.h>
+#include <gatery/hlim/Subnet.h>
+#include <gatery/hlim/TopologicalSort.h>
 #include <boost/test/unit_test.hpp>
 #include <boost/test/data/dataset.hpp>
 #include <boost/test/data/test_case.hpp>
 #include <boost/test/data/monomorphic.hpp>
 
+#include <latch>
+#include <sstream>
+
 
 using namespace boost::unit_test;
 
@@ -1993,3 +2002,615 @@ BOOST_FIXTURE_TEST_CASE(BitSimuHandleComparison, gtry::BoostUnitTestSimulationFi
 	runTest({ 1,1 });
 }
 
+BOOST_FIXTURE_TEST_CASE(ActivityDriven_Counter, BoostUnitTestSimulationFixture)
+{
+	using namespace gtry;
+	using namespace gtry::utils;
+
+	m_compileOptions.activityDrivenEvaluation = true;
+
+	Clock clock({ .absoluteFrequency = 10'000, .resetType = ClockConfig::ResetType::NONE });
+	{
+		ClockScope clkScp(clock);
+
+		UInt counter(8_b);
+		counter = reg(counter, 0);
+
+		auto incrementPin = pinIn(8_b);
+		auto outputPin = pinOut(counter);
+		auto sumPin = pinOut(counter + incrementPin);
+		counter += incrementPin;
+
+		addSimulationProcess([=]()->SimProcess{
+			co_await WaitFor(Seconds(1, 2)/clock.absoluteFrequency());
+			for (auto i : Range(10)) {
+				simu(incrementPin) = i;
+				co_await WaitFor(Seconds(5)/clock.absoluteFrequency());
+			}
+		});
+		addSimulationProcess([=]()->SimProcess{
+
+			size_t expectedSum = 0;
+
+			while (true) {
+				co_await AfterClk(clock);
+
+				expectedSum += simu(incrementPin);
+
+				BOOST_TEST(expectedSum % 256 == simu(outputPin));
+				BOOST_TEST((expectedSum + simu(incrementPin)) % 256 == simu(sumPin));
+				BOOST_TEST(simu(outputPin).defined() == 0xFF);
+			}
+		});
+	}
+
+	design.postprocess();
+	runTicks(clock.getClk(), 5*10 + 3);
+}
+
+BOOST_DATA_TEST_CASE_F(BoostUnitTestSimulationFixture, MultiThreaded_Accumulators, data::make({false, true}), activityDriven)
+{
+	using namespace gtry;
+	using namespace gtry::utils;
+
+	m_compileOptions.numThreads = 4;
+	m_compileOptions.activityDrivenEvaluation = activityDriven;
+
+	Clock clock({ .absoluteFrequency = 10'000, .resetType = ClockConfig::ResetType::NONE });
+	ClockScope clkScp(clock);
+
+	// Enough independent logic to be split into several execution blocks and advance groups.
+	const size_t numLanes = 32;
+	const size_t numStages = 8;
+
+	auto incrementPin = pinIn(8_b);
+	std::vector<OutputPins> accumulatorPins;
+	for (auto lane : Range(numLanes)) {
+		UInt increment = incrementPin;
+		for (auto stage : Range(numStages))
+			increment = (increment ^ (lane * numStages + stage)) + 1;
+
+		UInt accumulator(8_b);
+		accumulator = reg(accumulator, 0);
+		sim_assert((accumulator ^ accumulator) == 0) << "lane " << lane;
+		accumulatorPins.push_back(pinOut(accumulator));
+		accumulator += increment;
+	}
+
+	auto model = [&](size_t lane, size_t increment) {
+		for (auto stage : Range(numStages))
+			increment = ((increment ^ (lane * numStages + stage)) + 1) % 256;
+		return increment;
+	};
+
+	addSimulationProcess([=,this]()->SimProcess{
+		std::vector<size_t> expected(numLanes, 0);
+
+		co_await OnClk(clock);
+		for (auto i : Range(20)) {
+			simu(incrementPin) = i * 7;
+			co_await AfterClk(clock);
+
+			for (auto lane : Range(numLanes)) {
+				expected[lane] = (expected[lane] + model(lane, i * 7)) % 256;
+				BOOST_TEST(simu(accumulatorPins[lane]) == expected[lane]);
+			}
+		}
+		stopTest();
+	});
+
+	design.postprocess();
+	runTest(hlim::ClockRational(100, 1) / clock.getClk()->absoluteFrequency());
+}
+
+BOOST_FIXTURE_TEST_CASE(Compiled_MatchesReferenceSimulator, BoostUnitTestSimulationFixture)
+{
+	using namespace gtry;
+	using namespace gtry::utils;
+
+	auto *compiledSimulator = new sim::CompiledSimulator(false);
+	m_simulator.reset(compiledSimulator);
+	m_simulator->addCallbacks(this);
+
+	Clock clock({ .absoluteFrequency = 10'000, .resetType = ClockConfig::ResetType::NONE });
+	ClockScope clkScp(clock);
+
+	UInt a = pinIn(8_b);
+	UInt b = pinIn(8_b);
+	UInt sel = pinIn(2_b);
+	Bit enable = pinIn();
+
+	auto logicPin = pinOut((a & b) | ~(a ^ b));
+	auto sumPin = pinOut(a + b);
+	auto diffPin = pinOut(a - b);
+	auto productPin = pinOut(a * b);
+	auto lessPin = pinOut(a < b);
+	auto equalPin = pinOut(a == b);
+	auto muxPin = pinOut(mux(sel, { a, b, a + b, a ^ b }));
+
+	UInt accumulator(8_b);
+	accumulator = reg(accumulator, 0);
+	auto accumulatorPin = pinOut(accumulator);
+	IF (enable)
+		accumulator += a;
+
+	// Drives the same stimulus into either simulator and records the defined bits and the defined values of all outputs.
+	auto stimulus = [=](std::vector<std::uint64_t> &trace) {
+		return [=, &trace]()->SimProcess {
+			auto record = [&](const auto &pin) {
+				sim::DefaultBitVectorState state = simu(pin).eval();
+				std::uint64_t defined = state.extractNonStraddling(sim::DefaultConfig::DEFINED, 0, state.size());
+				trace.push_back(defined);
+				trace.push_back(state.extractNonStraddling(sim::DefaultConfig::VALUE, 0, state.size()) & defined);
+			};
+			auto recordAll = [&]() {
+				record(logicPin); record(sumPin); record(diffPin); record(productPin);
+				record(lessPin); record(equalPin); record(muxPin); record(accumulatorPin);
+			};
+
+			std::mt19937 rng{ 1234 };
+			co_await OnClk(clock);
+			for ([[maybe_unused]] auto i : Range(50)) {
+				simu(a) = rng() % 256;
+				simu(b) = rng() % 256;
+				simu(sel) = rng() % 4;
+				simu(enable) = rng() % 2 == 1;
+				co_await WaitStable();
+				recordAll();
+				co_await AfterClk(clock);
+			}
+
+			// Undefined inputs must propagate exactly as in the interpreted simulation.
+			simu(a) = 0;
+			simu(b).invalidate();
+			simu(sel) = 1;
+			co_await WaitStable();
+			recordAll();
+		};
+	};
+
+	design.postprocess();
+
+	std::vector<std::uint64_t> compiledTrace;
+	addSimulationProcess(stimulus(compiledTrace));
+	runFixedLengthTest(hlim::ClockRational(60, 1) / clock.getClk()->absoluteFrequency());
+	BOOST_CHECK(compiledSimulator->isCompiled());
+	BOOST_CHECK(compiledSimulator->getNumCompiledNodes() > 0);
+
+	std::vector<std::uint64_t> referenceTrace;
+	sim::ReferenceSimulator reference(false);
+	reference.addSimulationProcess(stimulus(referenceTrace));
+	reference.compileProgram(design.getCircuit());
+	reference.powerOn();
+	reference.advance(hlim::ClockRational(60, 1) / clock.getClk()->absoluteFrequency());
+
+	BOOST_CHECK(referenceTrace.size() == 51 * 8 * 2);
+	BOOST_CHECK(compiledTrace == referenceTrace);
+}
+
+BOOST_DATA_TEST_CASE_F(BoostUnitTestSimulationFixture, TwoState_Datapath, data::make({false, true}), activityDriven)
+{
+	using namespace gtry;
+	using namespace gtry::utils;
+
+	m_compileOptions.twoStateEvaluation = true;
+	m_compileOptions.activityDrivenEvaluation = activityDriven;
+
+	Clock clock({ .absoluteFrequency = 10'000, .resetType = ClockConfig::ResetType::NONE });
+	ClockScope clkScp(clock);
+
+	UInt a = pinIn(8_b);
+	UInt b = pinIn(8_b);
+
+	auto logicPin = pinOut((a & b) ^ ~a);
+	auto sumPin = pinOut(a + b);
+	auto lessPin = pinOut(a < b);
+
+	// A register that is never initialized, so that undefined values also arise inside the circuit.
+	UInt uninitialized(8_b);
+	uninitialized = reg(uninitialized);
+	Bit selectUninitialized = pinIn();
+	auto mixedSumPin = pinOut(a + mux(selectUninitialized, { b, uninitialized }));
+
+	UInt accumulator(8_b);
+	accumulator = reg(accumulator, 0);
+	auto accumulatorPin = pinOut(accumulator);
+	accumulator += a;
+
+	addSimulationProcess([=,this]()->SimProcess{
+		std::mt19937 rng{ 4321 };
+		size_t expectedAccumulator = 0;
+
+		simu(selectUninitialized) = '0';
+		co_await OnClk(clock);
+		for ([[maybe_unused]] auto i : Range(20)) {
+			size_t av = rng() % 256;
+			size_t bv = rng() % 256;
+			simu(a) = av;
+			simu(b) = bv;
+			co_await WaitStable();
+
+			BOOST_TEST(simu(logicPin) == (((av & bv) ^ ~av) & 0xFF));
+			BOOST_TEST(simu(sumPin) == (av + bv) % 256);
+			BOOST_TEST(simu(lessPin) == (av < bv));
+			BOOST_TEST(simu(mixedSumPin) == (av + bv) % 256);
+			BOOST_TEST(simu(accumulatorPin) == expectedAccumulator);
+
+			co_await AfterClk(clock);
+			expectedAccumulator = (expectedAccumulator + av) % 256;
+		}
+
+		// Undefined input pins return everything downstream to regular evaluation.
+		simu(b).invalidate();
+		co_await WaitStable();
+		BOOST_TEST(simu(sumPin).defined() == 0);
+		BOOST_TEST(simu(lessPin).defined() == 0);
+
+		simu(a) = 5;
+		simu(b) = 3;
+		co_await WaitStable();
+		BOOST_TEST(simu(sumPin).defined() == 0xFF);
+		BOOST_TEST(simu(sumPin) == 8);
+
+		// The adder behind the mux was fully defined so far, but must notice the undefined register reaching it.
+		BOOST_TEST(simu(mixedSumPin).defined() == 0xFF);
+		simu(selectUninitialized) = '1';
+		co_await WaitStable();
+		BOOST_TEST(simu(mixedSumPin).defined() == 0);
+
+		stopTest();
+	});
+
+	design.postprocess();
+	runTest(hlim::ClockRational(100, 1) / clock.getClk()->absoluteFrequency());
+}
+
+namespace {
+
+	/// Builds independent lanes of registered datapaths with a mix of narrow and wide (96 bit) signals.
+	std::vector<gtry::OutputPins> buildMixedWidthLanes(const gtry::InputPins &incrementPin, size_t numLanes, size_t numStages)
+	{
+		using namespace gtry;
+		using namespace gtry::utils;
+
+		std::vector<OutputPins> accumulatorPins;
+		for (auto lane : Range(numLanes)) {
+			UInt increment = incrementPin;
+			UInt wide = cat(increment, increment, increment, increment, increment, increment, increment, increment, increment, increment, increment, increment);
+			for (auto stage : Range(numStages)) {
+				increment = (increment ^ (lane * numStages + stage)) + 1;
+				Bit odd = increment.lsb();
+				wide = mux(odd, { wide, wide ^ (wide >> 1) });
+			}
+
+			UInt accumulator(8_b);
+			accumulator = reg(accumulator, 0);
+			accumulatorPins.push_back(pinOut(accumulator));
+			accumulator += increment ^ wide.lower(8_b);
+		}
+		return accumulatorPins;
+	}
+
+	size_t mixedWidthLaneModel(size_t lane, size_t numStages, size_t increment)
+	{
+		using namespace gtry::utils;
+
+		// The lower bits of the wide signal only depend on its lower 8 + numStages bits.
+		std::uint64_t wide = 0;
+		for ([[maybe_unused]] auto i : Range(8))
+			wide = (wide << 8) | increment;
+		for (auto stage : Range(numStages)) {
+			increment = ((increment ^ (lane * numStages + stage)) + 1) % 256;
+			if (increment & 1)
+				wide = wide ^ (wide >> 1);
+		}
+		return (increment ^ (wide & 0xFF)) % 256;
+	}
+}
+
+BOOST_DATA_TEST_CASE_F(BoostUnitTestSimulationFixture, StateLayout_MixedWidths, data::make({false, true}), evaluationOrder)
+{
+	using namespace gtry;
+	using namespace gtry::utils;
+
+	m_compileOptions.stateLayout = evaluationOrder ? sim::StateLayout::EVALUATION_ORDER : sim::StateLayout::SIZE_BUCKETS;
+
+	Clock clock({ .absoluteFrequency = 10'000, .resetType = ClockConfig::ResetType::NONE });
+	ClockScope clkScp(clock);
+
+	const size_t numLanes = 8;
+	const size_t numStages = 4;
+
+	auto incrementPin = pinIn(8_b);
+	auto accumulatorPins = buildMixedWidthLanes(incrementPin, numLanes, numStages);
+
+	addSimulationProcess([=,this]()->SimProcess{
+		std::vector<size_t> expected(numLanes, 0);
+
+		co_await OnClk(clock);
+		for (auto i : Range(20)) {
+			simu(incrementPin) = i * 13 % 256;
+			co_await AfterClk(clock);
+
+			for (auto lane : Range(numLanes)) {
+				expected[lane] = (expected[lane] + mixedWidthLaneModel(lane, numStages, i * 13 % 256)) % 256;
+				BOOST_TEST(simu(accumulatorPins[lane]) == expected[lane]);
+			}
+		}
+		stopTest();
+	});
+
+	design.postprocess();
+	runTest(hlim::ClockRational(100, 1) / clock.getClk()->absoluteFrequency());
+}
+
+BOOST_AUTO_TEST_CASE(PerformanceCounters_SampleAllThreads)
+{
+	using namespace gtry;
+	using Counters = sim::SimulatorPerformanceCounters;
+
+	Counters counters;
+	counters.setEnabled(true);
+
+	// Keeps all threads in one activity while taking samples, then lets them exit.
+	auto sampleThreads = [&](size_t numThreads, Counters::Other other, size_t numSamples) {
+		std::latch entered(numThreads);
+		std::latch sampled(1);
+
+		std::vector<std::thread> threads;
+		for ([[maybe_unused]] auto i : utils::Range(numThreads))
+			threads.emplace_back([&] {
+				auto outer = counters.processOther(Counters::Other::COMPILATION);
+				{
+					auto inner = counters.processOther(other);
+					entered.count_down();
+					sampled.wait();
+				}
+			});
+
+		entered.wait();
+		for ([[maybe_unused]] auto i : utils::Range(numSamples))
+			counters.tick();
+		sampled.count_down();
+
+		for (auto &t : threads)
+			t.join();
+	};
+
+	sampleThreads(4, Counters::Other::SIMULATION_PROCESS, 10);
+	BOOST_TEST(counters.getByOther()[(size_t) Counters::Other::SIMULATION_PROCESS].count == 40);
+	BOOST_TEST(counters.getByOther()[(size_t) Counters::Other::EVENT_CALLBACKS].count == 0);
+
+	// Threads that exited are idle, even once their slots are reused by new threads.
+	sampleThreads(6, Counters::Other::EVENT_CALLBACKS, 10);
+	BOOST_TEST(counters.getByOther()[(size_t) Counters::Other::SIMULATION_PROCESS].count == 40);
+	BOOST_TEST(counters.getByOther()[(size_t) Counters::Other::EVENT_CALLBACKS].count == 60);
+
+	// No thread is active anymore.
+	counters.tick();
+	BOOST_TEST(counters.getByOther()[(size_t) Counters::Other::SIMULATION_PROCESS].count == 40);
+	BOOST_TEST(counters.getByOther()[(size_t) Counters::Other::EVENT_CALLBACKS].count == 60);
+	BOOST_TEST(counters.getByOther()[(size_t) Counters::Other::COMPILATION].count == 0);
+}
+
+namespace {
+
+// The topological sort as it was before it worked on a GraphSnapshot: checks all inputs of each driven node whenever an output becomes ready.
+std::vector<gtry::hlim::BaseNode*> fullScanTopologicalSort(const gtry::hlim::Subnet &subnet)
+{
+	using namespace gtry;
+
+	std::vector<hlim::BaseNode*> sortedNodes;
+	utils::UnstableSet<hlim::BaseNode*> unsortedNodes(subnet);
+	utils::UnstableSet<hlim::NodePort> outputsReady;
+
+	auto allInputsReady = [&](hlim::BaseNode *node)->bool {
+		for (auto i : utils::Range(node->getNumInputPorts())) {
+			auto driver = node->getDriver(i);
+			if (driver.node == nullptr) continue;
+			if (!subnet.contains(driver.node)) continue;
+			if (driver.node->getOutputType(driver.port) == hlim::NodeIO::OUTPUT_LATCHED) continue;
+			if (outputsReady.contains(driver)) continue;
+			return false;
+		}
+		return true;
+	};
+
+	std::vector<hlim::BaseNode*> nodesReady;
+	for (auto *node : subnet)
+		if (allInputsReady(node))
+			nodesReady.push_back(node);
+
+	while (!nodesReady.empty()) {
+		auto *node = nodesReady.back();
+		nodesReady.pop_back();
+		if (!unsortedNodes.contains(node)) continue;
+		unsortedNodes.erase(node);
+		sortedNodes.push_back(node);
+
+		for (auto i : utils::Range(node->getNumOutputPorts()))
+			outputsReady.insert({.node=node, .port=i});
+
+		for (auto i : utils::Range(node->getNumOutputPorts()))
+			for (auto np : node->getDirectlyDriven(i))
+				if (allInputsReady(np.node))
+					nodesReady.push_back(np.node);
+	}
+	return sortedNodes;
+}
+
+void checkSnapshotMatchesCircuit(const gtry::hlim::Subnet &subnet)
+{
+	using namespace gtry;
+
+	hlim::GraphSnapshot graph(subnet);
+	BOOST_TEST(graph.numNodes() == subnet.size());
+
+	for (auto *node : subnet) {
+		auto nodeIdx = graph.getNodeIndex(node);
+		BOOST_TEST_REQUIRE(nodeIdx != hlim::GraphSnapshot::INVALID);
+		BOOST_CHECK(graph.getNode(nodeIdx) == node);
+		BOOST_CHECK(graph.getNodeKind(nodeIdx) == typeid(*node));
+		BOOST_TEST_REQUIRE(graph.getNumInputPorts(nodeIdx) == node->getNumInputPorts());
+		BOOST_TEST_REQUIRE(graph.getNumOutputPorts(nodeIdx) == node->getNumOutputPorts());
+
+		for (auto i : utils::Range(node->getNumInputPorts())) {
+			auto driver = node->getDriver(i);
+			auto snapshotDriver = graph.getDriver(graph.getInput(nodeIdx, i));
+			if (driver.node == nullptr || !subnet.contains(driver.node))
+				BOOST_TEST(snapshotDriver == hlim::GraphSnapshot::INVALID);
+			else
+				BOOST_CHECK(graph.getNodePort(snapshotDriver) == driver);
+		}
+
+		for (auto i : utils::Range(node->getNumOutputPorts())) {
+			auto output = graph.getOutput(nodeIdx, i);
+			BOOST_TEST(graph.getOutput({.node = node, .port = i}) == output);
+			BOOST_TEST(graph.getOutputWidth(output) == node->getOutputConnectionType(i).width);
+			BOOST_TEST(graph.getOutputType(output) == node->getOutputType(i));
+
+			std::vector<hlim::NodePort> expectedDriven;
+			for (auto np : node->getDirectlyDriven(i))
+				if (subnet.contains(np.node))
+					expectedDriven.push_back(np);
+
+			auto driven = graph.getDriven(output);
+			BOOST_TEST_REQUIRE(driven.size() == expectedDriven.size());
+			for (auto j : utils::Range(driven.size())) {
+				auto nodeOfInput = graph.getNode(graph.getInputNode(driven[j]));
+				BOOST_CHECK(nodeOfInput == expectedDriven[j].node);
+				BOOST_TEST(graph.getInputPort(driven[j]) == expectedDriven[j].port);
+			}
+		}
+	}
+
+	hlim::TopologicalSort sorter;
+	auto sorted = sorter.sort(subnet);
+	BOOST_CHECK(sorted == fullScanTopologicalSort(subnet));
+}
+
+}
+
+BOOST_FIXTURE_TEST_CASE(GraphSnapshot_MatchesCircuit, BoostUnitTestSimulationFixture)
+{
+	using namespace gtry;
+
+	Clock clock({ .absoluteFrequency = 100'000'000 });
+	ClockScope clkScp(clock);
+
+	UInt a = pinIn(8_b);
+	UInt b = pinIn(8_b);
+	Bit sel = pinIn();
+
+	UInt counter = 8_b;
+	counter = reg(counter + 1, 0);
+
+	UInt sum = a + b;
+	UInt output = mux(sel, { sum, counter ^ a });
+	output = reg(output + sum, 0);
+	pinOut(output);
+	pinOut(sum.upper(4_b));
+
+	design.postprocess();
+
+	auto all = hlim::Subnet::all(design.getCircuit());
+	checkSnapshotMatchesCircuit(all);
+
+	// Connections that leave the subnet have to be treated as unconnected
+	hlim::Subnet partial;
+	for (auto *node : all)
+		if (node->getId() % 3 != 0)
+			partial.add(node);
+	checkSnapshotMatchesCircuit(partial);
+
+	// Few nodes with far apart ids are not indexed through a table
+	hlim::Subnet scattered;
+	for (auto *node : all)
+		if (node->getId() % 8 == 0)
+			scattered.add(node);
+	checkSnapshotMatchesCircuit(scattered);
+}
+
+namespace {
+
+// Builds a design with many node groups containing muxes whose inputs are partly irrelevant, postprocesses it, and returns a listing of all nodes and their drivers.
+std::string postprocessedNetlist(size_t numPostprocessingThreads)
+{
+	using namespace gtry;
+
+	DesignScope design;
+	design.getCircuit().setNumPostprocessingThreads(numPostprocessingThreads);
+
+	Clock clock({ .absoluteFrequency = 100'000'000 });
+	ClockScope clkScp(clock);
+
+	Bit sel = pinIn();
+	UInt a = pinIn(8_b);
+	UInt b = pinIn(8_b);
+
+	for (auto i : utils::Range(16)) {
+		Area area("area" + std::to_string(i), true);
+
+		UInt offset = ConstUInt(i, 8_b);
+		UInt value = a + offset;
+		IF (sel) {
+			// Only the true branch of the inner condition is ever relevant
+			IF (sel)
+				value = b ^ offset;
+			ELSE
+				value = a - offset;
+		}
+		pinOut(reg(value, 0));
+	}
+
+	design.postprocess();
+
+	std::stringstream netlist;
+	for (const auto &node : design.getCircuit().getNodes()) {
+		netlist << node->getId() << ' ' << node->getTypeName() << ':';
+		for (auto i : utils::Range(node->getNumInputPorts())) {
+			auto driver = node->getDriver(i);
+			if (driver.node == nullptr)
+				netlist << " -";
+			else
+				netlist << ' ' << driver.node->getId() << '.' << driver.port;
+		}
+		netlist << '\n';
+	}
+	return netlist.str();
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(Postprocessing_MultiThreadedMatchesSingleThreaded)
+{
+	auto singleThreaded = postprocessedNetlist(1);
+	BOOST_TEST(singleThreaded == postprocessedNetlist(4));
+	BOOST_TEST(singleThreaded == postprocessedNetlist(0));
+}
+
+BOOST_FIXTURE_TEST_CASE(LocalRewriter_FoldsConstantChain, BoostUnitTestSimulationFixture)
+{
+	using namespace gtry;
+
+	hlim::Node_Pin *outPin;
+	{
+		UInt a = ConstUInt(3, 8_b);
+		UInt b = a + ConstUInt(4, 8_b);
+		UInt c = b + ConstUInt(1, 8_b);
+		outPin = pinOut(c ^ ConstUInt(0x0F, 8_b)).node();
+	}
+
+	auto subnet = hlim::Subnet::all(design.getCircuit());
+	hlim::LocalRewriter rewriter(design.getCircuit(), subnet);
+	rewriter.addDefaultRules();
+	rewriter.enqueueAll();
+	// Only folding the first adder makes the rest of the chain foldable.
+	BOOST_TEST(rewriter.run() >= 3);
+
+	auto driver = outPin->getNonSignalDriver(0);
+	auto *constant = dynamic_cast<hlim::Node_Constant*>(driver.node);
+	BOOST_TEST_REQUIRE(constant != nullptr);
+	BOOST_TEST(constant->getValue().extractNonStraddling(sim::DefaultConfig::VALUE, 0, 8) == (8 ^ 0x0F));
+	BOOST_TEST(constant->getValue().extractNonStraddling(sim::DefaultConfig::DEFINED, 0, 8) == 0xFF);
+}
@@ -147,6 +147,71 @@ BOOST_DATA_TEST_CASE_F(BoostUnitTestSimulationFixture, BigIntCompare, data::make
 	});
 
 
+	design.postprocess();
+
+	runTest({ 1,1000 });
+}
+
+BOOST_DATA_TEST_CASE_F(BoostUnitTestSimulationFixture, BigIntLogicMux, data::make({60, 65, 128, 260, 1024}), bitsize)
+{
+	using namespace gtry;
+
+	UInt a = pinIn(BitWidth((size_t)bitsize));
+	UInt b = pinIn(BitWidth((size_t)bitsize));
+	Bit sel = pinIn();
+
+	UInt andOut = a & b;
+	UInt orOut = a | b;
+	UInt xorOut = a ^ b;
+	UInt notOut = ~a;
+	UInt muxOut = mux(sel, { a, b });
+	UInt muxSameOut = mux(sel, { a, a });
+	Bit le = a < b;
+	Bit eq = a == b;
+
+	addSimulationProcess([=, this]()->SimProcess {
+		BigInt mask = (BigInt(1) << (size_t)bitsize)-1;
+
+		boost::random::mt19937 mt;
+		boost::random::uniform_int_distribution<sim::BigInt> ui(0, mask);
+
+		for (auto i : gtry::utils::Range(100)) {
+			sim::BigInt in1 = ui(mt);
+			// Also compare values that only differ in their lowest bit.
+			sim::BigInt in2 = i % 4 == 0 ? sim::BigInt(in1 ^ 1) : ui(mt);
+
+			simu(a) = in1;
+			simu(b) = in2;
+			simu(sel) = i % 2 == 1;
+
+			co_await WaitFor({1,1000000});
+
+			BOOST_TEST(simu(andOut).allDefined());
+			BOOST_TEST((sim::BigInt)simu(andOut) == (in1 & in2));
+			BOOST_TEST((sim::BigInt)simu(orOut) == (in1 | in2));
+			BOOST_TEST((sim::BigInt)simu(xorOut) == (in1 ^ in2));
+			BOOST_TEST(simu(notOut).allDefined());
+			BOOST_TEST((sim::BigInt)simu(notOut) == (sim::bitwiseNegation(in1, bitsize) & mask));
+
+			BOOST_TEST(simu(muxOut).allDefined());
+			BOOST_TEST((sim::BigInt)simu(muxOut) == (i % 2 == 1 ? in2 : in1));
+
+			BOOST_TEST(simu(le) == (in1 < in2));
+			BOOST_TEST(simu(eq) == (in1 == in2));
+
+			// With an undefined selector, only bits on which both inputs agree stay defined.
+			simu(sel).invalidate();
+			co_await WaitFor({1,1000000});
+
+			BOOST_TEST(simu(muxSameOut).allDefined());
+			BOOST_TEST((sim::BigInt)simu(muxSameOut) == in1);
+			BOOST_TEST(!simu(muxOut).allDefined());
+		}
+
+		stopTest();
+	});
+
+
 	design.postprocess();
 
 	runTest({ 1,1000 });
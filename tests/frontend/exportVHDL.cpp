@@ -26,6 +26,7 @@
 #include <boost/test/data/monomorphic.hpp>
 
 #include <thread>
+#include <fstream>
 
 
 using namespace boost::unit_test;
@@ -1214,6 +1215,45 @@ BOOST_FIXTURE_TEST_CASE(tristateBitIntoParent, gtry::GHDLTestFixture)
 }
 
 
+BOOST_FIXTURE_TEST_CASE(testbenchWithTristatePinAndReset, gtry::GHDLTestFixture)
+{
+	using namespace gtry;
+
+	Clock clock({ .absoluteFrequency = 10'000, .resetType = Clock::ResetType::SYNCHRONOUS });
+	ClockScope clockScope(clock);
+
+	UInt value = pinIn(8_b).setName("value");
+	Bit enable = pinIn().setName("enable");
+	UInt readback = tristatePin(value, enable).setName("tristatePin");
+	UInt delayed = reg(readback, 0);
+	pinOut(delayed).setName("delayed");
+
+	addSimulationProcess([=, this]()->SimProcess {
+		simu(enable) = '1';
+		for (auto i : gtry::utils::Range(20)) {
+			simu(value) = i;
+			co_await AfterClk(clock);
+			if (i >= 4)
+				BOOST_TEST(simu(delayed) == i);
+		}
+
+		stopTest();
+	});
+
+	// The tristate pin is an input and an output of the design, but the testbench must only have one case choice for it per command.
+	runTest({ 1,1 });
+
+	std::ifstream testVectors((m_cwd / "testbench.testvectors").string().c_str());
+	BOOST_TEST((bool) testVectors);
+	std::set<char> commands;
+	std::string line;
+	while (std::getline(testVectors, line))
+		if (!line.empty())
+			commands.insert(line[0]);
+	BOOST_TEST((commands == std::set<char>{ 'S', 'C', 'R', 'A' }));
+}
+
+
 
 BOOST_FIXTURE_TEST_CASE(IgnoreSimulationOnlyPins, gtry::GHDLTestFixture)
 {
@@ -1767,4 +1767,76 @@ BOOST_FIXTURE_TEST_CASE(memory_storage_comparison_background_large, MemoryStorag
 	numIterations = 10'000;
 
 	execute();
-}
\ No newline at end of file
+}
+
+BOOST_DATA_TEST_CASE_F(BoostUnitTestSimulationFixture, SimulatorModes_Memory, data::make({false, true}) * data::make({1, 4}), activityDriven, numThreads)
+{
+	using namespace gtry;
+	using namespace gtry::sim;
+	using namespace gtry::utils;
+
+	m_compileOptions.activityDrivenEvaluation = activityDriven;
+	m_compileOptions.numThreads = numThreads;
+
+	Clock clock({ .absoluteFrequency = 100'000'000 });
+	ClockScope clkScp(clock);
+
+	std::vector<size_t> contents;
+	contents.resize(16);
+	std::mt19937 rng{ 18055 };
+	for (auto &e : contents)
+		e = rng() % 16;
+
+	Memory<UInt> mem(contents.size(), 4_b);
+	mem.noConflicts();
+
+	UInt addr = pinIn(4_b);
+	UInt readAddr = pinIn(4_b);
+	auto output = pinOut(mem[readAddr]);
+	UInt input = pinIn(4_b);
+	Bit wrEn = pinIn();
+	IF (wrEn)
+		mem[addr] = input;
+
+	addSimulationProcess([=,this,&contents]()->SimProcess {
+
+		simu(wrEn) = '0';
+		simu(readAddr) = 3;
+		co_await AfterClk(clock);
+
+		simu(wrEn) = '1';
+		for (auto i : Range(16)) {
+			simu(addr) = i;
+			simu(input) = contents[i];
+			co_await AfterClk(clock);
+			// The read port's inputs do not change, but the memory content behind it does.
+			if (i >= 3)
+				BOOST_TEST(simu(output) == contents[3]);
+			else
+				BOOST_TEST(!simu(output).allDefined());
+		}
+		simu(wrEn) = '0';
+
+		for (auto i : Range(16)) {
+			simu(readAddr) = i;
+			co_await WaitStable();
+			BOOST_TEST(simu(output) == contents[i]);
+			co_await AfterClk(clock);
+		}
+
+		stopTest();
+	});
+
+	design.postprocess();
+	runTest(hlim::ClockRational(100, 1) / clock.getClk()->absoluteFrequency());
+}
+BOOST_TEST(simu(output) == contents[i]);
+			co_await AfterClk(clock);
+		}
+
+		stopTest();
+	});
+
+	design.postprocess();
+	runTest(hlim::ClockRational(100, 1) / clock.getClk()->absoluteFrequency());
+}
@@ -19,6 +19,7 @@
 
 #include <gatery/frontend.h>
 #include <gatery/hlim/RegisterRetiming.h>
+#include <gatery/hlim/SignalDelay.h>
 #include <gatery/hlim/Subnet.h>
 #include <gatery/hlim/coreNodes/Node_Signal.h>
 #include <gatery/hlim/coreNodes/Node_Register.h>
@@ -2134,4 +2135,55 @@ BOOST_FIXTURE_TEST_CASE(retiming_forward_incompatible_enables, BoostUnitTestSimu
 	pinOut(output).setName("output");
 
 	BOOST_REQUIRE_THROW(design.postprocess(), gtry::utils::DesignError);
-}
\ No newline at end of file
+}
+
+BOOST_FIXTURE_TEST_CASE(retiming_forward_incremental_delays, BoostUnitTestSimulationFixture)
+{
+	using namespace gtry;
+	using namespace gtry::utils;
+
+	Clock clock({ .absoluteFrequency = 100'000'000 });
+	ClockScope clkScp(clock);
+
+	UInt a = pinIn(32_b);
+	UInt b = pinIn(32_b);
+	UInt c = pinIn(32_b);
+
+	UInt sum = reg(a, {.allowRetimingForward=true}) + reg(b, {.allowRetimingForward=true});
+	sum = sum + reg(c, {.allowRetimingForward=true});
+	UInt output = sum ^ c;
+
+	stripSignalNodes(design.getCircuit());
+	auto subnet = hlim::Subnet::all(design.getCircuit());
+	design.getCircuit().optimizeSubnet(subnet);
+
+	hlim::SignalDelay delays;
+	delays.compute(subnet);
+
+	hlim::Subnet changedNodes;
+	hlim::Subnet rewiredNodes;
+	BOOST_REQUIRE(retimeForwardToOutput(design.getCircuit(), subnet, output.readPort(), {.ignoreRefs=true, .newNodes=&changedNodes, .rewiredNodes=&rewiredNodes}));
+	BOOST_CHECK(!changedNodes.empty());
+	for (auto *n : rewiredNodes)
+		changedNodes.add(n);
+	delays.update(subnet, changedNodes);
+
+	hlim::SignalDelay recomputed;
+	recomputed.compute(subnet);
+
+	for (auto *n : subnet)
+		for (auto i : Range(n->getNumOutputPorts())) {
+			hlim::NodePort np{.node = n, .port = i};
+			if (hlim::outputIsDependency(np)) continue;
+			BOOST_TEST_REQUIRE(delays.contains(np));
+			auto incremental = delays.getDelay(np);
+			auto full = recomputed.getDelay(np);
+			BOOST_TEST(std::vector<float>(incremental.begin(), incremental.end()) == std::vector<float>(full.begin(), full.end()), boost::test_tools::per_element());
+		}
+
+	auto incrementalCritical = delays.getCriticalBit();
+	auto fullCritical = recomputed.getCriticalBit();
+	BOOST_CHECK(incrementalCritical.output == fullCritical.output);
+	BOOST_TEST(incrementalCritical.bit == fullCritical.bit);
+	BOOST_TEST(incrementalCritical.delay == fullCritical.delay);
+}
@@ -18,6 +18,7 @@
 #include "frontend/pch.h"
 
 #include <gatery/simulation/Simulator.h>
+#include <gatery/simulation/ReferenceSimulator.h>
 #include <gatery/simulation/simProc/SimulationFiber.h>
 
 #include <boost/test/unit_test.hpp>
@@ -1122,3 +1123,529 @@ BOOST_FIXTURE_TEST_CASE(SimFromThread, BoostUnitTestSimulationFixture)
 
 */
 
+BOOST_FIXTURE_TEST_CASE(ActivityDriven_WaitChange, BoostUnitTestSimulationFixture)
+{
+	using namespace gtry;
+
+	m_compileOptions.activityDrivenEvaluation = true;
+
+	Clock clock({ .absoluteFrequency = 10'000, .resetType = ClockConfig::ResetType::NONE });
+	ClockScope clkScp(clock);
+
+	Bit toggle;
+	toggle = reg(!toggle, '0');
+	auto togglePin = pinOut(toggle);
+
+	addSimulationProcess([=,this]()->SimProcess{
+		co_await OnClk(clock);
+		for ([[maybe_unused]] auto i : Range(10)) {
+			ReadSignalList allInputs;
+			bool before = simu(togglePin) == '1';
+			co_await allInputs.anyInputChange();
+			BOOST_TEST((simu(togglePin) == '1') != before);
+		}
+		stopTest();
+	});
+
+	design.postprocess();
+	runTest(hlim::ClockRational(100, 1) / clock.getClk()->absoluteFrequency());
+}
+
+BOOST_DATA_TEST_CASE_F(BoostUnitTestSimulationFixture, Batch_Accumulator, data::make({1, 4}), numThreads)
+{
+	using namespace gtry;
+
+	const size_t batchSize = 4;
+	m_compileOptions.batchSize = batchSize;
+	m_compileOptions.numThreads = numThreads;
+
+	Clock clock({ .absoluteFrequency = 10'000, .resetType = ClockConfig::ResetType::NONE });
+	ClockScope clkScp(clock);
+
+	auto incrementPin = pinIn(8_b);
+	UInt accumulator(8_b);
+	accumulator = reg(accumulator, 0);
+	auto accumulatorPin = pinOut(accumulator);
+	accumulator += incrementPin;
+
+	auto instancesDone = std::make_shared<std::vector<bool>>(batchSize, false);
+
+	addSimulationProcess([=,this]()->SimProcess{
+		size_t batchIndex = simulationBatchIndex();
+		BOOST_TEST(batchIndex < batchSize);
+
+		// Each instance drives its own stimulus and must only ever see its own accumulator.
+		std::mt19937 rng{ (unsigned) batchIndex };
+		size_t expected = 0;
+
+		co_await OnClk(clock);
+		for ([[maybe_unused]] auto i : Range(20)) {
+			size_t increment = rng() % 256;
+			simu(incrementPin) = increment;
+			co_await AfterClk(clock);
+
+			expected = (expected + increment) % 256;
+			BOOST_TEST(simu(accumulatorPin) == expected);
+		}
+
+		(*instancesDone)[batchIndex] = true;
+		if (std::all_of(instancesDone->begin(), instancesDone->end(), [](bool done) { return done; }))
+			stopTest();
+	});
+
+	design.postprocess();
+	runTest(hlim::ClockRational(100, 1) / clock.getClk()->absoluteFrequency());
+	for (auto done : *instancesDone)
+		BOOST_TEST(done);
+}
+
+BOOST_DATA_TEST_CASE_F(BoostUnitTestSimulationFixture, Batch_RejectsUnsupportedModes, data::make({false, true}), activityDriven)
+{
+	using namespace gtry;
+
+	Clock clock({ .absoluteFrequency = 10'000 });
+	ClockScope clkScp(clock);
+
+	UInt counter = 8_b;
+	counter = reg(counter + 1, 0);
+	pinOut(counter);
+
+	design.postprocess();
+
+	sim::CompileOptions options;
+	options.batchSize = 4;
+	options.activityDrivenEvaluation = activityDriven;
+	options.twoStateEvaluation = !activityDriven;
+
+	sim::ReferenceSimulator simulator(false);
+	BOOST_CHECK_THROW(simulator.compileProgram(design.getCircuit(), {}, options), gtry::utils::DesignError);
+}
+
+BOOST_FIXTURE_TEST_CASE(EventQueue_MixedClocksAndWaits, BoostUnitTestSimulationFixture)
+{
+	using namespace gtry;
+
+	// The clocks make for a fine tick (1/2002000 s) so that long waits exceed the range of the timing wheel
+	Clock clockA({ .absoluteFrequency = 1000, .resetType = ClockConfig::ResetType::NONE });
+	Clock clockB({ .absoluteFrequency = 1001, .resetType = ClockConfig::ResetType::NONE });
+
+	auto counter = [](const Clock &clock) {
+		ClockScope clkScp(clock);
+		UInt counter(16_b);
+		counter = reg(counter, 0);
+		auto counterPin = pinOut(counter);
+		counter += 1;
+		return counterPin;
+	};
+	auto counterA = counter(clockA);
+	auto counterB = counter(clockB);
+
+	auto checkClock = [this](Clock clock, OutputPins counterPin)->SimProcess {
+		co_await OnClk(clock);
+		auto lastEdge = m_simulator->getCurrentSimulationTime();
+		size_t lastCount = simu(counterPin);
+		while (true) {
+			co_await OnClk(clock);
+			BOOST_TEST(m_simulator->getCurrentSimulationTime() == lastEdge + Seconds(1) / clock.absoluteFrequency());
+			BOOST_TEST(simu(counterPin) == (lastCount + 1) % (1 << 16));
+			lastEdge = m_simulator->getCurrentSimulationTime();
+			lastCount = simu(counterPin);
+		}
+	};
+	addSimulationProcess([=]() { return checkClock(clockA, counterA); });
+	addSimulationProcess([=]() { return checkClock(clockB, counterB); });
+
+	addSimulationProcess([=, this]()->SimProcess {
+		// Off-tick durations
+		for ([[maybe_unused]] auto i : Range(10)) {
+			auto before = m_simulator->getCurrentSimulationTime();
+			co_await WaitFor(Seconds(1, 3) / clockA.absoluteFrequency());
+			BOOST_TEST(m_simulator->getCurrentSimulationTime() == before + Seconds(1, 3) / clockA.absoluteFrequency());
+		}
+		// Beyond the range of the timing wheel
+		auto before = m_simulator->getCurrentSimulationTime();
+		co_await WaitFor(Seconds(10));
+		BOOST_TEST(m_simulator->getCurrentSimulationTime() == before + Seconds(10));
+
+		stopTest();
+	});
+
+	design.postprocess();
+	runTest(Seconds(11));
+}
+
+BOOST_FIXTURE_TEST_CASE(SignalWatch_ManyWatchers, BoostUnitTestSimulationFixture)
+{
+	using namespace gtry;
+
+	Clock clock({ .absoluteFrequency = 10'000, .resetType = ClockConfig::ResetType::NONE });
+	ClockScope clkScp(clock);
+
+	UInt counter(16_b);
+	counter = reg(counter, 0);
+	auto counterPin = pinOut(counter);
+	std::vector<OutputPin> bitPins;
+	for (auto i : Range(8))
+		bitPins.push_back(pinOut(counter[i]));
+	counter += 1;
+
+	struct Watcher {
+		size_t bit;
+		size_t startValue = 0;
+		size_t numChanges = 0;
+	};
+	auto watchers = std::make_shared<std::vector<Watcher>>();
+	// The watchers of all bits share state words, so most of them must not wake up when a word changes.
+	for (auto bit : Range(8))
+		for ([[maybe_unused]] auto i : Range(bit == 0 ? 100 : 4))
+			watchers->push_back({ .bit = bit });
+
+	for (auto w : Range(watchers->size()))
+		addSimulationProcess([=]()->SimProcess {
+			auto &watcher = (*watchers)[w];
+			co_await OnClk(clock);
+			watcher.startValue = simu(counterPin);
+			while (true) {
+				ReadSignalList signals;
+				bool before = simu(bitPins[watcher.bit]) == '1';
+				co_await signals.anyInputChange();
+				BOOST_TEST((simu(bitPins[watcher.bit]) == '1') != before);
+				watcher.numChanges++;
+			}
+		});
+
+	addSimulationProcess([=,this]()->SimProcess {
+		for ([[maybe_unused]] auto i : Range(64))
+			co_await AfterClk(clock);
+		co_await WaitFor(Seconds(1, 4) / clock.absoluteFrequency());
+
+		size_t endValue = simu(counterPin);
+		for (const auto &watcher : *watchers)
+			BOOST_TEST(watcher.numChanges == (endValue >> watcher.bit) - (watcher.startValue >> watcher.bit));
+		stopTest();
+	});
+
+	design.postprocess();
+	runTest(hlim::ClockRational(100, 1) / clock.getClk()->absoluteFrequency());
+}
+
+BOOST_FIXTURE_TEST_CASE(SigHandle_InPlaceAccess, BoostUnitTestSimulationFixture)
+{
+	using namespace gtry;
+
+	Clock clock({ .absoluteFrequency = 10'000, .resetType = ClockConfig::ResetType::NONE });
+	ClockScope clkScp(clock);
+
+	// Widths that do not fill their state words, next to a full word and a signal spanning several words.
+	UInt narrow = pinIn(3_b);
+	UInt odd = pinIn(17_b);
+	UInt full = pinIn(64_b);
+	UInt wide = pinIn(96_b);
+	Bit bit = pinIn();
+
+	auto narrowPin = pinOut(narrow + 1);
+	auto oddPin = pinOut(odd ^ 0x1'5555);
+	auto fullPin = pinOut(full);
+	auto widePin = pinOut(wide);
+	auto bitPin = pinOut(!bit);
+
+	addSimulationProcess([=,this]()->SimProcess {
+		std::mt19937_64 rng{ 4321 };
+
+		// Handles that are kept are bound to their state offsets when they are created.
+		auto oddIn = simu(odd);
+		auto oddOut = simu(oddPin);
+
+		co_await OnClk(clock);
+		for ([[maybe_unused]] auto i : Range(20)) {
+			std::uint64_t n = rng() % 8;
+			std::uint64_t o = rng() % (1 << 17);
+			std::uint64_t f = rng();
+			std::vector<std::uint32_t> w = { (std::uint32_t) rng(), (std::uint32_t) rng(), (std::uint32_t) rng() };
+			bool b = rng() % 2;
+
+			simu(narrow) = n;
+			oddIn = o;
+			simu(full) = f;
+			simu(wide) = w;
+			simu(bit) = b;
+			co_await WaitStable();
+
+			BOOST_TEST(simu(narrowPin) == (n + 1) % 8);
+			BOOST_TEST(oddOut == (o ^ 0x1'5555));
+			BOOST_TEST(oddOut.allDefined());
+			BOOST_TEST(simu(fullPin) == f);
+			BOOST_TEST(simu(fullPin).defined() == ~0ull);
+			BOOST_TEST(simu(widePin) == w);
+			BOOST_TEST(simu(bitPin) == (b ? '0' : '1'));
+			BOOST_TEST((bool) simu(bitPin) == !b);
+
+			co_await AfterClk(clock);
+		}
+
+		oddIn.invalidate();
+		co_await WaitStable();
+		BOOST_TEST(oddOut.defined() == 0);
+		BOOST_TEST(!oddOut.allDefined());
+
+		stopTest();
+	});
+
+	design.postprocess();
+	runTest(hlim::ClockRational(100, 1) / clock.getClk()->absoluteFrequency());
+}
+
+BOOST_FIXTURE_TEST_CASE(SigHandle_SharedBetweenVariants, BoostUnitTestSimulationFixture)
+{
+	using namespace gtry;
+
+	Clock clock({ .absoluteFrequency = 10'000 });
+	ClockScope clkScp(clock);
+
+	UInt increment = pinIn(8_b);
+	UInt accumulator = 8_b;
+	accumulator = reg(accumulator + increment, 0);
+	pinOut(accumulator);
+
+	design.postprocess();
+
+	// Created outside of any simulation and read concurrently by all variants, which must not modify it.
+	auto sharedAccumulator = simu(accumulator);
+
+	hlim::ClockRational cycle(1, 10'000);
+	sim::ReferenceSimulator prefix(false);
+	prefix.addSimulationProcess([&]()->SimProcess { simu(increment) = 0; co_return; });
+	prefix.compileProgram(design.getCircuit());
+	prefix.powerOn();
+	prefix.advance(cycle * 10);
+
+	std::vector<size_t> mismatchesOfVariant(8);
+	prefix.forkVariants(mismatchesOfVariant.size(), 
+		[&](size_t variant, sim::ReferenceSimulator &simulator) {
+			simulator.addSimulationProcess([&, variant]()->SimProcess {
+				simu(increment) = variant;
+				for ([[maybe_unused]] auto i : Range(200)) {
+					co_await OnClk(clock);
+					if (sharedAccumulator.value() != simu(accumulator).value())
+						mismatchesOfVariant[variant]++;
+				}
+			});
+		},
+		[&](size_t variant, sim::ReferenceSimulator &simulator) {
+			simulator.advance(cycle * 200);
+		}
+	);
+
+	for (auto mismatches : mismatchesOfVariant)
+		BOOST_TEST(mismatches == 0);
+}
+
+BOOST_FIXTURE_TEST_CASE(Checkpoint_RestoreIntoFreshSimulator, BoostUnitTestSimulationFixture)
+{
+	using namespace gtry;
+
+	Clock clock({ .absoluteFrequency = 10'000 });
+	ClockScope clkScp(clock);
+
+	UInt counter = 16_b;
+	counter = reg(counter + 1, 0);
+	auto counterPin = pinOut(counter);
+
+	design.postprocess();
+
+	hlim::ClockRational cycle(1, 10'000);
+	auto readCounter = [&](sim::Simulator &simulator) {
+		return simulator.getValueOfOutput(counterPin.node()->getDriver(0)).extractNonStraddling(sim::DefaultConfig::VALUE, 0, 16);
+	};
+
+	size_t numResumedProcesses = 0;
+	auto process = [&]()->SimProcess {
+		if (simulationResumedFromCheckpoint())
+			numResumedProcesses++;
+		co_return;
+	};
+
+	sim::ReferenceSimulator original(false);
+	original.addSimulationProcess(process);
+	original.compileProgram(design.getCircuit());
+	original.powerOn();
+	original.advance(cycle * 100);
+
+	std::stringstream file;
+	original.saveCheckpoint()->save(file);
+	original.advance(cycle * 50);
+
+	sim::ReferenceSimulator restored(false);
+	restored.addSimulationProcess(process);
+	restored.compileProgram(design.getCircuit());
+	auto checkpoint = restored.loadCheckpoint(file);
+	BOOST_TEST(checkpoint->simulationTime == cycle * 100);
+	restored.restoreCheckpoint(*checkpoint);
+	BOOST_TEST(readCounter(restored) != 0);
+	restored.advance(cycle * 50);
+
+	BOOST_TEST(numResumedProcesses == 1);
+	BOOST_TEST(restored.getCurrentSimulationTime() == original.getCurrentSimulationTime());
+	BOOST_TEST(readCounter(restored) == readCounter(original));
+}
+
+BOOST_FIXTURE_TEST_CASE(Checkpoint_RejectsDifferentStateLayout, BoostUnitTestSimulationFixture)
+{
+	using namespace gtry;
+
+	Clock clock({ .absoluteFrequency = 10'000 });
+	ClockScope clkScp(clock);
+
+	UInt counter = 16_b;
+	counter = reg(counter + 1, 0);
+	pinOut(counter);
+
+	design.postprocess();
+
+	sim::ReferenceSimulator original(false);
+	original.compileProgram(design.getCircuit());
+	original.powerOn();
+	original.advance(hlim::ClockRational(10, 10'000));
+
+	std::stringstream file;
+	original.saveCheckpoint()->save(file);
+
+	// Flip a bit of the layout hash, which follows the magic, the version, the simulation time, and the state width.
+	std::string otherLayout = file.str();
+	otherLayout[5 * 8] ^= 1;
+	std::stringstream otherLayoutFile(otherLayout);
+
+	sim::ReferenceSimulator restored(false);
+	restored.compileProgram(design.getCircuit());
+	auto checkpoint = restored.loadCheckpoint(otherLayoutFile);
+	BOOST_TEST(checkpoint->simulationTime == original.getCurrentSimulationTime());
+	BOOST_CHECK_THROW(restored.restoreCheckpoint(*checkpoint), gtry::utils::DesignError);
+
+	restored.restoreCheckpoint(*restored.loadCheckpoint(file));
+	BOOST_TEST(restored.getCurrentSimulationTime() == original.getCurrentSimulationTime());
+}
+
+BOOST_FIXTURE_TEST_CASE(Checkpoint_ForkVariants, BoostUnitTestSimulationFixture)
+{
+	using namespace gtry;
+
+	Clock clock({ .absoluteFrequency = 10'000 });
+	ClockScope clkScp(clock);
+
+	UInt increment = pinIn(8_b);
+	UInt accumulator = 8_b;
+	accumulator = reg(accumulator + increment, 0);
+	auto accumulatorPin = pinOut(accumulator);
+
+	design.postprocess();
+
+	hlim::ClockRational cycle(1, 10'000);
+	auto readAccumulator = [&](sim::Simulator &simulator) {
+		return simulator.getValueOfOutput(accumulatorPin.node()->getDriver(0)).extractNonStraddling(sim::DefaultConfig::VALUE, 0, 8);
+	};
+
+	sim::ReferenceSimulator prefix(false);
+	prefix.addSimulationProcess([&]()->SimProcess { simu(increment) = 1; co_return; });
+	prefix.compileProgram(design.getCircuit());
+	prefix.powerOn();
+	prefix.advance(cycle * 100);
+	auto accumulatorAtFork = readAccumulator(prefix);
+
+	std::vector<std::uint64_t> accumulatorOfVariant(8);
+	prefix.forkVariants(accumulatorOfVariant.size(), 
+		[&](size_t variant, sim::ReferenceSimulator &simulator) {
+			simulator.addSimulationProcess([&increment, variant]()->SimProcess { simu(increment) = variant; co_return; });
+		},
+		[&](size_t variant, sim::ReferenceSimulator &simulator) {
+			simulator.advance(cycle * 10);
+			accumulatorOfVariant[variant] = readAccumulator(simulator);
+		}
+	);
+
+	for (auto variant : utils::Range(accumulatorOfVariant.size()))
+		BOOST_TEST((accumulatorOfVariant[variant] - accumulatorAtFork) % 256 == variant * 10);
+	BOOST_TEST(readAccumulator(prefix) == accumulatorAtFork);
+}
+
+BOOST_FIXTURE_TEST_CASE(SharedProgram_ReusedAcrossSimulators, BoostUnitTestSimulationFixture)
+{
+	using namespace gtry;
+
+	Clock clock({ .absoluteFrequency = 10'000 });
+	ClockScope clkScp(clock);
+
+	UInt counter = 8_b;
+	counter = reg(counter + 1, 0);
+	auto counterPin = pinOut(counter);
+
+	design.postprocess();
+
+	sim::CompileOptions options;
+	options.shareProgram = true;
+
+	sim::ReferenceSimulator first(false);
+	first.compileProgram(design.getCircuit(), {}, options);
+	sim::ReferenceSimulator second(false);
+	second.compileProgram(design.getCircuit(), {}, options);
+	BOOST_TEST(first.getProgram() == second.getProgram());
+	BOOST_TEST(first.getProgramId() == second.getProgramId());
+
+	options.activityDrivenEvaluation = true;
+	sim::ReferenceSimulator third(false);
+	third.compileProgram(design.getCircuit(), {}, options);
+	BOOST_TEST(first.getProgram() != third.getProgram());
+
+	hlim::ClockRational cycle(1, 10'000);
+	for (auto *simulator : { &first, &second, &third }) {
+		simulator->powerOn();
+		simulator->advance(cycle * (10 + (simulator == &second)));
+	}
+	auto readCounter = [&](sim::Simulator &simulator) {
+		return simulator.getValueOfOutput(counterPin.node()->getDriver(0)).extractNonStraddling(sim::DefaultConfig::VALUE, 0, 8);
+	};
+	BOOST_TEST((readCounter(second) - readCounter(first)) % 256 == 1);
+	BOOST_TEST(readCounter(third) == readCounter(first));
+}
+
+BOOST_FIXTURE_TEST_CASE(SharedProgram_HashCollision, BoostUnitTestSimulationFixture)
+{
+	using namespace gtry;
+
+	Clock clock({ .absoluteFrequency = 10'000 });
+	ClockScope clkScp(clock);
+
+	UInt counter = 8_b;
+	counter = reg(counter + 1, 0);
+	pinOut(counter);
+
+	design.postprocess();
+
+	auto nodes = hlim::Subnet::allForSimulation(design.getCircuit());
+	sim::SimulatorPerformanceCounters performanceCounters;
+	size_t numCompilations = 0;
+	auto compile = [&](bool buildFanOut) {
+		return [&, buildFanOut] {
+			numCompilations++;
+			auto program = std::make_shared<sim::Program>();
+			program->compileProgram(design.getCircuit(), nodes, performanceCounters, buildFanOut);
+			return program;
+		};
+	};
+
+	// Two different compilations whose keys land in the same bucket.
+	auto key = sim::Program::compilationKey(nodes, false, 1, sim::StateLayout::EVALUATION_ORDER);
+	auto collidingKey = sim::Program::compilationKey(nodes, true, 1, sim::StateLayout::EVALUATION_ORDER);
+	BOOST_TEST(key.data != collidingKey.data);
+	collidingKey.hash = key.hash;
+
+	auto program = sim::Program::findOrCompileShared(key, compile(false));
+	auto collidingProgram = sim::Program::findOrCompileShared(collidingKey, compile(true));
+	BOOST_TEST(program != collidingProgram);
+	BOOST_TEST(program->m_nodeToStep.empty());
+	BOOST_TEST(!collidingProgram->m_nodeToStep.empty());
+	BOOST_TEST(numCompilations == 2);
+
+	BOOST_TEST(sim::Program::findOrCompileShared(key, compile(false)) == program);
+	BOOST_TEST(sim::Program::findOrCompileShared(collidingKey, compile(true)) == collidingProgram);
+	BOOST_TEST(numCompilations == 2);
+}
@@ -23,6 +23,10 @@
 #include <boost/test/data/monomorphic.hpp>
 
 #include <gatery/utils/ConfigTree.h>
+#include <gatery/utils/IdSet.h>
+
+#include <random>
+#include <set>
 
 using namespace boost::unit_test;
 using namespace gtry::utils;
@@ -201,3 +205,102 @@ BOOST_AUTO_TEST_CASE(ConfigTreeRecorder)
 }
 
 #endif
+
+namespace {
+	struct IdentifiedObject {
+		std::uint64_t id;
+		std::uint64_t getId() const { return id; }
+	};
+}
+
+BOOST_AUTO_TEST_CASE(IdSetOrderAndSetAlgebra)
+{
+	std::vector<IdentifiedObject> objects(10000);
+	for (size_t i = 0; i < objects.size(); i++)
+		objects[i].id = i;
+
+	IdSet<IdentifiedObject*> a, b;
+	for (size_t i : { 9000, 3, 4096, 17, 5000 })
+		BOOST_TEST(a.insert(&objects[i]));
+	BOOST_TEST(!a.insert(&objects[17]));
+	for (size_t i : { 17, 4096, 8000 })
+		b.insert(&objects[i]);
+
+	std::vector<std::uint64_t> ids;
+	for (auto *o : a)
+		ids.push_back(o->id);
+	BOOST_TEST(ids == std::vector<std::uint64_t>({ 3, 17, 4096, 5000, 9000 }), boost::test_tools::per_element());
+	BOOST_TEST(a.size() == 5);
+	BOOST_TEST(a.contains(&objects[5000]));
+	BOOST_TEST(!a.contains(&objects[5001]));
+
+	auto joined = a;
+	joined.insert(b);
+	BOOST_TEST(joined.size() == 6);
+	BOOST_TEST(joined.contains(&objects[8000]));
+
+	auto difference = a;
+	difference.erase(b);
+	BOOST_TEST(difference.size() == 3);
+	BOOST_TEST(!difference.contains(&objects[17]));
+
+	auto intersection = a;
+	intersection.intersect(b);
+	BOOST_TEST(intersection.size() == 2);
+	BOOST_TEST(*intersection.begin() == &objects[17]);
+
+	BOOST_TEST(a.erase(&objects[3]));
+	BOOST_TEST(!a.erase(&objects[3]));
+	BOOST_TEST((*a.begin())->id == 17);
+}
+
+BOOST_AUTO_TEST_CASE(IdSetSparseAndDensePagesMatchStdSet)
+{
+	std::vector<IdentifiedObject> objects(20000);
+	for (size_t i = 0; i < objects.size(); i++)
+		objects[i].id = i;
+
+	std::mt19937 rng(1337);
+	// Few ids per page keep the pages sparse, many ids per page make them dense.
+	for (size_t range : { 200, 20000 }) {
+		IdSet<IdentifiedObject*> a, b;
+		std::set<std::uint64_t> refA, refB;
+		std::uniform_int_distribution<size_t> id(0, range-1);
+		for (size_t i = 0; i < 6000; i++) {
+			size_t x = id(rng) * (objects.size() / range);
+			switch (rng() % 4) {
+				case 0: BOOST_TEST(a.insert(&objects[x]) == refA.insert(x).second); break;
+				case 1: BOOST_TEST(a.erase(&objects[x]) == (refA.erase(x) != 0)); break;
+				default: b.insert(&objects[x]); refB.insert(x); break;
+			}
+		}
+
+		auto check = [](const IdSet<IdentifiedObject*> &set, const std::set<std::uint64_t> &ref) {
+			std::vector<std::uint64_t> ids;
+			for (auto *o : set)
+				ids.push_back(o->id);
+			BOOST_TEST(ids == std::vector<std::uint64_t>(ref.begin(), ref.end()), boost::test_tools::per_element());
+			BOOST_TEST(set.size() == ref.size());
+		};
+		check(a, refA);
+		check(b, refB);
+
+		auto joined = a;
+		joined.insert(b);
+		std::set<std::uint64_t> refJoined = refA;
+		refJoined.insert(refB.begin(), refB.end());
+		check(joined, refJoined);
+
+		auto difference = joined;
+		difference.erase(a);
+		std::set<std::uint64_t> refDifference;
+		std::set_difference(refJoined.begin(), refJoined.end(), refA.begin(), refA.end(), std::inserter(refDifference, refDifference.end()));
+		check(difference, refDifference);
+
+		auto intersection = b;
+		intersection.intersect(a);
+		std::set<std::uint64_t> refIntersection;
+		std::set_intersection(refB.begin(), refB.end(), refA.begin(), refA.end(), std::inserter(refIntersection, refIntersection.end()));
+		check(intersection, refIntersection);
+	}
+}
@@ -44,3 +44,17 @@ project "gatery-tutorial-test"
     defines "BOOST_TEST_DYN_LINK"
     filter "system:linux"
         links { "boost_unit_test_framework", "boost_filesystem", "boost_json", "pthread", "dl", "yaml-cpp" }
+
+project "gatery-bench"
+    kind "ConsoleApp"
+    files { "bench/**.cpp", "bench/**.h" }
+    links { "gatery_core", "gatery_scl" }
+    includedirs { "%{prj.location}/../source", "%{prj.location}/" }
+
+    pchheader "bench/pch.h"
+    pchsource "bench/pch.cpp"
+
+    GateryProjectDefaults()
+
+    filter "system:linux"
+        links { "boost_filesystem", "boost_json", "pthread", "dl", "yaml-cpp" }